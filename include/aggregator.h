@@ -0,0 +1,199 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "schema.h"
+
+// Rolling statistics over the packets reaching the ground station: min, max,
+// mean and standard deviation of every float column, per tumbling window at
+// several resolutions (1 s, 1 min and 1 h by default), plus a sliding window
+// over the last few closed windows of each. Updating costs the same per packet
+// however long the run: a packet only touches the open window of the finest
+// resolution, which folds into the next one up when it closes, and sliding
+// windows add the bucket that closed and subtract the one that fell out.
+//
+// One thread feeds it (GroundStationSink holds its lock); any number read it
+// without locking through seqlocked snapshots, which the writer publishes at
+// the end of every add() and whenever a window closes.
+
+struct FieldStats
+{
+  float min = 0;
+  float max = 0;
+  double mean = 0;
+  double stddev = 0; // population
+};
+
+// Statistics of the packets with start <= timestamp < start + width
+struct WindowStats
+{
+  uint64_t start = 0;
+  uint64_t width = 0;
+  uint64_t count = 0; // no field is meaningful when 0
+  std::array<FieldStats, kTelemetryFloatColumns> fields{};
+};
+
+// Widths are in timestamp units, i.e. seconds at the default dt
+struct AggregateResolution
+{
+  std::string name; // metric label, e.g. "1m"
+  uint64_t width;   // a multiple of the previous resolution's
+  size_t history;   // closed windows kept for history(), at least sliding
+  size_t sliding;   // closed windows the sliding window spans
+};
+
+struct AggregationConfig
+{
+  std::vector<AggregateResolution> resolutions{
+      {"1s", 1, 120, 60},
+      {"1m", 60, 120, 60},
+      {"1h", 3600, 48, 24},
+  };
+};
+
+// The default resolutions for packets tick_seconds apart
+AggregationConfig default_aggregation(double tick_seconds);
+
+// Single-writer seqlock: readers copy the value and retry if the writer was
+// inside store() meanwhile. The value lives in relaxed atomic words so the
+// racing copy is well defined.
+template <typename T>
+class Seqlock
+{
+private:
+  static_assert(std::is_trivially_copyable_v<T>);
+  static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+  std::atomic<uint64_t> seq_{0};
+  std::array<std::atomic<uint64_t>, kWords> words_{};
+
+public:
+  void store(const T &value)
+  {
+    uint64_t buf[kWords] = {};
+    std::memcpy(buf, &value, sizeof(T));
+    uint64_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; ++i)
+      words_[i].store(buf[i], std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  T load() const
+  {
+    uint64_t buf[kWords];
+    for (;;)
+    {
+      uint64_t seq = seq_.load(std::memory_order_acquire);
+      if (seq & 1)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < kWords; ++i)
+        buf[i] = words_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == seq)
+        break;
+    }
+    T value;
+    std::memcpy(&value, buf, sizeof(T));
+    return value;
+  }
+};
+
+class TelemetryAggregator
+{
+private:
+  // Raw sums of one window, which is what gets published; readers turn them
+  // into WindowStats. Sums are of (value - shift) with shift the first
+  // packet's value, so the variance does not cancel out on large offsets.
+  struct Window
+  {
+    uint64_t index = 0;  // start / width
+    uint64_t widths = 1; // more than one for a sliding window
+    uint64_t count = 0;
+    std::array<float, kTelemetryFloatColumns> min, max;
+    std::array<double, kTelemetryFloatColumns> sum, sumsq;
+
+    void reset(uint64_t at);
+  };
+
+  struct Extreme
+  {
+    uint64_t index;
+    float value;
+  };
+
+  struct Level
+  {
+    AggregateResolution res;
+    Window open;                              // writer only
+    std::vector<Window> closed;               // writer's copy of ring, slot = index % history
+    std::unique_ptr<Seqlock<Window>[]> ring;
+    std::atomic<uint64_t> newest{0};          // index + 1 of the last closed window, 0 = none
+
+    // Sliding window: its buckets (a ring of up to `sliding`), their running
+    // sums and monotonic queues of the bucket minima and maxima
+    std::vector<Window> span;
+    size_t span_head = 0, span_size = 0;
+    Window span_sum;
+    std::array<std::deque<Extreme>, kTelemetryFloatColumns> lows, highs;
+
+    Seqlock<Window> current, sliding;
+  };
+
+  std::vector<std::unique_ptr<Level>> levels_;
+  std::array<double, kTelemetryFloatColumns> shift_{}; // set before the first publish, then read-only
+  bool started_ = false;
+  uint64_t open_end_ = 0; // finest open window covers [open_start_, open_end_)
+  uint64_t open_start_ = 0;
+
+  void accumulate(Window &w, const TelemetryPacket &pkt) const;
+  static void merge(Window &into, const Window &from);
+  WindowStats stats(const Window &w, uint64_t width) const; // reader side
+  void add_late(const TelemetryPacket &pkt);
+  void roll(size_t level, uint64_t index);
+  void close(size_t level);
+  void slide(Level &lv, const Window &w);
+  void publish_current();
+
+public:
+  // Throws std::invalid_argument for no resolutions, a zero width, a width
+  // that is not a multiple of the previous one or history < sliding
+  explicit TelemetryAggregator(const AggregationConfig &config = AggregationConfig{});
+
+  // Writer side; calls must not overlap. Packets older than the open window
+  // are folded into the closed window of each resolution that still holds
+  // their time, though not into the sliding windows, and counted in
+  // telemetry_aggregate_late_total.
+  void add(const TelemetryPacket *pkts, size_t count);
+
+  // Reader side, from any thread
+  size_t resolutions() const { return levels_.size(); }
+  const AggregateResolution &resolution(size_t level) const { return levels_[level]->res; }
+  // The open window as of the last add()
+  WindowStats current(size_t level) const;
+  // The last AggregateResolution::sliding closed windows
+  WindowStats sliding(size_t level) const;
+  // Up to n of the most recent closed windows that saw packets, oldest first
+  std::vector<WindowStats> history(size_t level, size_t n) const;
+
+  // Table of the widest sliding window that has seen packets
+  std::string summary() const;
+};
+
+// Registers telemetry_window_{min,max,mean,stddev} gauges per field and
+// resolution, reading the sliding windows, plus telemetry_window_packets.
+// They read NaN once the aggregator is gone.
+void export_window_metrics(const std::shared_ptr<TelemetryAggregator> &aggregator);
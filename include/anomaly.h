@@ -0,0 +1,147 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "schema.h"
+
+class Counter;
+
+// Streaming anomaly detection at the ground station. Every float column keeps
+// an exponentially weighted mean and variance and a smoothed rate of change,
+// updated per packet. Rules compare a column's value, z-score against that
+// mean and variance, or rate with a threshold, e.g.
+//
+//   battery<10.5   radiation:z>8   battery:rate<-0.01   pitch:rate>0.05
+//
+// Rates are per timestamp unit, i.e. per second at the default dt.
+//
+// A batch goes through one branch-free loop that keeps the columns side by
+// side in vector lanes: it updates the statistics and checks each packet
+// against the tightest threshold per column, measure and direction, which
+// fires whenever any rule would. After that only the rules already firing, or
+// whose threshold some packet in the batch may have crossed, are looked at one
+// by one. A rule alerts when it starts firing and again only after a packet on
+// which it did not.
+//
+// Statistics and rule state are kept per TelemetryPacket::source_id, so links
+// from different spacecraft can share one detector without their readings
+// mixing into one stream.
+
+enum class AnomalyMeasure
+{
+  Value,
+  ZScore, // (value - mean) / stddev, before the packet is folded in
+  Rate,   // smoothed change per timestamp unit
+};
+
+struct AnomalyRule
+{
+  size_t field; // float column, in schema order
+  AnomalyMeasure measure;
+  bool above; // true: measure > threshold, false: measure < threshold
+  float threshold;
+
+  // Parses "column<value" or "column>value", optionally with ":z" or ":rate"
+  // after the CSV column name. Throws std::invalid_argument on anything else.
+  static AnomalyRule parse(const std::string &text);
+  // The text form parse() accepts
+  std::string describe() const;
+};
+
+// Battery below 10.5 V or sagging faster than 10 mV/s, radiation spikes and
+// attitude drifting faster than 0.05 degrees/s on any axis
+std::vector<AnomalyRule> default_anomaly_rules();
+
+struct AnomalyEvent
+{
+  uint32_t source;
+  uint64_t timestamp;
+  size_t rule;    // index into AnomalyDetector::rules()
+  float measured; // the value, z-score or rate that crossed the threshold
+  float value;    // the column's value in the packet
+};
+
+struct DetectorConfig
+{
+  float alpha = 0.02f;     // weight of each packet in the mean and variance
+  float rate_alpha = 0.2f; // weight of each packet in the rate
+  uint32_t warmup = 64;    // packets before z-score rules apply
+  std::vector<AnomalyRule> rules = default_anomaly_rules();
+};
+
+class AnomalyDetector
+{
+public:
+  using AlertFn = std::function<void(const AnomalyEvent &)>;
+  static constexpr size_t kLanes = 16; // columns padded to whole AVX-512 / two AVX2 registers
+
+private:
+  struct alignas(64) Lanes
+  {
+    std::array<float, kLanes> v{};
+  };
+
+  // Which envelope a rule tightens
+  enum Bound
+  {
+    ValueHigh,
+    ValueLow,
+    ZHigh,
+    ZLow,
+    RateHigh,
+    RateLow,
+    kBounds,
+  };
+
+  // What the detector knows about one source
+  struct Stream
+  {
+    Lanes mean, var, rate, last;
+    uint64_t seen = 0;
+    uint64_t last_timestamp = 0;
+    std::vector<bool> active; // per rule
+    size_t active_count = 0;
+  };
+
+  DetectorConfig config_;
+  AlertFn on_alert_;
+  // kBounds rows of kLanes thresholds, unused ones infinite
+  alignas(64) std::array<float, kBounds * kLanes> envelope_, warmup_envelope_;
+  // Nonzero where some packet in the batch was past the envelope, zero between batches
+  alignas(64) std::array<int32_t, kBounds * kLanes> crossed_{};
+  std::unordered_map<uint32_t, Stream> streams_;
+  std::vector<Counter *> fired_; // telemetry_alerts_total{rule}
+  uint64_t alerts_ = 0;
+
+  // Per-batch scratch, kLanes floats per packet
+  std::vector<float> rows_, z_, rates_;
+  std::vector<float> inv_dt_;
+  std::vector<std::pair<size_t, size_t>> starts_; // (packet, rule) of the alerts in a batch
+
+  static int bound(const AnomalyRule &rule);
+  // One run of packets from the same source
+  void process_stream(Stream &stream, const TelemetryPacket *pkts, size_t count);
+  void check_rules(Stream &stream, const TelemetryPacket *pkts, size_t count);
+  const Stream *find(uint32_t source) const;
+
+public:
+  // Throws std::invalid_argument for a rule on a column that does not exist
+  explicit AnomalyDetector(DetectorConfig config = DetectorConfig{}, AlertFn on_alert = {});
+
+  // Not thread-safe; GroundStationSink calls it under its lock. Alerts are
+  // raised from inside, in packet order.
+  void process(const TelemetryPacket *pkts, size_t count);
+
+  const std::vector<AnomalyRule> &rules() const { return config_.rules; }
+  uint64_t alerts() const { return alerts_; }
+  // Statistics of one source's column; zero for a source not seen yet
+  float mean(size_t field, uint32_t source = 0) const;
+  float stddev(size_t field, uint32_t source = 0) const;
+  float rate(size_t field, uint32_t source = 0) const;
+};
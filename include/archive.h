@@ -0,0 +1,171 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include <array>
+
+#include "telemetry.h"
+
+// Binary columnar telemetry archive (.tlm).
+//
+//   header   "TLMARCH1" | u32 version | u32 block_rows
+//   blocks   block_rows x u64 timestamp, then block_rows x f32 for each of the
+//            nine float fields (ArchiveColumn order), then block_rows x u32
+//            source (version 2 on; version 1 files read as source 0). Every
+//            block has the same size on disk; the last one may be partly filled.
+//   index    one ArchiveBlockIndex per block
+//   trailer  u64 index_offset | u64 block_count | "TLMINDEX"
+//
+// Multi-byte values are stored little-endian (host order on every target we build for).
+
+enum ArchiveColumn : size_t
+{
+  kColTemperature,
+  kColRadiation,
+  kColBattery,
+  kColPosX,
+  kColPosY,
+  kColPosZ,
+  kColPitch,
+  kColRoll,
+  kColYaw,
+  kFloatColumns
+};
+
+struct ArchiveBlockIndex
+{
+  uint64_t offset; // file offset of the block
+  uint64_t rows;
+  uint64_t min_timestamp;
+  uint64_t max_timestamp;
+};
+
+class ArchiveWriter
+{
+private:
+  int fd_ = -1;
+  size_t block_rows_;
+  size_t rows_ = 0; // rows in the block being filled
+  uint64_t offset_;
+  std::vector<uint64_t> timestamps_;
+  std::vector<float> floats_; // kFloatColumns columns of block_rows_ each
+  std::vector<uint32_t> sources_;
+  std::vector<ArchiveBlockIndex> index_;
+
+  void write_block();
+
+public:
+  explicit ArchiveWriter(const std::string &path, size_t block_rows = 4096);
+  ~ArchiveWriter();
+  ArchiveWriter(const ArchiveWriter &) = delete;
+  ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+  void append(const TelemetryPacket *pkts, size_t count);
+  // Writes the partial block, index and trailer, then fsync()s the file first
+  // if sync is set. Called by the destructor, without sync, if needed.
+  void close(bool sync = false);
+};
+
+// Column pointers for one block, straight into the mapped file
+struct ArchiveBlockView
+{
+  const uint64_t *timestamp;
+  std::array<const float *, kFloatColumns> column;
+  const uint32_t *source; // null in version 1 archives
+  size_t rows;
+
+  TelemetryPacket packet(size_t row) const;
+};
+
+class ArchiveReader
+{
+private:
+  const uint8_t *map_ = nullptr;
+  size_t map_size_ = 0;
+  size_t block_rows_ = 0;
+  uint32_t version_ = 0;
+  const ArchiveBlockIndex *index_ = nullptr;
+  size_t block_count_ = 0;
+  size_t rows_ = 0;
+  bool sorted_ = true; // blocks in non-decreasing timestamp order
+
+public:
+  // Checks the header, trailer and every index entry against the file size,
+  // so block() never reaches outside the mapping. Throws std::runtime_error.
+  explicit ArchiveReader(const std::string &path);
+  ~ArchiveReader();
+  ArchiveReader(const ArchiveReader &) = delete;
+  ArchiveReader &operator=(const ArchiveReader &) = delete;
+
+  size_t rows() const { return rows_; }
+  size_t block_count() const { return block_count_; }
+  ArchiveBlockView block(size_t i) const;
+
+  // Calls fn(view, first_row, end_row) for every run of rows with timestamps in
+  // [t0, t1]. Uses the block index to skip straight to the matching blocks.
+  template <typename Fn>
+  void scan(uint64_t t0, uint64_t t1, Fn fn) const;
+
+  std::vector<TelemetryPacket> query(uint64_t t0, uint64_t t1) const;
+};
+
+// Calls fn for every row of a CSV log and returns how many there were. Logs
+// from before a column was added still read: their header must be a prefix
+// of kCsvHeader, and the columns it lacks read as 0. Throws
+// std::runtime_error on an unreadable file, a foreign header or a bad row.
+size_t read_csv_log(const std::string &path, const std::function<void(const TelemetryPacket &)> &fn);
+
+// Converters between the CSV log format and the archive. Both return rows converted.
+size_t csv_to_archive(const std::string &csv_path, const std::string &archive_path, size_t block_rows = 4096);
+size_t archive_to_csv(const std::string &archive_path, const std::string &csv_path);
+
+template <typename Fn>
+void ArchiveReader::scan(uint64_t t0, uint64_t t1, Fn fn) const
+{
+  size_t first = 0;
+  if (sorted_)
+  {
+    // First block whose max timestamp reaches t0
+    size_t lo = 0, hi = block_count_;
+    while (lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      if (index_[mid].max_timestamp < t0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    first = lo;
+  }
+
+  for (size_t b = first; b < block_count_; ++b)
+  {
+    const ArchiveBlockIndex &entry = index_[b];
+    if (sorted_ && entry.min_timestamp > t1)
+      break;
+    if (entry.max_timestamp < t0 || entry.min_timestamp > t1)
+      continue;
+
+    ArchiveBlockView view = block(b);
+    if (entry.min_timestamp >= t0 && entry.max_timestamp <= t1)
+    {
+      fn(view, size_t{0}, view.rows);
+      continue;
+    }
+
+    // Partial overlap: hand out each run of matching rows (a single run when sorted)
+    size_t i = 0;
+    while (i < view.rows)
+    {
+      while (i < view.rows && (view.timestamp[i] < t0 || view.timestamp[i] > t1))
+        ++i;
+      size_t begin = i;
+      while (i < view.rows && view.timestamp[i] >= t0 && view.timestamp[i] <= t1)
+        ++i;
+      if (begin < i)
+        fn(view, begin, i);
+    }
+  }
+}
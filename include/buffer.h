@@ -3,12 +3,51 @@
 #include <condition_variable>
 #include <vector>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
 
 #include "telemetry.h"
+#include "spill_ring.h"
+
+enum class BufferMode
+{
+  Locked,   // mutex + condition variables, safe for any number of threads
+  SpscRing, // lock-free ring, exactly one producer thread and one consumer thread
+};
+
+// How an SpscRing buffer waits when it is full (producer) or empty (consumer).
+// Locked buffers always block on their condition variables.
+enum class WaitStrategy
+{
+  Spin,         // busy-wait, lowest latency but burns a core
+  SpinThenPark, // spin for a short while, then sleep on a condition variable
+  Block,        // sleep on a condition variable straight away
+};
+
+// What push does when the buffer is full
+enum class OverflowPolicy
+{
+  Block,        // wait for the consumer (original behaviour)
+  BlockTimeout, // wait up to OverflowConfig::timeout, then drop what did not fit
+  DropOldest,   // evict the oldest queued packet; Locked mode only
+  DropNewest,   // discard the packet being pushed
+  Spill,        // append to a SpillRing on disk, drained back in order; Locked mode only
+};
+
+struct OverflowConfig
+{
+  OverflowPolicy policy = OverflowPolicy::Block;
+  std::chrono::milliseconds timeout{100}; // BlockTimeout
+  std::string spill_dir = "/tmp";         // Spill: where the unlinked scratch file lives
+  size_t spill_capacity = 1 << 20;        // Spill: packets on disk before the oldest are evicted
+};
 
 class TelemetryBuffer
 {
 private:
+  static constexpr size_t kCacheLine = 64;
+
   std::vector<TelemetryPacket> buffer_;
   size_t front, back;
   std::mutex mtx_;
@@ -17,14 +56,78 @@ private:
   const size_t capacity_;
   std::atomic<bool> stop_ = false;
 
+  const BufferMode mode_;
+  const WaitStrategy wait_;
+  const OverflowConfig overflow_;
+
+  // Overflow state, guarded by mtx_ in Locked mode. Spilled packets are
+  // always newer than everything in buffer_: once anything is on disk, new
+  // packets go to disk too until the consumer has caught up.
+  std::unique_ptr<SpillRing> spill_;
+  std::atomic<uint64_t> dropped_{0}, evicted_{0}, spilled_{0};
+  std::string metrics_labels_; // buffer="<n>", in creation order
+
+  // SpscRing state. Indices grow monotonically and are masked into buffer_,
+  // whose size is rounded up to a power of two. Each side keeps a cached copy
+  // of the other side's index so it only touches the shared line when needed.
+  size_t mask_ = 0;
+  alignas(kCacheLine) std::atomic<size_t> head_{0}; // consumer position
+  size_t cached_tail_ = 0;
+  alignas(kCacheLine) std::atomic<size_t> tail_{0}; // producer position
+  size_t cached_head_ = 0;
+  alignas(kCacheLine) std::atomic<bool> consumer_parked_{false};
+  std::atomic<bool> producer_parked_{false};
+
   bool isEmpty() const;
   bool isFull() const;
+  size_t limit() const { return capacity_ - 1; }
+
+  using Deadline = std::chrono::steady_clock::time_point;
+
+  template <typename Ready>
+  bool spsc_wait(Ready ready, std::atomic<bool> &parked, std::condition_variable &cv,
+                 Deadline deadline = Deadline::max());
+  void spsc_wake(std::atomic<bool> &parked, std::condition_variable &cv);
+
+  size_t spsc_push_n(const TelemetryPacket *pkts, size_t count);
+  size_t spsc_pop_n(TelemetryPacket *out, size_t max_count, Deadline deadline);
+  size_t locked_push_n(const TelemetryPacket *pkts, size_t count);
+  size_t locked_pop_n(TelemetryPacket *out, size_t max_count, Deadline deadline);
+  void unspill();
 
 public:
-  explicit TelemetryBuffer(size_t capacity = 100);
+  // Throws std::invalid_argument for DropOldest or Spill on an SpscRing buffer,
+  // whose producer cannot touch the consumer's end, and std::runtime_error if
+  // the spill file cannot be created.
+  explicit TelemetryBuffer(size_t capacity = 100,
+                           BufferMode mode = BufferMode::Locked,
+                           WaitStrategy wait = WaitStrategy::SpinThenPark,
+                           const OverflowConfig &overflow = OverflowConfig{});
+  ~TelemetryBuffer();
+  TelemetryBuffer(const TelemetryBuffer &) = delete;
+  TelemetryBuffer &operator=(const TelemetryBuffer &) = delete;
   void push(const TelemetryPacket &pkt);
   TelemetryPacket pop();
+
+  // Batch variants move many packets per synchronisation.
+  // push_n queues packets according to the overflow policy and returns how
+  // many were accepted: under Block fewer only after shutdown, under
+  // BlockTimeout and DropNewest also when the buffer stayed full. pop_n blocks until at least one
+  // packet is available, takes up to max_count and returns 0 once the buffer
+  // is shut down and drained.
+  size_t push_n(const TelemetryPacket *pkts, size_t count);
+  size_t pop_n(TelemetryPacket *out, size_t max_count);
+  // As pop_n, but gives up and returns 0 if nothing arrives before deadline
+  size_t pop_n(TelemetryPacket *out, size_t max_count, std::chrono::steady_clock::time_point deadline);
+
+  // Includes spilled packets
   size_t size();
   void shutdown();
   bool is_shutdown() const;
-};
\ No newline at end of file
+  BufferMode mode() const { return mode_; }
+  OverflowPolicy overflow_policy() const { return overflow_.policy; }
+
+  uint64_t dropped() const { return dropped_.load(); } // rejected on push (BlockTimeout, DropNewest)
+  uint64_t evicted() const { return evicted_.load(); } // queued, then discarded for newer packets
+  uint64_t spilled() const { return spilled_.load(); } // went through the spill ring
+};
@@ -0,0 +1,127 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "telemetry.h"
+#include "compression.h"
+
+// Fixed-length transfer frames after the CCSDS TM Space Data Link Protocol
+// (132.0-B), carrying CCSDS Space Packets (133.0-B). On the wire every frame
+// is a CADU:
+//
+//   ASM 1ACFFC1D | primary header (6) | data field (kFrameDataSize) | CRC-16 (2)
+//
+// The primary header holds the spacecraft id, a 3-bit virtual channel id, a
+// master and a per-VC frame counter, and the first header pointer: the offset
+// of the first packet that starts in this frame (kNoPacketStart if none), so a
+// receiver that lost sync can pick up at the next packet boundary. Packets
+// are packed back to back and span frames; a frame flushed before it is full
+// is padded with an idle packet.
+constexpr uint32_t kAttachedSyncMarker = 0x1ACFFC1D;
+constexpr size_t kAsmSize = 4;
+constexpr size_t kTransferFrameSize = 1024;
+constexpr size_t kFrameHeaderSize = 6;
+constexpr size_t kFrameCrcSize = 2;
+constexpr size_t kFrameDataSize = kTransferFrameSize - kFrameHeaderSize - kFrameCrcSize;
+constexpr size_t kCaduSize = kAsmSize + kTransferFrameSize;
+constexpr size_t kVirtualChannels = 8;
+constexpr uint16_t kSpacecraftId = 0x2A;
+constexpr uint16_t kNoPacketStart = 0x7FF;
+
+// Space packet application ids
+constexpr size_t kSpacePacketHeaderSize = 6;
+constexpr size_t kMaxSpacePacketData = 65536;
+constexpr uint16_t kApidTelemetry = 0x001; // one serialised TelemetryPacket
+constexpr uint16_t kApidColumnar = 0x002;  // u16 count + columnar_codec.h batch
+constexpr uint16_t kApidIdle = 0x7FF;
+
+// VC a source's packets travel on: the link's base VC offset by the source
+// id, so up to kVirtualChannels spacecraft share a link, or run as separate
+// links, without sharing a channel's counters and reassembly
+inline uint8_t ccsds_channel(uint8_t base, uint32_t source)
+{
+  return static_cast<uint8_t>((base + source) % kVirtualChannels);
+}
+
+// CRC-16-CCITT (poly 0x1021, init 0xFFFF), the frame error control field
+uint16_t crc16_ccitt(const uint8_t *data, size_t len);
+
+struct CcsdsChannelStats
+{
+  uint64_t frames = 0;
+  uint64_t packets = 0;
+  uint64_t lost_frames = 0; // from gaps in the VC frame counter
+};
+
+// Transmitter side. Each virtual channel fills its own frame; a frame is
+// emitted as soon as it is full, or padded out by flush().
+class CcsdsFramer
+{
+private:
+  struct Channel
+  {
+    std::array<uint8_t, kCaduSize> cadu;
+    size_t fill = 0;                  // data field bytes used
+    uint16_t first_header = kNoPacketStart;
+    uint8_t count = 0;                // VC frame counter
+    uint16_t packet_count = 0;        // space packet sequence count
+  };
+  std::array<Channel, kVirtualChannels> channels_;
+  uint8_t master_count_ = 0;
+  std::vector<uint8_t> scratch_;
+
+  void append(uint8_t vc, const uint8_t *data, size_t len, bool packet_start, std::vector<uint8_t> &out);
+  void emit(uint8_t vc, std::vector<uint8_t> &out);
+
+public:
+  // Appends a space packet; complete CADUs go to out
+  void add_packet(uint8_t vc, uint16_t apid, const uint8_t *data, size_t len, std::vector<uint8_t> &out);
+  // One kApidTelemetry packet per telemetry packet
+  void add_telemetry(uint8_t vc, const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out);
+  // kApidColumnar packets holding the whole batch
+  void add_columnar(uint8_t vc, const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out);
+  // Pads the channel's partly filled frame with idle data and emits it
+  void flush(uint8_t vc, std::vector<uint8_t> &out);
+};
+
+// Ground station side. Fed any run of bytes, finds the ASM, checks each
+// frame's CRC and demultiplexes virtual channels, reassembling packets per
+// VC. Frames are parsed in place, and each VC stages at most one partial
+// packet in a buffer allocated the first time the VC shows up. A corrupt frame costs only that frame
+// plus the packets spanning it; the search resumes one byte after its ASM.
+class CcsdsDeframer
+{
+private:
+  struct Channel
+  {
+    std::vector<uint8_t> staging; // header + data of the packet being reassembled, sized on first use
+    size_t have = 0;
+    size_t need = 0;              // 0 until the header is complete
+    bool synced = false;          // at a known packet boundary
+    bool seen = false;
+    uint8_t next_count = 0;
+  };
+  std::array<Channel, kVirtualChannels> channels_;
+  std::array<CcsdsChannelStats, kVirtualChannels> stats_{};
+  uint64_t good_frames_ = 0, bad_frames_ = 0, skipped_bytes_ = 0;
+
+  void process_frame(const uint8_t *frame, std::vector<TelemetryPacket> &out);
+  size_t feed(Channel &ch, uint8_t vc, const uint8_t *data, size_t len, std::vector<TelemetryPacket> &out);
+  void emit(uint8_t vc, const uint8_t *packet, size_t len, std::vector<TelemetryPacket> &out);
+
+public:
+  // Decodes every complete CADU in [data, data + len), appending packets to
+  // out, and returns how many bytes were used. The caller keeps the rest
+  // (at most one partial CADU) and passes it again with more data.
+  size_t consume(const uint8_t *data, size_t len, std::vector<TelemetryPacket> &out);
+
+  uint64_t good_frames() const { return good_frames_; }
+  uint64_t bad_frames() const { return bad_frames_; }
+  uint64_t skipped_bytes() const { return skipped_bytes_; } // discarded while hunting for the ASM
+  const CcsdsChannelStats &channel(uint8_t vc) const { return stats_[vc]; }
+  // Frame totals, then one line per VC that carried frames, each line starting with prefix
+  std::string summary(const std::string &prefix) const;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "schema.h"
+
+// Lossless codec specialised for batches of TelemetryPacket.
+// The batch is transposed into columns (Schema<TelemetryPacket> order) and
+// bit-packed Gorilla style:
+//   timestamp - delta-of-delta against the previous two ticks (1 bit for a steady tick)
+//   floats    - XOR against the previous value of the same field, storing only the
+//               meaningful bits between the leading and trailing zeros
+//   source    - 33 bits when the whole batch comes from one source, else a
+//               bit per packet plus 32 for each change
+// Each batch is self-contained, so frames can be decoded independently.
+
+// Appends the encoded batch to out
+void encode_columnar(const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out);
+// Decodes exactly count packets; throws if the input is truncated
+void decode_columnar(const uint8_t *data, size_t len, size_t count, TelemetryPacket *out);
+
+std::vector<uint8_t> encode_columnar(const std::vector<TelemetryPacket> &pkts);
+std::vector<TelemetryPacket> decode_columnar(const std::vector<uint8_t> &input, size_t count);
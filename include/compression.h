@@ -1,6 +1,201 @@
 #pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "schema.h"
+
+// Bytes one packet occupies on the wire before compression: the packed,
+// little-endian layout from Schema<TelemetryPacket>
+constexpr size_t kPacketWireSize = wire_size<TelemetryPacket>();
+static_assert(kPacketWireSize == 48, "TelemetryPacket wire layout changed");
 
 std::vector<uint8_t> serialise(const TelemetryPacket &pkt);
 TelemetryPacket deserialise(const std::vector<uint8_t> &data);
+void serialise_into(const TelemetryPacket &pkt, uint8_t *out);
+TelemetryPacket deserialise_from(const uint8_t *in);
+// deserialise_from() straight into pkt; the faster choice in loops
+void deserialise_into(const uint8_t *in, TelemetryPacket &pkt);
+
+class Counter;
+
+// Compression of self-contained payloads: PerPacket frames, UDP datagrams and
+// anything else passed through compress_data(). The first byte of a payload
+// says how it was made, so any codec holding the same dictionary decodes what
+// any other produced and the adaptive codec can switch from one payload to the
+// next without telling the other end:
+//
+//   0x00, then the input as is                         None
+//   0x01, the dictionary id (2 bytes, little-endian),  Dictionary
+//         then raw deflate primed with the dictionary
+//   a zlib stream (starts 0x?8)                        Zlib, as compress_data() always sent
+//
+// A 48-byte packet gives deflate almost nothing to find, so on single packets
+// zlib's 6 bytes of header and checksum cost more than it saves. The dictionary
+// codec leaves both out and starts from byte strings that recur in past
+// telemetry (see train_dictionary()). Raw deflate has no checksum, so the
+// dictionary id (the low half of its adler32, as zlib's FDICT carries in full)
+// is what stops a receiver with another dictionary decoding garbage.
+enum class CompressionMode
+{
+  None,
+  Zlib,
+  Dictionary,
+  Adaptive, // whichever of the others costs least in CPU time plus time on the link
+};
+
+using CompressionDictionary = std::vector<uint8_t>;
+
+// Both ends of a link must use the same dictionary
+struct CompressionConfig
+{
+  CompressionMode mode = CompressionMode::Zlib;
+  int level = Z_DEFAULT_COMPRESSION;                       // Zlib and Dictionary, also Batched deflate streams
+  std::shared_ptr<const CompressionDictionary> dictionary; // Dictionary (required) and Adaptive (optional)
+};
+
+class Codec
+{
+private:
+  z_stream inflate_{}; // raw inflate, set up on first use
+  bool inflating_ = false;
+
+protected:
+  std::shared_ptr<const CompressionDictionary> dictionary_;
+  uint16_t dictionary_id_ = 0;
+
+  explicit Codec(std::shared_ptr<const CompressionDictionary> dictionary = nullptr);
+
+public:
+  virtual ~Codec();
+  Codec(const Codec &) = delete;
+  Codec &operator=(const Codec &) = delete;
+
+  virtual const char *name() const = 0;
+  // Appends the payload for [in, in + len) to out
+  virtual void compress(const uint8_t *in, size_t len, std::vector<uint8_t> &out) = 0;
+  // Decodes a payload from any codec with the same dictionary into exactly
+  // out_len bytes. Throws std::runtime_error on anything else.
+  void decompress(const uint8_t *in, size_t len, uint8_t *out, size_t out_len);
+};
+
+class NoneCodec : public Codec
+{
+public:
+  const char *name() const override { return "none"; }
+  void compress(const uint8_t *in, size_t len, std::vector<uint8_t> &out) override;
+};
+
+// Deflate at a chosen level: a zlib stream without a dictionary, the tagged raw
+// form with one. The stream is reset rather than rebuilt for every payload.
+class ZlibCodec : public Codec
+{
+private:
+  z_stream deflate_{};
+  bool deflating_ = false;
+  int level_;
+
+public:
+  explicit ZlibCodec(int level = Z_DEFAULT_COMPRESSION, std::shared_ptr<const CompressionDictionary> dictionary = nullptr);
+  ~ZlibCodec() override;
+  const char *name() const override { return dictionary_ ? "dict" : "zlib"; }
+  void compress(const uint8_t *in, size_t len, std::vector<uint8_t> &out) override;
+};
+
+// Measures the thread CPU time each candidate spends per input byte and the
+// bytes it sends per input byte, and compresses with the one whose CPU time
+// plus time on a link of link_rate bytes/s is smallest. An unpaced link
+// (link_rate 0) only costs CPU time. Every kProbeEvery-th payload goes to the
+// next candidate in turn, so the figures follow the data.
+class AdaptiveCodec : public Codec
+{
+public:
+  static constexpr uint64_t kProbeEvery = 64;
+  static constexpr uint64_t kTimeEvery = 16; // payloads of the chosen codec timed
+
+private:
+  struct Candidate
+  {
+    std::unique_ptr<Codec> codec;
+    Counter *payloads = nullptr; // telemetry_adaptive_codec_payloads_total{codec}
+    double cpu_ns_per_byte = 0;
+    double ratio = 1;
+    bool measured = false;
+  };
+
+  std::vector<Candidate> candidates_;
+  double wire_ns_per_byte_;
+  size_t current_ = 0;
+  uint64_t payloads_ = 0;
+
+  void choose();
+
+public:
+  AdaptiveCodec(uint64_t link_rate, int level = Z_DEFAULT_COMPRESSION,
+                std::shared_ptr<const CompressionDictionary> dictionary = nullptr);
+  const char *name() const override { return "adaptive"; }
+  void compress(const uint8_t *in, size_t len, std::vector<uint8_t> &out) override;
+
+  // The codec payloads currently go through
+  const char *current() const { return candidates_[current_].codec->name(); }
+};
+
+// Sent after the Dictionary tag so both ends can tell they hold the same one
+uint16_t dictionary_id(const CompressionDictionary &dictionary);
+
+// Throws std::invalid_argument for Dictionary without a dictionary
+std::unique_ptr<Codec> make_codec(const CompressionConfig &config, uint64_t link_rate = 0);
+// "none", "zlib", "dict" or "adaptive"; throws std::invalid_argument otherwise
+CompressionMode parse_compression_mode(const std::string &name);
+
+// Byte strings that recur in the serialised packets, most frequent last where
+// deflate reaches them with the shortest distances. size is capped at the
+// 32 KB deflate can look back.
+CompressionDictionary train_dictionary(const TelemetryPacket *pkts, size_t count, size_t size = 1024);
+// A dictionary file holds the bytes and nothing else. Both throw std::runtime_error.
+CompressionDictionary load_dictionary(const std::string &path);
+void save_dictionary(const std::string &path, const CompressionDictionary &dictionary);
+
+// zlib at the default level, as PerPacket frames always sent. Each thread
+// keeps its own ZlibCodec for these.
 std::vector<uint8_t> compress_data(const std::vector<uint8_t> &input);
-std::vector<uint8_t> decompress_data(const std::vector<uint8_t> &input, size_t expected_size);
\ No newline at end of file
+std::vector<uint8_t> decompress_data(const std::vector<uint8_t> &input, size_t expected_size);
+std::vector<uint8_t> compress_data(const std::vector<uint8_t> &input, Codec &codec);
+std::vector<uint8_t> decompress_data(const std::vector<uint8_t> &input, size_t expected_size, Codec &codec);
+
+// Long-lived raw deflate stream. Every chunk ends with Z_SYNC_FLUSH so it can be
+// decoded as soon as it arrives, while the window carries over and later chunks
+// can reference earlier ones. The 00 00 FF FF flush marker is stripped from the
+// output and restored by InflateStream, saving four bytes per chunk.
+class DeflateStream
+{
+private:
+  z_stream zs_{};
+
+public:
+  explicit DeflateStream(int level = Z_DEFAULT_COMPRESSION);
+  ~DeflateStream();
+  DeflateStream(const DeflateStream &) = delete;
+  DeflateStream &operator=(const DeflateStream &) = delete;
+
+  // Appends the compressed chunk for [data, data + len) to out
+  void compress_chunk(const uint8_t *data, size_t len, std::vector<uint8_t> &out);
+};
+
+class InflateStream
+{
+private:
+  z_stream zs_{};
+
+public:
+  InflateStream();
+  ~InflateStream();
+  InflateStream(const InflateStream &) = delete;
+  InflateStream &operator=(const InflateStream &) = delete;
+
+  // Decodes one chunk produced by DeflateStream into exactly out_len bytes
+  void decompress_chunk(const uint8_t *data, size_t len, uint8_t *out, size_t out_len);
+};
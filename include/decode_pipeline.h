@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "telemetry.h"
+#include "frame.h"
+#include "link.h"
+
+// Ground station decode pipeline for one TCP link:
+//
+//   receive (caller) -> worker pool (decompress + deserialise) -> reorder -> deliver
+//
+// The caller submits frames in arrival order. Each frame takes a slot in a
+// ring of LinkConfig::decode_queue slots and is queued on one worker's deque,
+// under that worker's lock only. When it lands behind other work, one parked
+// worker is woken to steal from the back of the deque. A reorder thread hands
+// decoded frames to deliver in submission order, so the log stays in
+// transmit order however the workers finish. A slot is only freed once its
+// frame is delivered: when logging or decoding falls behind, submit() blocks
+// and the socket backs up to the transmitter.
+//
+// Batched deflate frames share one stream and can only be inflated in order;
+// submit() decodes those itself and they just pass through the reorder stage.
+class DecodePipeline
+{
+public:
+  using Deliver = std::function<void(const TelemetryPacket *pkts, size_t count)>;
+
+private:
+  struct Slot
+  {
+    FrameHeader header{};
+    std::vector<uint8_t> payload;
+    std::vector<TelemetryPacket> packets;
+    std::string error; // set instead of packets when the frame would not decode
+    std::atomic<bool> done{false};
+  };
+
+  struct Worker
+  {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<uint64_t> jobs; // slot sequence numbers
+    bool parked = false;       // waiting on cv, guarded by mtx
+    bool nudged = false;       // woken to steal, guarded by mtx
+    std::unique_ptr<FrameDecoder> decoder;
+    std::thread thread;
+  };
+
+  Deliver deliver_;
+  FrameDecoder serial_decoder_;
+  bool independent_;
+  std::vector<Slot> slots_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::mutex mtx_;
+  std::condition_variable cv_space_, cv_done_;
+  uint64_t submitted_ = 0, delivered_ = 0; // guarded by mtx_
+  bool finishing_ = false;                 // guarded by mtx_
+  std::atomic<bool> stop_{false};
+  std::string error_;
+  std::thread reorder_;
+
+  std::atomic<uint64_t> steals_{0};
+
+  bool take(size_t self, uint64_t &seq);
+  void nudge_idle(size_t busy);
+  void decode(FrameDecoder &decoder, Slot &slot, const uint8_t *payload);
+  void complete(Slot &slot);
+  void work(size_t self);
+  void reorder();
+
+public:
+  // Starts LinkConfig::decode_workers workers. With none, submit() decodes
+  // and delivers inline, exactly like the plain receiver.
+  DecodePipeline(const LinkConfig &config, Deliver deliver);
+  ~DecodePipeline();
+  DecodePipeline(const DecodePipeline &) = delete;
+  DecodePipeline &operator=(const DecodePipeline &) = delete;
+
+  // Queues one frame (payload is copied). Blocks while every slot is in use.
+  // Returns false once a frame has failed to decode; the link is then dead.
+  bool submit(const FrameHeader &header, const uint8_t *payload);
+  // Waits until everything submitted has been delivered and stops the threads.
+  // Returns false if a frame failed to decode (see error()).
+  bool finish();
+
+  const std::string &error() const { return error_; }
+  uint64_t steals() const { return steals_.load(); }
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include "telemetry.h"
+#include "compression.h"
+#include "ccsds.h"
+#include "link.h"
+#include "quantized.h"
+
+struct FrameHeader
+{
+  uint32_t payload_len;
+  uint32_t packet_count;
+};
+
+// Transmitter side: turns packets into complete wire frames (header + payload).
+// In Batched mode the deflate stream lives as long as the encoder, so one encoder
+// must be used per connection and frames must be sent in the order they were built.
+class FrameEncoder
+{
+private:
+  FrameMode mode_;
+  PayloadCodec codec_;
+  uint8_t vc_;
+  DeflateStream deflate_;
+  CcsdsFramer framer_;
+  QuantizedCodec quantized_;
+  std::unique_ptr<Codec> compressor_; // PerPacket
+  std::vector<uint8_t> raw_;
+
+public:
+  explicit FrameEncoder(const LinkConfig &config);
+
+  // Appends the wire bytes for pkts to out. PerPacket mode emits one frame per
+  // packet; Ccsds mode puts each source on its own virtual channel and pads
+  // the last transfer frame of each so nothing is held back.
+  void encode(const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out);
+};
+
+// Ground station side counterpart of FrameEncoder, one per connection.
+class FrameDecoder
+{
+private:
+  FrameMode mode_;
+  PayloadCodec codec_;
+  InflateStream inflate_;
+  QuantizedCodec quantized_;
+  std::unique_ptr<Codec> compressor_; // PerPacket
+  std::vector<uint8_t> raw_;
+
+public:
+  explicit FrameDecoder(const LinkConfig &config);
+
+  size_t header_size() const;
+  // False for Batched deflate, whose frames share one stream and must be decoded in order
+  bool independent_frames() const;
+  // Throws on lengths no valid frame can have, since the stream cannot be resynced
+  FrameHeader parse_header(const uint8_t *header) const;
+  // Decodes one frame payload and appends its packets to out
+  void decode(const FrameHeader &header, const uint8_t *payload, std::vector<TelemetryPacket> &out);
+};
+
+// Per-connection reassembly for non-blocking receivers: bytes are read straight
+// into prepare(), and commit() decodes every frame that is now complete, keeping
+// any partial frame for the next read. Ccsds links are the only ones that
+// survive corrupt bytes: the deframer resyncs instead of throwing.
+class FrameAssembler
+{
+private:
+  FrameDecoder decoder_;
+  std::unique_ptr<CcsdsDeframer> deframer_; // Ccsds mode only
+  std::vector<uint8_t> pending_;
+  size_t start_ = 0; // first unparsed byte
+  size_t end_ = 0;   // one past the last received byte
+
+public:
+  explicit FrameAssembler(const LinkConfig &config);
+
+  // Returns space for at least min_space more bytes
+  uint8_t *prepare(size_t min_space);
+  size_t space() const { return pending_.size() - end_; }
+  // Marks n bytes written at prepare() as received and decodes complete frames
+  // into out. Returns the number of frames completed. Throws on a corrupt
+  // frame, except in Ccsds mode, where the deframer drops it and resyncs.
+  size_t commit(size_t n, std::vector<TelemetryPacket> &out);
+
+  const CcsdsDeframer *deframer() const { return deframer_.get(); }
+};
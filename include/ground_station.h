@@ -0,0 +1,55 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include "telemetry.h"
+#include "link.h"
+#include "logger.h"
+
+class ShardedTelemetryLogger;
+
+// Final destination of every decoded packet: the optional LinkConfig::detector
+// first, then the log, LinkConfig::aggregator, console and the
+// LinkConfig::on_packet hook. Receivers may call deliver() from several
+// threads: each stage has its own lock, so one thread can log while another
+// runs the detector. The async and per-source logs do their own locking, and
+// the latter takes each source's packets on its own writer.
+class GroundStationSink
+{
+private:
+  const LinkConfig &config_;
+  std::unique_ptr<TelemetryLogger> logger_;
+  std::unique_ptr<ShardedTelemetryLogger> shards_;
+  std::mutex detect_mtx_, log_mtx_, aggregate_mtx_, output_mtx_;
+
+public:
+  // Opens logs/telemetry_<epoch>.csv, or with LinkConfig::log_writers starts
+  // the writers for logs/telemetry_<epoch>_src<id>.csv
+  explicit GroundStationSink(const LinkConfig &config);
+  // With per-source logs, prints each source's packet count and gaps
+  ~GroundStationSink();
+  void deliver(const TelemetryPacket *pkts, size_t count);
+};
+
+// Non-blocking receiver: one acceptor plus LinkConfig::reactor_threads epoll loops.
+// Returns once LinkConfig::expected_links links have connected and closed.
+// The caller owns listen_sock.
+void run_epoll_ground_station(const LinkConfig &config, GroundStationSink &sink, int listen_sock);
+
+// Datagram receiver for Transport::Udp: recvmmsg() batches, one sequence
+// tracker per sending address. Returns once LinkConfig::expected_links links
+// have sent their FIN, or all traffic stopped for LinkConfig::udp_idle_timeout,
+// and prints each link's loss and reordering. The caller owns sock.
+void run_udp_ground_station(const LinkConfig &config, GroundStationSink &sink, int sock);
+
+// Receiver for LinkConfig::reliable links (see reliable.h): one transmitter,
+// which may reconnect any number of times. Acks what it has delivered, drops
+// duplicates, and returns at the end-of-stream marker or once no transmitter
+// has connected for LinkConfig::reconnect_timeout. The caller owns listen_sock.
+void run_reliable_ground_station(const LinkConfig &config, GroundStationSink &sink, int listen_sock);
+
+// Receiver for Transport::Shm (see shm.h): creates the ring, waits up to
+// LinkConfig::reconnect_timeout for the transmitter to map it, and decodes
+// frames in place until the transmitter closes the stream.
+void run_shm_ground_station(const LinkConfig &config, GroundStationSink &sink);
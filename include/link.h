@@ -0,0 +1,122 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "telemetry.h"
+#include "logger.h"
+#include "quantized.h"
+#include "compression.h"
+
+class TelemetryAggregator;
+class AnomalyDetector;
+
+// How packets are grouped into frames on the wire
+enum class FrameMode
+{
+  PerPacket, // [u32 len][zlib packet], one frame per packet (original format)
+  Batched,   // [u32 len][u32 count][deflate chunk], many packets per frame on a persistent stream
+  Ccsds,     // fixed-length CCSDS transfer frames with sync markers and virtual channels (see ccsds.h)
+};
+
+// How a Batched frame payload is compressed. PerPacket frames go through
+// LinkConfig::compression instead.
+// Ccsds frames carry raw packets (Deflate) or columnar batches, never a deflate stream.
+enum class PayloadCodec
+{
+  Deflate,   // persistent raw deflate stream (see DeflateStream)
+  Columnar,  // delta-of-delta / XOR bit-packed columns (see columnar_codec.h), frames decode independently
+  Quantized, // lossy fixed point within LinkConfig::quantization (see quantized.h), Batched only
+};
+
+// How the ground station services its links
+enum class ReceiverMode
+{
+  Blocking, // accept one link and recv() on it synchronously (original behaviour)
+  Epoll,    // non-blocking sockets spread over a few epoll reactor threads, many links
+};
+
+// Which socket type carries frames
+enum class Transport
+{
+  Tcp, // one stream per link, frames as described by FrameMode
+  Udp, // self-contained datagrams with sequence numbers, see udp.h
+  Shm, // ring in shared memory, same host only, see shm.h
+};
+
+// How TCP links move bytes between the socket and user space
+enum class IoBackend
+{
+  Sockets, // send()/recv() per frame (original behaviour)
+  Uring,   // io_uring with registered buffers, many frames per syscall (see uring.h)
+};
+
+// Local channel impairment for the Udp transport, applied by a relay between
+// the transmitter and the ground station (see ImpairmentProxy). Probabilities
+// are per datagram.
+struct ChannelImpairment
+{
+  double loss = 0.0;                        // dropped outright
+  double reorder = 0.0;                     // held back by reorder_hold so later datagrams overtake it
+  std::chrono::microseconds delay{0};       // fixed one-way delay
+  std::chrono::microseconds jitter{0};      // plus a uniform [0, jitter) extra delay
+  std::chrono::microseconds reorder_hold{2000};
+  uint64_t seed = 1;
+
+  bool enabled() const { return loss > 0 || reorder > 0 || delay.count() > 0 || jitter.count() > 0; }
+};
+
+// Settings shared by transmitter_thread and ground_station_thread.
+// Framing and codec must match on both ends; the rest only matters to one side.
+struct LinkConfig
+{
+  uint16_t port = 5000;
+  FrameMode frame_mode = FrameMode::PerPacket;
+  PayloadCodec codec = PayloadCodec::Deflate;
+  QuantizationConfig quantization;               // Quantized: per-column range and step
+  CompressionConfig compression;                 // PerPacket frames and Udp datagrams; the level also sets Batched deflate's
+  size_t batch_size = 32;                        // Batched: max packets per frame
+  std::chrono::milliseconds batch_deadline{100}; // Batched: max time the first packet waits for company
+  bool verbose = true;                           // print a console line per packet
+  uint64_t link_rate = 0;                        // emulated downlink bytes/s (0 = as fast as the socket goes)
+  uint8_t virtual_channel = 0;                   // Ccsds: base VC (0-7); each source goes out on ccsds_channel(base, source_id)
+
+  ReceiverMode receiver = ReceiverMode::Blocking;
+  size_t reactor_threads = 2; // Epoll: event loops that connections are spread across
+  size_t expected_links = 1;  // Epoll: stop after this many links have connected and closed
+  size_t decode_workers = 0;  // Blocking: threads decoding frames in parallel (0 = on the receive thread)
+  size_t decode_queue = 64;   // Blocking: frames in flight between receive and delivery with decode_workers
+
+  IoBackend io_backend = IoBackend::Sockets; // Tcp: falls back to Sockets where io_uring is unavailable
+  size_t uring_depth = 16;                   // Uring: max frames written per io_uring_enter
+
+  bool reliable = false;                              // Tcp: sequence numbers, acks, reconnect and retransmit (see reliable.h)
+  size_t retransmit_window = 256;                     // reliable: unacked frames kept for retransmission
+  std::chrono::milliseconds reconnect_backoff{20};    // reliable: first retry delay, doubled up to 1 s
+  std::chrono::milliseconds reconnect_timeout{10000}; // reliable: give up after the link stayed down this long
+
+  Transport transport = Transport::Tcp;
+  size_t datagram_batch = 32;                     // Udp: datagrams moved per sendmmsg/recvmmsg call
+  std::chrono::milliseconds udp_idle_timeout{2000}; // Udp: give up on links that went quiet without a FIN
+  ChannelImpairment impairment;                   // Udp: loss/reorder/delay injected on the transmitter side
+
+  std::string shm_name;               // Shm: shared memory object both sides open (empty = private to this process)
+  size_t shm_capacity = 4 * 1024 * 1024; // Shm: ring size in bytes, rounded up to a power of two
+
+  // Ground station CSV log. Rows are formatted and written off the receive path,
+  // in blocks of up to 1024 rows or every 200 ms, and fsync'ed on shutdown.
+  LoggerOptions log_options{true, 1024, std::chrono::milliseconds(200), true};
+  // Ground station: 0 = one log for every source, else a log per source written
+  // by this many threads (see sharded_logger.h), with log_options' format and fsync
+  size_t log_writers = 0;
+
+  // Ground station: called with every decoded packet, never concurrently
+  std::function<void(const TelemetryPacket &)> on_packet;
+  // Ground station: fed every decoded packet when set (see aggregator.h)
+  std::shared_ptr<TelemetryAggregator> aggregator;
+  // Ground station: checks every decoded packet before it is logged (see anomaly.h)
+  std::shared_ptr<AnomalyDetector> detector;
+};
@@ -1,54 +1,78 @@
 #pragma once
-#include <fstream>
-#include <filesystem>
 #include <string>
-#include "../include/telemetry.h"
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include "../include/schema.h"
+
+class ArchiveWriter;
+
+enum class LogFormat
+{
+  Csv,     // text rows, see kCsvHeader
+  Archive, // binary columnar blocks, see archive.h
+};
+
+// Column names and order come from Schema<TelemetryPacket>
+constexpr const char *kCsvHeader = kCsvHeaderOf<TelemetryPacket>.data();
+// Upper bound on one formatted CSV row
+constexpr size_t kMaxCsvRowLength = max_csv_row_length<TelemetryPacket>();
+// Formats one row into [p, end) and returns one past its newline
+inline char *format_csv_row(char *p, char *end, const TelemetryPacket &pkt) { return format_csv(p, end, pkt); }
+
+struct LoggerOptions
+{
+  // Format and write on a background thread instead of the caller's thread
+  bool async = false;
+  // Write out after this many buffered records (0 = no count limit).
+  // In async mode this is also the size of each half of the double buffer.
+  size_t flush_every_records = 1;
+  // Async only: write out whatever is buffered at least this often (0 = no timer).
+  // Archive output only reaches the disk in whole blocks, whatever the flush policy.
+  std::chrono::milliseconds flush_interval{0};
+  // fsync() the file before closing
+  bool fsync_on_close = false;
+  LogFormat format = LogFormat::Csv;
+  // Archive only: rows per column block
+  size_t archive_block_rows = 4096;
+};
 
 class TelemetryLogger
 {
 private:
-  std::ofstream file_;
+  int fd_ = -1;
+  std::unique_ptr<ArchiveWriter> archive_;
+  LoggerOptions options_;
+  std::vector<char> text_; // formatted rows waiting for write()
+  size_t pending_rows_ = 0;
+
+  // Async double buffer: callers fill front_, the writer drains back_
+  std::vector<TelemetryPacket> front_, back_;
+  std::mutex mtx_;
+  std::condition_variable cv_writer_;
+  std::condition_variable cv_space_;
+  bool stop_ = false;
+  bool flush_requested_ = false;
+  bool writing_ = false; // writer is draining back_ with the lock released
+  std::thread writer_;
+
+  void format_rows(const TelemetryPacket *pkts, size_t count);
+  void write_text();
+  // Format + write for CSV, column append for Archive
+  void write_rows(const TelemetryPacket *pkts, size_t count);
+  void writer_loop();
 
 public:
-  explicit TelemetryLogger(const std::string &filename)
-  {
-    namespace fs = std::filesystem;
-
-    fs::path log_dir = "logs";
-    if (!fs::exists(log_dir))
-      fs::create_directory(log_dir);
-
-    fs::path filepath = log_dir / filename;
-    file_.open(filepath, std::ios::app);
-    if (!file_.is_open())
-      throw std::runtime_error("Failed to open log file.");
-
-    if (file_.tellp() == 0)
-    {
-      file_ << "timestamp,temperature,radiation,"
-               "pos_x,pos_y,pos_z,"
-               "pitch,roll,yaw,battery\n";
-    }
-  }
-
-  void log_packet(const TelemetryPacket &pkt)
-  {
-    file_ << pkt.timestamp << ","
-          << pkt.temperature << ","
-          << pkt.radiation << ","
-          << pkt.position[0] << ","
-          << pkt.position[1] << ","
-          << pkt.position[2] << ","
-          << pkt.orientation[0] << ","
-          << pkt.orientation[1] << ","
-          << pkt.orientation[2] << ","
-          << pkt.battery_voltage << "\n";
-    file_.flush(); // ensure immediate write (safe but slightly slower)
-  }
-
-  ~TelemetryLogger()
-  {
-    if (file_.is_open())
-      file_.close();
-  }
+  // Creates logs/<filename>. CSV logs are appended to; archives start fresh.
+  explicit TelemetryLogger(const std::string &filename, const LoggerOptions &options = LoggerOptions{});
+
+  void log_packet(const TelemetryPacket &pkt) { log_packets(&pkt, 1); }
+  void log_packets(const TelemetryPacket *pkts, size_t count);
+  // Writes out everything logged so far
+  void flush();
+
+  ~TelemetryLogger();
 };
@@ -0,0 +1,197 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pipeline metrics: counters, gauges and latency histograms, rendered in the
+// Prometheus text exposition format. Updates go to per-thread stripes with a
+// relaxed add, so the hot path never shares a cache line with another thread;
+// reads sum the stripes.
+
+constexpr size_t kMetricStripes = 16;
+
+// Threads are assigned stripes round-robin on first use
+inline size_t metric_stripe()
+{
+  static std::atomic<size_t> next{0};
+  thread_local size_t stripe = next.fetch_add(1, std::memory_order_relaxed) % kMetricStripes;
+  return stripe;
+}
+
+inline uint64_t metrics_now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+class Counter
+{
+private:
+  struct alignas(64) Slot
+  {
+    std::atomic<uint64_t> value{0};
+  };
+  Slot slots_[kMetricStripes];
+
+public:
+  void add(uint64_t n = 1) { slots_[metric_stripe()].value.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t value() const;
+};
+
+class Gauge
+{
+private:
+  std::atomic<int64_t> value_{0};
+
+public:
+  void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+  void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+};
+
+// Log-linear buckets: exact below 16, then 8 sub-buckets per power of two,
+// so any recorded value is within 12.5% of its bucket's bounds.
+constexpr size_t kHistogramSubBuckets = 8;
+constexpr size_t kHistogramBuckets = (64 - 2) * kHistogramSubBuckets;
+
+struct HistogramSnapshot
+{
+  std::vector<uint64_t> buckets;
+  uint64_t count = 0;
+  uint64_t sum = 0;
+
+  // Upper bound of the bucket holding the p-th percentile (p in 0..100)
+  uint64_t percentile(double p) const;
+};
+
+class Histogram
+{
+private:
+  struct alignas(64) Stripe
+  {
+    std::atomic<uint64_t> buckets[kHistogramBuckets];
+    std::atomic<uint64_t> sum{0};
+  };
+  std::unique_ptr<Stripe[]> stripes_;
+
+public:
+  Histogram();
+
+  static size_t bucket_of(uint64_t value)
+  {
+    if (value < 2 * kHistogramSubBuckets)
+      return value;
+    unsigned exp = 63 - __builtin_clzll(value); // >= 4
+    size_t sub = (value >> (exp - 3)) & (kHistogramSubBuckets - 1);
+    return (exp - 2) * kHistogramSubBuckets + sub;
+  }
+  static uint64_t bucket_lower(size_t bucket);
+  static uint64_t bucket_upper(size_t bucket); // inclusive
+
+  void record(uint64_t value)
+  {
+    Stripe &s = stripes_[metric_stripe()];
+    s.buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    s.sum.fetch_add(value, std::memory_order_relaxed);
+  }
+  HistogramSnapshot snapshot() const;
+};
+
+// Records the time from construction to destruction, in nanoseconds
+class ScopedTimer
+{
+private:
+  Histogram &histogram_;
+  uint64_t start_;
+
+public:
+  explicit ScopedTimer(Histogram &histogram) : histogram_(histogram), start_(metrics_now_ns()) {}
+  ~ScopedTimer() { histogram_.record(metrics_now_ns() - start_); }
+};
+
+// Owns every metric. Registration takes a lock and returns a reference that
+// stays valid for the life of the process, so callers look metrics up once and
+// keep the reference. Registering the same name and labels twice returns the
+// same metric.
+class MetricsRegistry
+{
+private:
+  enum class Kind
+  {
+    Counter,
+    Gauge,
+    GaugeCallback,
+    Histogram,
+  };
+
+  struct Entry
+  {
+    std::string name;
+    std::string help;
+    std::string labels; // e.g. stage="send", without braces
+    Kind kind;
+    double scale = 1; // histogram values are multiplied by this when rendered
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+    std::function<double()> read;
+  };
+
+  mutable std::mutex mtx_;
+  std::vector<std::unique_ptr<Entry>> entries_;
+
+  Entry &lookup(const std::string &name, const std::string &help, const std::string &labels, Kind kind);
+
+public:
+  Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "");
+  Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+  // Gauge computed on read, e.g. from other metrics
+  void gauge(const std::string &name, const std::string &help, std::function<double()> read,
+             const std::string &labels = "");
+  // Drops a series, for callback gauges that read an object about to go away.
+  // References to it from counter(), gauge() or histogram() become dangling.
+  void remove(const std::string &name, const std::string &labels = "");
+  // Values are recorded in nanoseconds and rendered in seconds by default
+  Histogram &histogram(const std::string &name, const std::string &help, const std::string &labels = "",
+                       double scale = 1e-9);
+
+  std::string render_prometheus() const;
+  // Writes the snapshot to path.tmp and renames it over path
+  bool write_file(const std::string &path) const;
+};
+
+MetricsRegistry &metrics();
+
+// Histogram shared by the pipeline stages, labelled by stage name
+Histogram &stage_histogram(const std::string &stage);
+
+// Publishes snapshots of the registry in the background: rewrites a dump
+// file every interval, and/or answers HTTP GETs on 127.0.0.1:port with the
+// Prometheus text. A zero port or empty path disables that side.
+class MetricsExporter
+{
+private:
+  std::string path_;
+  std::chrono::milliseconds interval_;
+  int listen_fd_ = -1;
+  int stop_fd_ = -1;
+  std::thread thread_;
+
+  void run();
+  void serve(int client);
+
+public:
+  MetricsExporter(uint16_t port, const std::string &path, std::chrono::milliseconds interval);
+  ~MetricsExporter(); // writes a final dump
+  MetricsExporter(const MetricsExporter &) = delete;
+  MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+  bool listening() const { return listen_fd_ >= 0; }
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Small BSD socket helpers shared by the transmitter and ground station.
+// Failures are reported with perror() and signalled by -1 / false.
+
+// Bound, listening TCP socket on INADDR_ANY:port (or 127.0.0.1:port) with SO_REUSEADDR set
+int open_listen_socket(uint16_t port, int backlog, bool loopback_only = false);
+// Connected TCP socket to 127.0.0.1:port. quiet skips the perror() for callers that retry.
+int connect_loopback(uint16_t port, bool quiet = false);
+bool set_nonblocking(int fd);
+
+// UDP socket bound to INADDR_ANY:port (or 127.0.0.1:port); port 0 picks a free one
+int open_udp_socket(uint16_t port, bool loopback_only = false);
+// UDP socket connected to 127.0.0.1:port, so plain send()/sendmmsg() need no address
+int connect_udp_loopback(uint16_t port);
+// Port a socket is bound to, 0 on error
+uint16_t local_port(int fd);
+
+// Loop until all bytes are moved; false if the peer closed or the socket failed
+bool send_all(int sock, const uint8_t *data, size_t len);
+bool recv_all(int sock, uint8_t *data, size_t len);
@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#include "telemetry.h"
+
+// Transmit priority of a packet, most urgent first
+enum class PacketPriority : uint8_t
+{
+  Alarm,   // always sent first (strict priority)
+  Warning, // shares the rest of the link with Routine by weight
+  Routine,
+};
+constexpr size_t kPriorityClasses = 3;
+
+const char *priority_name(PacketPriority priority);
+
+// One threshold test on a packet field, e.g. battery_voltage < 10.5 -> Alarm
+struct ClassifierRule
+{
+  enum class Field
+  {
+    Temperature,
+    Radiation,
+    BatteryVoltage,
+  };
+
+  Field field;
+  bool above; // true: field > threshold, false: field < threshold
+  float threshold;
+  PacketPriority priority;
+
+  // Parses "field<value=class" or "field>value=class", with field one of
+  // temperature, radiation, battery_voltage and class one of alarm, warning,
+  // routine. Throws std::invalid_argument on anything else.
+  static ClassifierRule parse(const std::string &text);
+};
+
+// Rules are checked in order and the first match wins; packets matching none are Routine
+class PacketClassifier
+{
+private:
+  std::vector<ClassifierRule> rules_;
+
+public:
+  // Low battery and radiation spikes are alarms, temperature excursions warnings
+  PacketClassifier();
+  explicit PacketClassifier(std::vector<ClassifierRule> rules) : rules_(std::move(rules)) {}
+
+  PacketPriority classify(const TelemetryPacket &pkt) const;
+  const std::vector<ClassifierRule> &rules() const { return rules_; }
+};
+
+struct PriorityConfig
+{
+  PacketClassifier classifier;
+  std::array<size_t, kPriorityClasses> capacity{256, 1024, 1024}; // per class, so a bulk backlog never blocks alarms
+  std::array<uint32_t, kPriorityClasses> weight{0, 4, 1};       // deficit round-robin quanta (packets); Alarm is strict
+};
+
+// Drop-in replacement for TelemetryBuffer in front of a transmitter: producers
+// push packets, which are classified into one bounded FIFO per priority, and
+// the consumer pops them through a scheduler. Alarm packets are served with
+// strict priority; Warning and Routine share what is left by deficit
+// round-robin, so a Routine backlog cannot starve Warnings and vice versa.
+// Order is FIFO within a class only. Any number of producers, one consumer.
+class PriorityTelemetryBuffer
+{
+private:
+  struct Queue
+  {
+    std::vector<TelemetryPacket> ring;
+    size_t head = 0, count = 0;
+    std::condition_variable cv_space;
+  };
+
+  PriorityConfig config_;
+  std::array<Queue, kPriorityClasses> queues_;
+  std::array<uint32_t, kPriorityClasses> deficit_{};
+  size_t next_class_ = 1; // DRR cursor over the non-strict classes
+  mutable std::mutex mtx_;
+  std::condition_variable cv_data_;
+  std::atomic<bool> stop_ = false;
+
+  size_t total_locked() const;
+  size_t take(size_t cls, TelemetryPacket *out, size_t max_count);
+  size_t schedule(TelemetryPacket *out, size_t max_count);
+
+public:
+  explicit PriorityTelemetryBuffer(const PriorityConfig &config = PriorityConfig{});
+
+  void push(const TelemetryPacket &pkt);
+  // Queues the batch's alarms first, then its warnings, then the rest, blocking
+  // while a class is full. Returns how many were queued (fewer only after shutdown).
+  size_t push_n(const TelemetryPacket *pkts, size_t count);
+
+  // Same contract as TelemetryBuffer::pop_n
+  size_t pop_n(TelemetryPacket *out, size_t max_count);
+  size_t pop_n(TelemetryPacket *out, size_t max_count, std::chrono::steady_clock::time_point deadline);
+
+  size_t size() const;
+  size_t size(PacketPriority priority) const;
+  void shutdown();
+  bool is_shutdown() const;
+};
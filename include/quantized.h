@@ -0,0 +1,90 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "schema.h"
+
+// Lossy fixed-point codec for batches of TelemetryPacket. Every float column
+// is clamped to [min, max] and rounded to a multiple of step, which takes
+// ceil(log2((max - min) / step + 1)) bits. Timestamps and sources become
+// offsets from the batch's smallest, in as many bits as the largest offset
+// needs (none for a batch from one source). Every packet is then a record of
+// the same width, so encoding and decoding are straight loops over each
+// column of the batch with no data-dependent branches:
+//
+//   [u64 base timestamp LE][u8 timestamp bits][u32 base source LE][u8 source bits]
+//   [records, bit-packed LSB first]
+//
+// Each batch is self-contained, so frames decode independently. With the
+// default ranges a packet takes 152 bits plus its timestamp offset, i.e.
+// about 20 bytes in batches of 32 instead of 48.
+
+// Range and resolution of one float column
+struct QuantRange
+{
+  float min;
+  float max;
+  float step;
+};
+
+// Both ends of a link must use the same ranges
+struct QuantizationConfig
+{
+  // Schema<TelemetryPacket> order. Temperature and battery cover what the
+  // sensors clamp to, position a low Earth orbit in km, orientation degrees.
+  std::array<QuantRange, kTelemetryFloatColumns> ranges{{
+      {-50.0f, 80.0f, 0.01f},    // temperature
+      {0.0f, 2.0f, 0.0001f},     // radiation
+      {-8192.0f, 8192.0f, 0.01f}, // pos_x
+      {-8192.0f, 8192.0f, 0.01f}, // pos_y
+      {-8192.0f, 8192.0f, 0.01f}, // pos_z
+      {-180.0f, 180.0f, 0.01f},  // pitch
+      {-180.0f, 180.0f, 0.01f},  // roll
+      {-180.0f, 180.0f, 0.01f},  // yaw
+      {9.0f, 12.6f, 0.001f},     // battery
+  }};
+
+  // Parses "column=min:max:step" with column a CSV column name such as
+  // battery. Throws std::invalid_argument on anything else.
+  void set(const std::string &spec);
+};
+
+class QuantizedCodec
+{
+private:
+  struct Field
+  {
+    float min, max, step, inv_step;
+    uint32_t max_code;
+    unsigned bits;
+    unsigned offset; // bit offset in the record, after the timestamp and source
+  };
+
+  std::array<Field, kTelemetryFloatColumns> fields_;
+  unsigned field_bits_ = 0;      // bits per record without the timestamp and source
+  std::vector<uint32_t> codes_;  // one column of the batch being encoded
+  std::vector<uint8_t> padded_;  // decode input plus slack for 8-byte loads
+
+public:
+  // Throws std::invalid_argument for an empty range, a step <= 0 or more
+  // than 2^31 steps
+  explicit QuantizedCodec(const QuantizationConfig &config = QuantizationConfig{});
+
+  // Appends the encoded batch to out. Out-of-range values are clamped and
+  // counted in telemetry_quantized_clamped_total.
+  void encode(const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out);
+  // Decodes exactly count packets; throws if the input is truncated
+  void decode(const uint8_t *data, size_t len, size_t count, TelemetryPacket *out);
+
+  // Bits per packet, excluding the timestamp offset
+  unsigned record_bits() const { return field_bits_; }
+  unsigned bits(size_t column) const { return fields_[column].bits; }
+  // Worst-case |decoded - original| for an in-range value of a column: half
+  // a step plus float rounding
+  float max_error(size_t column) const;
+  // One line per column: name, range, bits and worst-case error
+  std::string describe() const;
+};
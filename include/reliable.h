@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "telemetry.h"
+#include "frame.h"
+#include "link.h"
+
+// Reliable TCP link (LinkConfig::reliable). Every frame is prefixed with a
+// sequence number:
+//
+//   [u64 seq][frame as described by FrameMode]
+//
+// and the ground station answers with cumulative acks, [u64 next expected
+// seq], right after accepting a connection and then every few frames. The
+// transmitter keeps unacked frames as raw packets in a fixed window; when the
+// connection drops it reconnects with backoff, starts a fresh encoder (the
+// deflate stream died with the connection) and re-sends everything from the
+// last ack on. The ground station drops frames it has already delivered.
+// A frame with seq kEndOfStream ends the link once everything is acked.
+constexpr size_t kSeqSize = 8;
+constexpr uint64_t kEndOfStream = ~0ull;
+
+// Transmitter side of a reliable link
+class ReliableSender
+{
+private:
+  const LinkConfig &config_;
+  const size_t window_, batch_;
+
+  // Unacked frames: frame seq lives in slot seq % window_
+  std::vector<TelemetryPacket> packets_; // window_ * batch_
+  std::vector<uint32_t> counts_;
+  uint64_t next_seq_ = 0; // next frame to queue
+  uint64_t acked_ = 0;    // every frame below this has been delivered
+  uint64_t sent_ = 0;     // every frame below this went out at least once
+
+  int sock_ = -1;
+  std::unique_ptr<FrameEncoder> encoder_;
+  std::vector<uint8_t> bytes_;
+  uint8_t ack_buf_[kSeqSize];
+  size_t ack_have_ = 0;
+
+  uint64_t reconnects_ = 0, retransmitted_ = 0, wire_bytes_ = 0;
+
+  bool transmit(uint64_t seq);
+  bool read_acks(bool block, uint64_t &ack);
+  bool wait_for_ack();
+  bool reconnect();
+  void disconnect();
+
+public:
+  // Connects, retrying with backoff for up to LinkConfig::reconnect_timeout
+  explicit ReliableSender(const LinkConfig &config);
+  ~ReliableSender();
+  ReliableSender(const ReliableSender &) = delete;
+  ReliableSender &operator=(const ReliableSender &) = delete;
+
+  bool ok() const { return sock_ >= 0; }
+
+  // Queues one frame and sends it, blocking while the window is full. Returns
+  // false once the link stayed down for longer than reconnect_timeout.
+  bool send(const TelemetryPacket *pkts, size_t count);
+  // Waits until every frame is acked, then ends the link
+  bool finish();
+
+  uint64_t frames() const { return next_seq_; }
+  uint64_t reconnects() const { return reconnects_; }
+  uint64_t retransmitted() const { return retransmitted_; }
+  uint64_t wire_bytes() const { return wire_bytes_; }
+};
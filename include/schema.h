@@ -0,0 +1,386 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+
+#include "telemetry.h"
+
+// Compile-time description of a packet type: Schema<P>::columns lists its
+// scalar fields (array members one element at a time) with their CSV names,
+// in wire and CSV order. The packed binary codec, the CSV header, writer and
+// parser and the columnar codec's column order are all generated from it, so
+// adding a field is one struct member plus one line here.
+//
+// Wire format: the columns back to back with no padding, each little-endian.
+
+namespace schema_detail
+{
+  template <typename M>
+  struct Element
+  {
+    using type = M;
+  };
+
+  template <typename T, size_t N>
+  struct Element<std::array<T, N>>
+  {
+    using type = T;
+  };
+
+  constexpr bool kLittleEndianHost = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+  template <typename T>
+  using Bits = std::conditional_t<sizeof(T) == 8, uint64_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint16_t>>;
+
+  template <typename U>
+  U byteswap(U v)
+  {
+    if constexpr (sizeof(U) == 8)
+      return __builtin_bswap64(v);
+    else if constexpr (sizeof(U) == 4)
+      return __builtin_bswap32(v);
+    else
+      return __builtin_bswap16(v);
+  }
+
+  constexpr size_t length(const char *s)
+  {
+    size_t n = 0;
+    while (s[n])
+      ++n;
+    return n;
+  }
+}
+
+// One scalar column: a member, or element index of an std::array member
+template <typename P, typename M>
+struct Column
+{
+  using Packet = P;
+  using Type = typename schema_detail::Element<M>::type;
+  static_assert(std::is_arithmetic_v<Type> && sizeof(Type) >= 2, "columns are 16-64 bit numbers");
+
+  const char *name;
+  M P::*member;
+  size_t index;
+
+  template <typename Q>
+  constexpr auto &get(Q &pkt) const
+  {
+    if constexpr (std::is_same_v<M, Type>)
+      return pkt.*member;
+    else
+      return (pkt.*member)[index];
+  }
+};
+
+template <typename P, typename M>
+constexpr Column<P, M> column(const char *name, M P::*member, size_t index = 0)
+{
+  return {name, member, index};
+}
+
+template <typename P>
+struct Schema; // specialised below for each packet type
+
+// Calls fn(column) for every column of P, in schema order
+template <typename P, typename Fn>
+constexpr void for_each_column(Fn &&fn)
+{
+  std::apply([&](const auto &...cols)
+             { (fn(cols), ...); },
+             Schema<P>::columns);
+}
+
+template <typename P>
+constexpr size_t column_count()
+{
+  return std::tuple_size_v<std::decay_t<decltype(Schema<P>::columns)>>;
+}
+
+// Columns of P whose element type is T
+template <typename P, typename T>
+constexpr size_t column_count_of()
+{
+  size_t n = 0;
+  for_each_column<P>([&](auto col)
+                     { n += std::is_same_v<typename decltype(col)::Type, T>; });
+  return n;
+}
+
+// Calls fn(index, column) for every column of P whose element type is T, in
+// schema order; index counts those columns only
+template <typename P, typename T, typename Fn>
+constexpr void for_each_column_of(Fn &&fn)
+{
+  size_t index = 0;
+  for_each_column<P>([&](auto col)
+                     {
+                       if constexpr (std::is_same_v<typename decltype(col)::Type, T>)
+                         fn(index++, col); });
+}
+
+// CSV names of the columns of P whose element type is T, in schema order
+template <typename P, typename T>
+constexpr std::array<const char *, column_count_of<P, T>()> column_names_of()
+{
+  std::array<const char *, column_count_of<P, T>()> names{};
+  for_each_column_of<P, T>([&](size_t i, auto col)
+                           { names[i] = col.name; });
+  return names;
+}
+
+// Bytes one packet occupies on the wire
+template <typename P>
+constexpr size_t wire_size()
+{
+  size_t size = 0;
+  for_each_column<P>([&](auto col)
+                     { size += sizeof(typename decltype(col)::Type); });
+  return size;
+}
+
+template <typename T>
+inline void store_le(uint8_t *out, T value)
+{
+  using U = schema_detail::Bits<T>;
+  U bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  if constexpr (!schema_detail::kLittleEndianHost)
+    bits = schema_detail::byteswap(bits);
+  std::memcpy(out, &bits, sizeof(bits));
+}
+
+template <typename T>
+inline T load_le(const uint8_t *in)
+{
+  using U = schema_detail::Bits<T>;
+  U bits;
+  std::memcpy(&bits, in, sizeof(bits));
+  if constexpr (!schema_detail::kLittleEndianHost)
+    bits = schema_detail::byteswap(bits);
+  T value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+namespace schema_detail
+{
+  // True when the columns sit back to back in P in schema order, so that on a
+  // little-endian host the wire bytes are just the front of the struct. Needs
+  // member addresses, so it is not constexpr, but it folds to a constant.
+  template <typename P>
+  inline bool wire_is_prefix()
+  {
+    static_assert(std::is_trivially_copyable_v<P>);
+    if constexpr (!kLittleEndianHost)
+      return false;
+    P probe{};
+    size_t at = 0;
+    bool prefix = true;
+    for_each_column<P>([&](auto col)
+                       {
+                         auto offset = reinterpret_cast<const char *>(&col.get(probe)) - reinterpret_cast<const char *>(&probe);
+                         prefix = prefix && offset == static_cast<std::ptrdiff_t>(at);
+                         at += sizeof(typename decltype(col)::Type); });
+    return prefix;
+  }
+}
+
+// Writes wire_size<P>() bytes
+template <typename P>
+inline void encode_packed(const P &pkt, uint8_t *out)
+{
+  if (schema_detail::wire_is_prefix<P>())
+  {
+    std::memcpy(out, &pkt, wire_size<P>());
+    return;
+  }
+  for_each_column<P>([&](auto col)
+                     {
+                       using T = typename decltype(col)::Type;
+                       store_le<T>(out, col.get(pkt));
+                       out += sizeof(T); });
+}
+
+// Fills the columns of pkt in place. Prefer this to the by-value form in hot
+// loops: copying a packet just built field by field stalls on store forwarding.
+template <typename P>
+inline void decode_packed(const uint8_t *in, P &pkt)
+{
+  if (schema_detail::wire_is_prefix<P>())
+  {
+    std::memcpy(&pkt, in, wire_size<P>());
+    return;
+  }
+  for_each_column<P>([&](auto col)
+                     {
+                       using T = typename decltype(col)::Type;
+                       col.get(pkt) = load_le<T>(in);
+                       in += sizeof(T); });
+}
+
+template <typename P>
+inline P decode_packed(const uint8_t *in)
+{
+  P pkt{};
+  decode_packed(in, pkt);
+  return pkt;
+}
+
+// "name,name,...\n" plus a terminating NUL, built at compile time
+template <typename P>
+constexpr size_t csv_header_length()
+{
+  size_t n = 0;
+  for_each_column<P>([&](auto col)
+                     { n += schema_detail::length(col.name) + 1; });
+  return n;
+}
+
+template <typename P>
+constexpr std::array<char, csv_header_length<P>() + 1> make_csv_header()
+{
+  std::array<char, csv_header_length<P>() + 1> text{};
+  size_t at = 0;
+  for_each_column<P>([&](auto col)
+                     {
+                       for (const char *s = col.name; *s; ++s)
+                         text[at++] = *s;
+                       text[at++] = ','; });
+  text[at - 1] = '\n';
+  return text;
+}
+
+template <typename P>
+inline constexpr auto kCsvHeaderOf = make_csv_header<P>();
+
+namespace schema_detail
+{
+  // Longest text for one value: 20 digits for a u64, and for floats
+  // ostream's default %g with 6 significant digits, e.g. -1.23457e+38
+  template <typename T>
+  constexpr size_t max_text_length()
+  {
+    if constexpr (std::is_floating_point_v<T>)
+      return 13;
+    else
+      return std::numeric_limits<T>::digits10 + 1 + std::is_signed_v<T>;
+  }
+}
+
+// Upper bound on one formatted CSV row, separators and newline included
+template <typename P>
+constexpr size_t max_csv_row_length()
+{
+  size_t n = 0;
+  for_each_column<P>([&](auto col)
+                     { n += schema_detail::max_text_length<typename decltype(col)::Type>() + 1; });
+  return n;
+}
+
+// Formats one row into [p, end) and returns one past its newline
+template <typename P>
+inline char *format_csv(char *p, char *end, const P &pkt)
+{
+  for_each_column<P>([&](auto col)
+                     {
+                       using T = typename decltype(col)::Type;
+                       // Never past this column's share of the row bound, even where to_chars fails
+                       char *stop = std::min(end, p + schema_detail::max_text_length<T>());
+                       if constexpr (std::is_floating_point_v<T>)
+                         p = std::to_chars(p, stop, col.get(pkt), std::chars_format::general, 6).ptr;
+                       else
+                         p = std::to_chars(p, stop, col.get(pkt)).ptr;
+                       *p++ = ','; });
+  p[-1] = '\n';
+  return p;
+}
+
+// Parses the leading columns of one row as written by format_csv; false if
+// any is missing or malformed. Anything after the last column is ignored.
+template <typename P>
+inline bool parse_csv(const char *p, const char *end, P &pkt)
+{
+  bool ok = true;
+  bool first = true;
+  for_each_column<P>([&](auto col)
+                     {
+                       if (!ok)
+                         return;
+                       if (!first && (p == end || *p++ != ','))
+                       {
+                         ok = false;
+                         return;
+                       }
+                       first = false;
+                       auto res = std::from_chars(p, end, col.get(pkt));
+                       ok = res.ec == std::errc();
+                       p = res.ptr; });
+  return ok;
+}
+
+template <>
+struct Schema<TelemetryPacket>
+{
+  using P = TelemetryPacket;
+  static constexpr auto columns = std::make_tuple(
+      column("timestamp", &P::timestamp),
+      column("temperature", &P::temperature),
+      column("radiation", &P::radiation),
+      column("pos_x", &P::position, 0),
+      column("pos_y", &P::position, 1),
+      column("pos_z", &P::position, 2),
+      column("pitch", &P::orientation, 0),
+      column("roll", &P::orientation, 1),
+      column("yaw", &P::orientation, 2),
+      column("battery", &P::battery_voltage),
+      column("source", &P::source_id));
+};
+
+// The sensor readings: what the quantized codec, the aggregator and the
+// anomaly detector work on, indexed in this order
+constexpr size_t kTelemetryFloatColumns = column_count_of<TelemetryPacket, float>();
+inline constexpr auto kTelemetryFloatNames = column_names_of<TelemetryPacket, float>();
+
+template <>
+struct Schema<PowerPacket>
+{
+  using P = PowerPacket;
+  static constexpr auto columns = std::make_tuple(
+      column("timestamp", &P::timestamp),
+      column("bus_voltage", &P::bus_voltage),
+      column("bus_current", &P::bus_current),
+      column("state_of_charge", &P::state_of_charge),
+      column("solar_a", &P::solar_current, 0),
+      column("solar_b", &P::solar_current, 1),
+      column("solar_c", &P::solar_current, 2),
+      column("solar_d", &P::solar_current, 3),
+      column("fault_flags", &P::fault_flags));
+};
+
+template <>
+struct Schema<ThermalPacket>
+{
+  using P = ThermalPacket;
+  static constexpr auto columns = std::make_tuple(
+      column("timestamp", &P::timestamp),
+      column("zone_0", &P::zone_temperature, 0),
+      column("zone_1", &P::zone_temperature, 1),
+      column("zone_2", &P::zone_temperature, 2),
+      column("zone_3", &P::zone_temperature, 3),
+      column("zone_4", &P::zone_temperature, 4),
+      column("zone_5", &P::zone_temperature, 5),
+      column("zone_6", &P::zone_temperature, 6),
+      column("zone_7", &P::zone_temperature, 7),
+      column("heater_0", &P::heater_duty, 0),
+      column("heater_1", &P::heater_duty, 1),
+      column("heater_2", &P::heater_duty, 2),
+      column("heater_3", &P::heater_duty, 3));
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+
+#include "telemetry.h"
+
+// Multi-producer / multi-consumer buffer built from one bounded ring per producer.
+// Producers only ever touch their own shard, so they never contend with each other.
+// Consumers start at a "home" shard and steal from the others when it runs dry.
+// Each shard is drained strictly from its front, so per-producer FIFO order is kept.
+class ShardedTelemetryBuffer
+{
+private:
+  struct alignas(64) Shard
+  {
+    std::mutex mtx;
+    std::condition_variable cv_space;
+    std::vector<TelemetryPacket> ring;
+    size_t head = 0, tail = 0;    // monotonic, guarded by mtx
+    std::atomic<size_t> count{0}; // lock-free hint so consumers can skip empty shards
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  const size_t capacity_; // per shard
+
+  std::mutex wait_mtx_;
+  std::condition_variable cv_data_;
+  std::atomic<size_t> parked_{0}; // consumers asleep on cv_data_
+  std::atomic<bool> stop_ = false;
+
+  size_t try_pop(size_t shard, TelemetryPacket *out, size_t max_count);
+  bool any_pending() const;
+  void wake_consumers(bool all);
+
+public:
+  // Producer-side handle bound to one shard. Mirrors the TelemetryBuffer producer API.
+  class Producer
+  {
+    ShardedTelemetryBuffer *buf_;
+    size_t shard_;
+
+  public:
+    Producer(ShardedTelemetryBuffer &buf, size_t shard) : buf_(&buf), shard_(shard) {}
+    void push(const TelemetryPacket &pkt) { buf_->push(shard_, pkt); }
+    size_t push_n(const TelemetryPacket *pkts, size_t count) { return buf_->push_n(shard_, pkts, count); }
+    bool is_shutdown() const { return buf_->is_shutdown(); }
+  };
+
+  // Consumer-side handle. The id only selects the home shard; any consumer may steal.
+  class Consumer
+  {
+    ShardedTelemetryBuffer *buf_;
+    size_t id_;
+
+  public:
+    Consumer(ShardedTelemetryBuffer &buf, size_t id) : buf_(&buf), id_(id) {}
+    TelemetryPacket pop() { return buf_->pop(id_); }
+    size_t pop_n(TelemetryPacket *out, size_t max_count) { return buf_->pop_n(id_, out, max_count); }
+    size_t pop_n(TelemetryPacket *out, size_t max_count, std::chrono::steady_clock::time_point deadline)
+    {
+      return buf_->pop_n(id_, out, max_count, deadline);
+    }
+    bool is_shutdown() const { return buf_->is_shutdown(); }
+  };
+
+  ShardedTelemetryBuffer(size_t producers, size_t capacity_per_shard = 100);
+
+  Producer producer(size_t id) { return Producer(*this, id % shards_.size()); }
+  Consumer consumer(size_t id) { return Consumer(*this, id); }
+
+  void push(size_t producer, const TelemetryPacket &pkt);
+  size_t push_n(size_t producer, const TelemetryPacket *pkts, size_t count);
+
+  // Blocks until any shard has data. Returns an empty packet (or 0) once shut down and drained.
+  TelemetryPacket pop(size_t consumer);
+  size_t pop_n(size_t consumer, TelemetryPacket *out, size_t max_count);
+  // As pop_n, but gives up and returns 0 if nothing arrives before deadline
+  size_t pop_n(size_t consumer, TelemetryPacket *out, size_t max_count,
+               std::chrono::steady_clock::time_point deadline);
+
+  size_t size() const;
+  size_t shard_count() const { return shards_.size(); }
+  void shutdown();
+  bool is_shutdown() const;
+};
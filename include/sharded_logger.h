@@ -0,0 +1,120 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "telemetry.h"
+#include "logger.h"
+
+// Ground station log split by TelemetryPacket::source_id: every source gets
+// its own file, logs/<prefix>_src<id>.csv (or .tlm), written by one of a few
+// writer threads. Sources are placed on writers by consistent hashing, with
+// kVirtualNodes points per writer on a 64-bit ring, so a source always lands
+// on the same writer and a different writer count only moves the sources
+// whose ring segment changed hands.
+//
+// Each writer keeps a queue per source and gives the sources with packets
+// waiting one turn each in rotation, so a source sending in bursts cannot
+// starve the others on its writer. log_packets() never waits: each source's
+// queue is bounded, and packets that find it full are dropped and counted
+// against that source alone, so a slow file or a flooding source cannot hold
+// up the receiver or the other sources.
+//
+// Writers also follow each source's sequence. The timestamp is the source's
+// own tick, so a jump forward means packets went missing and a step back
+// means one arrived late or twice. Packets dropped on a full queue also show
+// up as missing.
+
+struct ShardedLoggerOptions
+{
+  size_t writers = 2;           // writer threads
+  size_t queue_packets = 16384; // per source; packets beyond this are dropped
+  size_t max_open_files = 512;  // CSV shards beyond this are closed least recently written first and reopened on demand
+  LoggerOptions log;            // per shard, written synchronously by its writer (async is ignored)
+};
+
+// Sequence of one source as seen by the ground station
+struct SourceStats
+{
+  uint32_t source = 0;
+  uint64_t packets = 0;
+  uint64_t missing = 0;        // ticks skipped over; a late packet may fill one in afterwards
+  uint64_t late = 0;           // packets at or before the newest timestamp already seen
+  uint64_t last_timestamp = 0; // newest seen
+  uint64_t dropped = 0;        // not logged because the source's queue was full
+};
+
+class ShardedTelemetryLogger
+{
+public:
+  static constexpr size_t kVirtualNodes = 64;
+  static constexpr size_t kTurnPackets = 1024; // most a source writes before the next source's turn
+
+private:
+  struct Shard
+  {
+    uint32_t source;
+    std::deque<TelemetryPacket> pending; // guarded by Writer::mtx
+    bool queued = false;                 // in Writer::ready, guarded by Writer::mtx
+    uint64_t dropped = 0;                // guarded by Writer::mtx
+    SourceStats stats;                   // written by the writer thread under Writer::mtx
+
+    // Writer thread only
+    std::unique_ptr<TelemetryLogger> logger;
+    uint64_t last_turn = 0;
+  };
+
+  struct Writer
+  {
+    std::mutex mtx;
+    std::condition_variable cv_work, cv_drained;
+    std::unordered_map<uint32_t, std::unique_ptr<Shard>> shards;
+    std::deque<Shard *> ready; // sources with packets waiting, in turn order
+    size_t pending = 0;        // packets queued across its shards
+    bool busy = false;         // writing a turn with the lock released
+    bool stop = false;
+
+    // Writer thread only
+    std::vector<Shard *> open; // shards with a file open
+    uint64_t turns = 0;
+    std::thread thread;
+  };
+
+  std::string prefix_;
+  ShardedLoggerOptions options_;
+  std::vector<std::pair<uint64_t, size_t>> ring_; // (point, writer), sorted by point
+  std::vector<std::unique_ptr<Writer>> writers_;
+
+  void enqueue(Writer &w, const TelemetryPacket *pkts, size_t count);
+  void write_loop(Writer &w);
+  void write_turn(Writer &w, Shard &shard, const std::vector<TelemetryPacket> &batch, SourceStats &stats);
+
+public:
+  // Starts the writers. prefix names the files, e.g. "telemetry_1700000000".
+  explicit ShardedTelemetryLogger(const std::string &prefix, const ShardedLoggerOptions &options = ShardedLoggerOptions{});
+  // Writes out everything queued and closes every shard
+  ~ShardedTelemetryLogger();
+  ShardedTelemetryLogger(const ShardedTelemetryLogger &) = delete;
+  ShardedTelemetryLogger &operator=(const ShardedTelemetryLogger &) = delete;
+
+  // Thread-safe and never blocks on a writer. Keeps each source's packets in
+  // the order given, less any dropped on a full queue.
+  void log_packets(const TelemetryPacket *pkts, size_t count);
+  // Waits until everything logged so far has been written
+  void flush();
+
+  size_t writers() const { return writers_.size(); }
+  size_t writer_for(uint32_t source) const;
+  // File of one source, relative to logs/
+  std::string filename(uint32_t source) const;
+  // Every source seen so far, by id; exact after flush()
+  std::vector<SourceStats> sources() const;
+};
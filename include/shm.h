@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "link.h"
+
+// Shared-memory link (Transport::Shm) between a transmitter and a ground
+// station on the same host, in one process or two. The ground station creates
+// a POSIX shared memory object holding a single-producer, single-consumer byte
+// ring and the transmitter maps the same object. Every encode() output is one
+// record:
+//
+//   [u32 len][frames as described by FrameMode][pad to 8 bytes]
+//
+// Records never wrap; one that does not fit before the end of the ring is
+// written at the start, behind a skip marker. The ground station decodes
+// frames where they lie and only then hands their space back. A waiting side
+// spins for a moment on the other's index and then sleeps on a futex inside
+// the mapping, which the other side only wakes when it sees it parked.
+struct ShmRingHeader;
+
+// Name of the shared memory object for a link: LinkConfig::shm_name, or one
+// unique to this process and port when that is empty
+std::string shm_object_name(const LinkConfig &config);
+
+// Transmitter side
+class ShmSender
+{
+private:
+  ShmRingHeader *ring_ = nullptr;
+  uint8_t *data_ = nullptr;
+  size_t capacity_ = 0, map_size_ = 0;
+  uint64_t head_ = 0; // our copy of ring_->head
+  bool closed_ = false;
+
+public:
+  // Maps the ring, waiting up to LinkConfig::reconnect_timeout for the ground
+  // station to create it
+  explicit ShmSender(const LinkConfig &config);
+  ~ShmSender();
+  ShmSender(const ShmSender &) = delete;
+  ShmSender &operator=(const ShmSender &) = delete;
+
+  bool ok() const { return ring_ != nullptr; }
+
+  // Copies one record into the ring, blocking while it is full. False once the
+  // ground station has gone, or for a record bigger than half the ring.
+  bool send(const uint8_t *data, size_t len);
+  // Marks the end of the stream; the ground station returns once it has read everything
+  void close();
+
+  size_t capacity() const { return capacity_; }
+};
+
+// Ground station side
+class ShmReceiver
+{
+private:
+  ShmRingHeader *ring_ = nullptr;
+  uint8_t *data_ = nullptr;
+  size_t capacity_ = 0, map_size_ = 0;
+  uint64_t tail_ = 0; // our copy of ring_->tail
+  size_t held_ = 0;   // bytes of the record handed out by next()
+  std::string name_;
+  bool linked_ = false; // the name still points at our object
+
+public:
+  // Creates the ring with room for LinkConfig::shm_capacity bytes
+  explicit ShmReceiver(const LinkConfig &config);
+  ~ShmReceiver();
+  ShmReceiver(const ShmReceiver &) = delete;
+  ShmReceiver &operator=(const ShmReceiver &) = delete;
+
+  bool ok() const { return ring_ != nullptr; }
+
+  // Waits for the transmitter to map the ring, then removes the name so
+  // nothing is left behind in /dev/shm
+  bool wait_for_sender(std::chrono::milliseconds timeout);
+  // The next record, in place; valid until release(). False once the
+  // transmitter has closed and everything before that has been read.
+  bool next(const uint8_t *&data, size_t &len);
+  // Hands the record from next() back to the transmitter
+  void release();
+};
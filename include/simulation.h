@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <memory>
+
+#include "telemetry.h"
+
+// How the sensor loop advances simulated time. Each tick moves the simulation
+// forward by a fixed dt; the speed factor only decides how long the loop
+// sleeps between ticks, so the packets produced depend on seed and dt alone.
+struct SimulationConfig
+{
+  double dt = 1.0;         // simulated seconds per tick (one packet per tick)
+  double speed = 1.0;      // simulated seconds per real second, 0 = as fast as possible
+  uint64_t seed = 0;       // 0 picks a random seed
+  uint64_t max_packets = 0; // stop after this many packets (0 = until the buffer shuts down)
+  uint32_t source_id = 0;   // stamped on every packet
+};
+
+// Fixed-step clock. advance() sleeps until the real time that matches the
+// next tick at the configured speed, measured from construction, so sleep
+// overshoot never accumulates into drift.
+class VirtualClock
+{
+private:
+  double dt_;
+  double speed_;
+  uint64_t ticks_ = 0;
+  std::chrono::steady_clock::time_point start_;
+
+public:
+  explicit VirtualClock(const SimulationConfig &config);
+
+  double dt() const { return dt_; }
+  uint64_t ticks() const { return ticks_; }
+  double now() const { return ticks_ * dt_; } // simulated seconds since start
+  bool realtime() const { return speed_ > 0; }
+
+  void advance();
+};
+
+// Resolves SimulationConfig::seed == 0 to a random seed
+uint64_t resolve_seed(uint64_t seed);
+
+// One spacecraft: five polymorphic sensors drawing noise from one seeded
+// generator, producing a packet per call (sensors.cpp)
+class TelemetrySimulator
+{
+private:
+  struct Sensors;
+  std::unique_ptr<Sensors> sensors_;
+  uint64_t tick_ = 0;
+
+public:
+  explicit TelemetrySimulator(uint64_t seed);
+  ~TelemetrySimulator();
+  TelemetrySimulator(TelemetrySimulator &&) noexcept;
+
+  TelemetryPacket generate_packet(double dt);
+};
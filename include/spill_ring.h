@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "telemetry.h"
+
+// Fixed-capacity FIFO of packets in a memory-mapped scratch file, used by
+// TelemetryBuffer's Spill overflow policy to ride out long link outages
+// without growing the heap. The file is unlinked as soon as it is created, so
+// nothing is left behind, even after a crash. Written pages are ordinary file
+// data that the kernel can write back and evict, so a full ring costs disk
+// rather than heap. Not thread-safe; the owner locks.
+class SpillRing
+{
+private:
+  uint8_t *map_ = nullptr;
+  size_t capacity_;
+  size_t head_ = 0, count_ = 0;
+
+  uint8_t *slot(size_t i) { return map_ + (i % capacity_) * sizeof(TelemetryPacket); }
+
+public:
+  // Creates the backing file in dir with all of its space reserved. Throws
+  // std::runtime_error on failure, including when the disk cannot hold it.
+  SpillRing(const std::string &dir, size_t capacity);
+  ~SpillRing();
+  SpillRing(const SpillRing &) = delete;
+  SpillRing &operator=(const SpillRing &) = delete;
+
+  // Appends pkt; a full ring makes room by discarding its oldest packet and returns false
+  bool push(const TelemetryPacket &pkt);
+  size_t pop_n(TelemetryPacket *out, size_t max_count);
+
+  size_t size() const { return count_; }
+  size_t capacity() const { return capacity_; }
+  bool empty() const { return count_ == 0; }
+};
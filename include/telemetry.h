@@ -1,13 +1,50 @@
 #pragma once
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
 struct TelemetryPacket
 {
-  uint64_t timestamp; // seconds since start of simulation
+  uint64_t timestamp; // simulation tick, i.e. seconds since start at the default 1 s dt
   float temperature;
   float radiation;
-  float battery_voltage;
   std::array<float, 3> position;
   std::array<float, 3> orientation;
+  float battery_voltage;
+  uint32_t source_id = 0; // spacecraft that produced it; fills what used to be tail padding
+};
+
+// Calls fn(first, n) for each run of consecutive packets from one source.
+// A batch almost always comes from one link, i.e. one source, so this is
+// usually a single call; per-source state is looked up once per run.
+template <typename Fn>
+inline void for_each_source_run(const TelemetryPacket *pkts, size_t count, Fn fn)
+{
+  for (size_t begin = 0; begin < count;)
+  {
+    size_t end = begin + 1;
+    while (end < count && pkts[end].source_id == pkts[begin].source_id)
+      ++end;
+    fn(pkts + begin, end - begin);
+    begin = end;
+  }
+}
+
+// Electrical power subsystem housekeeping
+struct PowerPacket
+{
+  uint64_t timestamp;
+  float bus_voltage;
+  float bus_current;
+  float state_of_charge; // battery, 0..1
+  std::array<float, 4> solar_current; // per array wing
+  uint32_t fault_flags;
+};
+
+// Thermal control subsystem housekeeping
+struct ThermalPacket
+{
+  uint64_t timestamp;
+  std::array<float, 8> zone_temperature;
+  std::array<float, 4> heater_duty; // 0..1
 };
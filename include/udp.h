@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "telemetry.h"
+#include "compression.h"
+#include "link.h"
+
+// UDP transport. Every datagram stands alone so a lost one costs only its own
+// packets, never the ones behind it:
+//
+//   [u32 seq][u16 count][u8 encoding][u8 flags][payload]
+//
+// seq numbers data datagrams 0, 1, 2, ... per link. A datagram with the FIN flag
+// ends the link; its seq is the number of data datagrams that were sent, which
+// lets the ground station turn gaps into an exact loss count.
+constexpr size_t kMaxDatagramSize = 1400; // stays clear of a 1500 byte MTU after IP/UDP headers
+constexpr size_t kDatagramHeaderSize = 8;
+constexpr size_t kMaxDatagramPackets = (kMaxDatagramSize - kDatagramHeaderSize) / kPacketWireSize;
+
+enum class DatagramEncoding : uint8_t
+{
+  Raw = 0,      // serialised packets back to back
+  Zlib = 1,     // the raw payload through LinkConfig::compression (zlib by default)
+  Columnar = 2, // columnar_codec.h
+};
+
+struct DatagramHeader
+{
+  uint32_t seq;
+  uint16_t count;
+  DatagramEncoding encoding;
+  bool fin;
+};
+
+// Writes one datagram carrying pkts[0..count) to out (kMaxDatagramSize bytes of
+// space) and returns its length. count must be at most kMaxDatagramPackets.
+// Falls back to Raw whenever the preferred encoding would not be smaller.
+// Zlib payloads go through codec, or compress_data() without one.
+size_t encode_datagram(uint32_t seq, const TelemetryPacket *pkts, size_t count, DatagramEncoding preferred,
+                       uint8_t *out, Codec *codec = nullptr);
+size_t encode_fin(uint32_t seq, uint8_t *out);
+// Appends the datagram's packets to out. Throws std::runtime_error on malformed input.
+DatagramHeader decode_datagram(const uint8_t *data, size_t len, std::vector<TelemetryPacket> &out,
+                              Codec *codec = nullptr);
+
+// Transmitter side: packs packets into datagrams and hands them to the kernel
+// LinkConfig::datagram_batch at a time with sendmmsg().
+class UdpSender
+{
+private:
+  int fd_;
+  size_t batch_;
+  DatagramEncoding encoding_;
+  std::unique_ptr<Codec> compressor_;
+  uint32_t seq_ = 0;
+  std::vector<uint8_t> slots_; // batch_ datagrams of kMaxDatagramSize each
+  std::vector<size_t> lengths_;
+  std::vector<size_t> counts_; // packets in each queued datagram
+  uint64_t syscalls_ = 0, bytes_ = 0;
+  uint64_t dropped_ = 0, dropped_packets_ = 0;
+
+  uint8_t *slot(size_t i) { return slots_.data() + i * kMaxDatagramSize; }
+
+public:
+  UdpSender(uint16_t port, const LinkConfig &config);
+  ~UdpSender();
+  UdpSender(const UdpSender &) = delete;
+  UdpSender &operator=(const UdpSender &) = delete;
+
+  bool ok() const { return fd_ >= 0; }
+
+  // Queues pkts as full datagrams; a full batch goes out straight away
+  bool send(const TelemetryPacket *pkts, size_t count);
+  // Sends whatever is queued
+  bool flush();
+  // Flushes and ends the link with a few copies of the FIN datagram
+  void finish();
+
+  uint32_t datagrams() const { return seq_; }
+  uint64_t syscalls() const { return syscalls_; }
+  uint64_t bytes() const { return bytes_; }
+  // Datagrams, and the packets in them, refused because nothing was listening
+  uint64_t dropped() const { return dropped_; }
+  uint64_t dropped_packets() const { return dropped_packets_; }
+};
+
+// Loopback relay that impairs a UDP link for testing: datagrams sent to port()
+// are forwarded to forward_port after being dropped, delayed or held back
+// according to ChannelImpairment, driven by its seed. FIN datagrams are never
+// impaired and are held until everything received before them has gone out.
+// stop() (or the destructor) forwards whatever is still held before returning.
+class ImpairmentProxy
+{
+private:
+  ChannelImpairment impairment_;
+  int in_fd_, out_fd_, stop_fd_;
+  uint16_t port_ = 0;
+  std::atomic<uint64_t> forwarded_{0}, dropped_{0}, reordered_{0};
+  std::thread thread_;
+
+  void run();
+
+public:
+  ImpairmentProxy(uint16_t forward_port, const ChannelImpairment &impairment);
+  ~ImpairmentProxy();
+  ImpairmentProxy(const ImpairmentProxy &) = delete;
+  ImpairmentProxy &operator=(const ImpairmentProxy &) = delete;
+
+  bool ok() const { return port_ != 0; }
+  uint16_t port() const { return port_; }
+
+  // Relays everything already sent to port(), then stops; later datagrams are ignored
+  void stop();
+
+  uint64_t forwarded() const { return forwarded_.load(); }
+  uint64_t dropped() const { return dropped_.load(); }
+  uint64_t reordered() const { return reordered_.load(); }
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "link.h"
+
+// Minimal io_uring wrapper on the raw syscalls (no liburing): one submission
+// and one completion ring, mapped into the process so queuing requests and
+// reaping completions are plain memory operations. Only submit() enters the
+// kernel. Not thread-safe.
+class IoUring
+{
+private:
+  int fd_ = -1;
+  void *sq_ring_ = nullptr, *cq_ring_ = nullptr;
+  size_t sq_ring_size_ = 0, cq_ring_size_ = 0, sqes_size_ = 0;
+  io_uring_sqe *sqes_ = nullptr;
+  unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_mask_ = nullptr, *sq_array_ = nullptr;
+  unsigned sq_entries_ = 0;
+  unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr, *cq_mask_ = nullptr;
+  io_uring_cqe *cqes_ = nullptr;
+  unsigned queued_ = 0; // SQEs filled in since the last submit()
+  uint64_t enters_ = 0;
+
+public:
+  // ok() is false if the kernel (or a seccomp policy) refuses io_uring
+  explicit IoUring(unsigned entries);
+  ~IoUring();
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  bool ok() const { return fd_ >= 0; }
+
+  // Zeroed SQE to fill in, nullptr when the submission ring is full
+  io_uring_sqe *get_sqe();
+  // Hands queued SQEs to the kernel and waits for wait_nr completions.
+  // Returns false on error.
+  bool submit(unsigned wait_nr = 0);
+  // Pops one completion if there is one; never enters the kernel
+  bool peek(io_uring_cqe &out);
+
+  bool register_files(const int *fds, unsigned count);
+  bool register_buffers(const iovec *iov, unsigned count);
+
+  uint64_t enters() const { return enters_; }
+};
+
+// Transmitter side: frames are copied into registered buffers and written to
+// the socket (a fixed file) as chains of linked writes, up to
+// LinkConfig::uring_depth writes per io_uring_enter. send() only queues; a
+// chain goes out once depth frames are waiting or when the caller runs out of
+// work and calls submit(), so a busy link batches and an idle one still sends
+// every frame right away. Only one chain is in flight at a time so a short
+// write can be finished before anything behind it.
+class UringSender
+{
+public:
+  static constexpr size_t kSlotSize = 64 * 1024;
+
+private:
+  struct Slot
+  {
+    size_t len = 0, done = 0;
+  };
+
+  IoUring ring_;
+  int sock_;
+  size_t depth_;
+  std::vector<uint8_t> memory_; // depth_ * 2 slots of kSlotSize bytes
+  std::vector<Slot> slots_;
+  std::deque<unsigned> free_, pending_;
+  std::vector<unsigned> chain_; // slots of the chain in flight, in stream order
+  size_t outstanding_ = 0;      // completions still due for chain_
+  bool ok_ = false;
+  uint64_t fallback_sends_ = 0;
+
+  uint8_t *slot_data(unsigned i) { return memory_.data() + i * kSlotSize; }
+  bool submit_chain();
+  bool reap(bool wait);
+  bool step();
+
+public:
+  UringSender(int sock, const LinkConfig &config);
+  bool ok() const { return ok_; }
+
+  // Queues one frame; false once the socket failed. Frames bigger than a slot
+  // are sent with send_all() once everything before them is out.
+  bool send(const uint8_t *data, size_t len);
+  // Hands every queued frame to the kernel without waiting for the last chain
+  bool submit();
+  // Waits until everything queued is on the socket
+  bool flush();
+
+  // Frames queued but not yet handed to the kernel
+  size_t queued() const { return pending_.size(); }
+  uint64_t syscalls() const { return ring_.enters() + fallback_sends_; }
+};
+
+// Ground station side: one multishot recv stays armed on the socket and the
+// kernel picks buffers from a pool handed over with IORING_OP_PROVIDE_BUFFERS,
+// so while data keeps arriving completions are reaped straight from shared
+// memory. io_uring_enter is only called when there is nothing to read yet,
+// and drained buffers go back to the pool with that same call.
+class UringReceiver
+{
+public:
+  static constexpr unsigned kBuffers = 16;
+  static constexpr size_t kBufferSize = 16 * 1024;
+
+private:
+  IoUring ring_;
+  std::vector<uint8_t> memory_; // kBuffers buffers of kBufferSize bytes
+  int current_ = -1;            // buffer being read from, handed back once drained
+  const uint8_t *ready_ = nullptr;
+  size_t ready_len_ = 0;
+  bool armed_ = false, eof_ = false, ok_ = false;
+
+  bool provide(unsigned first, unsigned count);
+  bool arm();
+
+public:
+  explicit UringReceiver(int sock);
+  bool ok() const { return ok_; }
+
+  // Like recv(): copies up to len bytes into out and returns how many, 0 at
+  // end of stream, -1 on error
+  ssize_t read(uint8_t *out, size_t len);
+  // Like recv_all()
+  bool read_all(uint8_t *out, size_t len);
+
+  uint64_t syscalls() const { return ring_.enters(); }
+};
@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "../include/aggregator.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  Counter &late_counter()
+  {
+    static Counter &c = metrics().counter("telemetry_aggregate_late_total",
+                                          "Packets older than the aggregator's open window");
+    return c;
+  }
+}
+
+AggregationConfig default_aggregation(double tick_seconds)
+{
+  // Whole ticks, each width a multiple of the one before
+  AggregationConfig config;
+  uint64_t prev = 1;
+  for (auto &r : config.resolutions)
+  {
+    double ticks = static_cast<double>(r.width) / tick_seconds;
+    uint64_t multiple = static_cast<uint64_t>(std::max(1.0, std::round(ticks / static_cast<double>(prev))));
+    r.width = prev * multiple;
+    prev = r.width;
+  }
+  return config;
+}
+
+void TelemetryAggregator::Window::reset(uint64_t at)
+{
+  index = at;
+  widths = 1;
+  count = 0;
+  min.fill(std::numeric_limits<float>::infinity());
+  max.fill(-std::numeric_limits<float>::infinity());
+  sum.fill(0);
+  sumsq.fill(0);
+}
+
+TelemetryAggregator::TelemetryAggregator(const AggregationConfig &config)
+{
+  if (config.resolutions.empty())
+    throw std::invalid_argument("Aggregation needs at least one resolution");
+  uint64_t prev = 1;
+  for (const auto &res : config.resolutions)
+  {
+    if (res.width == 0 || res.width % prev != 0)
+      throw std::invalid_argument("Aggregation window " + res.name + " is not a multiple of the one before");
+    if (res.sliding == 0 || res.history < res.sliding)
+      throw std::invalid_argument("Aggregation window " + res.name + " keeps fewer windows than it slides over");
+    prev = res.width;
+
+    auto lv = std::make_unique<Level>();
+    lv->res = res;
+    lv->open.reset(0);
+    lv->closed.resize(res.history);
+    for (auto &w : lv->closed)
+      w.reset(0);
+    lv->ring = std::make_unique<Seqlock<Window>[]>(res.history);
+    lv->span.resize(res.sliding);
+    lv->span_sum.reset(0);
+    levels_.push_back(std::move(lv));
+  }
+}
+
+inline void TelemetryAggregator::accumulate(Window &w, const TelemetryPacket &pkt) const
+{
+  for_each_column_of<TelemetryPacket, float>([&](size_t f, auto col)
+                                             {
+                                               float x = col.get(pkt);
+                                               double d = x - shift_[f];
+                                               w.min[f] = x < w.min[f] ? x : w.min[f];
+                                               w.max[f] = x > w.max[f] ? x : w.max[f];
+                                               w.sum[f] += d;
+                                               w.sumsq[f] += d * d; });
+  ++w.count;
+}
+
+void TelemetryAggregator::merge(Window &into, const Window &from)
+{
+  into.count += from.count;
+  for (size_t f = 0; f < kTelemetryFloatColumns; ++f)
+  {
+    into.min[f] = std::min(into.min[f], from.min[f]);
+    into.max[f] = std::max(into.max[f], from.max[f]);
+    into.sum[f] += from.sum[f];
+    into.sumsq[f] += from.sumsq[f];
+  }
+}
+
+void TelemetryAggregator::add(const TelemetryPacket *pkts, size_t count)
+{
+  if (count == 0)
+    return;
+  if (!started_)
+  {
+    for_each_column_of<TelemetryPacket, float>([&](size_t f, auto col)
+                                               { shift_[f] = col.get(pkts[0]); });
+    started_ = true;
+    roll(0, pkts[0].timestamp / levels_[0]->res.width);
+  }
+
+  uint64_t late = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const TelemetryPacket &pkt = pkts[i];
+    if (pkt.timestamp >= open_end_)
+      roll(0, pkt.timestamp / levels_[0]->res.width);
+    else if (pkt.timestamp < open_start_)
+    {
+      add_late(pkt);
+      ++late;
+      continue;
+    }
+    accumulate(levels_[0]->open, pkt);
+  }
+  if (late)
+    late_counter().add(late);
+  publish_current();
+}
+
+// Moves a level's open window forward to index, closing the old one into the
+// level above first, and keeps the levels above in step
+void TelemetryAggregator::roll(size_t level, uint64_t index)
+{
+  Level &lv = *levels_[level];
+  if (level > 0 && lv.open.index == index)
+    return;
+  if (lv.open.count > 0)
+    close(level);
+  lv.open.reset(index);
+  if (level == 0)
+  {
+    open_start_ = index * lv.res.width;
+    open_end_ = open_start_ + lv.res.width;
+  }
+  if (level + 1 < levels_.size())
+    roll(level + 1, index * lv.res.width / levels_[level + 1]->res.width);
+}
+
+void TelemetryAggregator::close(size_t level)
+{
+  Level &lv = *levels_[level];
+  const Window &w = lv.open;
+  size_t slot = w.index % lv.res.history;
+  lv.closed[slot] = w;
+  lv.ring[slot].store(w);
+  lv.newest.store(std::max(lv.newest.load(std::memory_order_relaxed), w.index + 1), std::memory_order_release);
+  slide(lv, w);
+  if (level + 1 < levels_.size())
+    merge(levels_[level + 1]->open, w);
+}
+
+// Adds a closed window to the level's sliding window and drops those that
+// fell out of it: running sums for the moments, and per field a queue of
+// bucket minima (maxima) that only keeps buckets which could still be the
+// minimum, so each bucket is pushed and popped once
+void TelemetryAggregator::slide(Level &lv, const Window &w)
+{
+  const uint64_t span = lv.res.sliding;
+  Window &s = lv.span_sum;
+  while (lv.span_size > 0 && lv.span[lv.span_head].index + span <= w.index)
+  {
+    const Window &old = lv.span[lv.span_head];
+    s.count -= old.count;
+    for (size_t f = 0; f < kTelemetryFloatColumns; ++f)
+    {
+      s.sum[f] -= old.sum[f];
+      s.sumsq[f] -= old.sumsq[f];
+    }
+    lv.span_head = (lv.span_head + 1) % span;
+    --lv.span_size;
+  }
+  if (lv.span_size == 0)
+    s.reset(0); // nothing left, so drop any rounding the subtractions left behind
+
+  for (size_t f = 0; f < kTelemetryFloatColumns; ++f)
+  {
+    auto &lows = lv.lows[f];
+    auto &highs = lv.highs[f];
+    while (!lows.empty() && lows.front().index + span <= w.index)
+      lows.pop_front();
+    while (!highs.empty() && highs.front().index + span <= w.index)
+      highs.pop_front();
+    while (!lows.empty() && lows.back().value >= w.min[f])
+      lows.pop_back();
+    while (!highs.empty() && highs.back().value <= w.max[f])
+      highs.pop_back();
+    lows.push_back({w.index, w.min[f]});
+    highs.push_back({w.index, w.max[f]});
+    s.sum[f] += w.sum[f];
+    s.sumsq[f] += w.sumsq[f];
+    s.min[f] = lows.front().value;
+    s.max[f] = highs.front().value;
+  }
+  s.count += w.count;
+  lv.span[(lv.span_head + lv.span_size++) % span] = w;
+
+  uint64_t first = w.index + 1 > span ? w.index + 1 - span : 0;
+  s.index = first;
+  s.widths = w.index + 1 - first;
+  lv.sliding.store(s);
+}
+
+// Packets behind the finest open window go into the closed window of each
+// level that covers their time, up to the first level whose open window does;
+// that one passes them on when it closes
+void TelemetryAggregator::add_late(const TelemetryPacket &pkt)
+{
+  for (auto &level : levels_)
+  {
+    Level &lv = *level;
+    uint64_t index = pkt.timestamp / lv.res.width;
+    if (index == lv.open.index)
+    {
+      accumulate(lv.open, pkt);
+      return;
+    }
+    if (lv.open.index - index > lv.res.history)
+      continue;
+
+    size_t slot = index % lv.res.history;
+    Window &w = lv.closed[slot];
+    if (w.index != index || w.count == 0)
+      w.reset(index); // the window saw no packets when it closed
+    accumulate(w, pkt);
+    lv.ring[slot].store(w);
+    lv.newest.store(std::max(lv.newest.load(std::memory_order_relaxed), index + 1), std::memory_order_release);
+  }
+}
+
+// A level's open window only gets the level below's when that closes, so
+// its current view adds the open windows of every level below
+void TelemetryAggregator::publish_current()
+{
+  Window view = levels_[0]->open;
+  levels_[0]->current.store(view);
+  for (size_t level = 1; level < levels_.size(); ++level)
+  {
+    Level &lv = *levels_[level];
+    Window below = view;
+    view = lv.open;
+    merge(view, below);
+    lv.current.store(view);
+  }
+}
+
+WindowStats TelemetryAggregator::stats(const Window &w, uint64_t width) const
+{
+  WindowStats out;
+  out.start = w.index * width;
+  out.width = w.widths * width;
+  out.count = w.count;
+  if (w.count == 0)
+    return out;
+  const double n = static_cast<double>(w.count);
+  for (size_t f = 0; f < kTelemetryFloatColumns; ++f)
+  {
+    double mean = w.sum[f] / n;
+    double var = std::max(0.0, w.sumsq[f] / n - mean * mean);
+    out.fields[f] = {w.min[f], w.max[f], shift_[f] + mean, std::sqrt(var)};
+  }
+  return out;
+}
+
+WindowStats TelemetryAggregator::current(size_t level) const
+{
+  return stats(levels_[level]->current.load(), levels_[level]->res.width);
+}
+
+WindowStats TelemetryAggregator::sliding(size_t level) const
+{
+  return stats(levels_[level]->sliding.load(), levels_[level]->res.width);
+}
+
+std::vector<WindowStats> TelemetryAggregator::history(size_t level, size_t n) const
+{
+  const Level &lv = *levels_[level];
+  std::vector<WindowStats> out;
+  uint64_t newest = lv.newest.load(std::memory_order_acquire);
+  n = std::min(n, lv.res.history);
+  // A slot overwritten while we read it holds a newer window and is skipped
+  for (uint64_t index = newest > n ? newest - n : 0; index < newest; ++index)
+  {
+    Window w = lv.ring[index % lv.res.history].load();
+    if (w.count > 0 && w.index == index)
+      out.push_back(stats(w, lv.res.width));
+  }
+  return out;
+}
+
+std::string TelemetryAggregator::summary() const
+{
+  std::ostringstream out;
+  for (size_t level = levels_.size(); level-- > 0;)
+  {
+    WindowStats s = sliding(level);
+    if (s.count == 0)
+      continue;
+    out << "  " << s.count << " packets in [" << s.start << ", " << s.start + s.width << "), sliding window of "
+        << levels_[level]->res.sliding << " x " << levels_[level]->res.name << "\n";
+    out << "  " << std::left << std::setw(12) << "field" << std::right << std::setw(12) << "min" << std::setw(12)
+        << "max" << std::setw(12) << "mean" << std::setw(12) << "stddev" << "\n";
+    for (size_t f = 0; f < kTelemetryFloatColumns; ++f)
+    {
+      const FieldStats &fs = s.fields[f];
+      out << "  " << std::left << std::setw(12) << kTelemetryFloatNames[f] << std::right << std::setw(12) << fs.min
+          << std::setw(12) << fs.max << std::setw(12) << fs.mean << std::setw(12) << fs.stddev << "\n";
+    }
+    return out.str();
+  }
+  return "  no closed windows yet\n";
+}
+
+void export_window_metrics(const std::shared_ptr<TelemetryAggregator> &aggregator)
+{
+  std::weak_ptr<TelemetryAggregator> weak = aggregator;
+  auto gauge = [&](const char *name, const char *help, const std::string &labels, size_t level, auto read)
+  {
+    metrics().gauge(name, help, [weak, level, read]
+                    {
+                      auto a = weak.lock();
+                      return a ? read(a->sliding(level)) : std::nan(""); },
+                    labels);
+  };
+
+  for (size_t level = 0; level < aggregator->resolutions(); ++level)
+  {
+    std::string window = "window=\"" + aggregator->resolution(level).name + "\"";
+    gauge("telemetry_window_packets", "Packets in each resolution's sliding window", window, level,
+          [](const WindowStats &s)
+          { return static_cast<double>(s.count); });
+    for (size_t f = 0; f < kTelemetryFloatColumns; ++f)
+    {
+      std::string labels = "field=\"" + std::string(kTelemetryFloatNames[f]) + "\"," + window;
+      gauge("telemetry_window_min", "Field minimum over each resolution's sliding window", labels, level,
+            [f](const WindowStats &s)
+            { return static_cast<double>(s.fields[f].min); });
+      gauge("telemetry_window_max", "Field maximum over each resolution's sliding window", labels, level,
+            [f](const WindowStats &s)
+            { return static_cast<double>(s.fields[f].max); });
+      gauge("telemetry_window_mean", "Field mean over each resolution's sliding window", labels, level,
+            [f](const WindowStats &s)
+            { return s.fields[f].mean; });
+      gauge("telemetry_window_stddev", "Field standard deviation over each resolution's sliding window", labels,
+            level, [f](const WindowStats &s)
+            { return s.fields[f].stddev; });
+    }
+  }
+}
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "../include/anomaly.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  constexpr size_t kLanes = AnomalyDetector::kLanes;
+  static_assert(kTelemetryFloatColumns <= kLanes, "more float columns than detector lanes");
+
+  constexpr float kInf = std::numeric_limits<float>::infinity();
+  constexpr float kMinVariance = 1e-12f; // keeps z finite on a constant column
+
+  struct KernelState
+  {
+    float *__restrict mean;
+    float *__restrict var;
+    float *__restrict rate;
+    float *__restrict last;
+  };
+
+  // One pass over a batch: z-score and rate of every column against the
+  // statistics so far, then the statistics updated with the packet. The inner
+  // loop over lanes has a fixed trip count and no branches, so it becomes a
+  // couple of vector instructions per step. crossed[b * kLanes + l] ends up
+  // nonzero if some packet was past bound b of column l. On x86 an AVX2 clone is
+  // picked at load time when the CPU has it (not under TSan, whose runtime is
+  // not up yet when the ifunc resolver runs).
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && !defined(__SANITIZE_THREAD__)
+  __attribute__((target_clones("avx2", "default")))
+#endif
+  void detect_kernel(size_t count, const float *__restrict rows, const float *__restrict inv_dt,
+                     float alpha, float rate_alpha, KernelState s, const float *__restrict bounds,
+                     float *__restrict z_out, float *__restrict rate_out, int32_t *__restrict crossed)
+  {
+    const float *vhi = bounds, *vlo = bounds + kLanes;
+    const float *zhi = bounds + 2 * kLanes, *zlo = bounds + 3 * kLanes;
+    const float *rhi = bounds + 4 * kLanes, *rlo = bounds + 5 * kLanes;
+    int32_t *cvhi = crossed, *cvlo = crossed + kLanes;
+    int32_t *czhi = crossed + 2 * kLanes, *czlo = crossed + 3 * kLanes;
+    int32_t *crhi = crossed + 4 * kLanes, *crlo = crossed + 5 * kLanes;
+    for (size_t i = 0; i < count; ++i)
+    {
+      const float *x = rows + i * kLanes;
+      float *z = z_out + i * kLanes;
+      float *r = rate_out + i * kLanes;
+      // No rate from a repeated or out-of-order timestamp
+      const float ra = inv_dt[i] > 0.0f ? rate_alpha : 0.0f;
+      for (size_t l = 0; l < kLanes; ++l)
+      {
+        float d = x[l] - s.mean[l];
+        float zl = d / std::sqrt(s.var[l] + kMinVariance);
+        float rl = s.rate[l] + ra * ((x[l] - s.last[l]) * inv_dt[i] - s.rate[l]);
+        float incr = alpha * d;
+        s.mean[l] += incr;
+        s.var[l] = (1.0f - alpha) * (s.var[l] + d * incr);
+        s.rate[l] = rl;
+        s.last[l] = x[l];
+        z[l] = zl;
+        r[l] = rl;
+        cvhi[l] |= x[l] > vhi[l];
+        cvlo[l] |= x[l] < vlo[l];
+        czhi[l] |= zl > zhi[l];
+        czlo[l] |= zl < zlo[l];
+        crhi[l] |= rl > rhi[l];
+        crlo[l] |= rl < rlo[l];
+      }
+    }
+  }
+}
+
+AnomalyRule AnomalyRule::parse(const std::string &text)
+{
+  size_t op = text.find_first_of("<>");
+  if (op == std::string::npos || op == 0 || op + 1 == text.size())
+    throw std::invalid_argument("Alert rule must look like column<value or column:z>value: " + text);
+
+  AnomalyRule rule;
+  std::string column = text.substr(0, op);
+  std::string measure;
+  size_t colon = column.find(':');
+  if (colon != std::string::npos)
+  {
+    measure = column.substr(colon + 1);
+    column.resize(colon);
+  }
+  if (measure.empty() || measure == "value")
+    rule.measure = AnomalyMeasure::Value;
+  else if (measure == "z")
+    rule.measure = AnomalyMeasure::ZScore;
+  else if (measure == "rate")
+    rule.measure = AnomalyMeasure::Rate;
+  else
+    throw std::invalid_argument("Unknown alert measure: " + measure);
+
+  rule.field = 0;
+  while (rule.field < kTelemetryFloatColumns && column != kTelemetryFloatNames[rule.field])
+    ++rule.field;
+  if (rule.field == kTelemetryFloatColumns)
+    throw std::invalid_argument("Unknown alert column: " + column);
+
+  rule.above = text[op] == '>';
+  try
+  {
+    size_t used = 0;
+    std::string value = text.substr(op + 1);
+    rule.threshold = std::stof(value, &used);
+    if (used != value.size())
+      throw std::invalid_argument(value);
+  }
+  catch (const std::exception &)
+  {
+    throw std::invalid_argument("Bad alert threshold: " + text);
+  }
+  return rule;
+}
+
+std::string AnomalyRule::describe() const
+{
+  std::string text = kTelemetryFloatNames[field];
+  if (measure == AnomalyMeasure::ZScore)
+    text += ":z";
+  else if (measure == AnomalyMeasure::Rate)
+    text += ":rate";
+  std::string value = std::to_string(threshold);
+  value.erase(value.find_last_not_of('0') + 1);
+  if (value.back() == '.')
+    value.pop_back();
+  return text + (above ? ">" : "<") + value;
+}
+
+std::vector<AnomalyRule> default_anomaly_rules()
+{
+  std::vector<AnomalyRule> rules;
+  for (const char *text : {"battery<10.5", "battery:rate<-0.01", "radiation>0.5", "radiation:z>8",
+                           "pitch:rate>0.05", "pitch:rate<-0.05", "roll:rate>0.05", "roll:rate<-0.05",
+                           "yaw:rate>0.05", "yaw:rate<-0.05"})
+    rules.push_back(AnomalyRule::parse(text));
+  return rules;
+}
+
+AnomalyDetector::AnomalyDetector(DetectorConfig config, AlertFn on_alert)
+    : config_(std::move(config)), on_alert_(std::move(on_alert))
+{
+  for (int b = 0; b < kBounds; ++b)
+    std::fill_n(&envelope_[b * kLanes], kLanes, b % 2 ? -kInf : kInf);
+
+  // Each column's tightest threshold per measure and direction
+  for (const AnomalyRule &rule : config_.rules)
+  {
+    if (rule.field >= kTelemetryFloatColumns)
+      throw std::invalid_argument("Alert rule on a column that does not exist");
+    float &edge = envelope_[bound(rule) * kLanes + rule.field];
+    edge = rule.above ? std::min(edge, rule.threshold) : std::max(edge, rule.threshold);
+    fired_.push_back(&metrics().counter("telemetry_alerts_total", "Anomaly rules that started firing at the ground station",
+                                        "rule=\"" + rule.describe() + "\""));
+  }
+  // z-scores mean nothing until the variance has settled
+  warmup_envelope_ = envelope_;
+  std::fill_n(&warmup_envelope_[ZHigh * kLanes], kLanes, kInf);
+  std::fill_n(&warmup_envelope_[ZLow * kLanes], kLanes, -kInf);
+}
+
+int AnomalyDetector::bound(const AnomalyRule &rule)
+{
+  int base = rule.measure == AnomalyMeasure::Value ? ValueHigh : rule.measure == AnomalyMeasure::ZScore ? ZHigh : RateHigh;
+  return rule.above ? base : base + 1;
+}
+
+const AnomalyDetector::Stream *AnomalyDetector::find(uint32_t source) const
+{
+  auto it = streams_.find(source);
+  return it == streams_.end() ? nullptr : &it->second;
+}
+
+float AnomalyDetector::mean(size_t field, uint32_t source) const
+{
+  const Stream *stream = find(source);
+  return stream ? stream->mean.v[field] : 0.0f;
+}
+
+float AnomalyDetector::stddev(size_t field, uint32_t source) const
+{
+  const Stream *stream = find(source);
+  return stream ? std::sqrt(stream->var.v[field]) : 0.0f;
+}
+
+float AnomalyDetector::rate(size_t field, uint32_t source) const
+{
+  const Stream *stream = find(source);
+  return stream ? stream->rate.v[field] : 0.0f;
+}
+
+void AnomalyDetector::process(const TelemetryPacket *pkts, size_t count)
+{
+  for_each_source_run(pkts, count, [&](const TelemetryPacket *run, size_t n)
+                      {
+                        Stream &stream = streams_[run->source_id];
+                        if (stream.active.empty())
+                          stream.active.assign(config_.rules.size(), false);
+                        process_stream(stream, run, n); });
+}
+
+void AnomalyDetector::process_stream(Stream &stream, const TelemetryPacket *pkts, size_t count)
+{
+  rows_.resize(count * kLanes);
+  z_.resize(count * kLanes);
+  rates_.resize(count * kLanes);
+  inv_dt_.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    for_each_column_of<TelemetryPacket, float>([&](size_t f, auto col)
+                                               { rows_[i * kLanes + f] = col.get(pkts[i]); });
+
+  if (stream.seen == 0)
+  {
+    // Start from the first packet rather than from zero
+    std::copy_n(rows_.begin(), kLanes, stream.mean.v.begin());
+    std::copy_n(rows_.begin(), kLanes, stream.last.v.begin());
+    stream.last_timestamp = pkts[0].timestamp;
+  }
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint64_t ts = pkts[i].timestamp;
+    inv_dt_[i] = ts > stream.last_timestamp ? 1.0f / static_cast<float>(ts - stream.last_timestamp) : 0.0f;
+    stream.last_timestamp = std::max(stream.last_timestamp, ts);
+  }
+
+  // Packets before the end of the warmup are checked without the z bounds
+  size_t cold = stream.seen < config_.warmup ? std::min<uint64_t>(count, config_.warmup - stream.seen) : 0;
+  KernelState state{stream.mean.v.data(), stream.var.v.data(), stream.rate.v.data(), stream.last.v.data()};
+  for (size_t begin = 0; begin < count;)
+  {
+    size_t end = begin < cold ? cold : count;
+    const auto &bounds = begin < cold ? warmup_envelope_ : envelope_;
+    detect_kernel(end - begin, &rows_[begin * kLanes], &inv_dt_[begin], config_.alpha, config_.rate_alpha, state,
+                  bounds.data(), &z_[begin * kLanes], &rates_[begin * kLanes], crossed_.data());
+    begin = end;
+  }
+
+  int32_t crossed = 0;
+  for (int32_t c : crossed_)
+    crossed |= c;
+  if (crossed || stream.active_count > 0)
+  {
+    check_rules(stream, pkts, count);
+    crossed_.fill(0);
+  }
+  stream.seen += count;
+}
+
+void AnomalyDetector::check_rules(Stream &stream, const TelemetryPacket *pkts, size_t count)
+{
+  // Only rules already firing or whose bound some packet crossed, one at a
+  // time down the batch; starts are rare and get sorted back into packet order
+  starts_.clear();
+  size_t cold = stream.seen < config_.warmup ? std::min<uint64_t>(count, config_.warmup - stream.seen) : 0;
+  for (size_t r = 0; r < config_.rules.size(); ++r)
+  {
+    const AnomalyRule &rule = config_.rules[r];
+    if (!stream.active[r] && !crossed_[bound(rule) * kLanes + rule.field])
+      continue;
+    const std::vector<float> &column = rule.measure == AnomalyMeasure::Value    ? rows_
+                                       : rule.measure == AnomalyMeasure::ZScore ? z_
+                                                                                : rates_;
+    const float *measured = column.data() + rule.field;
+    size_t from = rule.measure == AnomalyMeasure::ZScore ? cold : 0;
+    bool active = stream.active[r];
+    for (size_t i = 0; i < count; ++i)
+    {
+      float m = measured[i * kLanes];
+      bool firing = i >= from && (rule.above ? m > rule.threshold : m < rule.threshold);
+      if (firing == active)
+        continue;
+      active = firing;
+      if (firing)
+        starts_.push_back({i, r});
+    }
+    if (active != stream.active[r])
+    {
+      stream.active[r] = active;
+      active ? ++stream.active_count : --stream.active_count;
+    }
+  }
+
+  std::sort(starts_.begin(), starts_.end());
+  for (auto [i, r] : starts_)
+  {
+    const AnomalyRule &rule = config_.rules[r];
+    size_t at = i * kLanes + rule.field;
+    float measured = rule.measure == AnomalyMeasure::Value    ? rows_[at]
+                     : rule.measure == AnomalyMeasure::ZScore ? z_[at]
+                                                              : rates_[at];
+    ++alerts_;
+    fired_[r]->add(1);
+    if (on_alert_)
+      on_alert_({pkts[i].source_id, pkts[i].timestamp, r, measured, rows_[at]});
+  }
+}
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/archive.h"
+#include "../include/logger.h"
+
+namespace
+{
+  const char kFileMagic[8] = {'T', 'L', 'M', 'A', 'R', 'C', 'H', '1'};
+  const char kIndexMagic[8] = {'T', 'L', 'M', 'I', 'N', 'D', 'E', 'X'};
+  constexpr uint32_t kVersion = 2; // 1 had no source column
+  constexpr size_t kHeaderSize = 16;
+  constexpr size_t kTrailerSize = 24;
+
+  size_t block_bytes(size_t block_rows, uint32_t version = kVersion)
+  {
+    return block_rows * (sizeof(uint64_t) + kFloatColumns * sizeof(float) + (version >= 2 ? sizeof(uint32_t) : 0));
+  }
+
+  void write_all(int fd, const void *data, size_t len)
+  {
+    const char *p = static_cast<const char *>(data);
+    while (len > 0)
+    {
+      ssize_t n = ::write(fd, p, len);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+        throw std::runtime_error("Failed to write archive.");
+      p += n;
+      len -= n;
+    }
+  }
+
+  // Field accessors in ArchiveColumn order
+  float *field(TelemetryPacket &pkt, size_t col)
+  {
+    switch (col)
+    {
+    case kColTemperature:
+      return &pkt.temperature;
+    case kColRadiation:
+      return &pkt.radiation;
+    case kColBattery:
+      return &pkt.battery_voltage;
+    case kColPosX:
+    case kColPosY:
+    case kColPosZ:
+      return &pkt.position[col - kColPosX];
+    default:
+      return &pkt.orientation[col - kColPitch];
+    }
+  }
+}
+
+ArchiveWriter::ArchiveWriter(const std::string &path, size_t block_rows)
+    : block_rows_(block_rows ? block_rows : 1), offset_(kHeaderSize),
+      timestamps_(block_rows_), floats_(block_rows_ * kFloatColumns), sources_(block_rows_)
+{
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0)
+    throw std::runtime_error("Failed to open archive " + path);
+
+  uint8_t header[kHeaderSize];
+  uint32_t rows32 = static_cast<uint32_t>(block_rows_);
+  std::memcpy(header, kFileMagic, 8);
+  std::memcpy(header + 8, &kVersion, 4);
+  std::memcpy(header + 12, &rows32, 4);
+  write_all(fd_, header, sizeof(header));
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+  try
+  {
+    close();
+  }
+  catch (const std::exception &)
+  {
+    // Nothing sensible to do from a destructor; the archive is left without an index
+  }
+}
+
+void ArchiveWriter::append(const TelemetryPacket *pkts, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    TelemetryPacket pkt = pkts[i];
+    timestamps_[rows_] = pkt.timestamp;
+    sources_[rows_] = pkt.source_id;
+    for (size_t col = 0; col < kFloatColumns; ++col)
+      floats_[col * block_rows_ + rows_] = *field(pkt, col);
+
+    if (++rows_ == block_rows_)
+      write_block();
+  }
+}
+
+void ArchiveWriter::write_block()
+{
+  if (rows_ == 0)
+    return;
+
+  // Unused tail slots are zeroed so the file content is deterministic
+  std::fill(timestamps_.begin() + rows_, timestamps_.end(), 0);
+  std::fill(sources_.begin() + rows_, sources_.end(), 0);
+  for (size_t col = 0; col < kFloatColumns; ++col)
+    std::fill(floats_.begin() + col * block_rows_ + rows_, floats_.begin() + (col + 1) * block_rows_, 0.0f);
+
+  ArchiveBlockIndex entry{offset_, rows_, ~0ull, 0};
+  for (size_t i = 0; i < rows_; ++i)
+  {
+    entry.min_timestamp = std::min(entry.min_timestamp, timestamps_[i]);
+    entry.max_timestamp = std::max(entry.max_timestamp, timestamps_[i]);
+  }
+
+  write_all(fd_, timestamps_.data(), timestamps_.size() * sizeof(uint64_t));
+  write_all(fd_, floats_.data(), floats_.size() * sizeof(float));
+  write_all(fd_, sources_.data(), sources_.size() * sizeof(uint32_t));
+
+  index_.push_back(entry);
+  offset_ += block_bytes(block_rows_);
+  rows_ = 0;
+}
+
+void ArchiveWriter::close(bool sync)
+{
+  if (fd_ < 0)
+    return;
+
+  write_block();
+  uint64_t trailer[2] = {offset_, index_.size()};
+  write_all(fd_, index_.data(), index_.size() * sizeof(ArchiveBlockIndex));
+  write_all(fd_, trailer, sizeof(trailer));
+  write_all(fd_, kIndexMagic, sizeof(kIndexMagic));
+
+  if (sync)
+    ::fsync(fd_);
+  ::close(fd_);
+  fd_ = -1;
+}
+
+TelemetryPacket ArchiveBlockView::packet(size_t row) const
+{
+  TelemetryPacket pkt{};
+  pkt.timestamp = timestamp[row];
+  for (size_t col = 0; col < kFloatColumns; ++col)
+    *field(pkt, col) = column[col][row];
+  pkt.source_id = source ? source[row] : 0;
+  return pkt;
+}
+
+ArchiveReader::ArchiveReader(const std::string &path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error("Failed to open archive " + path);
+
+  struct stat st{};
+  if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < kHeaderSize + kTrailerSize)
+  {
+    ::close(fd);
+    throw std::runtime_error("Not a telemetry archive: " + path);
+  }
+
+  map_size_ = st.st_size;
+  void *map = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    throw std::runtime_error("Failed to map archive " + path);
+  map_ = static_cast<const uint8_t *>(map);
+
+  const uint8_t *trailer = map_ + map_size_ - kTrailerSize;
+  uint64_t index_offset, blocks;
+  uint32_t version, rows32;
+  std::memcpy(&version, map_ + 8, 4);
+  std::memcpy(&rows32, map_ + 12, 4);
+  std::memcpy(&index_offset, trailer, 8);
+  std::memcpy(&blocks, trailer + 8, 8);
+  block_rows_ = rows32;
+  version_ = version;
+
+  // blocks is bounded by the file size before it is multiplied by anything
+  size_t stride = block_bytes(block_rows_, version);
+  bool valid = std::memcmp(map_, kFileMagic, 8) == 0 && version >= 1 && version <= kVersion && block_rows_ > 0 &&
+               std::memcmp(trailer + 16, kIndexMagic, 8) == 0 &&
+               blocks <= (map_size_ - kHeaderSize - kTrailerSize) / (stride + sizeof(ArchiveBlockIndex)) &&
+               index_offset == kHeaderSize + blocks * stride &&
+               index_offset + blocks * sizeof(ArchiveBlockIndex) + kTrailerSize == map_size_;
+
+  // Every entry must name a whole block slot before the index, and no more
+  // rows than a block holds
+  index_ = reinterpret_cast<const ArchiveBlockIndex *>(map_ + index_offset);
+  block_count_ = valid ? blocks : 0;
+  for (size_t b = 0; b < block_count_ && valid; ++b)
+  {
+    const ArchiveBlockIndex &entry = index_[b];
+    valid = entry.offset >= kHeaderSize && (entry.offset - kHeaderSize) % stride == 0 &&
+            entry.offset <= index_offset - stride && entry.rows <= block_rows_;
+    rows_ += entry.rows;
+    if (b > 0 && entry.min_timestamp < index_[b - 1].max_timestamp)
+      sorted_ = false;
+  }
+  if (!valid)
+  {
+    munmap(const_cast<uint8_t *>(map_), map_size_);
+    map_ = nullptr;
+    throw std::runtime_error("Corrupt or unfinished archive: " + path);
+  }
+
+  // Range scans walk the columns front to back
+  madvise(const_cast<uint8_t *>(map_), map_size_, MADV_SEQUENTIAL);
+}
+
+ArchiveReader::~ArchiveReader()
+{
+  if (map_)
+    munmap(const_cast<uint8_t *>(map_), map_size_);
+}
+
+ArchiveBlockView ArchiveReader::block(size_t i) const
+{
+  const uint8_t *base = map_ + index_[i].offset;
+  ArchiveBlockView view{};
+  view.timestamp = reinterpret_cast<const uint64_t *>(base);
+  const float *floats = reinterpret_cast<const float *>(base + block_rows_ * sizeof(uint64_t));
+  for (size_t col = 0; col < kFloatColumns; ++col)
+    view.column[col] = floats + col * block_rows_;
+  view.source = version_ >= 2 ? reinterpret_cast<const uint32_t *>(floats + kFloatColumns * block_rows_) : nullptr;
+  view.rows = index_[i].rows;
+  return view;
+}
+
+std::vector<TelemetryPacket> ArchiveReader::query(uint64_t t0, uint64_t t1) const
+{
+  std::vector<TelemetryPacket> out;
+  scan(t0, t1, [&](const ArchiveBlockView &view, size_t begin, size_t end)
+       {
+         for (size_t row = begin; row < end; ++row)
+           out.push_back(view.packet(row)); });
+  return out;
+}
+
+size_t read_csv_log(const std::string &path, const std::function<void(const TelemetryPacket &)> &fn)
+{
+  std::ifstream in(path);
+  std::string line;
+  if (!in.is_open() || !std::getline(in, line))
+    throw std::runtime_error("Failed to read " + path);
+
+  // Captures from before a column was added lack it; pad each row with zeros
+  const std::string header = kCsvHeader;
+  if (line.empty() || header.compare(0, line.size(), line) != 0 ||
+      (header[line.size()] != ',' && header[line.size()] != '\n'))
+    throw std::runtime_error(path + " is not a telemetry CSV log");
+  std::string padding;
+  for (size_t n = std::count(header.begin() + line.size(), header.end(), ','); n > 0; --n)
+    padding += ",0";
+
+  size_t rows = 0;
+  while (std::getline(in, line))
+  {
+    if (line.empty())
+      continue;
+    line += padding;
+
+    TelemetryPacket pkt{};
+    if (!parse_csv(line.data(), line.data() + line.size(), pkt))
+      throw std::runtime_error("Malformed CSV row " + std::to_string(rows + 2) + " in " + path);
+    fn(pkt);
+    rows++;
+  }
+  return rows;
+}
+
+size_t csv_to_archive(const std::string &csv_path, const std::string &archive_path, size_t block_rows)
+{
+  ArchiveWriter writer(archive_path, block_rows);
+  size_t rows = read_csv_log(csv_path, [&](const TelemetryPacket &pkt)
+                             { writer.append(&pkt, 1); });
+  writer.close();
+  return rows;
+}
+
+size_t archive_to_csv(const std::string &archive_path, const std::string &csv_path)
+{
+  ArchiveReader reader(archive_path);
+  std::ofstream out(csv_path, std::ios::trunc);
+  if (!out.is_open())
+    throw std::runtime_error("Failed to open " + csv_path);
+
+  out << kCsvHeader;
+  std::vector<char> text;
+  for (size_t b = 0; b < reader.block_count(); ++b)
+  {
+    ArchiveBlockView view = reader.block(b);
+    text.resize(view.rows * kMaxCsvRowLength);
+    char *p = text.data();
+    for (size_t row = 0; row < view.rows; ++row)
+      p = format_csv_row(p, text.data() + text.size(), view.packet(row));
+    out.write(text.data(), p - text.data());
+  }
+  return reader.rows();
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+
+#include "../include/archive.h"
+#include "../include/logger.h"
+
+// Command-line front end for the binary telemetry archive
+static void usage(const char *prog)
+{
+  std::cout << "Usage:\n"
+            << "  " << prog << " to-archive <in.csv> <out.tlm> [block_rows]\n"
+            << "  " << prog << " to-csv <in.tlm> <out.csv>\n"
+            << "  " << prog << " query <in.tlm> <t0> <t1>    print rows with t0 <= timestamp <= t1\n"
+            << "  " << prog << " stats <in.tlm>              rows, blocks and a full-range scan rate\n";
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string cmd = argv[1];
+  try
+  {
+    if (cmd == "to-archive" && argc >= 4)
+    {
+      size_t block_rows = argc >= 5 ? std::stoul(argv[4]) : 4096;
+      std::cout << csv_to_archive(argv[2], argv[3], block_rows) << " rows written to " << argv[3] << "\n";
+    }
+    else if (cmd == "to-csv" && argc >= 4)
+      std::cout << archive_to_csv(argv[2], argv[3]) << " rows written to " << argv[3] << "\n";
+    else if (cmd == "query" && argc >= 5)
+    {
+      ArchiveReader reader(argv[2]);
+      for (const TelemetryPacket &pkt : reader.query(std::stoull(argv[3]), std::stoull(argv[4])))
+      {
+        char row[kMaxCsvRowLength];
+        std::cout.write(row, format_csv_row(row, row + sizeof(row), pkt) - row);
+      }
+    }
+    else if (cmd == "stats")
+    {
+      ArchiveReader reader(argv[2]);
+      auto start = std::chrono::steady_clock::now();
+      double sum = 0;
+      reader.scan(0, ~0ull, [&](const ArchiveBlockView &view, size_t begin, size_t end)
+                  {
+                    for (size_t row = begin; row < end; ++row)
+                      sum += view.column[kColTemperature][row]; });
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      std::cout << reader.rows() << " rows in " << reader.block_count() << " blocks, mean temperature "
+                << (reader.rows() ? sum / reader.rows() : 0.0) << ", scanned at "
+                << reader.rows() / seconds << " rows/s\n";
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
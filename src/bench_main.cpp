@@ -0,0 +1,1035 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "../include/aggregator.h"
+#include "../include/anomaly.h"
+#include "../include/buffer.h"
+#include "../include/priority_buffer.h"
+#include "../include/sharded_buffer.h"
+#include "../include/compression.h"
+#include "../include/frame.h"
+#include "../include/decode_pipeline.h"
+#include "../include/link.h"
+#include "../include/logger.h"
+#include "../include/sharded_logger.h"
+#include "../include/simulation.h"
+#include "../include/fleet.h"
+#include "../include/metrics.h"
+#include "../include/net.h"
+#include "../include/shm.h"
+
+// Forward declarations of the thread functions defined in other files
+void transmitter_thread(TelemetryBuffer &buffer, const LinkConfig &config);
+void transmitter_thread(PriorityTelemetryBuffer &buffer, const LinkConfig &config);
+void ground_station_thread(const LinkConfig &config);
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+  struct BenchOptions
+  {
+    bool quick = false; // smaller sizes, for CI smoke runs
+    uint16_t port = 5200;
+    std::string json_path;
+  };
+
+  // One line of output: a named case with a handful of numeric metrics
+  struct BenchResult
+  {
+    std::string suite;
+    std::string name;
+    std::vector<std::pair<std::string, double>> metrics;
+  };
+
+  std::vector<BenchResult> results;
+
+  void report(const std::string &suite, const std::string &name, std::vector<std::pair<std::string, double>> metrics)
+  {
+    std::cout << "  " << std::left << std::setw(36) << name;
+    for (const auto &[key, value] : metrics)
+      std::cout << "  " << key << "=" << value;
+    std::cout << std::endl;
+    results.push_back({suite, name, std::move(metrics)});
+  }
+
+  double seconds_since(Clock::time_point start)
+  {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  std::vector<TelemetryPacket> make_stream(size_t count)
+  {
+    std::vector<TelemetryPacket> stream(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      TelemetryPacket &pkt = stream[i];
+      float t = static_cast<float>(i + 1);
+      pkt.timestamp = i + 1;
+      pkt.temperature = 25.0f - 0.005f * t + 0.05f * std::sin(t * 1.7f);
+      pkt.radiation = 0.05f + 0.002f * std::sin(t * 3.1f);
+      pkt.battery_voltage = 12.5f - 0.0001f * t + 0.002f * std::cos(t * 2.3f);
+      pkt.position = {7000.0f * std::cos(t * 0.00116f), 7000.0f * std::sin(t * 0.00116f), 0.0f};
+      pkt.orientation = {0.01f * std::sin(t), 0.01f * std::cos(t), 0.02f * std::sin(t * 0.5f)};
+    }
+    return stream;
+  }
+
+  // Nearest-rank percentile of an already sorted sample
+  double percentile(const std::vector<double> &sorted, double p)
+  {
+    if (sorted.empty())
+      return 0;
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+  }
+
+  // Suites that run a ground station leave its logs/telemetry_* files behind;
+  // this removes the ones that appeared while it was alive
+  class GroundStationLogs
+  {
+  private:
+    std::set<std::filesystem::path> before_;
+
+    static std::set<std::filesystem::path> list()
+    {
+      std::set<std::filesystem::path> files;
+      std::error_code ec;
+      for (const auto &entry : std::filesystem::directory_iterator("logs", ec))
+        if (entry.path().filename().string().rfind("telemetry_", 0) == 0)
+          files.insert(entry.path());
+      return files;
+    }
+
+  public:
+    GroundStationLogs() : before_(list()) {}
+    ~GroundStationLogs()
+    {
+      std::error_code ec;
+      for (const std::filesystem::path &file : list())
+        if (!before_.count(file))
+          std::filesystem::remove(file, ec);
+    }
+  };
+
+  // --- Buffers ---
+
+  // Producers push `total` packets between them, consumers drain with pop_n.
+  // Works for anything with push(), pop_n() and shutdown(), via the two adaptors.
+  template <typename Push, typename Pop, typename Shutdown>
+  double run_buffer_case(size_t producers, size_t consumers, size_t total, Push push, Pop pop, Shutdown shutdown)
+  {
+    std::atomic<size_t> consumed{0};
+    auto start = Clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < consumers; ++c)
+      threads.emplace_back([&, c]
+                           {
+                             TelemetryPacket out[64];
+                             while (consumed.load(std::memory_order_relaxed) < total)
+                             {
+                               size_t n = pop(c, out, 64);
+                               if (n == 0)
+                                 break;
+                               consumed.fetch_add(n, std::memory_order_relaxed);
+                             } });
+
+    std::vector<std::thread> producer_threads;
+    for (size_t p = 0; p < producers; ++p)
+      producer_threads.emplace_back([&, p]
+                                    {
+                                      TelemetryPacket pkt{};
+                                      size_t share = total / producers + (p < total % producers ? 1 : 0);
+                                      for (size_t i = 0; i < share; ++i)
+                                      {
+                                        pkt.timestamp = i;
+                                        push(p, pkt);
+                                      } });
+
+    for (auto &t : producer_threads)
+      t.join();
+    while (consumed.load() < total)
+      std::this_thread::yield();
+    double seconds = seconds_since(start);
+
+    shutdown(); // releases consumers still parked in pop_n
+    for (auto &t : threads)
+      t.join();
+    return total / seconds;
+  }
+
+  void bench_buffers(const BenchOptions &opts)
+  {
+    std::cout << "[buffer] push/pop throughput" << std::endl;
+    const size_t total = opts.quick ? 200000 : 2000000;
+
+    {
+      TelemetryBuffer buffer(1024, BufferMode::SpscRing, WaitStrategy::SpinThenPark);
+      double rate = run_buffer_case(
+          1, 1, total, [&](size_t, const TelemetryPacket &pkt)
+          { buffer.push(pkt); },
+          [&](size_t, TelemetryPacket *out, size_t max)
+          { return buffer.pop_n(out, max); },
+          [&]
+          { buffer.shutdown(); });
+      report("buffer", "spsc_ring 1p1c", {{"packets_per_sec", rate}});
+    }
+
+    for (size_t threads : {1, 2, 4})
+    {
+      TelemetryBuffer buffer(1024, BufferMode::Locked);
+      double rate = run_buffer_case(
+          threads, threads, total, [&](size_t, const TelemetryPacket &pkt)
+          { buffer.push(pkt); },
+          [&](size_t, TelemetryPacket *out, size_t max)
+          { return buffer.pop_n(out, max); },
+          [&]
+          { buffer.shutdown(); });
+      report("buffer", "locked " + std::to_string(threads) + "p" + std::to_string(threads) + "c",
+             {{"packets_per_sec", rate}});
+    }
+
+    for (size_t threads : {1, 2, 4})
+    {
+      ShardedTelemetryBuffer buffer(threads, 1024);
+      double rate = run_buffer_case(
+          threads, threads, total, [&](size_t p, const TelemetryPacket &pkt)
+          { buffer.push(p, pkt); },
+          [&](size_t c, TelemetryPacket *out, size_t max)
+          { return buffer.pop_n(c, out, max); },
+          [&]
+          { buffer.shutdown(); });
+      report("buffer", "sharded " + std::to_string(threads) + "p" + std::to_string(threads) + "c",
+             {{"packets_per_sec", rate}});
+    }
+  }
+
+  // --- Serialisation and compression ---
+
+  void bench_codecs(const BenchOptions &opts)
+  {
+    std::cout << "[codec] serialise/compress/decompress throughput by batch size" << std::endl;
+    const size_t total = opts.quick ? 20000 : 200000;
+    std::vector<TelemetryPacket> stream = make_stream(total);
+
+    // Per-packet API, exactly what the PerPacket link does
+    {
+      auto start = Clock::now();
+      std::vector<uint8_t> raw;
+      for (const TelemetryPacket &pkt : stream)
+        raw = serialise(pkt);
+      double ser = total / seconds_since(start);
+
+      std::vector<std::vector<uint8_t>> compressed(total);
+      start = Clock::now();
+      size_t bytes = 0;
+      for (size_t i = 0; i < total; ++i)
+      {
+        compressed[i] = compress_data(serialise(stream[i]));
+        bytes += compressed[i].size();
+      }
+      double comp = total / seconds_since(start);
+
+      start = Clock::now();
+      for (size_t i = 0; i < total; ++i)
+        raw = decompress_data(compressed[i], kPacketWireSize);
+      double decomp = total / seconds_since(start);
+
+      report("codec", "serialise", {{"packets_per_sec", ser}});
+      report("codec", "compress_data batch 1", {{"packets_per_sec", comp}, {"bytes_per_packet", static_cast<double>(bytes) / total}});
+      report("codec", "decompress_data batch 1", {{"packets_per_sec", decomp}});
+    }
+
+    // Each codec behind compress_data on single packets, dictionary trained on the first half
+    {
+      auto dictionary = std::make_shared<const CompressionDictionary>(train_dictionary(stream.data(), total / 2));
+      NoneCodec none;
+      ZlibCodec zlib, fast(1), primed(Z_DEFAULT_COMPRESSION, dictionary);
+      AdaptiveCodec adaptive(64 * 1024, Z_DEFAULT_COMPRESSION, dictionary);
+      const std::pair<const char *, Codec *> codecs[] = {
+          {"none", &none}, {"zlib", &zlib}, {"zlib level 1", &fast}, {"dict", &primed}, {"adaptive 64 KB/s", &adaptive}};
+      std::vector<uint8_t> raw(kPacketWireSize), payload;
+      for (auto [name, codec] : codecs)
+      {
+        size_t bytes = 0, packets = 0;
+        auto start = Clock::now();
+        for (size_t i = total / 2; i < total; ++i, ++packets)
+        {
+          serialise_into(stream[i], raw.data());
+          payload.clear();
+          codec->compress(raw.data(), raw.size(), payload);
+          codec->decompress(payload.data(), payload.size(), raw.data(), raw.size());
+          bytes += payload.size();
+        }
+        double rate = packets / seconds_since(start);
+        report("codec", std::string("codec ") + name + " batch 1",
+               {{"packets_per_sec", rate}, {"bytes_per_packet", static_cast<double>(bytes) / packets}});
+      }
+    }
+
+    // compress_data over a whole serialised batch
+    for (size_t batch : {8, 32, 128})
+    {
+      std::vector<uint8_t> raw(batch * kPacketWireSize);
+      std::vector<std::vector<uint8_t>> compressed;
+      size_t bytes = 0;
+
+      auto start = Clock::now();
+      for (size_t i = 0; i + batch <= total; i += batch)
+      {
+        for (size_t j = 0; j < batch; ++j)
+          serialise_into(stream[i + j], raw.data() + j * kPacketWireSize);
+        compressed.push_back(compress_data(raw));
+        bytes += compressed.back().size();
+      }
+      size_t packets = compressed.size() * batch;
+      double comp = packets / seconds_since(start);
+
+      start = Clock::now();
+      for (const auto &frame : compressed)
+        raw = decompress_data(frame, batch * kPacketWireSize);
+      double decomp = packets / seconds_since(start);
+
+      std::string b = std::to_string(batch);
+      report("codec", "compress_data batch " + b, {{"packets_per_sec", comp}, {"bytes_per_packet", static_cast<double>(bytes) / packets}});
+      report("codec", "decompress_data batch " + b, {{"packets_per_sec", decomp}});
+    }
+
+    // Link frame codecs, encode + decode on a persistent stream
+    for (PayloadCodec codec : {PayloadCodec::Deflate, PayloadCodec::Columnar, PayloadCodec::Quantized})
+      for (size_t batch : {8, 32, 128})
+      {
+        LinkConfig config;
+        config.frame_mode = FrameMode::Batched;
+        config.codec = codec;
+        config.batch_size = batch;
+        FrameEncoder encoder(config);
+        FrameDecoder decoder(config);
+        std::vector<uint8_t> bytes;
+        std::vector<TelemetryPacket> out;
+        size_t wire = 0, packets = 0;
+
+        auto start = Clock::now();
+        for (size_t i = 0; i + batch <= total; i += batch)
+        {
+          bytes.clear();
+          encoder.encode(stream.data() + i, batch, bytes);
+          FrameHeader h = decoder.parse_header(bytes.data());
+          out.clear();
+          decoder.decode(h, bytes.data() + decoder.header_size(), out);
+          wire += bytes.size();
+          packets += batch;
+        }
+        double rate = packets / seconds_since(start);
+
+        const char *codec_name = codec == PayloadCodec::Deflate ? "deflate" : codec == PayloadCodec::Columnar ? "columnar" : "quantized";
+        std::string name = std::string("frame ") + codec_name + " batch " + std::to_string(batch);
+        report("codec", name, {{"packets_per_sec", rate}, {"bytes_per_packet", static_cast<double>(wire) / packets}});
+      }
+  }
+
+  // --- Logger ---
+
+  void bench_logger(const BenchOptions &opts)
+  {
+    std::cout << "[logger] rows/s" << std::endl;
+    const size_t total = opts.quick ? 50000 : 500000;
+    std::vector<TelemetryPacket> stream = make_stream(total);
+    std::string tag = std::to_string(getpid());
+
+    struct Case
+    {
+      const char *name;
+      LoggerOptions options;
+      const char *ext;
+    };
+    LoggerOptions archive;
+    archive.format = LogFormat::Archive;
+    LoggerOptions archive_async = archive;
+    archive_async.async = true;
+    archive_async.flush_every_records = 4096;
+    const Case cases[] = {
+        {"csv sync, flush per row", LoggerOptions{}, ".csv"},
+        {"csv async, 4096 rows/block", LoggerOptions{true, 4096, std::chrono::milliseconds(0), false}, ".csv"},
+        {"csv async, 1024 rows or 200 ms", LoggerOptions{true, 1024, std::chrono::milliseconds(200), true}, ".csv"},
+        {"archive sync", archive, ".tlm"},
+        {"archive async", archive_async, ".tlm"},
+    };
+
+    for (const Case &c : cases)
+    {
+      std::string filename = "bench_logger_" + tag + c.ext;
+      auto start = Clock::now();
+      {
+        TelemetryLogger logger(filename, c.options);
+        for (const TelemetryPacket &pkt : stream)
+          logger.log_packet(pkt);
+      }
+      report("logger", c.name, {{"rows_per_sec", total / seconds_since(start)}});
+      std::remove(("logs/" + filename).c_str());
+    }
+
+    // The same rows from 64 sources, 32-packet batches per source as links deliver them
+    const uint32_t sources = 64;
+    const size_t batch = 32;
+    for (size_t i = 0; i < total; ++i)
+      stream[i].source_id = static_cast<uint32_t>(i / batch % sources);
+    for (size_t writers : {1, 2, 4})
+    {
+      ShardedLoggerOptions options;
+      options.writers = writers;
+      options.queue_packets = total; // measure the writers, not the drops
+      std::string prefix = "bench_shards_" + tag;
+      auto start = Clock::now();
+      {
+        ShardedTelemetryLogger logger(prefix, options);
+        for (size_t i = 0; i < total; i += batch)
+          logger.log_packets(stream.data() + i, std::min(batch, total - i));
+      }
+      std::string name = "csv sharded, " + std::to_string(sources) + " sources, " + std::to_string(writers) + " writers";
+      report("logger", name, {{"rows_per_sec", total / seconds_since(start)}});
+      for (uint32_t s = 0; s < sources; ++s)
+        std::remove(("logs/" + prefix + "_src" + std::to_string(s) + ".csv").c_str());
+    }
+  }
+
+  // --- Window aggregation ---
+
+  void bench_aggregate(const BenchOptions &opts)
+  {
+    std::cout << "[aggregate] packets/s into 1 s / 1 min / 1 h windows" << std::endl;
+    const size_t total = opts.quick ? 200000 : 2000000;
+    std::vector<TelemetryPacket> stream = make_stream(total);
+
+    struct Case
+    {
+      const char *name;
+      size_t per_second;
+      size_t batch;
+    };
+    const Case cases[] = {
+        {"1 packet/s, add per packet", 1, 1},
+        {"1 packet/s, batches of 32", 1, 32},
+        {"100 packets/s, batches of 32", 100, 32},
+    };
+    for (const Case &c : cases)
+    {
+      for (size_t i = 0; i < total; ++i)
+        stream[i].timestamp = i / c.per_second;
+      TelemetryAggregator agg;
+      auto start = Clock::now();
+      for (size_t i = 0; i < total; i += c.batch)
+        agg.add(stream.data() + i, std::min(c.batch, total - i));
+      double seconds = seconds_since(start);
+      report("aggregate", c.name, {{"packets_per_sec", total / seconds}, {"ns_per_packet", seconds * 1e9 / total}});
+    }
+
+    // What every consumer does today: recompute the last minute from the raw rows
+    const size_t span = 60, rescans = total / 10;
+    volatile double sink = 0; // keeps the loop from being optimised away
+    auto start = Clock::now();
+    for (size_t i = span; i < span + rescans; ++i)
+    {
+      float lo = stream[i].temperature, hi = lo;
+      double sum = 0, sumsq = 0;
+      for (size_t j = i - span; j < i; ++j)
+        for_each_column<TelemetryPacket>([&](auto col)
+                                         {
+                                           if constexpr (std::is_same_v<typename decltype(col)::Type, float>)
+                                           {
+                                             float x = col.get(stream[j]);
+                                             lo = std::min(lo, x);
+                                             hi = std::max(hi, x);
+                                             sum += x;
+                                             sumsq += static_cast<double>(x) * x;
+                                           } });
+      sink = sink + lo + hi + sum + sumsq;
+    }
+    double seconds = seconds_since(start);
+    report("aggregate", "rescan last 60 s per packet", {{"packets_per_sec", rescans / seconds}, {"ns_per_packet", seconds * 1e9 / rescans}});
+  }
+
+  // --- Fleet simulation ---
+
+  void bench_fleet(const BenchOptions &opts)
+  {
+    std::cout << "[fleet] packets/s, scalar TelemetrySimulator vs SoA FleetSimulator" << std::endl;
+    const uint64_t ticks = opts.quick ? 10 : 100;
+
+    for (size_t vehicles : {10000, 100000})
+    {
+      std::string v = std::to_string(vehicles / 1000) + "k";
+
+      std::vector<TelemetrySimulator> scalar;
+      scalar.reserve(vehicles);
+      for (size_t i = 0; i < vehicles; ++i)
+        scalar.emplace_back(i + 1);
+      std::vector<TelemetryPacket> out(vehicles);
+      auto start = Clock::now();
+      for (uint64_t t = 0; t < ticks; ++t)
+        for (size_t i = 0; i < vehicles; ++i)
+          out[i] = scalar[i].generate_packet(1.0);
+      report("fleet", "scalar " + v, {{"packets_per_sec", vehicles * ticks / seconds_since(start)}});
+
+      std::vector<size_t> thread_counts = {1};
+      if (std::thread::hardware_concurrency() > 1)
+        thread_counts.push_back(std::thread::hardware_concurrency());
+      for (size_t threads : thread_counts)
+      {
+        FleetConfig config;
+        config.vehicles = vehicles;
+        config.threads = threads;
+        FleetSimulator fleet(config);
+        std::atomic<uint64_t> delivered{0};
+        start = Clock::now();
+        fleet.run(ticks, [&](size_t, const FleetPacket *, size_t n)
+                  { delivered.fetch_add(n, std::memory_order_relaxed); });
+        report("fleet", "soa " + v + " " + std::to_string(threads) + " threads",
+               {{"packets_per_sec", delivered.load() / seconds_since(start)}});
+      }
+    }
+  }
+
+  // --- End to end ---
+
+  // A paced producer stamps each packet with its send time, the transmitter
+  // ships it over loopback and the ground station's on_packet hook records
+  // the delay. Stands in for the sensor thread, which only ticks once a second.
+  void bench_end_to_end(const BenchOptions &opts)
+  {
+    GroundStationLogs logs;
+    std::cout << "[e2e] loopback latency, producer -> transmitter -> ground station" << std::endl;
+    const size_t total = opts.quick ? 5000 : 50000;
+    const auto interval = std::chrono::microseconds(50); // 20k packets/s offered load
+
+    struct Case
+    {
+      const char *name;
+      FrameMode mode;
+      PayloadCodec codec;
+      size_t batch;
+      Transport transport;
+      double loss;
+    };
+    // Loopback TCP never loses a segment, so loss is only injected on UDP; the
+    // lossy case shows delivered packets keep their latency when others vanish
+    const Case cases[] = {
+        {"per-packet zlib", FrameMode::PerPacket, PayloadCodec::Deflate, 1, Transport::Tcp, 0},
+        {"batched deflate 32, 1 ms", FrameMode::Batched, PayloadCodec::Deflate, 32, Transport::Tcp, 0},
+        {"batched columnar 32, 1 ms", FrameMode::Batched, PayloadCodec::Columnar, 32, Transport::Tcp, 0},
+        {"udp columnar 32, 1 ms", FrameMode::Batched, PayloadCodec::Columnar, 32, Transport::Udp, 0},
+        {"udp columnar 32, 1 ms, 5% loss", FrameMode::Batched, PayloadCodec::Columnar, 32, Transport::Udp, 0.05},
+    };
+
+    uint16_t port = opts.port;
+    for (const Case &c : cases)
+    {
+      LinkConfig config;
+      config.port = port++;
+      config.frame_mode = c.mode;
+      config.codec = c.codec;
+      config.batch_size = c.batch;
+      config.batch_deadline = std::chrono::milliseconds(1);
+      config.verbose = false;
+      config.transport = c.transport;
+      config.impairment.loss = c.loss;
+
+      std::vector<double> latency_us;
+      latency_us.reserve(total);
+      std::atomic<size_t> received{0};
+      config.on_packet = [&](const TelemetryPacket &pkt)
+      {
+        uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+        latency_us.push_back((now - pkt.timestamp) / 1000.0);
+        received.fetch_add(1, std::memory_order_release);
+      };
+
+      TelemetryBuffer buffer(1024, BufferMode::SpscRing, WaitStrategy::SpinThenPark);
+      std::thread ground_station([&]
+                                 { ground_station_thread(config); });
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      std::thread transmitter([&]
+                              { transmitter_thread(buffer, config); });
+
+      std::vector<TelemetryPacket> stream = make_stream(total);
+      auto start = Clock::now();
+      auto next = start;
+      for (TelemetryPacket &pkt : stream)
+      {
+        std::this_thread::sleep_until(next);
+        next += interval;
+        pkt.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+        buffer.push(pkt);
+      }
+
+      // Lossy links never reach the total, so also stop once deliveries dry up
+      auto give_up = Clock::now() + std::chrono::seconds(10);
+      auto last_progress = Clock::now();
+      size_t seen = 0;
+      while (received.load(std::memory_order_acquire) < total && Clock::now() < give_up &&
+             Clock::now() - last_progress < std::chrono::milliseconds(200))
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        size_t now_received = received.load(std::memory_order_acquire);
+        if (now_received != seen)
+        {
+          seen = now_received;
+          last_progress = Clock::now();
+        }
+      }
+      double seconds = std::chrono::duration<double>(last_progress - start).count();
+
+      buffer.shutdown();
+      transmitter.join();
+      ground_station.join();
+
+      std::sort(latency_us.begin(), latency_us.end());
+      double mean = 0;
+      for (double l : latency_us)
+        mean += l;
+      mean = latency_us.empty() ? 0 : mean / latency_us.size();
+
+      report("e2e", c.name,
+             {{"packets", static_cast<double>(latency_us.size())},
+              {"packets_per_sec", latency_us.size() / seconds},
+              {"mean_us", mean},
+              {"p50_us", percentile(latency_us, 50)},
+              {"p99_us", percentile(latency_us, 99)},
+              {"p999_us", percentile(latency_us, 99.9)},
+              {"max_us", latency_us.empty() ? 0 : latency_us.back()}});
+    }
+  }
+
+  // --- Ingest ---
+
+  // Ground station decode throughput without the socket: frames are encoded up
+  // front and fed to a DecodePipeline with a growing number of workers
+  void bench_ingest(const BenchOptions &opts)
+  {
+    std::cout << "[ingest] ground station decode pipeline, packets/s by worker count" << std::endl;
+    const size_t total = opts.quick ? 20000 : 200000;
+    std::vector<TelemetryPacket> stream = make_stream(total);
+
+    struct Case
+    {
+      const char *name;
+      FrameMode mode;
+      PayloadCodec codec;
+    };
+    const Case cases[] = {
+        {"per-packet zlib", FrameMode::PerPacket, PayloadCodec::Deflate},
+        {"batched columnar 32", FrameMode::Batched, PayloadCodec::Columnar},
+    };
+
+    std::vector<size_t> worker_counts = {0, 1};
+    for (size_t w = 2; w <= std::thread::hardware_concurrency(); w *= 2)
+      worker_counts.push_back(w);
+
+    for (const Case &c : cases)
+    {
+      LinkConfig config;
+      config.frame_mode = c.mode;
+      config.codec = c.codec;
+
+      FrameEncoder encoder(config);
+      std::vector<uint8_t> wire;
+      for (size_t i = 0; i < total; i += 32)
+        encoder.encode(&stream[i], std::min<size_t>(32, total - i), wire);
+
+      // With and without the anomaly detector in the delivery path, as GroundStationSink runs it
+      for (size_t workers : worker_counts)
+        for (bool detect : {false, true})
+        {
+          config.decode_workers = workers;
+          AnomalyDetector detector;
+          uint64_t delivered = 0;
+          auto start = Clock::now();
+          {
+            DecodePipeline pipeline(config, [&](const TelemetryPacket *pkts, size_t count)
+                                    {
+                                      if (detect)
+                                        detector.process(pkts, count);
+                                      delivered += count; });
+            FrameDecoder decoder(config);
+            for (size_t at = 0; at < wire.size();)
+            {
+              FrameHeader h = decoder.parse_header(wire.data() + at);
+              at += decoder.header_size();
+              pipeline.submit(h, wire.data() + at);
+              at += h.payload_len;
+            }
+            pipeline.finish();
+          }
+          report("ingest", std::string(c.name) + ", " + std::to_string(workers) + " workers" + (detect ? " + detection" : ""),
+                 {{"packets_per_sec", delivered / seconds_since(start)}});
+        }
+    }
+
+    // The detector alone, in the batches frames arrive in
+    for (size_t batch : {1, 32})
+    {
+      AnomalyDetector detector;
+      auto start = Clock::now();
+      for (size_t i = 0; i < total; i += batch)
+        detector.process(&stream[i], std::min(batch, total - i));
+      double seconds = seconds_since(start);
+      report("ingest", "anomaly detection only, batch " + std::to_string(batch),
+             {{"packets_per_sec", total / seconds}, {"ns_per_packet", seconds * 1e9 / total}});
+    }
+  }
+
+  // --- Priority ---
+
+  // A bulk producer keeps a rate-limited link saturated while a second one
+  // injects an alarm every few milliseconds; only the alarms' latency is
+  // recorded. With a plain FIFO every alarm waits behind the whole backlog.
+  template <typename Buffer>
+  void run_priority_case(const char *name, Buffer &buffer, LinkConfig config, std::chrono::milliseconds duration)
+  {
+    std::vector<double> latency_us;
+    config.on_packet = [&](const TelemetryPacket &pkt)
+    {
+      if (pkt.radiation < 0.5f)
+        return;
+      uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+      latency_us.push_back((now - pkt.timestamp) / 1000.0);
+    };
+
+    std::thread ground_station([&]
+                               { ground_station_thread(config); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::thread transmitter([&]
+                            { transmitter_thread(buffer, config); });
+
+    std::atomic<bool> running{true};
+    std::thread bulk([&]
+                     {
+      std::vector<TelemetryPacket> stream = make_stream(4096);
+      for (size_t i = 0; running.load(std::memory_order_relaxed); i = (i + 32) % stream.size())
+        buffer.push_n(&stream[i], 32); });
+
+    std::vector<TelemetryPacket> alarm = make_stream(1);
+    alarm[0].radiation = 0.9f;
+    size_t sent = 0;
+    auto start = Clock::now();
+    while (Clock::now() - start < duration)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      alarm[0].timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+      buffer.push(alarm[0]);
+      sent++;
+    }
+
+    running = false;
+    buffer.shutdown();
+    bulk.join();
+    transmitter.join();
+    ground_station.join();
+
+    std::sort(latency_us.begin(), latency_us.end());
+    report("priority", name,
+           {{"alarms", static_cast<double>(latency_us.size())},
+            {"alarms_sent", static_cast<double>(sent)},
+            {"p50_us", percentile(latency_us, 50)},
+            {"p99_us", percentile(latency_us, 99)},
+            {"max_us", latency_us.empty() ? 0 : latency_us.back()}});
+  }
+
+  void bench_priority(const BenchOptions &opts)
+  {
+    GroundStationLogs logs;
+    std::cout << "[priority] alarm latency behind a saturating bulk backlog, 256 KB/s link" << std::endl;
+    const auto duration = std::chrono::milliseconds(opts.quick ? 1000 : 5000);
+    LinkConfig config;
+    config.frame_mode = FrameMode::Batched;
+    config.codec = PayloadCodec::Columnar;
+    config.batch_size = 32;
+    config.batch_deadline = std::chrono::milliseconds(1);
+    config.link_rate = 256 * 1024;
+    config.verbose = false;
+
+    config.port = opts.port + 20;
+    TelemetryBuffer fifo(1024);
+    run_priority_case("fifo 1024", fifo, config, duration);
+
+    config.port = opts.port + 21;
+    PriorityTelemetryBuffer priority;
+    run_priority_case("strict alarm + drr", priority, config, duration);
+  }
+
+  // --- Syscalls ---
+
+  double cpu_seconds()
+  {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  }
+
+  // A flat-out loopback link, counting the syscalls that moved its bytes and
+  // the process CPU time (both ends, encode and decode included)
+  void bench_syscalls(const BenchOptions &opts)
+  {
+    GroundStationLogs logs;
+    std::cout << "[syscalls] sockets vs io_uring, loopback link flat out" << std::endl;
+    const size_t total = opts.quick ? 20000 : 200000;
+    std::vector<TelemetryPacket> stream = make_stream(total);
+    Counter &sends = metrics().counter("telemetry_io_syscalls_total", "", "call=\"send\"");
+    Counter &recvs = metrics().counter("telemetry_io_syscalls_total", "", "call=\"recv\"");
+    Counter &enters = metrics().counter("telemetry_io_syscalls_total", "", "call=\"io_uring_enter\"");
+
+    struct Case
+    {
+      const char *name;
+      IoBackend backend;
+      FrameMode mode;
+    };
+    const Case cases[] = {
+        {"sockets per-packet", IoBackend::Sockets, FrameMode::PerPacket},
+        {"io_uring per-packet", IoBackend::Uring, FrameMode::PerPacket},
+        {"sockets batched columnar 32", IoBackend::Sockets, FrameMode::Batched},
+        {"io_uring batched columnar 32", IoBackend::Uring, FrameMode::Batched},
+    };
+
+    uint16_t port = opts.port + 30;
+    for (const Case &c : cases)
+    {
+      LinkConfig config;
+      config.port = port++;
+      config.io_backend = c.backend;
+      config.frame_mode = c.mode;
+      config.codec = PayloadCodec::Columnar;
+      config.batch_deadline = std::chrono::milliseconds(1);
+      config.verbose = false;
+      std::atomic<size_t> received{0};
+      config.on_packet = [&](const TelemetryPacket &)
+      { received.fetch_add(1, std::memory_order_relaxed); };
+
+      std::thread ground_station([&]
+                                 { ground_station_thread(config); });
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+      uint64_t calls0 = sends.value() + recvs.value() + enters.value();
+      double cpu0 = cpu_seconds();
+      auto start = Clock::now();
+      TelemetryBuffer buffer(4096, BufferMode::SpscRing);
+      std::thread transmitter([&]
+                              { transmitter_thread(buffer, config); });
+      buffer.push_n(stream.data(), stream.size());
+      while (buffer.size() > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      buffer.shutdown();
+      transmitter.join();
+      ground_station.join();
+      double seconds = seconds_since(start);
+      double cpu = cpu_seconds() - cpu0;
+      // The io_uring counts are added as each end closes, so read them after the joins
+      uint64_t calls = sends.value() + recvs.value() + enters.value() - calls0;
+
+      report("syscalls", c.name,
+             {{"packets", static_cast<double>(received.load())},
+              {"packets_per_sec", received.load() / seconds},
+              {"syscalls_per_packet", static_cast<double>(calls) / total},
+              {"cpu_s_per_million", cpu / total * 1e6}});
+    }
+  }
+
+  // --- Shared memory ---
+
+  constexpr size_t kRecordSize = 64;
+
+  uint64_t now_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+  }
+
+  // Raw transport, no codec or buffer: `paced` timestamped records 20 us apart
+  // for one-way latency, then `flat_out` back to back for throughput
+  template <typename Send, typename Receive>
+  void run_transport_case(const char *name, size_t paced, size_t flat_out, Send send, Receive receive)
+  {
+    std::vector<double> latency_us;
+    latency_us.reserve(paced);
+    std::thread reader([&]
+                       {
+      uint8_t rec[kRecordSize];
+      for (size_t i = 0; i < paced + flat_out && receive(rec); ++i)
+      {
+        if (i >= paced)
+          continue;
+        uint64_t sent;
+        std::memcpy(&sent, rec, sizeof(sent));
+        latency_us.push_back((now_ns() - sent) / 1000.0);
+      } });
+
+    uint8_t rec[kRecordSize] = {};
+    auto next = Clock::now();
+    for (size_t i = 0; i < paced; ++i)
+    {
+      std::this_thread::sleep_until(next);
+      next += std::chrono::microseconds(20);
+      uint64_t stamp = now_ns();
+      std::memcpy(rec, &stamp, sizeof(stamp));
+      send(rec);
+    }
+    auto start = Clock::now();
+    for (size_t i = 0; i < flat_out; ++i)
+      send(rec);
+    reader.join();
+    double seconds = seconds_since(start);
+
+    std::sort(latency_us.begin(), latency_us.end());
+    report("shm", name,
+           {{"p50_us", percentile(latency_us, 50)},
+            {"p99_us", percentile(latency_us, 99)},
+            {"records_per_sec", flat_out / seconds}});
+  }
+
+  void bench_shm(const BenchOptions &opts)
+  {
+    std::cout << "[shm] 64-byte records, shared-memory ring vs TCP loopback" << std::endl;
+    const size_t paced = opts.quick ? 2000 : 20000;
+    const size_t flat_out = opts.quick ? 100000 : 1000000;
+
+    {
+      LinkConfig config;
+      config.port = opts.port + 40;
+      ShmReceiver receiver(config);
+      ShmSender sender(config);
+      if (receiver.ok() && sender.ok() && receiver.wait_for_sender(std::chrono::milliseconds(1000)))
+        run_transport_case(
+            "shm ring", paced, flat_out, [&](const uint8_t *rec)
+            { sender.send(rec, kRecordSize); },
+            [&](uint8_t *rec)
+            {
+              const uint8_t *data;
+              size_t len;
+              if (!receiver.next(data, len))
+                return false;
+              std::memcpy(rec, data, std::min(len, kRecordSize));
+              receiver.release();
+              return true;
+            });
+    }
+
+    int listen_sock = open_listen_socket(opts.port + 40, 1, true);
+    int tx = listen_sock >= 0 ? connect_loopback(opts.port + 40) : -1;
+    int rx = tx >= 0 ? accept(listen_sock, nullptr, nullptr) : -1;
+    if (rx >= 0)
+    {
+      int one = 1;
+      setsockopt(tx, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      run_transport_case(
+          "tcp loopback", paced, flat_out, [&](const uint8_t *rec)
+          { send_all(tx, rec, kRecordSize); },
+          [&](uint8_t *rec)
+          { return recv_all(rx, rec, kRecordSize); });
+    }
+    for (int fd : {rx, tx, listen_sock})
+      if (fd >= 0)
+        close(fd);
+  }
+
+  void write_json(const std::string &path)
+  {
+    std::ofstream out(path);
+    out << "{\n  \"schema\": 1,\n  \"unix_time\": "
+        << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+        << ",\n  \"hardware_threads\": " << std::thread::hardware_concurrency()
+        << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      const BenchResult &r = results[i];
+      out << "    {\"suite\": \"" << r.suite << "\", \"name\": \"" << r.name << "\", \"metrics\": {";
+      for (size_t m = 0; m < r.metrics.size(); ++m)
+        out << (m ? ", " : "") << "\"" << r.metrics[m].first << "\": " << std::setprecision(10) << r.metrics[m].second;
+      out << "}}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    std::cout << "Results written to " << path << std::endl;
+  }
+}
+
+static void usage(const char *prog)
+{
+  std::cout << "Usage: " << prog << " [options] [suite...]\n"
+            << "  suites: buffer codec logger aggregate fleet ingest e2e priority syscalls shm (default: all)\n"
+            << "  --quick           smaller runs, for smoke testing\n"
+            << "  --port N          first port for the e2e suite (default 5200)\n"
+            << "  --json PATH       also write the results as JSON to PATH\n";
+}
+
+int main(int argc, char **argv)
+{
+  BenchOptions opts;
+  std::vector<std::string> suites;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if (arg == "--quick")
+      opts.quick = true;
+    else if (arg == "--port" && has_value)
+      opts.port = static_cast<uint16_t>(std::stoi(argv[++i]));
+    else if (arg == "--json" && has_value)
+      opts.json_path = argv[++i];
+    else if (arg == "buffer" || arg == "codec" || arg == "logger" || arg == "aggregate" || arg == "fleet" || arg == "ingest" ||
+             arg == "e2e" || arg == "priority" || arg == "syscalls" ||
+             arg == "shm")
+      suites.push_back(arg);
+    else
+    {
+      usage(argv[0]);
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  auto wanted = [&](const char *suite)
+  { return suites.empty() || std::find(suites.begin(), suites.end(), suite) != suites.end(); };
+
+  if (wanted("buffer"))
+    bench_buffers(opts);
+  if (wanted("codec"))
+    bench_codecs(opts);
+  if (wanted("logger"))
+    bench_logger(opts);
+  if (wanted("aggregate"))
+    bench_aggregate(opts);
+  if (wanted("fleet"))
+    bench_fleet(opts);
+  if (wanted("ingest"))
+    bench_ingest(opts);
+  if (wanted("e2e"))
+    bench_end_to_end(opts);
+  if (wanted("priority"))
+    bench_priority(opts);
+  if (wanted("syscalls"))
+    bench_syscalls(opts);
+  if (wanted("shm"))
+    bench_shm(opts);
+
+  if (!opts.json_path.empty())
+    write_json(opts.json_path);
+  return 0;
+}
@@ -3,14 +3,87 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 #include "../include/telemetry.h"
 #include "../include/buffer.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  // Spins before an SpinThenPark waiter falls back to the condition variable
+  constexpr unsigned kSpinLimit = 4096;
+
+  inline void cpu_relax()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  struct BufferMetrics
+  {
+    Counter &pushed = metrics().counter("telemetry_buffer_pushed_total", "Packets pushed into telemetry buffers");
+    Counter &popped = metrics().counter("telemetry_buffer_popped_total", "Packets popped from telemetry buffers");
+    Histogram &producer_wait = metrics().histogram("telemetry_buffer_wait_seconds",
+                                                   "Time spent waiting on a full (producer) or empty (consumer) buffer",
+                                                   "side=\"producer\"");
+    Histogram &consumer_wait = metrics().histogram("telemetry_buffer_wait_seconds", "", "side=\"consumer\"");
+    Counter &dropped = metrics().counter("telemetry_buffer_dropped_total", "Packets discarded by full telemetry buffers",
+                                         "reason=\"rejected\"");
+    Counter &evicted = metrics().counter("telemetry_buffer_dropped_total", "", "reason=\"evicted\"");
+    Counter &spilled = metrics().counter("telemetry_buffer_spilled_total", "Packets that overflowed to a spill ring on disk");
+  };
+
+  const char *const kOccupancyGauge = "telemetry_buffer_occupancy_packets";
+  std::atomic<uint64_t> next_buffer_id{0};
+
+  BufferMetrics &buffer_metrics()
+  {
+    static BufferMetrics m;
+    return m;
+  }
+
+  size_t round_up_pow2(size_t n)
+  {
+    size_t p = 1;
+    while (p < n)
+      p <<= 1;
+    return p;
+  }
+}
 
 // capacity_ = N + 1 is used to distinguish full vs empty states using front and back
 // Effective capacity is actually capacity_ - 1
-TelemetryBuffer::TelemetryBuffer(size_t capacity) : capacity_(capacity + 1), buffer_(capacity + 1), front(0), back(0) {}
+// In SpscRing mode the storage is rounded up to a power of two instead, and the
+// logical capacity is still capacity_ - 1 so both modes hold the same number of packets.
+TelemetryBuffer::TelemetryBuffer(size_t capacity, BufferMode mode, WaitStrategy wait, const OverflowConfig &overflow)
+    : capacity_(capacity + 1), buffer_(capacity + 1), front(0), back(0), mode_(mode), wait_(wait), overflow_(overflow)
+{
+  if (mode_ == BufferMode::SpscRing)
+  {
+    if (overflow_.policy == OverflowPolicy::DropOldest || overflow_.policy == OverflowPolicy::Spill)
+      throw std::invalid_argument("DropOldest and Spill overflow need a Locked buffer");
+    buffer_.resize(round_up_pow2(std::max<size_t>(capacity, 1)));
+    mask_ = buffer_.size() - 1;
+  }
+  if (overflow_.policy == OverflowPolicy::Spill)
+    spill_ = std::make_unique<SpillRing>(overflow_.spill_dir, overflow_.spill_capacity);
+
+  // Read on scrape, so the hot path pays nothing for it
+  metrics_labels_ = "buffer=\"" + std::to_string(next_buffer_id.fetch_add(1)) + "\"";
+  metrics().gauge(kOccupancyGauge, "Packets queued in each telemetry buffer, spilled ones included", [this]
+                  { return static_cast<double>(size()); }, metrics_labels_);
+}
+
+TelemetryBuffer::~TelemetryBuffer()
+{
+  metrics().remove(kOccupancyGauge, metrics_labels_);
+}
 
 bool TelemetryBuffer::isEmpty() const
 {
@@ -24,39 +97,316 @@ bool TelemetryBuffer::isFull() const
 
 void TelemetryBuffer::push(const TelemetryPacket &pkt)
 {
-  std::unique_lock<std::mutex> lock(mtx_);
-
-  cv_full_.wait(lock, [this]
-                { return stop_ || !isFull(); });
-
-  if (stop_)
-    return;
-
-  buffer_[back] = pkt;
-  back = (back + 1) % capacity_;
-
-  cv_empty_.notify_one();
+  push_n(&pkt, 1);
 }
 
 TelemetryPacket TelemetryBuffer::pop()
 {
+  if (mode_ == BufferMode::SpscRing)
+  {
+    TelemetryPacket pkt{};
+    spsc_pop_n(&pkt, 1, Deadline::max());
+    return pkt;
+  }
+
   std::unique_lock<std::mutex> lock(mtx_);
-  cv_empty_.wait(lock, [this]
-                 { return stop_ || !isEmpty(); });
+  if (isEmpty())
+  {
+    ScopedTimer wait(buffer_metrics().consumer_wait);
+    cv_empty_.wait(lock, [this]
+                   { return stop_ || !isEmpty(); });
+  }
 
   if (stop_ && isEmpty())
     return TelemetryPacket{};
 
   TelemetryPacket prev_pkt = buffer_[front];
   front = (front + 1) % capacity_;
+  buffer_metrics().popped.add();
+  unspill();
 
   cv_full_.notify_one();
   return prev_pkt;
 }
 
+size_t TelemetryBuffer::push_n(const TelemetryPacket *pkts, size_t count)
+{
+  if (mode_ == BufferMode::SpscRing)
+    return spsc_push_n(pkts, count);
+  return locked_push_n(pkts, count);
+}
+
+size_t TelemetryBuffer::pop_n(TelemetryPacket *out, size_t max_count)
+{
+  return pop_n(out, max_count, Deadline::max());
+}
+
+size_t TelemetryBuffer::pop_n(TelemetryPacket *out, size_t max_count, std::chrono::steady_clock::time_point deadline)
+{
+  if (mode_ == BufferMode::SpscRing)
+    return spsc_pop_n(out, max_count, deadline);
+  return locked_pop_n(out, max_count, deadline);
+}
+
+size_t TelemetryBuffer::locked_push_n(const TelemetryPacket *pkts, size_t count)
+{
+  BufferMetrics &m = buffer_metrics();
+  size_t pushed = 0;
+  Deadline deadline = Deadline::max();
+  std::unique_lock<std::mutex> lock(mtx_);
+
+  while (pushed < count && !stop_)
+  {
+    // buffer_ stays full while anything is on disk, so this also keeps order
+    if (spill_ && isFull())
+    {
+      size_t start = pushed;
+      for (; pushed < count; ++pushed)
+        if (!spill_->push(pkts[pushed]))
+        {
+          evicted_++;
+          m.evicted.add();
+        }
+      spilled_ += count - start;
+      m.spilled.add(count - start);
+      break;
+    }
+
+    if (isFull())
+    {
+      if (overflow_.policy == OverflowPolicy::DropNewest)
+        break;
+      if (overflow_.policy == OverflowPolicy::DropOldest)
+      {
+        size_t n = std::min(count - pushed, capacity_ - 1);
+        front = (front + n) % capacity_;
+        evicted_ += n;
+        m.evicted.add(n);
+      }
+      else
+      {
+        ScopedTimer wait(m.producer_wait);
+        auto ready = [this]
+        { return stop_ || !isFull(); };
+        if (overflow_.policy == OverflowPolicy::BlockTimeout)
+        {
+          if (deadline == Deadline::max())
+            deadline = std::chrono::steady_clock::now() + overflow_.timeout;
+          if (!cv_full_.wait_until(lock, deadline, ready))
+            break;
+        }
+        else
+          cv_full_.wait(lock, ready);
+      }
+    }
+    if (stop_)
+      break;
+
+    while (pushed < count && !isFull())
+    {
+      buffer_[back] = pkts[pushed++];
+      back = (back + 1) % capacity_;
+    }
+    cv_empty_.notify_one();
+  }
+  if (pushed < count && !stop_)
+  {
+    dropped_ += count - pushed;
+    m.dropped.add(count - pushed);
+  }
+  m.pushed.add(pushed);
+  return pushed;
+}
+
+// Refills buffer_ from the spill ring after the consumer made room. Caller holds mtx_.
+void TelemetryBuffer::unspill()
+{
+  if (!spill_ || spill_->empty())
+    return;
+  while (!isFull() && !spill_->empty())
+  {
+    // Up to the wrap point or the free space, whichever is shorter
+    size_t free = capacity_ - 1 - (back >= front ? back - front : capacity_ - (front - back));
+    size_t run = std::min(free, capacity_ - back);
+    back = (back + spill_->pop_n(&buffer_[back], run)) % capacity_;
+  }
+}
+
+size_t TelemetryBuffer::locked_pop_n(TelemetryPacket *out, size_t max_count, Deadline deadline)
+{
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto ready = [this]
+  { return stop_ || !isEmpty(); };
+
+  if (!ready())
+  {
+    ScopedTimer wait(buffer_metrics().consumer_wait);
+    if (deadline == Deadline::max())
+      cv_empty_.wait(lock, ready);
+    else
+      cv_empty_.wait_until(lock, deadline, ready);
+  }
+
+  size_t popped = 0;
+  while (popped < max_count && !isEmpty())
+  {
+    out[popped++] = buffer_[front];
+    front = (front + 1) % capacity_;
+  }
+
+  if (popped > 0)
+  {
+    unspill();
+    cv_full_.notify_all();
+    buffer_metrics().popped.add(popped);
+  }
+  return popped;
+}
+
+// Waits until ready() holds, returning false if the buffer was shut down or the
+// deadline passed first.
+// Parking uses the usual flag/fence handshake: the waiter publishes `parked`
+// and then re-checks ready(), the other side publishes its index and then
+// checks `parked`, so at least one of them sees the other's store.
+template <typename Ready>
+bool TelemetryBuffer::spsc_wait(Ready ready, std::atomic<bool> &parked, std::condition_variable &cv,
+                                Deadline deadline)
+{
+  const bool timed = deadline != Deadline::max();
+
+  if (wait_ != WaitStrategy::Block)
+  {
+    for (unsigned spins = 0; wait_ == WaitStrategy::Spin || spins < kSpinLimit; ++spins)
+    {
+      if (ready())
+        return true;
+      if (stop_.load(std::memory_order_relaxed))
+        return false;
+      if (timed && spins % 64 == 63 && std::chrono::steady_clock::now() >= deadline)
+        return false;
+      cpu_relax();
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (true)
+  {
+    parked.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (ready())
+      break;
+    if (stop_ || (timed && std::chrono::steady_clock::now() >= deadline))
+    {
+      parked.store(false, std::memory_order_relaxed);
+      return false;
+    }
+    if (timed)
+      cv.wait_until(lock, deadline);
+    else
+      cv.wait(lock);
+  }
+  parked.store(false, std::memory_order_relaxed);
+  return true;
+}
+
+void TelemetryBuffer::spsc_wake(std::atomic<bool> &parked, std::condition_variable &cv)
+{
+  if (wait_ == WaitStrategy::Spin)
+    return;
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (parked.load(std::memory_order_relaxed))
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    cv.notify_one();
+  }
+}
+
+size_t TelemetryBuffer::spsc_push_n(const TelemetryPacket *pkts, size_t count)
+{
+  size_t pushed = 0;
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  Deadline deadline = Deadline::max();
+
+  while (pushed < count)
+  {
+    auto has_space = [&]
+    {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      return tail - cached_head_ < limit();
+    };
+
+    if (tail - cached_head_ >= limit() && !has_space())
+    {
+      if (overflow_.policy == OverflowPolicy::DropNewest)
+        break;
+      if (overflow_.policy == OverflowPolicy::BlockTimeout && deadline == Deadline::max())
+        deadline = std::chrono::steady_clock::now() + overflow_.timeout;
+      ScopedTimer wait(buffer_metrics().producer_wait);
+      if (!spsc_wait(has_space, producer_parked_, cv_full_, deadline))
+        break;
+    }
+    if (stop_.load(std::memory_order_relaxed))
+      break;
+
+    size_t n = std::min(count - pushed, limit() - (tail - cached_head_));
+    for (size_t i = 0; i < n; ++i)
+      buffer_[(tail + i) & mask_] = pkts[pushed + i];
+
+    pushed += n;
+    tail += n;
+    tail_.store(tail, std::memory_order_release);
+    spsc_wake(consumer_parked_, cv_empty_);
+  }
+  if (pushed < count && !stop_.load(std::memory_order_relaxed))
+  {
+    dropped_.fetch_add(count - pushed, std::memory_order_relaxed);
+    buffer_metrics().dropped.add(count - pushed);
+  }
+  buffer_metrics().pushed.add(pushed);
+  return pushed;
+}
+
+size_t TelemetryBuffer::spsc_pop_n(TelemetryPacket *out, size_t max_count, Deadline deadline)
+{
+  size_t head = head_.load(std::memory_order_relaxed);
+
+  auto has_data = [&]
+  {
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    return cached_tail_ != head;
+  };
+
+  // After shutdown we still hand out whatever is left, matching Locked mode
+  if (cached_tail_ == head)
+  {
+    bool ready;
+    {
+      ScopedTimer wait(buffer_metrics().consumer_wait);
+      ready = spsc_wait(has_data, consumer_parked_, cv_empty_, deadline);
+    }
+    if (!ready && !has_data())
+      return 0;
+  }
+
+  size_t n = std::min(max_count, cached_tail_ - head);
+  for (size_t i = 0; i < n; ++i)
+    out[i] = buffer_[(head + i) & mask_];
+
+  head_.store(head + n, std::memory_order_release);
+  spsc_wake(producer_parked_, cv_full_);
+  buffer_metrics().popped.add(n);
+  return n;
+}
+
 void TelemetryBuffer::shutdown()
 {
-  stop_ = true;
+  {
+    // Taking the lock orders stop_ against any waiter that is about to sleep
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_ = true;
+  }
   cv_full_.notify_all();
   cv_empty_.notify_all();
 
@@ -65,10 +415,18 @@ void TelemetryBuffer::shutdown()
 
 size_t TelemetryBuffer::size()
 {
+  if (mode_ == BufferMode::SpscRing)
+  {
+    // Read head first: tail can only move forward, so tail >= head holds
+    size_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+
   std::scoped_lock lock(mtx_);
+  size_t spilled = spill_ ? spill_->size() : 0;
   if (back >= front)
-    return back - front;
-  return capacity_ - (front - back);
+    return back - front + spilled;
+  return capacity_ - (front - back) + spilled;
 }
 
 bool TelemetryBuffer::is_shutdown() const
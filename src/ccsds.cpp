@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <arpa/inet.h>
+
+#include "../include/ccsds.h"
+#include "../include/columnar_codec.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  // Most packets a columnar space packet may hold: bounds the payload well
+  // under kMaxSpacePacketData even for incompressible packets
+  constexpr size_t kMaxColumnarPackets = 1024;
+
+  // Slicing-by-8: entries[k][b] is the CRC of byte b followed by k zero bytes,
+  // so eight bytes fold in with independent lookups instead of a serial chain
+  struct CrcTable
+  {
+    uint16_t entries[8][256];
+    CrcTable()
+    {
+      for (unsigned i = 0; i < 256; ++i)
+      {
+        uint16_t crc = static_cast<uint16_t>(i << 8);
+        for (int bit = 0; bit < 8; ++bit)
+          crc = static_cast<uint16_t>(crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+        entries[0][i] = crc;
+      }
+      for (int k = 1; k < 8; ++k)
+        for (unsigned i = 0; i < 256; ++i)
+          entries[k][i] = static_cast<uint16_t>(entries[k - 1][i] << 8 ^ entries[0][entries[k - 1][i] >> 8]);
+    }
+  };
+
+  const CrcTable crc_table;
+
+  struct CcsdsMetrics
+  {
+    Counter *frames[kVirtualChannels];
+    Counter *lost_frames[kVirtualChannels];
+    Counter &bad_frames = metrics().counter("telemetry_ccsds_bad_frames_total", "Transfer frames rejected by the CRC check");
+    Counter &skipped_bytes = metrics().counter("telemetry_ccsds_skipped_bytes_total", "Bytes discarded while searching for a sync marker");
+
+    CcsdsMetrics()
+    {
+      for (size_t vc = 0; vc < kVirtualChannels; ++vc)
+      {
+        std::string label = "vc=\"" + std::to_string(vc) + "\"";
+        frames[vc] = &metrics().counter("telemetry_ccsds_frames_total", "Good transfer frames per virtual channel", label);
+        lost_frames[vc] = &metrics().counter("telemetry_ccsds_lost_frames_total", "Gaps in the virtual channel frame counter", label);
+      }
+    }
+  };
+
+  CcsdsMetrics &ccsds_metrics()
+  {
+    static CcsdsMetrics m;
+    return m;
+  }
+
+  void put_u16(uint8_t *out, uint16_t value)
+  {
+    out[0] = static_cast<uint8_t>(value >> 8);
+    out[1] = static_cast<uint8_t>(value);
+  }
+
+  uint16_t get_u16(const uint8_t *in)
+  {
+    return static_cast<uint16_t>(in[0] << 8 | in[1]);
+  }
+
+  uint32_t get_u32(const uint8_t *in)
+  {
+    uint32_t be;
+    std::memcpy(&be, in, sizeof(be));
+    return ntohl(be);
+  }
+
+  const uint8_t kAsmBytes[kAsmSize] = {0x1A, 0xCF, 0xFC, 0x1D};
+  const uint8_t kIdleFill[kFrameDataSize] = {};
+}
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len)
+{
+  const auto &t = crc_table.entries;
+  uint16_t crc = 0xFFFF;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8)
+  {
+    const uint8_t *d = data + i;
+    crc = static_cast<uint16_t>(t[7][d[0] ^ (crc >> 8)] ^ t[6][d[1] ^ (crc & 0xFF)] ^ t[5][d[2]] ^ t[4][d[3]] ^
+                                t[3][d[4]] ^ t[2][d[5]] ^ t[1][d[6]] ^ t[0][d[7]]);
+  }
+  for (; i < len; ++i)
+    crc = static_cast<uint16_t>((crc << 8) ^ t[0][(crc >> 8) ^ data[i]]);
+  return crc;
+}
+
+void CcsdsFramer::append(uint8_t vc, const uint8_t *data, size_t len, bool packet_start, std::vector<uint8_t> &out)
+{
+  Channel &ch = channels_[vc];
+  // A full frame is emitted straight away, so there is always room for the first byte here
+  if (packet_start && ch.first_header == kNoPacketStart)
+    ch.first_header = static_cast<uint16_t>(ch.fill);
+
+  while (len > 0)
+  {
+    size_t n = std::min(len, kFrameDataSize - ch.fill);
+    std::memcpy(ch.cadu.data() + kAsmSize + kFrameHeaderSize + ch.fill, data, n);
+    ch.fill += n;
+    data += n;
+    len -= n;
+    if (ch.fill == kFrameDataSize)
+      emit(vc, out);
+  }
+}
+
+void CcsdsFramer::emit(uint8_t vc, std::vector<uint8_t> &out)
+{
+  Channel &ch = channels_[vc];
+  uint8_t *cadu = ch.cadu.data();
+  uint8_t *frame = cadu + kAsmSize;
+
+  std::memcpy(cadu, kAsmBytes, kAsmSize);
+  put_u16(frame, static_cast<uint16_t>(kSpacecraftId << 4 | vc << 1)); // version 0, no OCF
+  frame[2] = master_count_++;
+  frame[3] = ch.count++;
+  put_u16(frame + 4, static_cast<uint16_t>(0x3 << 11 | ch.first_header)); // segment length id 11: no segmentation
+  put_u16(frame + kTransferFrameSize - kFrameCrcSize, crc16_ccitt(frame, kTransferFrameSize - kFrameCrcSize));
+
+  out.insert(out.end(), cadu, cadu + kCaduSize);
+  ch.fill = 0;
+  ch.first_header = kNoPacketStart;
+}
+
+void CcsdsFramer::add_packet(uint8_t vc, uint16_t apid, const uint8_t *data, size_t len, std::vector<uint8_t> &out)
+{
+  Channel &ch = channels_[vc];
+  uint8_t header[kSpacePacketHeaderSize];
+  put_u16(header, apid & 0x7FF);                                        // version 0, telemetry, no secondary header
+  put_u16(header + 2, static_cast<uint16_t>(0x3 << 14 | (ch.packet_count++ & 0x3FFF))); // unsegmented
+  put_u16(header + 4, static_cast<uint16_t>(len - 1));
+  append(vc, header, sizeof(header), true, out);
+  append(vc, data, len, false, out);
+}
+
+void CcsdsFramer::add_telemetry(uint8_t vc, const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out)
+{
+  uint8_t raw[kPacketWireSize];
+  for (size_t i = 0; i < count; ++i)
+  {
+    serialise_into(pkts[i], raw);
+    add_packet(vc, kApidTelemetry, raw, sizeof(raw), out);
+  }
+}
+
+void CcsdsFramer::add_columnar(uint8_t vc, const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out)
+{
+  while (count > 0)
+  {
+    size_t n = std::min(count, kMaxColumnarPackets);
+    scratch_.assign(2, 0);
+    put_u16(scratch_.data(), static_cast<uint16_t>(n));
+    encode_columnar(pkts, n, scratch_);
+    add_packet(vc, kApidColumnar, scratch_.data(), scratch_.size(), out);
+    pkts += n;
+    count -= n;
+  }
+}
+
+void CcsdsFramer::flush(uint8_t vc, std::vector<uint8_t> &out)
+{
+  // An idle packet needs at least 7 bytes; if less is left it spills into one
+  // more frame, which the next pass pads out exactly
+  Channel &ch = channels_[vc];
+  while (ch.fill > 0)
+  {
+    size_t len = std::max(kFrameDataSize - ch.fill, kSpacePacketHeaderSize + 1);
+    add_packet(vc, kApidIdle, kIdleFill, len - kSpacePacketHeaderSize, out);
+  }
+}
+
+size_t CcsdsDeframer::consume(const uint8_t *data, size_t len, std::vector<TelemetryPacket> &out)
+{
+  CcsdsMetrics &m = ccsds_metrics();
+  size_t pos = 0;
+
+  while (len - pos >= kCaduSize)
+  {
+    if (get_u32(data + pos) != kAttachedSyncMarker)
+    {
+      // Hunt for the next marker, keeping a tail that might be the start of one
+      const void *hit = memmem(data + pos + 1, len - pos - 1, kAsmBytes, kAsmSize);
+      size_t next = hit ? static_cast<const uint8_t *>(hit) - data : len - (kAsmSize - 1);
+      skipped_bytes_ += next - pos;
+      m.skipped_bytes.add(next - pos);
+      pos = next;
+      continue;
+    }
+
+    const uint8_t *frame = data + pos + kAsmSize;
+    uint16_t id = get_u16(frame);
+    bool valid = (id >> 14) == 0 && ((id >> 4) & 0x3FF) == kSpacecraftId &&
+                 crc16_ccitt(frame, kTransferFrameSize - kFrameCrcSize) ==
+                     get_u16(frame + kTransferFrameSize - kFrameCrcSize);
+    if (!valid)
+    {
+      // The marker may have been a coincidence in the data; look again just past it
+      bad_frames_++;
+      m.bad_frames.add();
+      skipped_bytes_++;
+      m.skipped_bytes.add();
+      pos++;
+      continue;
+    }
+
+    process_frame(frame, out);
+    good_frames_++;
+    pos += kCaduSize;
+  }
+  return pos;
+}
+
+void CcsdsDeframer::process_frame(const uint8_t *frame, std::vector<TelemetryPacket> &out)
+{
+  uint8_t vc = (get_u16(frame) >> 1) & 0x7;
+  uint8_t count = frame[3];
+  uint16_t first_header = get_u16(frame + 4) & 0x7FF;
+
+  Channel &ch = channels_[vc];
+  CcsdsChannelStats &stats = stats_[vc];
+  CcsdsMetrics &m = ccsds_metrics();
+  stats.frames++;
+  m.frames[vc]->add();
+
+  if (!ch.seen)
+  {
+    ch.staging.resize(kSpacePacketHeaderSize + kMaxSpacePacketData);
+    ch.seen = true;
+  }
+  else if (count != ch.next_count)
+  {
+    // Frames went missing on this VC, so the packet in progress is broken
+    uint8_t lost = static_cast<uint8_t>(count - ch.next_count);
+    stats.lost_frames += lost;
+    m.lost_frames[vc]->add(lost);
+    ch.synced = false;
+  }
+  ch.next_count = static_cast<uint8_t>(count + 1);
+
+  if (first_header != kNoPacketStart && first_header >= kFrameDataSize)
+  {
+    ch.synced = false;
+    return;
+  }
+  // The pointer must agree with what is left of the packet in progress
+  // (unknown while that packet's header is itself split)
+  if (ch.synced && first_header != kNoPacketStart && (ch.have == 0 || ch.need > 0) &&
+      ch.need - ch.have != first_header)
+    ch.synced = false;
+
+  const uint8_t *field = frame + kFrameHeaderSize;
+  size_t pos = 0;
+  if (!ch.synced)
+  {
+    if (first_header == kNoPacketStart)
+      return;
+    ch.have = ch.need = 0;
+    ch.synced = true;
+    pos = first_header;
+  }
+
+  while (pos < kFrameDataSize && ch.synced)
+    pos += feed(ch, vc, field + pos, kFrameDataSize - pos, out);
+}
+
+size_t CcsdsDeframer::feed(Channel &ch, uint8_t vc, const uint8_t *data, size_t len, std::vector<TelemetryPacket> &out)
+{
+  // Fast path: a whole packet inside this frame is decoded in place
+  if (ch.have == 0 && len >= kSpacePacketHeaderSize)
+  {
+    size_t total = kSpacePacketHeaderSize + get_u16(data + 4) + 1;
+    if (total <= len)
+    {
+      emit(vc, data, total, out);
+      return total;
+    }
+  }
+
+  size_t used = 0;
+  if (ch.need == 0)
+  {
+    size_t n = std::min(kSpacePacketHeaderSize - ch.have, len);
+    std::memcpy(ch.staging.data() + ch.have, data, n);
+    ch.have += n;
+    used = n;
+    if (ch.have < kSpacePacketHeaderSize)
+      return used;
+    ch.need = kSpacePacketHeaderSize + get_u16(ch.staging.data() + 4) + 1;
+  }
+
+  size_t n = std::min(ch.need - ch.have, len - used);
+  std::memcpy(ch.staging.data() + ch.have, data + used, n);
+  ch.have += n;
+  used += n;
+  if (ch.have == ch.need)
+  {
+    emit(vc, ch.staging.data(), ch.need, out);
+    ch.have = ch.need = 0;
+  }
+  return used;
+}
+
+void CcsdsDeframer::emit(uint8_t vc, const uint8_t *packet, size_t len, std::vector<TelemetryPacket> &out)
+{
+  uint16_t apid = get_u16(packet) & 0x7FF;
+  const uint8_t *data = packet + kSpacePacketHeaderSize;
+  size_t data_len = len - kSpacePacketHeaderSize;
+
+  if (apid == kApidTelemetry && data_len == kPacketWireSize)
+  {
+    out.push_back(deserialise_from(data));
+    stats_[vc].packets++;
+  }
+  else if (apid == kApidColumnar && data_len > 2)
+  {
+    size_t count = get_u16(data);
+    size_t at = out.size();
+    out.resize(at + count);
+    try
+    {
+      decode_columnar(data + 2, data_len - 2, count, out.data() + at);
+      stats_[vc].packets += count;
+    }
+    catch (const std::exception &)
+    {
+      out.resize(at); // the CRC passed, so only a buggy sender gets here; drop the packet, keep the link
+    }
+  }
+  // Idle packets and unknown application ids are skipped
+}
+
+std::string CcsdsDeframer::summary(const std::string &prefix) const
+{
+  std::ostringstream out;
+  out << prefix << "CCSDS: " << good_frames_ << " good frames, " << bad_frames_ << " bad, " << skipped_bytes_
+      << " bytes skipped while resyncing\n";
+  for (uint8_t vc = 0; vc < kVirtualChannels; ++vc)
+    if (stats_[vc].frames > 0)
+      out << prefix << "  VC " << int(vc) << ": " << stats_[vc].frames << " frames, " << stats_[vc].packets
+          << " packets, " << stats_[vc].lost_frames << " frames lost\n";
+  return out.str();
+}
@@ -0,0 +1,353 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "../include/columnar_codec.h"
+
+namespace
+{
+  // MSB-first bit writer over a 64-bit accumulator
+  class BitWriter
+  {
+    std::vector<uint8_t> &out_;
+    uint64_t acc_ = 0;
+    unsigned bits_ = 0; // valid bits held in acc_, at most 63 between calls
+
+  public:
+    explicit BitWriter(std::vector<uint8_t> &out) : out_(out) {}
+
+    // Writes the low n bits of value, n <= 32
+    void put(uint32_t value, unsigned n)
+    {
+      if (n == 0)
+        return;
+      acc_ = (acc_ << n) | (value & (0xFFFFFFFFu >> (32 - n)));
+      bits_ += n;
+      while (bits_ >= 8)
+      {
+        bits_ -= 8;
+        out_.push_back(static_cast<uint8_t>(acc_ >> bits_));
+      }
+    }
+
+    void put64(uint64_t value)
+    {
+      put(static_cast<uint32_t>(value >> 32), 32);
+      put(static_cast<uint32_t>(value), 32);
+    }
+
+    void finish()
+    {
+      if (bits_ > 0)
+        out_.push_back(static_cast<uint8_t>(acc_ << (8 - bits_)));
+      bits_ = 0;
+    }
+  };
+
+  // MSB-first bit reader that refills a 64-bit window a byte at a time
+  class BitReader
+  {
+    const uint8_t *data_;
+    const uint8_t *end_;
+    uint64_t acc_ = 0;
+    unsigned bits_ = 0;
+
+    void refill(unsigned need)
+    {
+      while (bits_ < need)
+      {
+        if (data_ == end_)
+          throw std::runtime_error("Columnar decode: truncated input");
+        acc_ = (acc_ << 8) | *data_++;
+        bits_ += 8;
+      }
+    }
+
+  public:
+    BitReader(const uint8_t *data, size_t len) : data_(data), end_(data + len) {}
+
+    // Reads n bits, n <= 32
+    uint32_t get(unsigned n)
+    {
+      if (n == 0)
+        return 0;
+      refill(n);
+      bits_ -= n;
+      return static_cast<uint32_t>(acc_ >> bits_) & (0xFFFFFFFFu >> (32 - n));
+    }
+
+    bool bit() { return get(1) != 0; }
+
+    uint64_t get64()
+    {
+      uint64_t hi = get(32);
+      return (hi << 32) | get(32);
+    }
+  };
+
+  uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+  int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+  // Delta-of-delta buckets: control prefix, payload width
+  //   0                   dod == 0
+  //   10   + 7 bits       |zigzag| < 2^7
+  //   110  + 12 bits      |zigzag| < 2^12
+  //   1110 + 32 bits      |zigzag| < 2^32
+  //   1111 + 64 bits      anything else
+  void put_dod(BitWriter &w, int64_t dod)
+  {
+    uint64_t z = zigzag(dod);
+    if (z == 0)
+      w.put(0b0, 1);
+    else if (z < (1u << 7))
+    {
+      w.put(0b10, 2);
+      w.put(static_cast<uint32_t>(z), 7);
+    }
+    else if (z < (1u << 12))
+    {
+      w.put(0b110, 3);
+      w.put(static_cast<uint32_t>(z), 12);
+    }
+    else if (z >> 32 == 0)
+    {
+      w.put(0b1110, 4);
+      w.put(static_cast<uint32_t>(z), 32);
+    }
+    else
+    {
+      w.put(0b1111, 4);
+      w.put64(z);
+    }
+  }
+
+  int64_t get_dod(BitReader &r)
+  {
+    if (!r.bit())
+      return 0;
+    if (!r.bit())
+      return unzigzag(r.get(7));
+    if (!r.bit())
+      return unzigzag(r.get(12));
+    if (!r.bit())
+      return unzigzag(r.get(32));
+    return unzigzag(r.get64());
+  }
+
+  template <typename Col>
+  void encode_timestamps(BitWriter &w, const TelemetryPacket *pkts, size_t count, Col col)
+  {
+    w.put64(col.get(pkts[0]));
+    uint64_t prev = col.get(pkts[0]);
+    int64_t prev_delta = 0;
+    for (size_t i = 1; i < count; ++i)
+    {
+      // Unsigned arithmetic so arbitrary timestamp jumps wrap instead of overflowing
+      int64_t delta = static_cast<int64_t>(col.get(pkts[i]) - prev);
+      put_dod(w, static_cast<int64_t>(static_cast<uint64_t>(delta) - static_cast<uint64_t>(prev_delta)));
+      prev = col.get(pkts[i]);
+      prev_delta = delta;
+    }
+  }
+
+  template <typename Col>
+  void decode_timestamps(BitReader &r, TelemetryPacket *out, size_t count, Col col)
+  {
+    uint64_t prev = r.get64();
+    col.get(out[0]) = prev;
+    uint64_t prev_delta = 0;
+    for (size_t i = 1; i < count; ++i)
+    {
+      prev_delta += static_cast<uint64_t>(get_dod(r));
+      prev += prev_delta;
+      col.get(out[i]) = prev;
+    }
+  }
+
+  uint32_t float_bits(float f)
+  {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+  }
+
+  float bits_float(uint32_t u)
+  {
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+  }
+
+  // Gorilla XOR encoding of one float column
+  //   0                                 same value as before
+  //   10 + meaningful bits              fits inside the previous leading/trailing window
+  //   11 + 5b leading + 5b (len - 1) + meaningful bits
+  template <typename Col>
+  void encode_floats(BitWriter &w, const TelemetryPacket *pkts, size_t count, Col col)
+  {
+    uint32_t prev = float_bits(col.get(pkts[0]));
+    w.put(prev, 32);
+
+    unsigned lead = 33, trail = 0; // 33: no window established yet
+    for (size_t i = 1; i < count; ++i)
+    {
+      uint32_t cur = float_bits(col.get(pkts[i]));
+      uint32_t x = cur ^ prev;
+      prev = cur;
+
+      if (x == 0)
+      {
+        w.put(0b0, 1);
+        continue;
+      }
+
+      unsigned l = __builtin_clz(x);
+      unsigned t = __builtin_ctz(x);
+      if (l > 31)
+        l = 31;
+
+      if (lead <= 32 && l >= lead && t >= trail)
+      {
+        w.put(0b10, 2);
+        w.put(x >> trail, 32 - lead - trail);
+      }
+      else
+      {
+        unsigned len = 32 - l - t;
+        w.put(0b11, 2);
+        w.put(l, 5);
+        w.put(len - 1, 5);
+        w.put(x >> t, len);
+        lead = l;
+        trail = t;
+      }
+    }
+  }
+
+  template <typename Col>
+  void decode_floats(BitReader &r, TelemetryPacket *out, size_t count, Col col)
+  {
+    uint32_t prev = r.get(32);
+    col.get(out[0]) = bits_float(prev);
+
+    unsigned lead = 0, trail = 0;
+    for (size_t i = 1; i < count; ++i)
+    {
+      if (r.bit())
+      {
+        if (r.bit())
+        {
+          lead = r.get(5);
+          unsigned len = r.get(5) + 1;
+          if (lead + len > 32)
+            throw std::runtime_error("Columnar decode: corrupt float window");
+          trail = 32 - lead - len;
+        }
+        prev ^= r.get(32 - lead - trail) << trail;
+      }
+      col.get(out[i]) = bits_float(prev);
+    }
+  }
+
+  // u32 identifier column, almost always one value per batch
+  //   first value, 32 bits
+  //   0                                 every packet has it
+  //   1 + per packet: 0 same as before, 1 + 32 bits new value
+  template <typename Col>
+  void encode_ids(BitWriter &w, const TelemetryPacket *pkts, size_t count, Col col)
+  {
+    uint32_t prev = col.get(pkts[0]);
+    w.put(prev, 32);
+    size_t i = 1;
+    while (i < count && col.get(pkts[i]) == prev)
+      ++i;
+    w.put(i < count, 1);
+    if (i == count)
+      return;
+    for (i = 1; i < count; ++i)
+    {
+      uint32_t cur = col.get(pkts[i]);
+      w.put(cur != prev, 1);
+      if (cur != prev)
+        w.put(cur, 32);
+      prev = cur;
+    }
+  }
+
+  template <typename Col>
+  void decode_ids(BitReader &r, TelemetryPacket *out, size_t count, Col col)
+  {
+    uint32_t prev = r.get(32);
+    bool varies = r.bit();
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (varies && i > 0 && r.bit())
+        prev = r.get(32);
+      col.get(out[i]) = prev;
+    }
+  }
+
+  // Columns go in Schema<TelemetryPacket> order: the u64 timestamp as
+  // delta-of-delta, every float as XOR, the u32 source as runs
+  template <typename Col>
+  void encode_column(BitWriter &w, const TelemetryPacket *pkts, size_t count, Col col)
+  {
+    using T = typename Col::Type;
+    static_assert(std::is_same_v<T, uint64_t> || std::is_same_v<T, float> || std::is_same_v<T, uint32_t>,
+                  "no columnar encoding for this type");
+    if constexpr (std::is_same_v<T, uint64_t>)
+      encode_timestamps(w, pkts, count, col);
+    else if constexpr (std::is_same_v<T, uint32_t>)
+      encode_ids(w, pkts, count, col);
+    else
+      encode_floats(w, pkts, count, col);
+  }
+
+  template <typename Col>
+  void decode_column(BitReader &r, TelemetryPacket *out, size_t count, Col col)
+  {
+    using T = typename Col::Type;
+    if constexpr (std::is_same_v<T, uint64_t>)
+      decode_timestamps(r, out, count, col);
+    else if constexpr (std::is_same_v<T, uint32_t>)
+      decode_ids(r, out, count, col);
+    else
+      decode_floats(r, out, count, col);
+  }
+}
+
+void encode_columnar(const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out)
+{
+  if (count == 0)
+    return;
+
+  // Typical batches land well under 32 bytes per packet
+  out.reserve(out.size() + 16 + count * 32);
+  BitWriter w(out);
+  for_each_column<TelemetryPacket>([&](auto col)
+                                   { encode_column(w, pkts, count, col); });
+  w.finish();
+}
+
+void decode_columnar(const uint8_t *data, size_t len, size_t count, TelemetryPacket *out)
+{
+  if (count == 0)
+    return;
+
+  BitReader r(data, len);
+  for_each_column<TelemetryPacket>([&](auto col)
+                                   { decode_column(r, out, count, col); });
+}
+
+std::vector<uint8_t> encode_columnar(const std::vector<TelemetryPacket> &pkts)
+{
+  std::vector<uint8_t> out;
+  encode_columnar(pkts.data(), pkts.size(), out);
+  return out;
+}
+
+std::vector<TelemetryPacket> decode_columnar(const std::vector<uint8_t> &input, size_t count)
+{
+  std::vector<TelemetryPacket> out(count);
+  decode_columnar(input.data(), input.size(), count, out.data());
+  return out;
+}
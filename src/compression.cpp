@@ -1,43 +1,420 @@
 #include <vector>
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
 #include <zlib.h>
 #include <stdexcept>
 
 #include "../include/telemetry.h"
+#include "../include/compression.h"
+#include "../include/metrics.h"
+
+void serialise_into(const TelemetryPacket &pkt, uint8_t *out)
+{
+  encode_packed(pkt, out);
+}
+
+TelemetryPacket deserialise_from(const uint8_t *in)
+{
+  return decode_packed<TelemetryPacket>(in);
+}
+
+void deserialise_into(const uint8_t *in, TelemetryPacket &pkt)
+{
+  decode_packed(in, pkt);
+}
 
 std::vector<uint8_t> serialise(const TelemetryPacket &pkt)
 {
-  std::vector<uint8_t> data(sizeof(pkt));
-  std::memcpy(data.data(), &pkt, sizeof(pkt));
+  std::vector<uint8_t> data(kPacketWireSize);
+  serialise_into(pkt, data.data());
   return data;
 }
 
 TelemetryPacket deserialise(const std::vector<uint8_t> &data)
 {
-  TelemetryPacket pkt{};
-  std::memcpy(&pkt, data.data(), sizeof(pkt));
-  return pkt;
+  return deserialise_from(data.data());
 }
 
-std::vector<uint8_t> compress_data(const std::vector<uint8_t> &input)
+namespace
+{
+  constexpr uint8_t kTagNone = 0x00;
+  constexpr uint8_t kTagDictionary = 0x01;
+  constexpr size_t kDictionaryHeader = 3; // tag and dictionary id
+  constexpr size_t kMaxDictionary = 32 * 1024; // deflate's window
+  constexpr size_t kMaxTrainPackets = 200000;
+
+  uint64_t thread_cpu_ns()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+  }
+
+  ZlibCodec &default_codec()
+  {
+    thread_local ZlibCodec codec;
+    return codec;
+  }
+}
+
+uint16_t dictionary_id(const CompressionDictionary &dictionary)
+{
+  uLong sum = adler32(adler32(0L, Z_NULL, 0), dictionary.data(), static_cast<uInt>(dictionary.size()));
+  return static_cast<uint16_t>(sum);
+}
+
+Codec::Codec(std::shared_ptr<const CompressionDictionary> dictionary) : dictionary_(std::move(dictionary))
+{
+  if (dictionary_)
+    dictionary_id_ = dictionary_id(*dictionary_);
+}
+
+Codec::~Codec()
 {
-  uLongf out_size = compressBound(input.size());
-  std::vector<uint8_t> output(out_size);
+  if (inflating_)
+    inflateEnd(&inflate_);
+}
+
+void Codec::decompress(const uint8_t *in, size_t len, uint8_t *out, size_t out_len)
+{
+  if (len == 0)
+    throw std::runtime_error("Decompression failed: empty payload");
+  if (in[0] == kTagNone)
+  {
+    if (len - 1 != out_len)
+      throw std::runtime_error("Decompression failed: payload size mismatch");
+    std::memcpy(out, in + 1, out_len);
+    return;
+  }
+
+  bool primed = in[0] == kTagDictionary;
+  if (primed && !dictionary_)
+    throw std::runtime_error("Decompression failed: payload needs a dictionary");
+  if (primed && (len < kDictionaryHeader || (in[1] | in[2] << 8) != dictionary_id_))
+    throw std::runtime_error("Decompression failed: payload made with another dictionary");
+  if (!primed && (in[0] & 0x0F) != Z_DEFLATED)
+    throw std::runtime_error("Decompression failed: unknown payload");
 
-  if (compress(output.data(), &out_size, input.data(), input.size()) != Z_OK)
+  // One stream for both: zlib framing on a plain payload, raw deflate after the tag
+  int window_bits = primed ? -15 : 15;
+  if (!inflating_)
+  {
+    if (inflateInit2(&inflate_, window_bits) != Z_OK)
+      throw std::runtime_error("inflateInit2 failed");
+    inflating_ = true;
+  }
+  else if (inflateReset2(&inflate_, window_bits) != Z_OK)
+    throw std::runtime_error("inflateReset2 failed");
+  if (primed && inflateSetDictionary(&inflate_, dictionary_->data(), static_cast<uInt>(dictionary_->size())) != Z_OK)
+    throw std::runtime_error("inflateSetDictionary failed");
+
+  uint8_t spare;
+  size_t header = primed ? kDictionaryHeader : 0;
+  inflate_.next_in = const_cast<Bytef *>(in + header);
+  inflate_.avail_in = static_cast<uInt>(len - header);
+  inflate_.next_out = out_len ? out : &spare;
+  inflate_.avail_out = static_cast<uInt>(out_len);
+  if (inflate(&inflate_, Z_FINISH) != Z_STREAM_END || inflate_.avail_out != 0 || inflate_.avail_in != 0)
+    throw std::runtime_error("Decompression failed");
+}
+
+void NoneCodec::compress(const uint8_t *in, size_t len, std::vector<uint8_t> &out)
+{
+  out.push_back(kTagNone);
+  out.insert(out.end(), in, in + len);
+}
+
+ZlibCodec::ZlibCodec(int level, std::shared_ptr<const CompressionDictionary> dictionary)
+    : Codec(std::move(dictionary)), level_(level)
+{
+  if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION)
+    throw std::invalid_argument("Compression level must be 0-9");
+}
+
+ZlibCodec::~ZlibCodec()
+{
+  if (deflating_)
+    deflateEnd(&deflate_);
+}
+
+void ZlibCodec::compress(const uint8_t *in, size_t len, std::vector<uint8_t> &out)
+{
+  if (!deflating_)
+  {
+    if (deflateInit2(&deflate_, level_, Z_DEFLATED, dictionary_ ? -15 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      throw std::runtime_error("deflateInit2 failed");
+    deflating_ = true;
+  }
+  else if (deflateReset(&deflate_) != Z_OK)
+    throw std::runtime_error("deflateReset failed");
+
+  if (dictionary_)
+  {
+    out.push_back(kTagDictionary);
+    out.push_back(static_cast<uint8_t>(dictionary_id_));
+    out.push_back(static_cast<uint8_t>(dictionary_id_ >> 8));
+    if (deflateSetDictionary(&deflate_, dictionary_->data(), static_cast<uInt>(dictionary_->size())) != Z_OK)
+      throw std::runtime_error("deflateSetDictionary failed");
+  }
+
+  size_t start = out.size();
+  out.resize(start + deflateBound(&deflate_, len));
+  deflate_.next_in = const_cast<Bytef *>(in);
+  deflate_.avail_in = static_cast<uInt>(len);
+  deflate_.next_out = out.data() + start;
+  deflate_.avail_out = static_cast<uInt>(out.size() - start);
+  if (deflate(&deflate_, Z_FINISH) != Z_STREAM_END)
     throw std::runtime_error("Compression failed");
+  out.resize(out.size() - deflate_.avail_out);
+}
 
-  output.resize(out_size);
-  return output;
+AdaptiveCodec::AdaptiveCodec(uint64_t link_rate, int level, std::shared_ptr<const CompressionDictionary> dictionary)
+    : Codec(std::move(dictionary)), wire_ns_per_byte_(link_rate ? 1e9 / static_cast<double>(link_rate) : 0.0)
+{
+  candidates_.push_back({std::make_unique<NoneCodec>()});
+  candidates_.push_back({std::make_unique<ZlibCodec>(level)});
+  if (dictionary_ && !dictionary_->empty())
+    candidates_.push_back({std::make_unique<ZlibCodec>(level, dictionary_)});
+  for (Candidate &c : candidates_)
+    c.payloads = &metrics().counter("telemetry_adaptive_codec_payloads_total", "Payloads the adaptive codec sent through each codec",
+                                    std::string("codec=\"") + c.codec->name() + "\"");
+}
+
+void AdaptiveCodec::compress(const uint8_t *in, size_t len, std::vector<uint8_t> &out)
+{
+  // Every candidate twice to begin with: the first payload sets up its stream,
+  // the second is timed. After that every kProbeEvery-th goes to the next one.
+  const size_t n = candidates_.size();
+  bool starting = payloads_ < 2 * n;
+  bool probe = starting || payloads_ % kProbeEvery == 0;
+  size_t pick = starting ? payloads_ % n : probe ? (payloads_ / kProbeEvery) % n : current_;
+  bool timed = payloads_ >= n && (probe || payloads_ % kTimeEvery == 0);
+  ++payloads_;
+
+  Candidate &c = candidates_[pick];
+  size_t start = out.size();
+  uint64_t t0 = timed ? thread_cpu_ns() : 0;
+  c.codec->compress(in, len, out);
+  c.payloads->add();
+  if (!timed || len == 0)
+    return;
+
+  // Smoothed, so one payload that lost the CPU halfway does not decide
+  constexpr double kWeight = 0.25;
+  double cpu = static_cast<double>(thread_cpu_ns() - t0) / len;
+  double ratio = static_cast<double>(out.size() - start) / len;
+  c.cpu_ns_per_byte = c.measured ? c.cpu_ns_per_byte + kWeight * (cpu - c.cpu_ns_per_byte) : cpu;
+  c.ratio = c.measured ? c.ratio + kWeight * (ratio - c.ratio) : ratio;
+  c.measured = true;
+  choose();
+}
+
+void AdaptiveCodec::choose()
+{
+  double best = std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < candidates_.size(); ++i)
+  {
+    const Candidate &c = candidates_[i];
+    double cost = c.cpu_ns_per_byte + c.ratio * wire_ns_per_byte_;
+    if (c.measured && cost < best)
+    {
+      best = cost;
+      current_ = i;
+    }
+  }
+}
+
+std::unique_ptr<Codec> make_codec(const CompressionConfig &config, uint64_t link_rate)
+{
+  switch (config.mode)
+  {
+  case CompressionMode::None:
+    return std::make_unique<NoneCodec>();
+  case CompressionMode::Dictionary:
+    if (!config.dictionary || config.dictionary->empty())
+      throw std::invalid_argument("Dictionary compression needs a dictionary");
+    return std::make_unique<ZlibCodec>(config.level, config.dictionary);
+  case CompressionMode::Adaptive:
+    return std::make_unique<AdaptiveCodec>(link_rate, config.level, config.dictionary);
+  default:
+    return std::make_unique<ZlibCodec>(config.level);
+  }
+}
+
+CompressionMode parse_compression_mode(const std::string &name)
+{
+  if (name == "none")
+    return CompressionMode::None;
+  if (name == "zlib")
+    return CompressionMode::Zlib;
+  if (name == "dict")
+    return CompressionMode::Dictionary;
+  if (name == "adaptive")
+    return CompressionMode::Adaptive;
+  throw std::invalid_argument("Unknown compression: " + name);
+}
+
+CompressionDictionary train_dictionary(const TelemetryPacket *pkts, size_t count, size_t size)
+{
+  // Deflate matches are 3 bytes or more and barely pay off at 3, so every
+  // 4-byte window of every packet is counted, over evenly spaced packets
+  constexpr size_t kWindow = 4;
+  size = std::min(size, kMaxDictionary);
+  size_t step = std::max<size_t>(count / kMaxTrainPackets, 1);
+  std::unordered_map<uint32_t, uint64_t> counts;
+  uint8_t raw[kPacketWireSize];
+  for (size_t i = 0; i < count; i += step)
+  {
+    serialise_into(pkts[i], raw);
+    for (size_t at = 0; at + kWindow <= kPacketWireSize; ++at)
+    {
+      uint32_t window;
+      std::memcpy(&window, raw + at, kWindow);
+      counts[window]++;
+    }
+  }
+
+  // Most frequent first, ties by value so the same captures give the same dictionary
+  std::vector<std::pair<uint64_t, uint32_t>> ranked;
+  for (auto [window, n] : counts)
+    if (n > 1)
+      ranked.push_back({n, window});
+  std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b)
+            { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+  ranked.resize(std::min(ranked.size(), size / kWindow));
+
+  CompressionDictionary dictionary(ranked.size() * kWindow);
+  for (size_t i = 0; i < ranked.size(); ++i)
+    std::memcpy(dictionary.data() + dictionary.size() - (i + 1) * kWindow, &ranked[i].second, kWindow);
+  return dictionary;
+}
+
+CompressionDictionary load_dictionary(const std::string &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("Cannot read dictionary " + path);
+  CompressionDictionary dictionary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (dictionary.empty())
+    throw std::runtime_error("Dictionary " + path + " is empty");
+  return dictionary;
+}
+
+void save_dictionary(const std::string &path, const CompressionDictionary &dictionary)
+{
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(dictionary.data()), static_cast<std::streamsize>(dictionary.size()));
+  if (!out)
+    throw std::runtime_error("Cannot write dictionary " + path);
+}
+
+std::vector<uint8_t> compress_data(const std::vector<uint8_t> &input)
+{
+  return compress_data(input, default_codec());
 }
 
 std::vector<uint8_t> decompress_data(const std::vector<uint8_t> &input, size_t expected_size)
 {
-  std::vector<uint8_t> output(expected_size);
+  return decompress_data(input, expected_size, default_codec());
+}
 
-  if (uncompress(output.data(), &expected_size, input.data(), input.size()) != Z_OK)
-    throw std::runtime_error("Decompression failed");
+std::vector<uint8_t> compress_data(const std::vector<uint8_t> &input, Codec &codec)
+{
+  std::vector<uint8_t> output;
+  output.reserve(input.size() + 16);
+  codec.compress(input.data(), input.size(), output);
+  return output;
+}
 
+std::vector<uint8_t> decompress_data(const std::vector<uint8_t> &input, size_t expected_size, Codec &codec)
+{
+  std::vector<uint8_t> output(expected_size);
+  codec.decompress(input.data(), input.size(), output.data(), expected_size);
   return output;
-}
\ No newline at end of file
+}
+
+namespace
+{
+  constexpr uint8_t kSyncFlushTail[4] = {0x00, 0x00, 0xFF, 0xFF};
+}
+
+DeflateStream::DeflateStream(int level)
+{
+  // Negative window bits: raw deflate, no zlib header or adler32 trailer
+  if (deflateInit2(&zs_, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw std::runtime_error("deflateInit2 failed");
+}
+
+DeflateStream::~DeflateStream()
+{
+  deflateEnd(&zs_);
+}
+
+void DeflateStream::compress_chunk(const uint8_t *data, size_t len, std::vector<uint8_t> &out)
+{
+  size_t start = out.size();
+  // deflateBound covers a fresh stream; add room for the flush block and stored-block headers
+  out.resize(start + deflateBound(&zs_, len) + 16);
+
+  zs_.next_in = const_cast<Bytef *>(data);
+  zs_.avail_in = static_cast<uInt>(len);
+  size_t produced = 0;
+  // The flush is only complete once deflate leaves room to spare; should the
+  // estimate ever fall short, grow the output and carry on
+  do
+  {
+    if (produced == out.size() - start)
+      out.resize(out.size() + std::max<size_t>(len / 2, 64));
+    zs_.next_out = out.data() + start + produced;
+    zs_.avail_out = static_cast<uInt>(out.size() - start - produced);
+    int rc = deflate(&zs_, Z_SYNC_FLUSH);
+    produced = out.size() - start - zs_.avail_out;
+    if (rc != Z_OK && rc != Z_BUF_ERROR)
+      throw std::runtime_error("Compression failed");
+  } while (zs_.avail_out == 0);
+  if (zs_.avail_in != 0)
+    throw std::runtime_error("Compression failed");
+
+  if (produced >= 4 && std::memcmp(out.data() + start + produced - 4, kSyncFlushTail, 4) == 0)
+    produced -= 4;
+  out.resize(start + produced);
+}
+
+InflateStream::InflateStream()
+{
+  if (inflateInit2(&zs_, -15) != Z_OK)
+    throw std::runtime_error("inflateInit2 failed");
+}
+
+InflateStream::~InflateStream()
+{
+  inflateEnd(&zs_);
+}
+
+void InflateStream::decompress_chunk(const uint8_t *data, size_t len, uint8_t *out, size_t out_len)
+{
+  zs_.next_out = out;
+  zs_.avail_out = static_cast<uInt>(out_len);
+
+  auto feed = [&](const uint8_t *in, size_t in_len)
+  {
+    zs_.next_in = const_cast<Bytef *>(in);
+    zs_.avail_in = static_cast<uInt>(in_len);
+    int rc = inflate(&zs_, Z_SYNC_FLUSH);
+    // Z_BUF_ERROR only means no progress was possible, e.g. an empty marker block
+    if (rc != Z_OK && rc != Z_BUF_ERROR)
+      throw std::runtime_error("Decompression failed");
+  };
+
+  feed(data, len);
+  feed(kSyncFlushTail, sizeof(kSyncFlushTail));
+
+  if (zs_.avail_out != 0 || zs_.avail_in != 0)
+    throw std::runtime_error("Decompression failed: chunk size mismatch");
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+
+#include "../include/decode_pipeline.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  struct PipelineMetrics
+  {
+    Counter &steals = metrics().counter("telemetry_pipeline_steals_total", "Frames a decode worker took from another worker's queue");
+    Gauge &in_flight = metrics().gauge("telemetry_pipeline_frames_in_flight", "Frames received but not yet delivered");
+  };
+
+  PipelineMetrics &pipeline_metrics()
+  {
+    static PipelineMetrics m;
+    return m;
+  }
+}
+
+DecodePipeline::DecodePipeline(const LinkConfig &config, Deliver deliver)
+    : deliver_(std::move(deliver)), serial_decoder_(config), independent_(serial_decoder_.independent_frames()),
+      slots_(std::max<size_t>(config.decode_queue, 1))
+{
+  if (config.decode_workers == 0)
+    return;
+
+  for (size_t i = 0; i < config.decode_workers; ++i)
+  {
+    workers_.push_back(std::make_unique<Worker>());
+    workers_.back()->decoder = std::make_unique<FrameDecoder>(config);
+  }
+  for (size_t i = 0; i < workers_.size(); ++i)
+    workers_[i]->thread = std::thread(&DecodePipeline::work, this, i);
+  reorder_ = std::thread(&DecodePipeline::reorder, this);
+}
+
+DecodePipeline::~DecodePipeline()
+{
+  finish();
+}
+
+void DecodePipeline::decode(FrameDecoder &decoder, Slot &slot, const uint8_t *payload)
+{
+  slot.packets.clear();
+  slot.error.clear();
+  try
+  {
+    decoder.decode(slot.header, payload, slot.packets);
+  }
+  catch (const std::exception &e)
+  {
+    slot.error = e.what();
+  }
+}
+
+void DecodePipeline::complete(Slot &slot)
+{
+  slot.done.store(true);
+  // Taking the lock orders the store before a reorder thread that is about to wait
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+  }
+  cv_done_.notify_one();
+}
+
+bool DecodePipeline::submit(const FrameHeader &header, const uint8_t *payload)
+{
+  if (workers_.empty())
+  {
+    Slot &slot = slots_[0];
+    slot.header = header;
+    decode(serial_decoder_, slot, payload);
+    if (!slot.error.empty())
+    {
+      error_ = slot.error;
+      return false;
+    }
+    deliver_(slot.packets.data(), slot.packets.size());
+    return true;
+  }
+
+  uint64_t seq;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_space_.wait(lock, [&]
+                   { return submitted_ - delivered_ < slots_.size() || !error_.empty(); });
+    if (!error_.empty())
+      return false;
+    seq = submitted_++;
+  }
+  pipeline_metrics().in_flight.add(1);
+
+  Slot &slot = slots_[seq % slots_.size()];
+  slot.header = header;
+  if (!independent_)
+  {
+    decode(serial_decoder_, slot, payload);
+    complete(slot);
+    return true;
+  }
+
+  slot.payload.assign(payload, payload + header.payload_len);
+  size_t target = seq % workers_.size();
+  Worker &worker = *workers_[target];
+  bool waits;
+  {
+    std::lock_guard<std::mutex> lock(worker.mtx);
+    worker.jobs.push_back(seq);
+    waits = !worker.parked || worker.jobs.size() > 1;
+  }
+  worker.cv.notify_one();
+  // Queued behind a busy worker: better taken by one with nothing to do
+  if (waits)
+    nudge_idle(target);
+  return true;
+}
+
+void DecodePipeline::nudge_idle(size_t busy)
+{
+  for (size_t i = 1; i < workers_.size(); ++i)
+  {
+    Worker &w = *workers_[(busy + i) % workers_.size()];
+    {
+      std::lock_guard<std::mutex> lock(w.mtx);
+      if (!w.parked || w.nudged || !w.jobs.empty())
+        continue;
+      w.nudged = true;
+    }
+    w.cv.notify_one();
+    return;
+  }
+}
+
+bool DecodePipeline::take(size_t self, uint64_t &seq)
+{
+  {
+    Worker &own = *workers_[self];
+    std::lock_guard<std::mutex> lock(own.mtx);
+    if (!own.jobs.empty())
+    {
+      seq = own.jobs.front();
+      own.jobs.pop_front();
+      return true;
+    }
+  }
+  // Steal the newest job of the next busy worker; its oldest is what it is about to start on
+  for (size_t i = 1; i < workers_.size(); ++i)
+  {
+    Worker &victim = *workers_[(self + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mtx);
+    if (!victim.jobs.empty())
+    {
+      seq = victim.jobs.back();
+      victim.jobs.pop_back();
+      steals_.fetch_add(1, std::memory_order_relaxed);
+      pipeline_metrics().steals.add();
+      return true;
+    }
+  }
+  return false;
+}
+
+void DecodePipeline::work(size_t self)
+{
+  Worker &own = *workers_[self];
+  while (true)
+  {
+    uint64_t seq;
+    if (take(self, seq))
+    {
+      Slot &slot = slots_[seq % slots_.size()];
+      decode(*own.decoder, slot, slot.payload.data());
+      complete(slot);
+      continue;
+    }
+
+    // Nothing here or to steal: park until a job is queued here, another
+    // worker's backlog needs a hand, or the pipeline stops
+    std::unique_lock<std::mutex> lock(own.mtx);
+    own.parked = true;
+    own.cv.wait(lock, [&]
+                { return !own.jobs.empty() || own.nudged || stop_.load(); });
+    own.parked = false;
+    own.nudged = false;
+    if (own.jobs.empty() && stop_.load())
+      return;
+  }
+}
+
+void DecodePipeline::reorder()
+{
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (true)
+  {
+    cv_done_.wait(lock, [&]
+                  { return (delivered_ < submitted_ && slots_[delivered_ % slots_.size()].done.load()) ||
+                           (finishing_ && delivered_ == submitted_); });
+    if (delivered_ == submitted_)
+      return;
+
+    Slot &slot = slots_[delivered_ % slots_.size()];
+    if (!slot.error.empty())
+    {
+      // Nothing after a bad frame can be trusted on a stream link, so it and
+      // everything queued behind it leave the in-flight count undelivered
+      error_ = slot.error;
+      pipeline_metrics().in_flight.add(-static_cast<int64_t>(submitted_ - delivered_));
+      cv_space_.notify_all();
+      return;
+    }
+
+    lock.unlock();
+    deliver_(slot.packets.data(), slot.packets.size());
+    slot.done.store(false);
+    pipeline_metrics().in_flight.add(-1);
+    lock.lock();
+    delivered_++;
+    cv_space_.notify_one();
+  }
+}
+
+bool DecodePipeline::finish()
+{
+  if (reorder_.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      finishing_ = true;
+    }
+    cv_done_.notify_all();
+    reorder_.join();
+
+    stop_ = true;
+    for (auto &worker : workers_)
+    {
+      // Under the worker's lock, so one about to park sees stop_
+      {
+        std::lock_guard<std::mutex> lock(worker->mtx);
+      }
+      worker->cv.notify_one();
+    }
+    for (auto &worker : workers_)
+      worker->thread.join();
+  }
+  return error_.empty();
+}
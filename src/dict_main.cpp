@@ -0,0 +1,150 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#include "../include/compression.h"
+#include "../include/archive.h"
+#include "../include/logger.h"
+
+// Builds and checks the preset dictionary for --compress dict from captured logs
+static void usage(const char *prog)
+{
+  std::cout << "Usage:\n"
+            << "  " << prog << " train <out.dict> [--size N] [capture...]   dictionary of N bytes (default 1024)\n"
+            << "  " << prog << " eval <in.dict> [--level N] [capture...]    bytes and time per single packet, by codec\n"
+            << "  Captures are CSV logs or .tlm archives; without any, every one in logs/ is read.\n";
+}
+
+static bool ends_with(const std::string &s, const std::string &suffix)
+{
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void load_capture(const std::string &path, std::vector<TelemetryPacket> &out)
+{
+  if (ends_with(path, ".tlm"))
+  {
+    ArchiveReader reader(path);
+    std::vector<TelemetryPacket> rows = reader.query(0, ~0ull);
+    out.insert(out.end(), rows.begin(), rows.end());
+    return;
+  }
+
+  read_csv_log(path, [&](const TelemetryPacket &pkt)
+               { out.push_back(pkt); });
+}
+
+static std::vector<TelemetryPacket> load_captures(std::vector<std::string> paths)
+{
+  if (paths.empty())
+  {
+    namespace fs = std::filesystem;
+    if (fs::is_directory("logs"))
+      for (const auto &entry : fs::directory_iterator("logs"))
+        if (ends_with(entry.path().string(), ".csv") || ends_with(entry.path().string(), ".tlm"))
+          paths.push_back(entry.path().string());
+    std::sort(paths.begin(), paths.end());
+  }
+
+  std::vector<TelemetryPacket> packets;
+  for (const std::string &path : paths)
+  {
+    size_t before = packets.size();
+    load_capture(path, packets);
+    std::cout << path << ": " << packets.size() - before << " packets\n";
+  }
+  if (packets.empty())
+    throw std::runtime_error("No packets in the captures");
+  return packets;
+}
+
+// Every packet through codec on its own, as PerPacket frames carry them
+static void eval_codec(Codec &codec, const std::vector<TelemetryPacket> &packets)
+{
+  std::vector<uint8_t> raw(kPacketWireSize), back(kPacketWireSize), payload;
+  size_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const TelemetryPacket &pkt : packets)
+  {
+    serialise_into(pkt, raw.data());
+    payload.clear();
+    codec.compress(raw.data(), raw.size(), payload);
+    codec.decompress(payload.data(), payload.size(), back.data(), back.size());
+    if (back != raw)
+      throw std::runtime_error(std::string(codec.name()) + " did not round-trip");
+    bytes += payload.size();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "  " << codec.name() << ": " << static_cast<double>(bytes) / packets.size() << " bytes/packet, "
+            << seconds * 1e6 / packets.size() << " us/packet compress+decompress\n";
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string cmd = argv[1], dict_path = argv[2];
+  size_t size = 1024;
+  int level = Z_DEFAULT_COMPRESSION;
+  std::vector<std::string> captures;
+  for (int i = 3; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "--size" && i + 1 < argc)
+      size = std::stoul(argv[++i]);
+    else if (arg == "--level" && i + 1 < argc)
+      level = std::stoi(argv[++i]);
+    else
+      captures.push_back(arg);
+  }
+
+  try
+  {
+    if (cmd == "train")
+    {
+      std::vector<TelemetryPacket> packets = load_captures(captures);
+      CompressionDictionary dictionary = train_dictionary(packets.data(), packets.size(), size);
+      save_dictionary(dict_path, dictionary);
+      std::cout << dictionary.size() << " byte dictionary from " << packets.size() << " packets written to " << dict_path
+                << "\n";
+    }
+    else if (cmd == "eval")
+    {
+      auto dictionary = std::make_shared<const CompressionDictionary>(load_dictionary(dict_path));
+      std::vector<TelemetryPacket> packets = load_captures(captures);
+      // Evenly spaced, so a long capture does not take minutes
+      const size_t kMaxPackets = 100000;
+      if (packets.size() > kMaxPackets)
+      {
+        for (size_t i = 0; i < kMaxPackets; ++i)
+          packets[i] = packets[i * packets.size() / kMaxPackets];
+        packets.resize(kMaxPackets);
+      }
+      std::cout << packets.size() << " packets of " << kPacketWireSize << " bytes, one per payload:\n";
+      NoneCodec none;
+      ZlibCodec zlib(level), primed(level, dictionary);
+      eval_codec(none, packets);
+      eval_codec(zlib, packets);
+      eval_codec(primed, packets);
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,244 @@
+#include <cmath>
+#include <thread>
+#include <algorithm>
+
+#include "../include/fleet.h"
+
+namespace
+{
+  constexpr double kPi = 3.14159265358979323846;
+  constexpr double kReferenceRadius = 7000.0; // km, same orbit as PositionSensor
+  constexpr double kReferencePeriod = 5400.0; // s
+
+  // Noise channels, one independent stream each
+  enum Channel : uint32_t
+  {
+    kTemperature,
+    kRadiation,
+    kBattery,
+    kPitch,
+    kRoll,
+    kYaw,
+    kPhase, // initial orbital angle
+    kRadius,
+  };
+
+  uint64_t splitmix64(uint64_t x)
+  {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  // Key for one (tick, channel) stream; vehicles index into it
+  uint32_t stream_key(uint64_t seed, uint64_t tick, uint32_t channel)
+  {
+    return static_cast<uint32_t>(splitmix64(seed ^ splitmix64(tick * 16 + channel)) >> 32);
+  }
+
+  // 32-bit integer hash (lowbias32); only 32-bit multiplies, so it vectorizes
+  inline uint32_t mix32(uint32_t x)
+  {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+  }
+
+  // Approximately standard normal: sum of four 16-bit uniforms (Irwin-Hall),
+  // centred and scaled to unit variance
+  inline float gaussian(uint32_t key, uint32_t i)
+  {
+    uint32_t a = mix32(i ^ key);
+    uint32_t b = mix32(a + 0x9e3779b9u);
+    // Fits in 19 bits, so the signed conversion (which vectorizes) is exact
+    float sum = static_cast<float>(static_cast<int32_t>((a & 0xffff) + (a >> 16) + (b & 0xffff) + (b >> 16)));
+    return (sum * (1.0f / 65536.0f) - 2.0f) * 1.7320508f;
+  }
+
+  inline float uniform(uint32_t key, uint32_t i)
+  {
+    return (mix32(i ^ key) >> 8) * (1.0f / 16777216.0f);
+  }
+
+  inline float clampf(float v, float lo, float hi)
+  {
+    v = v < lo ? lo : v;
+    return v > hi ? hi : v;
+  }
+
+  inline float wrap_degrees(float a)
+  {
+    // Per-tick steps are tiny, so one correction is always enough. Selecting the
+    // offset rather than the result keeps it vectorizable: GCC will not
+    // if-convert a conditional add while FP traps are assumed to matter.
+    float offset = a >= 180.0f ? -360.0f : (a < -180.0f ? 360.0f : 0.0f);
+    return a + offset;
+  }
+
+  struct NoiseKeys
+  {
+    uint32_t temperature, radiation, battery, pitch, roll, yaw;
+  };
+
+  // A free function so the __restrict parameters are honoured (GCC ignores
+  // restrict on locals and gives up on runtime alias checks for this many
+  // arrays). Keep the body free of calls and branches so it stays vectorized.
+  // On x86 an AVX2 clone is picked at load time when the CPU has it (not under
+  // TSan, whose runtime is not up yet when the ifunc resolver runs).
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && !defined(__SANITIZE_THREAD__)
+  __attribute__((target_clones("avx2", "default")))
+#endif
+  void step_kernel(size_t begin, size_t end, float dt, NoiseKeys keys,
+                   float *__restrict temperature, float *__restrict radiation, float *__restrict voltage,
+                   float *__restrict pitch, float *__restrict roll, float *__restrict yaw,
+                   float *__restrict c, float *__restrict s,
+                   const float *__restrict rc, const float *__restrict rs)
+  {
+    // Same drift and noise parameters as the scalar sensors
+    for (size_t i = begin; i < end; ++i)
+    {
+      uint32_t id = static_cast<uint32_t>(i);
+      temperature[i] = clampf(temperature[i] - 0.005f * dt + 0.05f * gaussian(keys.temperature, id), -50.0f, 80.0f);
+      voltage[i] = clampf(voltage[i] - 0.0001f * dt + 0.002f * gaussian(keys.battery, id), 9.0f, 12.6f);
+      float rad = 0.05f + 0.002f * gaussian(keys.radiation, id); // equatorial orbits, so z = 0
+      radiation[i] = rad > 0.0f ? rad : 0.0f;
+
+      pitch[i] = wrap_degrees(pitch[i] + 0.01f * gaussian(keys.pitch, id));
+      roll[i] = wrap_degrees(roll[i] + 0.01f * gaussian(keys.roll, id));
+      yaw[i] = wrap_degrees(yaw[i] + 0.02f * gaussian(keys.yaw, id));
+
+      float nc = c[i] * rc[i] - s[i] * rs[i];
+      float ns = s[i] * rc[i] + c[i] * rs[i];
+      c[i] = nc;
+      s[i] = ns;
+    }
+  }
+}
+
+FleetSimulator::FleetSimulator(const FleetConfig &config) : config_(config)
+{
+  const size_t n = config_.vehicles;
+  temperature_.assign(n, 25.0f);
+  radiation_.assign(n, 0.1f);
+  voltage_.assign(n, 12.5f);
+  pitch_.assign(n, 0.0f);
+  roll_.assign(n, 0.0f);
+  yaw_.assign(n, 0.0f);
+  cos_.resize(n);
+  sin_.resize(n);
+  rot_cos_.resize(n);
+  rot_sin_.resize(n);
+  radius_.resize(n);
+  phase_.resize(n);
+  omega_.resize(n);
+
+  uint32_t phase_key = stream_key(config_.seed, 0, kPhase);
+  uint32_t radius_key = stream_key(config_.seed, 0, kRadius);
+  for (size_t i = 0; i < n; ++i)
+  {
+    double r = 6900.0 + 400.0 * uniform(radius_key, i);
+    double period = kReferencePeriod * std::pow(r / kReferenceRadius, 1.5); // Kepler's third law
+    radius_[i] = static_cast<float>(r);
+    phase_[i] = 2 * kPi * uniform(phase_key, i);
+    omega_[i] = 2 * kPi / period;
+    cos_[i] = static_cast<float>(std::cos(phase_[i]));
+    sin_[i] = static_cast<float>(std::sin(phase_[i]));
+    rot_cos_[i] = static_cast<float>(std::cos(omega_[i] * config_.dt));
+    rot_sin_[i] = static_cast<float>(std::sin(omega_[i] * config_.dt));
+  }
+}
+
+void FleetSimulator::step_slice(size_t begin, size_t end, uint64_t tick)
+{
+  const uint64_t seed = config_.seed;
+  NoiseKeys keys{stream_key(seed, tick, kTemperature), stream_key(seed, tick, kRadiation),
+                 stream_key(seed, tick, kBattery), stream_key(seed, tick, kPitch),
+                 stream_key(seed, tick, kRoll), stream_key(seed, tick, kYaw)};
+
+  step_kernel(begin, end, static_cast<float>(config_.dt), keys,
+              temperature_.data(), radiation_.data(), voltage_.data(),
+              pitch_.data(), roll_.data(), yaw_.data(),
+              cos_.data(), sin_.data(), rot_cos_.data(), rot_sin_.data());
+
+  // Float rotation error builds up slowly; snap back to the exact angle now and then
+  if (tick % kResyncTicks == 0)
+    for (size_t i = begin; i < end; ++i)
+    {
+      double angle = phase_[i] + omega_[i] * config_.dt * tick;
+      cos_[i] = static_cast<float>(std::cos(angle));
+      sin_[i] = static_cast<float>(std::sin(angle));
+    }
+}
+
+void FleetSimulator::emit_slice(size_t begin, size_t end, uint64_t tick, FleetPacket *out) const
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    FleetPacket &fp = out[i - begin];
+    fp.vehicle_id = static_cast<uint32_t>(i);
+    TelemetryPacket &pkt = fp.packet;
+    pkt.timestamp = tick;
+    pkt.temperature = temperature_[i];
+    pkt.radiation = radiation_[i];
+    pkt.battery_voltage = voltage_[i];
+    pkt.position = {radius_[i] * cos_[i], radius_[i] * sin_[i], 0.0f};
+    pkt.orientation = {pitch_[i], roll_[i], yaw_[i]};
+    pkt.source_id = fp.vehicle_id;
+  }
+}
+
+void FleetSimulator::step()
+{
+  tick_++;
+  step_slice(0, config_.vehicles, tick_);
+}
+
+void FleetSimulator::snapshot(std::vector<FleetPacket> &out) const
+{
+  out.resize(config_.vehicles);
+  emit_slice(0, config_.vehicles, tick_, out.data());
+}
+
+uint64_t FleetSimulator::run(uint64_t ticks, const Sink &sink)
+{
+  const size_t n = config_.vehicles;
+  const size_t workers = std::max<size_t>(1, std::min(config_.threads, n));
+  const uint64_t first_tick = tick_ + 1;
+
+  auto work = [&](size_t w)
+  {
+    // Slices are multiples of 16 vehicles so neighbouring workers never share a cache line
+    size_t chunk = (n / workers + 15) & ~size_t{15};
+    size_t begin = std::min(n, w * chunk);
+    size_t end = w + 1 == workers ? n : std::min(n, begin + chunk);
+    std::vector<FleetPacket> packets(end - begin);
+
+    for (uint64_t t = first_tick; t < first_tick + ticks; ++t)
+    {
+      step_slice(begin, end, t);
+      if (sink && begin < end)
+      {
+        emit_slice(begin, end, t, packets.data());
+        sink(w, packets.data(), packets.size());
+      }
+    }
+  };
+
+  if (workers == 1)
+    work(0);
+  else
+  {
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; ++w)
+      threads.emplace_back(work, w);
+    for (auto &t : threads)
+      t.join();
+  }
+
+  tick_ += ticks;
+  return ticks * n;
+}
@@ -0,0 +1,242 @@
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+
+#include "../include/frame.h"
+#include "../include/columnar_codec.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  // Generous upper bounds used to reject garbage headers
+  constexpr uint32_t kMaxPayload = 16u << 20;
+  constexpr uint32_t kMaxPacketsPerFrame = kMaxPayload / kPacketWireSize;
+
+  void put_u32(std::vector<uint8_t> &out, size_t at, uint32_t value)
+  {
+    uint32_t be = htonl(value);
+    std::memcpy(out.data() + at, &be, sizeof(be));
+  }
+
+  struct CodecMetrics
+  {
+    Histogram &serialise = stage_histogram("serialise");
+    Histogram &compress = stage_histogram("compress");
+    Histogram &decompress = stage_histogram("decompress");
+  };
+
+  CodecMetrics &codec_metrics()
+  {
+    static CodecMetrics m;
+    return m;
+  }
+
+  uint32_t get_u32(const uint8_t *in)
+  {
+    uint32_t be;
+    std::memcpy(&be, in, sizeof(be));
+    return ntohl(be);
+  }
+}
+
+FrameEncoder::FrameEncoder(const LinkConfig &config)
+    : mode_(config.frame_mode), codec_(config.codec), vc_(config.virtual_channel & 0x7),
+      deflate_(config.compression.level), quantized_(config.quantization),
+      compressor_(make_codec(config.compression, config.link_rate)) {}
+
+void FrameEncoder::encode(const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out)
+{
+  if (count == 0)
+    return;
+
+  if (mode_ == FrameMode::PerPacket)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      uint64_t t0 = metrics_now_ns();
+      raw_.resize(kPacketWireSize);
+      serialise_into(pkts[i], raw_.data());
+      uint64_t t1 = metrics_now_ns();
+      size_t at = out.size();
+      out.resize(at + 4);
+      compressor_->compress(raw_.data(), raw_.size(), out);
+      codec_metrics().serialise.record(t1 - t0);
+      codec_metrics().compress.record(metrics_now_ns() - t1);
+      put_u32(out, at, out.size() - at - 4);
+    }
+    return;
+  }
+
+  if (mode_ == FrameMode::Ccsds)
+  {
+    // Each source on its own virtual channel
+    uint32_t used = 0;
+    for_each_source_run(pkts, count, [&](const TelemetryPacket *run, size_t n)
+                        {
+                          uint8_t vc = ccsds_channel(vc_, run->source_id);
+                          if (codec_ == PayloadCodec::Columnar)
+                          {
+                            ScopedTimer timer(codec_metrics().compress);
+                            framer_.add_columnar(vc, run, n, out);
+                          }
+                          else
+                          {
+                            ScopedTimer timer(codec_metrics().serialise);
+                            framer_.add_telemetry(vc, run, n, out);
+                          }
+                          used |= 1u << vc; });
+    for (uint8_t vc = 0; vc < kVirtualChannels; ++vc)
+      if (used & (1u << vc))
+        framer_.flush(vc, out);
+    return;
+  }
+
+  size_t at = out.size();
+  out.resize(at + 8);
+
+  if (codec_ == PayloadCodec::Columnar)
+  {
+    // Serialising and compressing are one pass here, so it all counts as compress
+    ScopedTimer timer(codec_metrics().compress);
+    encode_columnar(pkts, count, out);
+  }
+  else if (codec_ == PayloadCodec::Quantized)
+  {
+    ScopedTimer timer(codec_metrics().compress);
+    quantized_.encode(pkts, count, out);
+  }
+  else
+  {
+    uint64_t t0 = metrics_now_ns();
+    raw_.resize(count * kPacketWireSize);
+    for (size_t i = 0; i < count; ++i)
+      serialise_into(pkts[i], raw_.data() + i * kPacketWireSize);
+    uint64_t t1 = metrics_now_ns();
+    deflate_.compress_chunk(raw_.data(), raw_.size(), out);
+    codec_metrics().serialise.record(t1 - t0);
+    codec_metrics().compress.record(metrics_now_ns() - t1);
+  }
+
+  put_u32(out, at, out.size() - at - 8);
+  put_u32(out, at + 4, count);
+}
+
+FrameDecoder::FrameDecoder(const LinkConfig &config)
+    : mode_(config.frame_mode), codec_(config.codec), quantized_(config.quantization),
+      compressor_(make_codec(config.compression, config.link_rate)) {}
+
+size_t FrameDecoder::header_size() const
+{
+  return mode_ == FrameMode::PerPacket ? 4 : 8;
+}
+
+bool FrameDecoder::independent_frames() const
+{
+  return !(mode_ == FrameMode::Batched && codec_ == PayloadCodec::Deflate);
+}
+
+FrameHeader FrameDecoder::parse_header(const uint8_t *header) const
+{
+  FrameHeader h{get_u32(header), 1};
+  if (mode_ == FrameMode::Batched)
+    h.packet_count = get_u32(header + 4);
+
+  if (h.payload_len == 0 || h.payload_len > kMaxPayload ||
+      h.packet_count == 0 || h.packet_count > kMaxPacketsPerFrame)
+    throw std::runtime_error("Invalid frame header");
+  return h;
+}
+
+void FrameDecoder::decode(const FrameHeader &header, const uint8_t *payload, std::vector<TelemetryPacket> &out)
+{
+  ScopedTimer timer(codec_metrics().decompress);
+
+  if (mode_ == FrameMode::PerPacket)
+  {
+    raw_.resize(kPacketWireSize);
+    compressor_->decompress(payload, header.payload_len, raw_.data(), raw_.size());
+    out.push_back(deserialise_from(raw_.data()));
+    return;
+  }
+
+  if (codec_ == PayloadCodec::Columnar)
+  {
+    size_t at = out.size();
+    out.resize(at + header.packet_count);
+    decode_columnar(payload, header.payload_len, header.packet_count, out.data() + at);
+    return;
+  }
+
+  if (codec_ == PayloadCodec::Quantized)
+  {
+    size_t at = out.size();
+    out.resize(at + header.packet_count);
+    quantized_.decode(payload, header.payload_len, header.packet_count, out.data() + at);
+    return;
+  }
+
+  raw_.resize(header.packet_count * kPacketWireSize);
+  inflate_.decompress_chunk(payload, header.payload_len, raw_.data(), raw_.size());
+  size_t at = out.size();
+  out.resize(at + header.packet_count);
+  for (size_t i = 0; i < header.packet_count; ++i)
+    deserialise_into(raw_.data() + i * kPacketWireSize, out[at + i]);
+}
+
+FrameAssembler::FrameAssembler(const LinkConfig &config) : decoder_(config), pending_(64 * 1024)
+{
+  if (config.frame_mode == FrameMode::Ccsds)
+    deframer_ = std::make_unique<CcsdsDeframer>();
+}
+
+uint8_t *FrameAssembler::prepare(size_t min_space)
+{
+  if (pending_.size() - end_ < min_space)
+  {
+    // Slide the partial frame to the front first, grow only if that is not enough
+    std::memmove(pending_.data(), pending_.data() + start_, end_ - start_);
+    end_ -= start_;
+    start_ = 0;
+    if (pending_.size() - end_ < min_space)
+      pending_.resize(end_ + min_space);
+  }
+  return pending_.data() + end_;
+}
+
+size_t FrameAssembler::commit(size_t n, std::vector<TelemetryPacket> &out)
+{
+  end_ += n;
+  size_t frames = 0;
+
+  if (deframer_)
+  {
+    // Fixed-size frames: whatever is left over is under one CADU and always fits
+    ScopedTimer timer(codec_metrics().decompress);
+    uint64_t before = deframer_->good_frames();
+    start_ += deframer_->consume(pending_.data() + start_, end_ - start_, out);
+    if (start_ == end_)
+      start_ = end_ = 0;
+    return deframer_->good_frames() - before;
+  }
+
+  const size_t header_size = decoder_.header_size();
+
+  while (end_ - start_ >= header_size)
+  {
+    FrameHeader h = decoder_.parse_header(pending_.data() + start_);
+    if (end_ - start_ < header_size + h.payload_len)
+    {
+      // Make sure the rest of this frame will fit on the next prepare()
+      prepare(header_size + h.payload_len - (end_ - start_));
+      break;
+    }
+
+    decoder_.decode(h, pending_.data() + start_ + header_size, out);
+    start_ += header_size + h.payload_len;
+    frames++;
+  }
+
+  if (start_ == end_)
+    start_ = end_ = 0;
+  return frames;
+}
@@ -1,42 +1,131 @@
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 
+#include "../include/aggregator.h"
+#include "../include/anomaly.h"
 #include "../include/buffer.h"
 #include "../include/compression.h"
+#include "../include/frame.h"
+#include "../include/decode_pipeline.h"
+#include "../include/link.h"
 #include "../include/logger.h"
+#include "../include/net.h"
+#include "../include/sharded_logger.h"
+#include "../include/ground_station.h"
+#include "../include/metrics.h"
+#include "../include/uring.h"
 
-void ground_station_thread()
+static std::string log_prefix()
 {
-  int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
-  if (listen_sock < 0)
+  auto now = std::chrono::system_clock::now();
+  std::time_t t = std::chrono::system_clock::to_time_t(now);
+  return "telemetry_" + std::to_string(t);
+}
+
+GroundStationSink::GroundStationSink(const LinkConfig &config) : config_(config)
+{
+  if (config.log_writers > 0)
   {
-    perror("socket");
+    ShardedLoggerOptions options;
+    options.writers = config.log_writers;
+    options.log = config.log_options;
+    shards_ = std::make_unique<ShardedTelemetryLogger>(log_prefix(), options);
+  }
+  else
+    logger_ = std::make_unique<TelemetryLogger>(
+        log_prefix() + (config.log_options.format == LogFormat::Archive ? ".tlm" : ".csv"), config.log_options);
+}
+
+GroundStationSink::~GroundStationSink()
+{
+  if (!shards_)
     return;
+  shards_->flush();
+  std::vector<SourceStats> sources = shards_->sources();
+  uint64_t packets = 0, missing = 0, late = 0, dropped = 0;
+  for (const SourceStats &s : sources)
+  {
+    packets += s.packets;
+    missing += s.missing;
+    late += s.late;
+    dropped += s.dropped;
   }
+  std::cout << "[Ground Station] " << sources.size() << " sources logged by " << shards_->writers() << " writers: "
+            << packets << " packets, " << missing << " missing, " << late << " late, " << dropped
+            << " dropped on a full queue\n";
+  // Only the sources with gaps, and not thousands of them
+  size_t shown = 0;
+  for (const SourceStats &s : sources)
+    if ((s.missing || s.late || s.dropped) && shown++ < 10)
+      std::cout << "[Ground Station]   source " << s.source << ": " << s.packets << " packets, " << s.missing
+                << " missing, " << s.late << " late, " << s.dropped << " dropped\n";
+}
 
-  sockaddr_in addr{};
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons(5000);
-  addr.sin_addr.s_addr = INADDR_ANY; // accept from any interface
+void GroundStationSink::deliver(const TelemetryPacket *pkts, size_t count)
+{
+  static Histogram &log_time = stage_histogram("log");
+  static Histogram &aggregate_time = stage_histogram("aggregate");
+  static Histogram &detect_time = stage_histogram("detect");
+  static Counter &rx_packets = metrics().counter("telemetry_rx_packets_total", "Packets decoded at the ground station");
 
-  if (bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)))
+  // Each stage has its own lock, so reactor threads overlap across stages
+  if (config_.detector)
   {
-    perror("bind");
-    return;
+    std::lock_guard<std::mutex> lock(detect_mtx_);
+    ScopedTimer timer(detect_time);
+    config_.detector->process(pkts, count);
+  }
+  {
+    ScopedTimer timer(log_time);
+    if (shards_)
+      shards_->log_packets(pkts, count); // locks per writer, never waits
+    else if (config_.log_options.async)
+      logger_->log_packets(pkts, count); // locks its double buffer
+    else
+    {
+      std::lock_guard<std::mutex> lock(log_mtx_);
+      logger_->log_packets(pkts, count);
+    }
+  }
+  rx_packets.add(count);
+  if (config_.aggregator)
+  {
+    std::lock_guard<std::mutex> lock(aggregate_mtx_);
+    ScopedTimer timer(aggregate_time);
+    config_.aggregator->add(pkts, count);
   }
 
-  listen(listen_sock, 1); // only 1 connection is queued
+  if (!config_.verbose && !config_.on_packet)
+    return;
+  // Hooks are written for one caller at a time
+  std::lock_guard<std::mutex> lock(output_mtx_);
+  for (size_t i = 0; i < count; ++i)
+  {
+    const TelemetryPacket &pkt = pkts[i];
+    if (config_.verbose)
+      std::cout << "[Ground Station] Packet received:"
+                << " Temp=" << pkt.temperature
+                << "  Volt=" << pkt.battery_voltage
+                << "  Rad=" << pkt.radiation
+                << "  Time=" << pkt.timestamp
+                << std::endl;
+    if (config_.on_packet)
+      config_.on_packet(pkt);
+  }
+}
 
+static void run_blocking_ground_station(const LinkConfig &config, int listen_sock)
+{
   std::cout << "[Ground Station] Waiting for connection...\n";
 
   int client_sock = accept(listen_sock, nullptr, nullptr);
 
-  auto now = std::chrono::system_clock::now();
-  std::time_t t = std::chrono::system_clock::to_time_t(now);
-  std::string filename = "telemetry_" + std::to_string(t) + ".csv";
-  TelemetryLogger logger(filename);
+  GroundStationSink sink(config);
 
   if (client_sock < 0)
   {
@@ -45,39 +134,169 @@ void ground_station_thread()
   }
   std::cout << "[Ground Station] Connected to transmitter.\n";
 
-  while (true)
+  std::unique_ptr<UringReceiver> uring;
+  if (config.io_backend == IoBackend::Uring)
   {
-    uint32_t len_network;
-    ssize_t n = recv(client_sock, &len_network, sizeof(len_network), 0);
+    uring = std::make_unique<UringReceiver>(client_sock);
+    if (!uring->ok())
+    {
+      std::cerr << "[Ground Station] io_uring unavailable, using recv()\n";
+      uring.reset();
+    }
+  }
+  auto read_all = [&](uint8_t *out, size_t len)
+  { return uring ? uring->read_all(out, len) : recv_all(client_sock, out, len); };
 
-    if (n <= 0) // transmitter disconnected
-      break;
+  FrameDecoder decoder(config);
+  std::vector<uint8_t> header(decoder.header_size());
+  std::vector<uint8_t> buffer;
+  std::vector<TelemetryPacket> packets;
+
+  uint64_t received = 0, frames = 0, wire_bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  Histogram &recv_time = stage_histogram("recv");
+  Counter &rx_frames = metrics().counter("telemetry_rx_frames_total", "Frames received at the ground station");
+  Counter &rx_bytes = metrics().counter("telemetry_rx_bytes_total", "Bytes received at the ground station, framing included");
 
-    uint32_t len = ntohl(len_network);
+  // CCSDS frames have no length prefix to wait on; bytes go straight into the deframer
+  const bool ccsds = config.frame_mode == FrameMode::Ccsds;
+  FrameAssembler assembler(config);
 
-    std::vector<uint8_t> buffer(len);
-    size_t received = 0;
-    while (received < len)
+  // With decode workers this thread only receives; decoding and logging run behind it
+  std::unique_ptr<DecodePipeline> pipeline;
+  if (config.decode_workers > 0 && !ccsds)
+    pipeline = std::make_unique<DecodePipeline>(config, [&sink](const TelemetryPacket *pkts, size_t count)
+                                                { sink.deliver(pkts, count); });
+
+  while (true)
+  {
+    if (ccsds)
     {
-      ssize_t chunk = recv(client_sock, buffer.data() + received, len - received, 0);
-      if (chunk <= 0)
+      uint8_t *space = assembler.prepare(kCaduSize);
+      ssize_t n = uring ? uring->read(space, assembler.space()) : recv(client_sock, space, assembler.space(), 0);
+      if (n <= 0)
         break;
-      received += chunk;
+      packets.clear();
+      uint64_t t0 = metrics_now_ns();
+      size_t cadus = assembler.commit(n, packets);
+      recv_time.record(metrics_now_ns() - t0);
+      frames += cadus;
+      wire_bytes += n;
+      received += packets.size();
+      rx_frames.add(cadus);
+      rx_bytes.add(n);
+      if (!packets.empty())
+        sink.deliver(packets.data(), packets.size());
+      continue;
     }
 
-    buffer = decompress_data(buffer, sizeof(TelemetryPacket));
-    TelemetryPacket pkt = deserialise(buffer);
+    if (!read_all(header.data(), header.size())) // transmitter disconnected
+      break;
 
-    std::cout << "[Ground Station] Packet received:"
-              << " Temp=" << pkt.temperature
-              << "  Volt=" << pkt.battery_voltage
-              << "  Rad=" << pkt.radiation
-              << "  Time=" << pkt.timestamp
-              << std::endl;
-    logger.log_packet(pkt);
+    try
+    {
+      FrameHeader h = decoder.parse_header(header.data());
+      buffer.resize(h.payload_len);
+
+      // Only the payload is timed: waiting for the header is idle time, not receive cost
+      uint64_t t0 = metrics_now_ns();
+      if (!read_all(buffer.data(), buffer.size()))
+        break;
+      recv_time.record(metrics_now_ns() - t0);
+
+      packets.clear();
+      if (pipeline)
+      {
+        if (!pipeline->submit(h, buffer.data()))
+          throw std::runtime_error(pipeline->error());
+      }
+      else
+        decoder.decode(h, buffer.data(), packets);
+      received += pipeline ? h.packet_count : packets.size();
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "[Ground Station] Dropping link: " << e.what() << "\n";
+      break;
+    }
+
+    frames++;
+    wire_bytes += header.size() + buffer.size();
+    rx_frames.add();
+    rx_bytes.add(header.size() + buffer.size());
+    if (!pipeline)
+      sink.deliver(packets.data(), packets.size());
   }
 
+  if (pipeline && !pipeline->finish())
+    std::cerr << "[Ground Station] Dropping link: " << pipeline->error() << "\n";
+  if (uring)
+    metrics().counter("telemetry_io_syscalls_total", "Syscalls made to move link bytes", "call=\"io_uring_enter\"").add(uring->syscalls());
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (received > 0)
+    std::cout << "[Ground Station] " << received << " packets in " << frames << " frames: "
+              << static_cast<double>(wire_bytes) / received << " bytes/packet on wire, "
+              << received / seconds << " packets/s\n";
+  if (const CcsdsDeframer *deframer = assembler.deframer())
+    std::cout << deframer->summary("[Ground Station] ");
+
   close(client_sock);
+}
+
+void ground_station_thread(const LinkConfig &config)
+{
+  if (config.transport == Transport::Udp)
+  {
+    int sock = open_udp_socket(config.port);
+    if (sock < 0)
+      return;
+    GroundStationSink sink(config);
+    run_udp_ground_station(config, sink, sock);
+    close(sock);
+    std::cout << "[Ground Station] Closed.\n";
+    return;
+  }
+
+  if (config.transport == Transport::Shm)
+  {
+    GroundStationSink sink(config);
+    run_shm_ground_station(config, sink);
+    std::cout << "[Ground Station] Closed.\n";
+    return;
+  }
+
+  if (config.reliable)
+  {
+    int listen_sock = open_listen_socket(config.port, 1);
+    if (listen_sock < 0)
+      return;
+    GroundStationSink sink(config);
+    run_reliable_ground_station(config, sink, listen_sock);
+    close(listen_sock);
+    std::cout << "[Ground Station] Closed.\n";
+    return;
+  }
+
+  bool epoll = config.receiver == ReceiverMode::Epoll;
+  int listen_sock = open_listen_socket(config.port, epoll ? SOMAXCONN : 1); // blocking mode queues 1 connection
+  if (listen_sock < 0)
+    return;
+
+  if (epoll)
+  {
+    GroundStationSink sink(config);
+    run_epoll_ground_station(config, sink, listen_sock);
+  }
+  else
+    run_blocking_ground_station(config, listen_sock);
+
   close(listen_sock);
   std::cout << "[Ground Station] Closed.\n";
-}
\ No newline at end of file
+}
+
+void ground_station_thread()
+{
+  ground_station_thread(LinkConfig{});
+}
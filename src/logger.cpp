@@ -0,0 +1,210 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../include/logger.h"
+#include "../include/archive.h"
+
+TelemetryLogger::TelemetryLogger(const std::string &filename, const LoggerOptions &options) : options_(options)
+{
+  namespace fs = std::filesystem;
+
+  fs::path log_dir = "logs";
+  if (!fs::exists(log_dir))
+    fs::create_directory(log_dir);
+
+  fs::path filepath = log_dir / filename;
+  if (options_.format == LogFormat::Archive)
+    archive_ = std::make_unique<ArchiveWriter>(filepath.string(), options_.archive_block_rows);
+  else
+    fd_ = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (!archive_ && fd_ < 0)
+    throw std::runtime_error("Failed to open log file.");
+
+  if (!archive_ && ::lseek(fd_, 0, SEEK_END) == 0)
+  {
+    text_.assign(kCsvHeader, kCsvHeader + std::strlen(kCsvHeader));
+    write_text();
+  }
+
+  if (options_.async)
+  {
+    size_t block = options_.flush_every_records ? options_.flush_every_records : 4096;
+    front_.reserve(block);
+    back_.reserve(block);
+    text_.reserve(block * kMaxCsvRowLength);
+    writer_ = std::thread(&TelemetryLogger::writer_loop, this);
+  }
+}
+
+void TelemetryLogger::format_rows(const TelemetryPacket *pkts, size_t count)
+{
+  size_t at = text_.size();
+  text_.resize(at + count * kMaxCsvRowLength);
+  char *p = text_.data() + at;
+  char *end = text_.data() + text_.size();
+  for (size_t i = 0; i < count; ++i)
+    p = format_csv_row(p, end, pkts[i]);
+  text_.resize(p - text_.data());
+  pending_rows_ += count;
+}
+
+// One write() for the whole block of text
+void TelemetryLogger::write_text()
+{
+  const char *p = text_.data();
+  size_t left = text_.size();
+  while (left > 0)
+  {
+    ssize_t n = ::write(fd_, p, left);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      throw std::runtime_error("Failed to write log file.");
+    }
+    p += n;
+    left -= n;
+  }
+  text_.clear();
+  pending_rows_ = 0;
+}
+
+void TelemetryLogger::write_rows(const TelemetryPacket *pkts, size_t count)
+{
+  if (archive_)
+  {
+    archive_->append(pkts, count);
+    return;
+  }
+  format_rows(pkts, count);
+  write_text();
+}
+
+void TelemetryLogger::log_packets(const TelemetryPacket *pkts, size_t count)
+{
+  if (archive_ && !options_.async)
+  {
+    archive_->append(pkts, count);
+    return;
+  }
+
+  if (!options_.async)
+  {
+    format_rows(pkts, count);
+    if (options_.flush_every_records != 0 && pending_rows_ >= options_.flush_every_records)
+      write_text();
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  const size_t block = front_.capacity();
+  for (size_t i = 0; i < count;)
+  {
+    // Both halves busy means the disk is behind: wait instead of growing without bound
+    cv_space_.wait(lock, [&]
+                   { return front_.size() < block; });
+
+    size_t n = std::min(count - i, block - front_.size());
+    front_.insert(front_.end(), pkts + i, pkts + i + n);
+    i += n;
+
+    if (front_.size() >= block)
+      cv_writer_.notify_one();
+  }
+}
+
+void TelemetryLogger::writer_loop()
+{
+  std::unique_lock<std::mutex> lock(mtx_);
+  const size_t block = front_.capacity();
+
+  while (true)
+  {
+    auto ready = [&]
+    { return stop_ || flush_requested_ || front_.size() >= block; };
+
+    if (options_.flush_interval.count() > 0)
+      cv_writer_.wait_for(lock, options_.flush_interval, ready);
+    else
+      cv_writer_.wait(lock, ready);
+
+    flush_requested_ = false;
+    if (front_.empty())
+    {
+      cv_space_.notify_all(); // a flush() may be waiting on an already empty buffer
+      if (stop_)
+        break;
+      continue;
+    }
+
+    // Swap halves and format/write with the lock released, so callers keep logging
+    front_.swap(back_);
+    writing_ = true;
+    cv_space_.notify_all();
+    lock.unlock();
+
+    try
+    {
+      write_rows(back_.data(), back_.size());
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "[Logger] " << e.what() << " Dropped " << back_.size() << " rows.\n";
+      text_.clear();
+      pending_rows_ = 0;
+    }
+
+    lock.lock();
+    back_.clear();
+    writing_ = false;
+    cv_space_.notify_all();
+  }
+}
+
+void TelemetryLogger::flush()
+{
+  if (!options_.async)
+  {
+    if (!archive_)
+      write_text();
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  flush_requested_ = true;
+  cv_writer_.notify_one();
+  cv_space_.wait(lock, [&]
+                 { return front_.empty() && !writing_; });
+}
+
+TelemetryLogger::~TelemetryLogger()
+{
+  if (writer_.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cv_writer_.notify_one();
+    writer_.join();
+  }
+
+  if (archive_)
+  {
+    archive_->close(options_.fsync_on_close);
+    return;
+  }
+
+  if (fd_ >= 0)
+  {
+    write_text();
+    if (options_.fsync_on_close)
+      ::fsync(fd_);
+    ::close(fd_);
+  }
+}
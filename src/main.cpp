@@ -1,29 +1,495 @@
 #include <thread>
 #include <iostream>
+#include <string>
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include "../include/aggregator.h"
+#include "../include/anomaly.h"
 #include "../include/buffer.h"
+#include "../include/priority_buffer.h"
+#include "../include/link.h"
+#include "../include/metrics.h"
+#include "../include/simulation.h"
 
 // Forward declarations of the thread functions defined in other files
-void sensor_thread(TelemetryBuffer &buffer);
-void transmitter_thread(TelemetryBuffer &buffer);
-void ground_station_thread();
+void sensor_thread(TelemetryBuffer &buffer, const SimulationConfig &config);
+void sensor_thread(PriorityTelemetryBuffer &buffer, const SimulationConfig &config);
+void transmitter_thread(TelemetryBuffer &buffer, const LinkConfig &config);
+void transmitter_thread(PriorityTelemetryBuffer &buffer, const LinkConfig &config);
+void ground_station_thread(const LinkConfig &config);
 
-int main()
+static void usage(const char *prog)
 {
-  std::cout << "Starting Space Telemetry Simulation..." << std::endl;
+  std::cout << "Usage: " << prog << " [options]\n"
+            << "  --port N          TCP port between transmitter and ground station (default 5000)\n"
+            << "  --batch N         send frames of up to N packets on a streaming deflate context\n"
+            << "  --codec NAME      Batched frame codec: deflate (default), columnar or quantized (lossy fixed point)\n"
+            << "  --quantize Q      quantized range such as battery=9:12.6:0.001 (column=min:max:step); repeatable\n"
+            << "  --compress NAME   per-packet frames and UDP datagrams: zlib (default), none, dict or adaptive\n"
+            << "  --level N         deflate level 0-9 for zlib, dict and --batch deflate streams (default 6)\n"
+            << "  --dict PATH       dictionary for --compress dict or adaptive, built by telemetry_dict train\n"
+            << "  --ccsds           fixed-length CCSDS transfer frames (batches as with --batch, default 32)\n"
+            << "  --vc N            CCSDS base virtual channel (0-7); source S goes out on VC (N + S) % 8\n"
+            << "  --deadline-ms N   max time a packet waits for its frame to fill (default 100)\n"
+            << "  --links N         run N sensor/transmitter links into an epoll ground station\n"
+            << "  --decoders N      decode frames on N threads behind the receiver (blocking mode, default 0)\n"
+            << "  --reactors N      epoll reactor threads at the ground station (default 2)\n"
+            << "  --reliable        sequence-numbered TCP frames with acks; reconnect and retransmit when the link drops\n"
+            << "  --window N        --reliable: unacked frames kept for retransmission (default 256)\n"
+            << "  --io NAME         TCP byte moving: sockets (default) or uring (io_uring, batched writes, registered buffers)\n"
+            << "  --uring-depth N   --io uring: max frames written per io_uring_enter (default 16)\n"
+            << "  --shm             carry frames through a shared-memory ring instead of TCP (same host only)\n"
+            << "  --shm-name NAME   --shm: shared memory object to use, so the two sides can run as separate processes\n"
+            << "  --role R          run both sides (default), or only the transmitter or ground-station side\n"
+            << "  --udp             send datagrams (sendmmsg/recvmmsg) instead of a TCP stream\n"
+            << "  --loss P          UDP: drop each datagram with probability P (local impairment)\n"
+            << "  --reorder P       UDP: hold each datagram back with probability P so later ones overtake it\n"
+            << "  --delay-ms N      UDP: add N ms of one-way delay\n"
+            << "  --jitter-ms N     UDP: add up to N ms of random extra delay\n"
+            << "  --priority        queue alarms ahead of routine telemetry (strict priority + weighted round-robin)\n"
+            << "  --rule R          priority rule such as battery_voltage<10.5=alarm; repeatable, replaces the defaults\n"
+            << "  --link-rate N     emulate a downlink of N bytes/s\n"
+            << "  --overflow P      when a link's buffer is full: block (default), timeout, drop-oldest, drop-newest, spill\n"
+            << "  --overflow-timeout-ms N  how long --overflow timeout waits before dropping (default 100)\n"
+            << "  --spill-dir DIR   where --overflow spill keeps its scratch file (default /tmp)\n"
+            << "  --spill-packets N packets spilled to disk before the oldest are evicted (default 1048576)\n"
+            << "  --archive         log to a binary columnar archive (.tlm) instead of CSV\n"
+            << "  --source N        spacecraft id stamped on packets; with --links, link i sends as N + i (default 0)\n"
+            << "  --log-writers N   one log per source, written by N threads (ground station)\n"
+            << "  --aggregate       keep 1 s / 1 min / 1 h window statistics at the ground station, exported as metrics\n"
+            << "  --detect          flag battery sag, radiation spikes and attitude drift at the ground station (stderr)\n"
+            << "  --alert R         detector rule such as battery:rate<-0.01 (column[:z|:rate]<value); repeatable, replaces the defaults\n"
+            << "  --quiet           no per-packet console output\n"
+            << "  --seed N          seed for the sensor noise; runs with the same seed and dt are identical\n"
+            << "  --dt S            simulated seconds per packet (default 1)\n"
+            << "  --speed X         simulated seconds per real second, 0 = as fast as possible (default 1)\n"
+            << "  --packets N       stop each link after N packets and shut down cleanly\n"
+            << "  --headless        --speed 0 --quiet: run the pipeline flat out on the virtual clock\n"
+            << "  --metrics-port N  serve Prometheus metrics on 127.0.0.1:N\n"
+            << "  --metrics-file P  rewrite a Prometheus metrics snapshot to P periodically\n"
+            << "  --metrics-interval-ms N  snapshot period for --metrics-file (default 1000)\n";
+}
 
-  TelemetryBuffer buffer(100);
+int main(int argc, char **argv)
+{
+  LinkConfig config;
+  SimulationConfig sim;
+  uint16_t metrics_port = 0;
+  std::string metrics_file;
+  std::chrono::milliseconds metrics_interval(1000);
+  bool priority = false;
+  std::vector<ClassifierRule> rules;
+  OverflowConfig overflow;
+  std::string role = "both";
+  bool aggregate = false;
+  bool detect = false;
+  DetectorConfig detector_config;
+  bool custom_alerts = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if (arg == "--port" && has_value)
+      config.port = static_cast<uint16_t>(std::stoi(argv[++i]));
+    else if (arg == "--batch" && has_value)
+    {
+      if (config.frame_mode == FrameMode::PerPacket)
+        config.frame_mode = FrameMode::Batched;
+      config.batch_size = std::stoul(argv[++i]);
+    }
+    else if (arg == "--codec" && has_value)
+    {
+      std::string name = argv[++i];
+      if (name == "deflate")
+        config.codec = PayloadCodec::Deflate;
+      else if (name == "columnar")
+        config.codec = PayloadCodec::Columnar;
+      else if (name == "quantized")
+        config.codec = PayloadCodec::Quantized;
+      else
+      {
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    else if (arg == "--quantize" && has_value)
+    {
+      try
+      {
+        config.quantization.set(argv[++i]);
+      }
+      catch (const std::invalid_argument &e)
+      {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    }
+    else if (arg == "--compress" && has_value)
+    {
+      try
+      {
+        config.compression.mode = parse_compression_mode(argv[++i]);
+      }
+      catch (const std::invalid_argument &e)
+      {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    }
+    else if (arg == "--level" && has_value)
+      config.compression.level = std::stoi(argv[++i]);
+    else if (arg == "--dict" && has_value)
+    {
+      try
+      {
+        config.compression.dictionary = std::make_shared<const CompressionDictionary>(load_dictionary(argv[++i]));
+      }
+      catch (const std::runtime_error &e)
+      {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    }
+    else if (arg == "--ccsds")
+      config.frame_mode = FrameMode::Ccsds;
+    else if (arg == "--vc" && has_value)
+      config.virtual_channel = static_cast<uint8_t>(std::stoi(argv[++i]) & 0x7);
+    else if (arg == "--deadline-ms" && has_value)
+      config.batch_deadline = std::chrono::milliseconds(std::stol(argv[++i]));
+    else if (arg == "--links" && has_value)
+    {
+      config.receiver = ReceiverMode::Epoll;
+      config.expected_links = std::max(1, std::stoi(argv[++i]));
+    }
+    else if (arg == "--reliable")
+      config.reliable = true;
+    else if (arg == "--window" && has_value)
+      config.retransmit_window = std::max(1, std::stoi(argv[++i]));
+    else if (arg == "--decoders" && has_value)
+      config.decode_workers = std::stoul(argv[++i]);
+    else if (arg == "--reactors" && has_value)
+      config.reactor_threads = std::max(1, std::stoi(argv[++i]));
+    else if (arg == "--io" && has_value)
+    {
+      std::string name = argv[++i];
+      if (name != "sockets" && name != "uring")
+      {
+        usage(argv[0]);
+        return 1;
+      }
+      config.io_backend = name == "uring" ? IoBackend::Uring : IoBackend::Sockets;
+    }
+    else if (arg == "--uring-depth" && has_value)
+      config.uring_depth = std::max(1, std::stoi(argv[++i]));
+    else if (arg == "--udp")
+      config.transport = Transport::Udp;
+    else if (arg == "--shm")
+      config.transport = Transport::Shm;
+    else if (arg == "--shm-name" && has_value)
+    {
+      config.transport = Transport::Shm;
+      config.shm_name = argv[++i];
+    }
+    else if (arg == "--role" && has_value)
+    {
+      role = argv[++i];
+      if (role != "both" && role != "transmitter" && role != "ground-station")
+      {
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    else if (arg == "--loss" && has_value)
+      config.impairment.loss = std::stod(argv[++i]);
+    else if (arg == "--reorder" && has_value)
+      config.impairment.reorder = std::stod(argv[++i]);
+    else if (arg == "--delay-ms" && has_value)
+      config.impairment.delay = std::chrono::milliseconds(std::stol(argv[++i]));
+    else if (arg == "--jitter-ms" && has_value)
+      config.impairment.jitter = std::chrono::milliseconds(std::stol(argv[++i]));
+    else if (arg == "--priority")
+      priority = true;
+    else if (arg == "--rule" && has_value)
+    {
+      try
+      {
+        rules.push_back(ClassifierRule::parse(argv[++i]));
+      }
+      catch (const std::invalid_argument &e)
+      {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+      priority = true;
+    }
+    else if (arg == "--overflow" && has_value)
+    {
+      std::string policy = argv[++i];
+      if (policy == "block")
+        overflow.policy = OverflowPolicy::Block;
+      else if (policy == "timeout")
+        overflow.policy = OverflowPolicy::BlockTimeout;
+      else if (policy == "drop-oldest")
+        overflow.policy = OverflowPolicy::DropOldest;
+      else if (policy == "drop-newest")
+        overflow.policy = OverflowPolicy::DropNewest;
+      else if (policy == "spill")
+        overflow.policy = OverflowPolicy::Spill;
+      else
+      {
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    else if (arg == "--overflow-timeout-ms" && has_value)
+      overflow.timeout = std::chrono::milliseconds(std::stoi(argv[++i]));
+    else if (arg == "--spill-dir" && has_value)
+      overflow.spill_dir = argv[++i];
+    else if (arg == "--spill-packets" && has_value)
+      overflow.spill_capacity = std::stoull(argv[++i]);
+    else if (arg == "--link-rate" && has_value)
+      config.link_rate = std::stoull(argv[++i]);
+    else if (arg == "--archive")
+      config.log_options.format = LogFormat::Archive;
+    else if (arg == "--source" && has_value)
+      sim.source_id = static_cast<uint32_t>(std::stoul(argv[++i]));
+    else if (arg == "--log-writers" && has_value)
+      config.log_writers = std::max(1, std::stoi(argv[++i]));
+    else if (arg == "--aggregate")
+      aggregate = true;
+    else if (arg == "--detect")
+      detect = true;
+    else if (arg == "--alert" && has_value)
+    {
+      try
+      {
+        if (!custom_alerts)
+          detector_config.rules.clear();
+        detector_config.rules.push_back(AnomalyRule::parse(argv[++i]));
+      }
+      catch (const std::invalid_argument &e)
+      {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+      custom_alerts = true;
+      detect = true;
+    }
+    else if (arg == "--quiet")
+      config.verbose = false;
+    else if (arg == "--seed" && has_value)
+      sim.seed = std::stoull(argv[++i]);
+    else if (arg == "--dt" && has_value)
+      sim.dt = std::stod(argv[++i]);
+    else if (arg == "--speed" && has_value)
+      sim.speed = std::max(0.0, std::stod(argv[++i]));
+    else if (arg == "--packets" && has_value)
+      sim.max_packets = std::stoull(argv[++i]);
+    else if (arg == "--headless")
+    {
+      sim.speed = 0;
+      config.verbose = false;
+    }
+    else if (arg == "--metrics-port" && has_value)
+      metrics_port = static_cast<uint16_t>(std::stoi(argv[++i]));
+    else if (arg == "--metrics-file" && has_value)
+      metrics_file = argv[++i];
+    else if (arg == "--metrics-interval-ms" && has_value)
+      metrics_interval = std::chrono::milliseconds(std::stol(argv[++i]));
+    else
+    {
+      usage(argv[0]);
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  if (config.reliable && (config.transport != Transport::Tcp || config.frame_mode == FrameMode::Ccsds ||
+                          config.receiver == ReceiverMode::Epoll))
+  {
+    std::cerr << "--reliable runs one TCP link with length-prefixed frames; it cannot be combined with --udp, --shm, --ccsds or --links\n";
+    return 1;
+  }
+  if (config.transport == Transport::Shm && config.receiver == ReceiverMode::Epoll)
+  {
+    std::cerr << "--shm is a single link; it cannot be combined with --links\n";
+    return 1;
+  }
+  if (role != "both" && config.transport == Transport::Shm && config.shm_name.empty())
+  {
+    std::cerr << "--role needs --shm-name with --shm, so both processes open the same ring\n";
+    return 1;
+  }
+  if (config.compression.mode != CompressionMode::Zlib &&
+      ((config.frame_mode != FrameMode::PerPacket && config.transport != Transport::Udp) ||
+       (config.transport == Transport::Udp && config.codec == PayloadCodec::Columnar)))
+  {
+    std::cerr << "--compress applies to per-packet frames and zlib UDP datagrams; --batch and --ccsds frames use --codec\n";
+    return 1;
+  }
+  if (config.compression.mode == CompressionMode::Dictionary && !config.compression.dictionary)
+  {
+    std::cerr << "--compress dict needs --dict PATH\n";
+    return 1;
+  }
+  if (config.compression.level < Z_DEFAULT_COMPRESSION || config.compression.level > Z_BEST_COMPRESSION)
+  {
+    std::cerr << "--level must be 0-9\n";
+    return 1;
+  }
+  if (config.codec == PayloadCodec::Columnar && config.frame_mode == FrameMode::PerPacket && config.transport != Transport::Udp)
+  {
+    std::cerr << "--codec columnar needs --batch or --ccsds frames, or --udp\n";
+    return 1;
+  }
+  if (config.codec == PayloadCodec::Quantized)
+  {
+    if (config.frame_mode != FrameMode::Batched || config.transport == Transport::Udp)
+    {
+      std::cerr << "--codec quantized needs --batch on a TCP or --shm link\n";
+      return 1;
+    }
+    try
+    {
+      std::cout << "Quantized telemetry:\n"
+                << QuantizedCodec(config.quantization).describe();
+    }
+    catch (const std::invalid_argument &e)
+    {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+  }
+
+  // Print the seed so any run can be replayed with --seed
+  sim.seed = resolve_seed(sim.seed);
+  std::cout << "Starting Space Telemetry Simulation (seed " << sim.seed << ", dt " << sim.dt << " s, speed "
+            << (sim.speed > 0 ? std::to_string(sim.speed) + "x" : std::string("max")) << ")..." << std::endl;
+
+  if (aggregate && role != "transmitter")
+  {
+    config.aggregator = std::make_shared<TelemetryAggregator>(default_aggregation(sim.dt));
+    export_window_metrics(config.aggregator);
+  }
+  if (detect && role != "transmitter")
+  {
+    // Straight to stderr, ahead of the packet log
+    config.detector = std::make_shared<AnomalyDetector>(detector_config, [rules = detector_config.rules](const AnomalyEvent &e)
+                                                        { std::cerr << "[ALERT] source " << e.source << " t=" << e.timestamp << " " << rules[e.rule].describe()
+                                                                    << " (measured " << e.measured << ", value " << e.value << ")" << std::endl; });
+  }
+  auto print_aggregates = [&]
+  {
+    if (config.aggregator)
+      std::cout << "[Ground Station] Window statistics:\n"
+                << config.aggregator->summary();
+  };
+
+  std::unique_ptr<MetricsExporter> exporter;
+  if (metrics_port != 0 || !metrics_file.empty())
+    exporter = std::make_unique<MetricsExporter>(metrics_port, metrics_file, metrics_interval);
+
+  if (role == "ground-station")
+  {
+    ground_station_thread(config);
+    print_aggregates();
+    return 0;
+  }
+
+  // Each link is one sensor thread feeding one transmitter thread, so the lock-free ring applies
+  size_t links = config.receiver == ReceiverMode::Epoll ? config.expected_links : 1;
+  std::vector<std::unique_ptr<TelemetryBuffer>> buffers;
+  std::vector<std::unique_ptr<PriorityTelemetryBuffer>> priority_buffers;
+  PriorityConfig priority_config;
+  if (!rules.empty())
+    priority_config.classifier = PacketClassifier(rules);
+  for (size_t i = 0; i < links; ++i)
+  {
+    if (priority)
+      priority_buffers.push_back(std::make_unique<PriorityTelemetryBuffer>(priority_config));
+    else
+    {
+      // The lock-free ring's producer cannot evict or refill at the consumer's end
+      bool locked = overflow.policy == OverflowPolicy::DropOldest || overflow.policy == OverflowPolicy::Spill;
+      try
+      {
+        buffers.push_back(std::make_unique<TelemetryBuffer>(100, locked ? BufferMode::Locked : BufferMode::SpscRing,
+                                                            WaitStrategy::SpinThenPark, overflow));
+      }
+      catch (const std::runtime_error &e)
+      {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    }
+  }
 
-  std::thread ground_station(ground_station_thread);
+  // A transmitter-only run expects the ground station in another process
+  std::thread ground_station;
+  if (role == "both")
+  {
+    ground_station = std::thread(ground_station_thread, config);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
 
-  std::this_thread::sleep_for(std::chrono::seconds(1));
+  std::vector<std::thread> sensors, transmitters;
+  for (size_t i = 0; i < links; ++i)
+  {
+    SimulationConfig link_sim = sim;
+    link_sim.seed = sim.seed + i; // each link gets its own stream
+    link_sim.source_id = sim.source_id + static_cast<uint32_t>(i); // and is its own spacecraft
+    LinkConfig link_config = config;
+    link_config.impairment.seed = link_sim.seed; // and its own impairment pattern
+    if (priority)
+    {
+      PriorityTelemetryBuffer &buffer = *priority_buffers[i];
+      sensors.emplace_back([&buffer, link_sim]
+                           { sensor_thread(buffer, link_sim); });
+      transmitters.emplace_back([&buffer, link_config]
+                                { transmitter_thread(buffer, link_config); });
+    }
+    else
+    {
+      TelemetryBuffer &buffer = *buffers[i];
+      sensors.emplace_back([&buffer, link_sim]
+                           { sensor_thread(buffer, link_sim); });
+      transmitters.emplace_back([&buffer, link_config]
+                                { transmitter_thread(buffer, link_config); });
+    }
+  }
 
-  std::thread sensor(sensor_thread, std::ref(buffer));
-  std::thread transmitter(transmitter_thread, std::ref(buffer));
+  // Sensors only return on their own with --packets. Let the transmitters
+  // drain what is queued, then shut the links down. A transmitter that gave
+  // up has already shut its buffer, and what is left in it is lost.
+  for (size_t i = 0; i < links; ++i)
+  {
+    sensors[i].join();
+    auto queued = [&]
+    { return priority ? priority_buffers[i]->size() : buffers[i]->size(); };
+    auto stopped = [&]
+    { return priority ? priority_buffers[i]->is_shutdown() : buffers[i]->is_shutdown(); };
+    while (queued() > 0 && !stopped())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (stopped())
+      continue;
+    if (priority)
+      priority_buffers[i]->shutdown();
+    else
+      buffers[i]->shutdown();
+  }
+  for (auto &t : transmitters)
+    t.join();
+  if (ground_station.joinable())
+    ground_station.join();
+  print_aggregates();
 
-  sensor.join();
-  transmitter.join();
-  ground_station.join();
+  for (size_t i = 0; i < buffers.size(); ++i)
+    if (buffers[i]->dropped() + buffers[i]->evicted() + buffers[i]->spilled() > 0)
+      std::cout << "[Buffer] link " << i << ": " << buffers[i]->dropped() << " dropped, " << buffers[i]->evicted()
+                << " evicted, " << buffers[i]->spilled() << " spilled to disk\n";
 
   return 0;
-}
\ No newline at end of file
+}
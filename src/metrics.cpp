@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../include/metrics.h"
+#include "../include/net.h"
+
+namespace
+{
+  std::string format_value(double v)
+  {
+    if (std::isinf(v))
+      return v > 0 ? "+Inf" : "-Inf";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", v);
+    return buf;
+  }
+
+  std::string series(const std::string &name, const std::string &labels, const std::string &extra = "")
+  {
+    if (labels.empty() && extra.empty())
+      return name;
+    std::string all = labels;
+    if (!extra.empty())
+      all += (all.empty() ? "" : ",") + extra;
+    return name + "{" + all + "}";
+  }
+}
+
+uint64_t Counter::value() const
+{
+  uint64_t total = 0;
+  for (const Slot &s : slots_)
+    total += s.value.load(std::memory_order_relaxed);
+  return total;
+}
+
+uint64_t HistogramSnapshot::percentile(double p) const
+{
+  if (count == 0)
+    return 0;
+  uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * count));
+  rank = std::max<uint64_t>(rank, 1);
+
+  uint64_t seen = 0;
+  for (size_t b = 0; b < buckets.size(); ++b)
+  {
+    seen += buckets[b];
+    if (seen >= rank)
+      return Histogram::bucket_upper(b);
+  }
+  return Histogram::bucket_upper(buckets.size() - 1);
+}
+
+Histogram::Histogram() : stripes_(std::make_unique<Stripe[]>(kMetricStripes)) {}
+
+uint64_t Histogram::bucket_lower(size_t bucket)
+{
+  if (bucket < 2 * kHistogramSubBuckets)
+    return bucket;
+  unsigned exp = bucket / kHistogramSubBuckets + 2;
+  uint64_t sub = bucket % kHistogramSubBuckets;
+  return (kHistogramSubBuckets + sub) << (exp - 3);
+}
+
+uint64_t Histogram::bucket_upper(size_t bucket)
+{
+  if (bucket < 2 * kHistogramSubBuckets)
+    return bucket;
+  unsigned exp = bucket / kHistogramSubBuckets + 2;
+  return bucket_lower(bucket) + ((uint64_t{1} << (exp - 3)) - 1);
+}
+
+HistogramSnapshot Histogram::snapshot() const
+{
+  HistogramSnapshot snap;
+  snap.buckets.assign(kHistogramBuckets, 0);
+  for (size_t s = 0; s < kMetricStripes; ++s)
+  {
+    for (size_t b = 0; b < kHistogramBuckets; ++b)
+      snap.buckets[b] += stripes_[s].buckets[b].load(std::memory_order_relaxed);
+    snap.sum += stripes_[s].sum.load(std::memory_order_relaxed);
+  }
+  for (uint64_t n : snap.buckets)
+    snap.count += n;
+  return snap;
+}
+
+MetricsRegistry::Entry &MetricsRegistry::lookup(const std::string &name, const std::string &help,
+                                                const std::string &labels, Kind kind)
+{
+  for (auto &e : entries_)
+    if (e->name == name && e->labels == labels)
+    {
+      if (e->kind != kind)
+        throw std::invalid_argument("Metric " + name + " registered with two different types");
+      return *e;
+    }
+
+  auto e = std::make_unique<Entry>();
+  e->name = name;
+  e->help = help;
+  e->labels = labels;
+  e->kind = kind;
+  entries_.push_back(std::move(e));
+  return *entries_.back();
+}
+
+Counter &MetricsRegistry::counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  Entry &e = lookup(name, help, labels, Kind::Counter);
+  if (!e.counter)
+    e.counter = std::make_unique<Counter>();
+  return *e.counter;
+}
+
+Gauge &MetricsRegistry::gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  Entry &e = lookup(name, help, labels, Kind::Gauge);
+  if (!e.gauge)
+    e.gauge = std::make_unique<Gauge>();
+  return *e.gauge;
+}
+
+void MetricsRegistry::gauge(const std::string &name, const std::string &help, std::function<double()> read,
+                            const std::string &labels)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  Entry &e = lookup(name, help, labels, Kind::GaugeCallback);
+  if (!e.read)
+    e.read = std::move(read);
+}
+
+void MetricsRegistry::remove(const std::string &name, const std::string &labels)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [&](const std::unique_ptr<Entry> &e)
+                                { return e->name == name && e->labels == labels; }),
+                 entries_.end());
+}
+
+Histogram &MetricsRegistry::histogram(const std::string &name, const std::string &help, const std::string &labels,
+                                      double scale)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  Entry &e = lookup(name, help, labels, Kind::Histogram);
+  if (!e.histogram)
+  {
+    e.histogram = std::make_unique<Histogram>();
+    e.scale = scale;
+  }
+  return *e.histogram;
+}
+
+std::string MetricsRegistry::render_prometheus() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  std::ostringstream out;
+  std::vector<bool> done(entries_.size(), false);
+
+  // Series sharing a name are grouped under one HELP/TYPE block
+  for (size_t i = 0; i < entries_.size(); ++i)
+  {
+    if (done[i])
+      continue;
+    const Entry &first = *entries_[i];
+    const char *type = first.kind == Kind::Counter     ? "counter"
+                       : first.kind == Kind::Histogram ? "histogram"
+                                                       : "gauge";
+    out << "# HELP " << first.name << " " << first.help << "\n"
+        << "# TYPE " << first.name << " " << type << "\n";
+
+    for (size_t j = i; j < entries_.size(); ++j)
+    {
+      const Entry &e = *entries_[j];
+      if (done[j] || e.name != first.name)
+        continue;
+      done[j] = true;
+
+      switch (e.kind)
+      {
+      case Kind::Counter:
+        out << series(e.name, e.labels) << " " << e.counter->value() << "\n";
+        break;
+      case Kind::Gauge:
+        out << series(e.name, e.labels) << " " << e.gauge->value() << "\n";
+        break;
+      case Kind::GaugeCallback:
+        out << series(e.name, e.labels) << " " << format_value(e.read()) << "\n";
+        break;
+      case Kind::Histogram:
+      {
+        // The fine buckets are for in-process percentiles; a scrape gets one
+        // bound per power of two, empty or not, so its le set never changes
+        HistogramSnapshot snap = e.histogram->snapshot();
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < snap.buckets.size(); ++b)
+        {
+          cumulative += snap.buckets[b];
+          uint64_t next = Histogram::bucket_upper(b) + 1; // wraps to 0 after the last bucket
+          if ((next & (next - 1)) != 0)
+            continue;
+          std::string le = "le=\"" + format_value(Histogram::bucket_upper(b) * e.scale) + "\"";
+          out << series(e.name + "_bucket", e.labels, le) << " " << cumulative << "\n";
+        }
+        out << series(e.name + "_bucket", e.labels, "le=\"+Inf\"") << " " << snap.count << "\n"
+            << series(e.name + "_sum", e.labels) << " " << format_value(snap.sum * e.scale) << "\n"
+            << series(e.name + "_count", e.labels) << " " << snap.count << "\n";
+        break;
+      }
+      }
+    }
+  }
+  return out.str();
+}
+
+bool MetricsRegistry::write_file(const std::string &path) const
+{
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    if (!out)
+      return false;
+    out << render_prometheus();
+    if (!out)
+      return false;
+  }
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+MetricsRegistry &metrics()
+{
+  static MetricsRegistry registry;
+  return registry;
+}
+
+Histogram &stage_histogram(const std::string &stage)
+{
+  return metrics().histogram("telemetry_stage_duration_seconds", "Time spent in each pipeline stage",
+                             "stage=\"" + stage + "\"");
+}
+
+MetricsExporter::MetricsExporter(uint16_t port, const std::string &path, std::chrono::milliseconds interval)
+    : path_(path), interval_(std::max(interval, std::chrono::milliseconds(1))), stop_fd_(eventfd(0, EFD_NONBLOCK))
+{
+  if (port != 0)
+  {
+    listen_fd_ = open_listen_socket(port, 16, true);
+    if (listen_fd_ >= 0)
+      set_nonblocking(listen_fd_);
+  }
+  thread_ = std::thread(&MetricsExporter::run, this);
+}
+
+MetricsExporter::~MetricsExporter()
+{
+  uint64_t one = 1;
+  (void)!write(stop_fd_, &one, sizeof(one));
+  thread_.join();
+
+  if (!path_.empty())
+    metrics().write_file(path_);
+  if (listen_fd_ >= 0)
+    close(listen_fd_);
+  close(stop_fd_);
+}
+
+void MetricsExporter::serve(int client)
+{
+  // Any request gets the snapshot; read (and ignore) it first so the client
+  // does not see a reset for unread data
+  timeval timeout{1, 0};
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  char request[1024];
+  (void)!recv(client, request, sizeof(request), 0);
+
+  std::string body = metrics().render_prometheus();
+  std::string response = "HTTP/1.0 200 OK\r\n"
+                         "Content-Type: text/plain; version=0.0.4\r\n"
+                         "Content-Length: " +
+                         std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+  send_all(client, reinterpret_cast<const uint8_t *>(response.data()), response.size());
+  close(client);
+}
+
+void MetricsExporter::run()
+{
+  auto next_dump = std::chrono::steady_clock::now() + interval_;
+
+  while (true)
+  {
+    int timeout = -1;
+    if (!path_.empty())
+    {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(next_dump - std::chrono::steady_clock::now());
+      timeout = static_cast<int>(std::max<int64_t>(left.count(), 0));
+    }
+
+    pollfd fds[2] = {{stop_fd_, POLLIN, 0}, {listen_fd_, POLLIN, 0}};
+    int n = poll(fds, listening() ? 2 : 1, timeout);
+    if (n < 0 && errno != EINTR)
+      return;
+    if (fds[0].revents & POLLIN)
+      return;
+
+    if (listening() && (fds[1].revents & POLLIN))
+    {
+      int client;
+      while ((client = accept(listen_fd_, nullptr, nullptr)) >= 0) // blocking, unlike the listener
+        serve(client);
+    }
+
+    if (!path_.empty() && std::chrono::steady_clock::now() >= next_dump)
+    {
+      metrics().write_file(path_);
+      next_dump += interval_;
+    }
+  }
+}
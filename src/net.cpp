@@ -0,0 +1,159 @@
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "../include/net.h"
+#include "../include/metrics.h"
+
+int open_listen_socket(uint16_t port, int backlog, bool loopback_only)
+{
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+  {
+    perror("socket");
+    return -1;
+  }
+
+  // Lets back-to-back runs rebind while the previous socket sits in TIME_WAIT
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(loopback_only ? INADDR_LOOPBACK : INADDR_ANY);
+
+  if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)))
+  {
+    perror("bind");
+    close(sock);
+    return -1;
+  }
+  if (listen(sock, backlog))
+  {
+    perror("listen");
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+int connect_loopback(uint16_t port, bool quiet)
+{
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+  {
+    perror("socket");
+    return -1;
+  }
+
+  sockaddr_in server_addr{};
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(port);
+  inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
+
+  if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+  {
+    if (!quiet)
+      perror("connect");
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+int open_udp_socket(uint16_t port, bool loopback_only)
+{
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0)
+  {
+    perror("socket");
+    return -1;
+  }
+
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(loopback_only ? INADDR_LOOPBACK : INADDR_ANY);
+
+  if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)))
+  {
+    perror("bind");
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+int connect_udp_loopback(uint16_t port)
+{
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0)
+  {
+    perror("socket");
+    return -1;
+  }
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+  {
+    perror("connect");
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+uint16_t local_port(int fd)
+{
+  sockaddr_in addr{};
+  socklen_t len = sizeof(addr);
+  if (getsockname(fd, (struct sockaddr *)&addr, &len) < 0)
+    return 0;
+  return ntohs(addr.sin_port);
+}
+
+bool set_nonblocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool send_all(int sock, const uint8_t *data, size_t len)
+{
+  static Counter &calls = metrics().counter("telemetry_io_syscalls_total", "Syscalls made to move link bytes", "call=\"send\"");
+  while (len > 0)
+  {
+    calls.add();
+    ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool recv_all(int sock, uint8_t *data, size_t len)
+{
+  static Counter &calls = metrics().counter("telemetry_io_syscalls_total", "Syscalls made to move link bytes", "call=\"recv\"");
+  while (len > 0)
+  {
+    calls.add();
+    ssize_t n = recv(sock, data, len, 0);
+    if (n <= 0)
+      return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "../include/priority_buffer.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  struct PriorityMetrics
+  {
+    Counter *queued[kPriorityClasses];
+
+    PriorityMetrics()
+    {
+      for (size_t c = 0; c < kPriorityClasses; ++c)
+        queued[c] = &metrics().counter("telemetry_priority_packets_total", "Packets queued per transmit priority",
+                                       std::string("class=\"") + priority_name(static_cast<PacketPriority>(c)) + "\"");
+    }
+  };
+
+  PriorityMetrics &priority_metrics()
+  {
+    static PriorityMetrics m;
+    return m;
+  }
+}
+
+const char *priority_name(PacketPriority priority)
+{
+  switch (priority)
+  {
+  case PacketPriority::Alarm:
+    return "alarm";
+  case PacketPriority::Warning:
+    return "warning";
+  default:
+    return "routine";
+  }
+}
+
+ClassifierRule ClassifierRule::parse(const std::string &text)
+{
+  size_t op = text.find_first_of("<>");
+  size_t eq = text.find('=', op == std::string::npos ? 0 : op);
+  if (op == std::string::npos || eq == std::string::npos || op == 0 || eq == op + 1)
+    throw std::invalid_argument("Rule must look like field<value=class: " + text);
+
+  ClassifierRule rule;
+  std::string field = text.substr(0, op);
+  if (field == "temperature")
+    rule.field = Field::Temperature;
+  else if (field == "radiation")
+    rule.field = Field::Radiation;
+  else if (field == "battery_voltage")
+    rule.field = Field::BatteryVoltage;
+  else
+    throw std::invalid_argument("Unknown rule field: " + field);
+
+  rule.above = text[op] == '>';
+  try
+  {
+    size_t used = 0;
+    std::string value = text.substr(op + 1, eq - op - 1);
+    rule.threshold = std::stof(value, &used);
+    if (used != value.size())
+      throw std::invalid_argument(value);
+  }
+  catch (const std::exception &)
+  {
+    throw std::invalid_argument("Bad rule threshold: " + text);
+  }
+
+  std::string cls = text.substr(eq + 1);
+  if (cls == "alarm")
+    rule.priority = PacketPriority::Alarm;
+  else if (cls == "warning")
+    rule.priority = PacketPriority::Warning;
+  else if (cls == "routine")
+    rule.priority = PacketPriority::Routine;
+  else
+    throw std::invalid_argument("Unknown rule class: " + cls);
+  return rule;
+}
+
+PacketClassifier::PacketClassifier()
+    : rules_{
+          {ClassifierRule::Field::BatteryVoltage, false, 10.5f, PacketPriority::Alarm},
+          {ClassifierRule::Field::Radiation, true, 0.5f, PacketPriority::Alarm}, // ten times the orbital baseline
+          {ClassifierRule::Field::Temperature, true, 60.0f, PacketPriority::Warning},
+          {ClassifierRule::Field::Temperature, false, -20.0f, PacketPriority::Warning},
+      }
+{
+}
+
+PacketPriority PacketClassifier::classify(const TelemetryPacket &pkt) const
+{
+  for (const ClassifierRule &rule : rules_)
+  {
+    float v = rule.field == ClassifierRule::Field::Temperature ? pkt.temperature
+              : rule.field == ClassifierRule::Field::Radiation ? pkt.radiation
+                                                               : pkt.battery_voltage;
+    if (rule.above ? v > rule.threshold : v < rule.threshold)
+      return rule.priority;
+  }
+  return PacketPriority::Routine;
+}
+
+PriorityTelemetryBuffer::PriorityTelemetryBuffer(const PriorityConfig &config) : config_(config)
+{
+  for (size_t c = 0; c < kPriorityClasses; ++c)
+  {
+    queues_[c].ring.resize(std::max<size_t>(config_.capacity[c], 1));
+    config_.weight[c] = std::max<uint32_t>(config_.weight[c], 1);
+  }
+}
+
+size_t PriorityTelemetryBuffer::total_locked() const
+{
+  size_t total = 0;
+  for (const Queue &q : queues_)
+    total += q.count;
+  return total;
+}
+
+void PriorityTelemetryBuffer::push(const TelemetryPacket &pkt)
+{
+  push_n(&pkt, 1);
+}
+
+size_t PriorityTelemetryBuffer::push_n(const TelemetryPacket *pkts, size_t count)
+{
+  PriorityMetrics &m = priority_metrics();
+  thread_local std::vector<uint8_t> classes;
+  classes.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    classes[i] = static_cast<uint8_t>(config_.classifier.classify(pkts[i]));
+
+  // One class at a time, most urgent first: a producer stuck waiting for
+  // Routine space has already queued the batch's alarms. Order across
+  // classes is the scheduler's business anyway.
+  std::unique_lock<std::mutex> lock(mtx_);
+  size_t queued = 0;
+  for (size_t cls = 0; cls < kPriorityClasses; ++cls)
+  {
+    Queue &q = queues_[cls];
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (classes[i] != cls)
+        continue;
+      if (q.count == q.ring.size())
+      {
+        // Hand over what is queued so far before sleeping, or the consumer might never come
+        cv_data_.notify_one();
+        q.cv_space.wait(lock, [&]
+                        { return q.count < q.ring.size() || stop_; });
+      }
+      if (stop_)
+        return queued;
+
+      q.ring[(q.head + q.count) % q.ring.size()] = pkts[i];
+      q.count++;
+      queued++;
+      m.queued[cls]->add();
+    }
+  }
+  cv_data_.notify_one();
+  return queued;
+}
+
+size_t PriorityTelemetryBuffer::take(size_t cls, TelemetryPacket *out, size_t max_count)
+{
+  Queue &q = queues_[cls];
+  size_t n = std::min(q.count, max_count);
+  for (size_t i = 0; i < n; ++i)
+    out[i] = q.ring[(q.head + i) % q.ring.size()];
+  if (n > 0)
+  {
+    q.head = (q.head + n) % q.ring.size();
+    q.count -= n;
+    q.cv_space.notify_all();
+  }
+  return n;
+}
+
+size_t PriorityTelemetryBuffer::schedule(TelemetryPacket *out, size_t max_count)
+{
+  size_t n = take(static_cast<size_t>(PacketPriority::Alarm), out, max_count);
+
+  // Deficit round-robin over the rest. Packets all cost the same, so a
+  // class's deficit is simply how many more packets it may send this turn;
+  // a turn cut short by max_count resumes on the next call.
+  while (n < max_count)
+  {
+    bool pending = false;
+    for (size_t c = 1; c < kPriorityClasses; ++c)
+      pending = pending || queues_[c].count > 0;
+    if (!pending)
+      break;
+
+    size_t c = next_class_;
+    if (queues_[c].count > 0)
+    {
+      if (deficit_[c] == 0)
+        deficit_[c] = config_.weight[c];
+      size_t got = take(c, out + n, std::min<size_t>(deficit_[c], max_count - n));
+      deficit_[c] -= static_cast<uint32_t>(got);
+      n += got;
+      if (deficit_[c] > 0 && queues_[c].count > 0)
+        break; // out of room in this batch, not out of turn
+    }
+    deficit_[c] = queues_[c].count > 0 ? deficit_[c] : 0;
+    next_class_ = next_class_ + 1 < kPriorityClasses ? next_class_ + 1 : 1;
+  }
+  return n;
+}
+
+size_t PriorityTelemetryBuffer::pop_n(TelemetryPacket *out, size_t max_count)
+{
+  return pop_n(out, max_count, std::chrono::steady_clock::time_point::max());
+}
+
+size_t PriorityTelemetryBuffer::pop_n(TelemetryPacket *out, size_t max_count,
+                                      std::chrono::steady_clock::time_point deadline)
+{
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto ready = [&]
+  { return total_locked() > 0 || stop_; };
+  if (deadline == std::chrono::steady_clock::time_point::max())
+    cv_data_.wait(lock, ready);
+  else if (!cv_data_.wait_until(lock, deadline, ready))
+    return 0;
+  return schedule(out, max_count);
+}
+
+size_t PriorityTelemetryBuffer::size() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return total_locked();
+}
+
+size_t PriorityTelemetryBuffer::size(PacketPriority priority) const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return queues_[static_cast<size_t>(priority)].count;
+}
+
+void PriorityTelemetryBuffer::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_ = true;
+  }
+  cv_data_.notify_all();
+  for (Queue &q : queues_)
+    q.cv_space.notify_all();
+}
+
+bool PriorityTelemetryBuffer::is_shutdown() const
+{
+  return stop_;
+}
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "../include/quantized.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  constexpr size_t kHeaderSize = 14; // u64 base timestamp + u8 timestamp bits + u32 base source + u8 source bits
+  constexpr size_t kSlack = 8;      // every bit access is one unaligned 8-byte load
+
+  static_assert(kTelemetryFloatColumns + column_count_of<TelemetryPacket, uint64_t>() +
+                        column_count_of<TelemetryPacket, uint32_t>() ==
+                    column_count<TelemetryPacket>(),
+                "no quantization for this column type");
+
+  unsigned bit_width(uint64_t v)
+  {
+    return v == 0 ? 0 : 64 - __builtin_clzll(v);
+  }
+
+  // ORs value (below 2^width, width <= 32) in at bit position at. The buffer
+  // must be zeroed and have kSlack bytes past the last record.
+  inline void put_bits(uint8_t *base, size_t at, uint32_t value)
+  {
+    uint8_t *p = base + (at >> 3);
+    uint64_t word = load_le<uint64_t>(p);
+    store_le<uint64_t>(p, word | static_cast<uint64_t>(value) << (at & 7));
+  }
+
+  inline uint32_t get_bits(const uint8_t *base, size_t at, unsigned width)
+  {
+    uint64_t word = load_le<uint64_t>(base + (at >> 3)) >> (at & 7);
+    return static_cast<uint32_t>(word & ((uint64_t{1} << width) - 1));
+  }
+
+  Counter &clamped_counter()
+  {
+    static Counter &c = metrics().counter("telemetry_quantized_clamped_total",
+                                          "Values clamped to their quantization range before sending");
+    return c;
+  }
+}
+
+void QuantizationConfig::set(const std::string &spec)
+{
+  size_t eq = spec.find('=');
+  size_t c1 = spec.find(':', eq == std::string::npos ? 0 : eq);
+  size_t c2 = c1 == std::string::npos ? c1 : spec.find(':', c1 + 1);
+  if (eq == std::string::npos || c2 == std::string::npos)
+    throw std::invalid_argument("Quantization must look like column=min:max:step: " + spec);
+
+  std::string name = spec.substr(0, eq);
+  size_t column = 0;
+  while (column < kTelemetryFloatNames.size() && name != kTelemetryFloatNames[column])
+    ++column;
+  if (column == kTelemetryFloatNames.size())
+    throw std::invalid_argument("Unknown quantized column: " + name);
+
+  QuantRange range;
+  try
+  {
+    range.min = std::stof(spec.substr(eq + 1, c1 - eq - 1));
+    range.max = std::stof(spec.substr(c1 + 1, c2 - c1 - 1));
+    range.step = std::stof(spec.substr(c2 + 1));
+  }
+  catch (const std::exception &)
+  {
+    throw std::invalid_argument("Bad quantization range: " + spec);
+  }
+  ranges[column] = range;
+}
+
+QuantizedCodec::QuantizedCodec(const QuantizationConfig &config)
+{
+  for (size_t i = 0; i < kTelemetryFloatColumns; ++i)
+  {
+    const QuantRange &r = config.ranges[i];
+    double steps = (static_cast<double>(r.max) - r.min) / r.step;
+    if (!(r.step > 0) || !(r.max > r.min) || !(steps < 2147483648.0))
+      throw std::invalid_argument(std::string("Unusable quantization range for ") + kTelemetryFloatNames[i]);
+
+    Field &f = fields_[i];
+    f.min = r.min;
+    f.max = r.max;
+    f.step = r.step;
+    f.inv_step = 1.0f / r.step;
+    f.max_code = static_cast<uint32_t>(std::lround(steps));
+    f.bits = bit_width(f.max_code);
+    f.offset = field_bits_;
+    field_bits_ += f.bits;
+  }
+}
+
+void QuantizedCodec::encode(const TelemetryPacket *pkts, size_t count, std::vector<uint8_t> &out)
+{
+  if (count == 0)
+    return;
+
+  uint64_t base = pkts[0].timestamp;
+  for (size_t i = 1; i < count; ++i)
+    base = pkts[i].timestamp < base ? pkts[i].timestamp : base;
+  uint64_t spread = 0;
+  for (size_t i = 0; i < count; ++i)
+    spread |= pkts[i].timestamp - base;
+  const unsigned ts_bits = bit_width(spread);
+  uint32_t source_base = pkts[0].source_id;
+  for (size_t i = 1; i < count; ++i)
+    source_base = pkts[i].source_id < source_base ? pkts[i].source_id : source_base;
+  uint32_t source_spread = 0;
+  for (size_t i = 0; i < count; ++i)
+    source_spread |= pkts[i].source_id - source_base;
+  const unsigned source_bits = bit_width(source_spread);
+  const unsigned prefix = ts_bits + source_bits;
+  const size_t record = prefix + field_bits_;
+  const size_t body = (count * record + 7) / 8;
+
+  size_t at = out.size();
+  out.resize(at + kHeaderSize + body + kSlack, 0);
+  uint8_t *header = out.data() + at;
+  store_le<uint64_t>(header, base);
+  header[8] = static_cast<uint8_t>(ts_bits);
+  store_le<uint32_t>(header + 9, source_base);
+  header[13] = static_cast<uint8_t>(source_bits);
+  uint8_t *bits = header + kHeaderSize;
+
+  // Offsets wider than 32 bits go in two halves
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint64_t delta = pkts[i].timestamp - base;
+    put_bits(bits, i * record, static_cast<uint32_t>(delta));
+    if (ts_bits > 32)
+      put_bits(bits, i * record + 32, static_cast<uint32_t>(delta >> 32));
+  }
+  if (source_bits > 0)
+    for (size_t i = 0; i < count; ++i)
+      put_bits(bits, i * record + ts_bits, pkts[i].source_id - source_base);
+
+  codes_.resize(count);
+  uint64_t clamped = 0;
+  for_each_column_of<TelemetryPacket, float>([&](size_t c, auto col)
+                                             {
+                                               const Field f = fields_[c];
+                                               // Comparisons rather than std::clamp so NaN lands on min and the loop stays branch-free
+                                               for (size_t i = 0; i < count; ++i)
+                                               {
+                                                 float x = col.get(pkts[i]);
+                                                 float v = x > f.min ? x : f.min;
+                                                 v = v < f.max ? v : f.max;
+                                                 clamped += !(x >= f.min && x <= f.max);
+                                                 uint32_t code = static_cast<uint32_t>((v - f.min) * f.inv_step + 0.5f);
+                                                 codes_[i] = code < f.max_code ? code : f.max_code;
+                                               }
+                                               size_t pos = prefix + f.offset;
+                                               for (size_t i = 0; i < count; ++i, pos += record)
+                                                 put_bits(bits, pos, codes_[i]); });
+  if (clamped)
+    clamped_counter().add(clamped);
+
+  out.resize(at + kHeaderSize + body);
+}
+
+void QuantizedCodec::decode(const uint8_t *data, size_t len, size_t count, TelemetryPacket *out)
+{
+  if (count == 0)
+    return;
+  if (len < kHeaderSize)
+    throw std::runtime_error("Quantized decode: truncated input");
+
+  const uint64_t base = load_le<uint64_t>(data);
+  const unsigned ts_bits = data[8];
+  const uint32_t source_base = load_le<uint32_t>(data + 9);
+  const unsigned source_bits = data[13];
+  if (ts_bits > 64 || source_bits > 32)
+    throw std::runtime_error("Quantized decode: corrupt header");
+  const unsigned prefix = ts_bits + source_bits;
+  const size_t record = prefix + field_bits_;
+  const size_t body = (count * record + 7) / 8;
+  if (len - kHeaderSize < body)
+    throw std::runtime_error("Quantized decode: truncated input");
+
+  padded_.resize(body + kSlack);
+  std::memcpy(padded_.data(), data + kHeaderSize, body);
+  std::memset(padded_.data() + body, 0, kSlack);
+  const uint8_t *bits = padded_.data();
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint64_t delta = get_bits(bits, i * record, ts_bits > 32 ? 32 : ts_bits);
+    if (ts_bits > 32)
+      delta |= static_cast<uint64_t>(get_bits(bits, i * record + 32, ts_bits - 32)) << 32;
+    out[i].timestamp = base + delta;
+    out[i].source_id = source_base + get_bits(bits, i * record + ts_bits, source_bits);
+  }
+
+  for_each_column_of<TelemetryPacket, float>([&](size_t c, auto col)
+                                             {
+                                               const Field f = fields_[c];
+                                               size_t pos = prefix + f.offset;
+                                               for (size_t i = 0; i < count; ++i, pos += record)
+                                                 col.get(out[i]) = f.min + static_cast<float>(get_bits(bits, pos, f.bits)) * f.step; });
+}
+
+float QuantizedCodec::max_error(size_t column) const
+{
+  const Field &f = fields_[column];
+  // The arithmetic on both ends rounds to the float spacing of the largest magnitude involved
+  float magnitude = std::max({std::fabs(f.min), std::fabs(f.max), f.max - f.min});
+  float ulp = std::nextafter(magnitude, INFINITY) - magnitude;
+  return f.step / 2 + 2 * ulp;
+}
+
+std::string QuantizedCodec::describe() const
+{
+  std::ostringstream out;
+  for (size_t c = 0; c < kTelemetryFloatColumns; ++c)
+  {
+    const Field &f = fields_[c];
+    out << "  " << std::left << std::setw(12) << kTelemetryFloatNames[c] << "[" << f.min << ", " << f.max << "] step " << f.step
+        << ", " << f.bits << " bits, max error " << max_error(c) << "\n";
+  }
+  out << "  " << field_bits_ << " bits per packet plus the timestamp and source offsets\n";
+  return out.str();
+}
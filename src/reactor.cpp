@@ -0,0 +1,302 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <unordered_set>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "../include/frame.h"
+#include "../include/net.h"
+#include "../include/ground_station.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  constexpr size_t kReadChunk = 16 * 1024;
+  constexpr int kMaxEvents = 256;
+
+  struct Connection
+  {
+    int fd;
+    size_t id;
+    FrameAssembler assembler;
+    uint64_t packets = 0, frames = 0, wire_bytes = 0;
+    std::chrono::steady_clock::time_point opened = std::chrono::steady_clock::now();
+
+    Connection(int fd, size_t id, const LinkConfig &config) : fd(fd), id(id), assembler(config) {}
+  };
+
+  void signal_eventfd(int fd)
+  {
+    uint64_t one = 1;
+    (void)!write(fd, &one, sizeof(one));
+  }
+
+  // One epoll loop. Connections are handed over by the acceptor with adopt() and
+  // from then on are only touched by this reactor's thread.
+  class Reactor
+  {
+    const LinkConfig &config_;
+    GroundStationSink &sink_;
+    int epfd_;
+    int stop_fd_;
+    int closed_fd_; // acceptor's eventfd, bumped for every closed link
+    std::atomic<uint64_t> &total_packets_;
+    std::mutex mtx_;
+    std::unordered_set<Connection *> connections_;
+    std::vector<TelemetryPacket> packets_;
+
+    Histogram &recv_time_ = stage_histogram("recv");
+    Counter &rx_frames_ = metrics().counter("telemetry_rx_frames_total", "Frames received at the ground station");
+    Counter &rx_bytes_ = metrics().counter("telemetry_rx_bytes_total", "Bytes received at the ground station, framing included");
+    Gauge &open_links_ = metrics().gauge("telemetry_ground_station_links", "Links currently connected to the epoll ground station");
+
+    void close_connection(Connection *conn)
+    {
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - conn->opened).count();
+      if (config_.verbose)
+      {
+        std::cout << "[Ground Station] Link " << conn->id << " closed: " << conn->packets << " packets in "
+                  << conn->frames << " frames, " << conn->packets / seconds << " packets/s\n";
+        if (const CcsdsDeframer *deframer = conn->assembler.deframer())
+          std::cout << deframer->summary("[Ground Station]   ");
+      }
+
+      close(conn->fd);
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        connections_.erase(conn);
+      }
+      open_links_.add(-1);
+      delete conn;
+      signal_eventfd(closed_fd_);
+    }
+
+    // Edge-triggered, so drain the socket until it would block
+    void on_readable(Connection *conn)
+    {
+      packets_.clear();
+      bool open = true;
+
+      while (true)
+      {
+        uint8_t *dst = conn->assembler.prepare(kReadChunk);
+        uint64_t t0 = metrics_now_ns();
+        ssize_t n = recv(conn->fd, dst, conn->assembler.space(), 0);
+        if (n > 0)
+        {
+          recv_time_.record(metrics_now_ns() - t0);
+          rx_bytes_.add(n);
+          try
+          {
+            size_t frames = conn->assembler.commit(n, packets_);
+            conn->frames += frames;
+            rx_frames_.add(frames);
+          }
+          catch (const std::exception &e)
+          {
+            std::cerr << "[Ground Station] Dropping link " << conn->id << ": " << e.what() << "\n";
+            open = false;
+            break;
+          }
+          conn->wire_bytes += n;
+          continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+          break;
+        if (n < 0 && errno == EINTR)
+          continue;
+        open = false; // orderly shutdown or hard error
+        break;
+      }
+
+      conn->packets += packets_.size();
+      if (!packets_.empty())
+      {
+        sink_.deliver(packets_.data(), packets_.size());
+        total_packets_.fetch_add(packets_.size(), std::memory_order_relaxed);
+      }
+      if (!open)
+        close_connection(conn);
+    }
+
+  public:
+    Reactor(const LinkConfig &config, GroundStationSink &sink, int closed_fd, std::atomic<uint64_t> &total_packets)
+        : config_(config), sink_(sink), epfd_(epoll_create1(0)), stop_fd_(eventfd(0, EFD_NONBLOCK)),
+          closed_fd_(closed_fd), total_packets_(total_packets)
+    {
+      if (epfd_ < 0 || stop_fd_ < 0)
+        throw std::runtime_error("Failed to create reactor");
+
+      epoll_event ev{};
+      ev.events = EPOLLIN;
+      ev.data.ptr = nullptr; // the stop eventfd is the only entry without a Connection
+      epoll_ctl(epfd_, EPOLL_CTL_ADD, stop_fd_, &ev);
+    }
+
+    ~Reactor()
+    {
+      for (Connection *conn : connections_)
+      {
+        close(conn->fd);
+        delete conn;
+        open_links_.add(-1);
+      }
+      close(stop_fd_);
+      close(epfd_);
+    }
+
+    void adopt(int fd, size_t id)
+    {
+      auto *conn = new Connection(fd, id, config_);
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        connections_.insert(conn);
+      }
+      open_links_.add(1);
+
+      epoll_event ev{};
+      ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+      ev.data.ptr = conn;
+      if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+      {
+        perror("epoll_ctl");
+        close_connection(conn);
+      }
+    }
+
+    void stop() { signal_eventfd(stop_fd_); }
+
+    void run()
+    {
+      epoll_event events[kMaxEvents];
+      while (true)
+      {
+        int n = epoll_wait(epfd_, events, kMaxEvents, -1);
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n < 0)
+        {
+          perror("epoll_wait");
+          return;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+          if (events[i].data.ptr == nullptr)
+            return;
+          on_readable(static_cast<Connection *>(events[i].data.ptr));
+        }
+      }
+    }
+  };
+}
+
+void run_epoll_ground_station(const LinkConfig &config, GroundStationSink &sink, int listen_sock)
+{
+  int closed_fd = eventfd(0, EFD_NONBLOCK);
+  int epfd = epoll_create1(0);
+  set_nonblocking(listen_sock);
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = listen_sock;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, listen_sock, &ev);
+  ev.data.fd = closed_fd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, closed_fd, &ev);
+
+  std::atomic<uint64_t> total_packets{0};
+  size_t reactor_count = std::max<size_t>(config.reactor_threads, 1);
+  std::vector<std::unique_ptr<Reactor>> reactors;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < reactor_count; ++i)
+  {
+    reactors.push_back(std::make_unique<Reactor>(config, sink, closed_fd, total_packets));
+    threads.emplace_back(&Reactor::run, reactors.back().get());
+  }
+
+  std::cout << "[Ground Station] Waiting for connections on " << reactor_count << " reactor threads...\n";
+
+  size_t accepted = 0, closed = 0;
+  auto start = std::chrono::steady_clock::now();
+  // Out of descriptors, the pending link stays queued and the level-triggered
+  // listener stays ready; it is taken out of the epoll set for a while instead
+  // of spinning on accept4 until a link closes
+  const auto kAcceptPause = std::chrono::milliseconds(100);
+  bool listening = true;
+  std::chrono::steady_clock::time_point resume;
+
+  while (config.expected_links == 0 || closed < config.expected_links)
+  {
+    if (!listening && std::chrono::steady_clock::now() >= resume)
+    {
+      ev.data.fd = listen_sock;
+      epoll_ctl(epfd, EPOLL_CTL_ADD, listen_sock, &ev);
+      listening = true;
+    }
+    int timeout = -1;
+    if (!listening)
+      timeout = std::max(0, static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(resume - std::chrono::steady_clock::now()).count()));
+
+    epoll_event events[2];
+    int n = epoll_wait(epfd, events, 2, timeout);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+    {
+      perror("epoll_wait");
+      break;
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+      if (events[i].data.fd == closed_fd)
+      {
+        uint64_t count = 0;
+        if (read(closed_fd, &count, sizeof(count)) == sizeof(count))
+          closed += count;
+        continue;
+      }
+
+      // Round-robin new links over the reactors
+      while (true)
+      {
+        int client = accept4(listen_sock, nullptr, nullptr, SOCK_NONBLOCK);
+        if (client < 0)
+        {
+          if (errno == EINTR || errno == ECONNABORTED)
+            continue;
+          if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+          {
+            perror("accept4");
+            epoll_ctl(epfd, EPOLL_CTL_DEL, listen_sock, nullptr);
+            listening = false;
+            resume = std::chrono::steady_clock::now() + kAcceptPause;
+          }
+          break;
+        }
+        reactors[accepted % reactor_count]->adopt(client, accepted);
+        accepted++;
+      }
+    }
+  }
+
+  for (auto &reactor : reactors)
+    reactor->stop();
+  for (auto &t : threads)
+    t.join();
+  reactors.clear();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "[Ground Station] " << accepted << " links served on " << reactor_count << " reactors: "
+            << total_packets.load() << " packets, " << total_packets.load() / seconds << " packets/s\n";
+
+  close(epfd);
+  close(closed_fd);
+}
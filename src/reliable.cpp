@@ -0,0 +1,320 @@
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../include/reliable.h"
+#include "../include/ground_station.h"
+#include "../include/net.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  constexpr std::chrono::milliseconds kMaxBackoff(1000);
+
+  void put_u64(uint8_t *out, uint64_t value)
+  {
+    for (int i = 7; i >= 0; --i, value >>= 8)
+      out[i] = static_cast<uint8_t>(value);
+  }
+
+  uint64_t get_u64(const uint8_t *in)
+  {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i)
+      value = value << 8 | in[i];
+    return value;
+  }
+
+  bool send_ack(int sock, uint64_t next)
+  {
+    uint8_t ack[kSeqSize];
+    put_u64(ack, next);
+    return send_all(sock, ack, sizeof(ack));
+  }
+
+  // Waits for fd to become readable; false on timeout
+  bool wait_readable(int fd, std::chrono::milliseconds timeout)
+  {
+    pollfd pfd{fd, POLLIN, 0};
+    return poll(&pfd, 1, static_cast<int>(timeout.count())) > 0;
+  }
+
+  struct ReliableMetrics
+  {
+    Counter &reconnects = metrics().counter("telemetry_reliable_reconnects_total", "Reliable link reconnects after a drop");
+    Counter &retransmitted = metrics().counter("telemetry_reliable_retransmitted_frames_total",
+                                               "Frames sent again after a reconnect");
+    Counter &duplicates = metrics().counter("telemetry_reliable_duplicate_frames_total",
+                                            "Frames the ground station had already delivered");
+  };
+
+  ReliableMetrics &reliable_metrics()
+  {
+    static ReliableMetrics m;
+    return m;
+  }
+}
+
+ReliableSender::ReliableSender(const LinkConfig &config)
+    : config_(config), window_(std::max<size_t>(config.retransmit_window, 1)),
+      batch_(config.frame_mode == FrameMode::Batched ? std::max<size_t>(config.batch_size, 1) : 1),
+      packets_(window_ * batch_), counts_(window_)
+{
+  reconnect();
+}
+
+ReliableSender::~ReliableSender()
+{
+  disconnect();
+}
+
+void ReliableSender::disconnect()
+{
+  if (sock_ >= 0)
+    close(sock_);
+  sock_ = -1;
+  ack_have_ = 0;
+}
+
+bool ReliableSender::transmit(uint64_t seq)
+{
+  size_t slot = seq % window_;
+  bytes_.assign(kSeqSize, 0);
+  put_u64(bytes_.data(), seq);
+  encoder_->encode(&packets_[slot * batch_], counts_[slot], bytes_);
+  if (!send_all(sock_, bytes_.data(), bytes_.size()))
+    return false;
+
+  wire_bytes_ += bytes_.size();
+  if (seq < sent_)
+  {
+    retransmitted_++;
+    reliable_metrics().retransmitted.add();
+  }
+  sent_ = std::max(sent_, seq + 1);
+  return true;
+}
+
+// Reads whatever acks have arrived (or waits for one if block is set) and
+// leaves the latest in ack. False if the connection is gone before any ack
+// could be read; a close right after one is reported by the next call.
+bool ReliableSender::read_acks(bool block, uint64_t &ack)
+{
+  bool got = false;
+  while (true)
+  {
+    ssize_t n = recv(sock_, ack_buf_ + ack_have_, kSeqSize - ack_have_, block && !got ? 0 : MSG_DONTWAIT);
+    if (n == 0)
+      return got;
+    if (n < 0)
+      return got || (!block && (errno == EAGAIN || errno == EWOULDBLOCK));
+
+    ack_have_ += n;
+    if (ack_have_ == kSeqSize)
+    {
+      ack = get_u64(ack_buf_);
+      ack_have_ = 0;
+      got = true;
+    }
+  }
+}
+
+bool ReliableSender::wait_for_ack()
+{
+  if (!wait_readable(sock_, config_.reconnect_timeout))
+    return false; // an ack this late means the link is dead even if the socket is not
+  uint64_t ack = acked_;
+  if (!read_acks(true, ack))
+    return false;
+  acked_ = std::clamp(ack, acked_, next_seq_);
+  return true;
+}
+
+bool ReliableSender::reconnect()
+{
+  bool first = sock_ < 0 && sent_ == 0;
+  disconnect();
+
+  auto give_up = std::chrono::steady_clock::now() + config_.reconnect_timeout;
+  auto backoff = config_.reconnect_backoff;
+  while (true)
+  {
+    sock_ = connect_loopback(config_.port, true);
+    uint64_t ack = acked_;
+    if (sock_ >= 0 && wait_readable(sock_, config_.reconnect_timeout) && read_acks(true, ack))
+    {
+      // The ground station says where it is; resend from there on a fresh stream
+      acked_ = std::clamp(ack, acked_, next_seq_);
+      encoder_ = std::make_unique<FrameEncoder>(config_);
+      bool ok = true;
+      for (uint64_t seq = acked_; ok && seq < next_seq_; ++seq)
+        ok = transmit(seq);
+      if (ok)
+      {
+        if (!first)
+        {
+          reconnects_++;
+          reliable_metrics().reconnects.add();
+        }
+        return true;
+      }
+    }
+    disconnect();
+
+    if (std::chrono::steady_clock::now() + backoff > give_up)
+    {
+      std::cerr << "[Transmitter] Link down for " << config_.reconnect_timeout.count() << " ms, giving up\n";
+      return false;
+    }
+    std::this_thread::sleep_for(backoff);
+    backoff = std::min<std::chrono::milliseconds>(backoff * 2, kMaxBackoff);
+  }
+}
+
+bool ReliableSender::send(const TelemetryPacket *pkts, size_t count)
+{
+  while (next_seq_ - acked_ >= window_)
+    if (!wait_for_ack() && !reconnect())
+      return false;
+
+  // count is at most batch_, the size collect_batch() fills
+  size_t slot = next_seq_ % window_;
+  std::copy(pkts, pkts + count, &packets_[slot * batch_]);
+  counts_[slot] = static_cast<uint32_t>(count);
+  uint64_t seq = next_seq_++;
+
+  // A failed send is retried by reconnect(), which resends everything unacked
+  if (sock_ < 0 || !transmit(seq))
+    return reconnect();
+
+  uint64_t ack = acked_;
+  if (!read_acks(false, ack))
+    return reconnect();
+  acked_ = std::clamp(ack, acked_, next_seq_);
+  return true;
+}
+
+bool ReliableSender::finish()
+{
+  while (true)
+  {
+    while (acked_ < next_seq_)
+      if (!wait_for_ack() && !reconnect())
+        return false;
+
+    // The ground station echoes the end marker; without the echo the marker may be lost
+    uint8_t end[kSeqSize];
+    put_u64(end, kEndOfStream);
+    uint64_t ack = acked_;
+    bool alive = sock_ >= 0 && send_all(sock_, end, sizeof(end));
+    while (alive && ack != kEndOfStream)
+      alive = wait_readable(sock_, config_.reconnect_timeout) && read_acks(true, ack);
+    if (alive)
+    {
+      disconnect();
+      return true;
+    }
+    if (!reconnect())
+      return false;
+  }
+}
+
+void run_reliable_ground_station(const LinkConfig &config, GroundStationSink &sink, int listen_sock)
+{
+  FrameDecoder probe(config);
+  std::vector<uint8_t> seq_buf(kSeqSize), header(probe.header_size()), payload;
+  std::vector<TelemetryPacket> packets;
+  const size_t ack_every = std::max<size_t>(config.retransmit_window / 4, 1);
+
+  uint64_t next = 0, received = 0, duplicates = 0, connections = 0;
+  bool ended = false;
+  auto start = std::chrono::steady_clock::now();
+
+  Counter &rx_frames = metrics().counter("telemetry_rx_frames_total", "Frames received at the ground station");
+  Counter &rx_bytes = metrics().counter("telemetry_rx_bytes_total", "Bytes received at the ground station, framing included");
+
+  std::cout << "[Ground Station] Waiting for connection...\n";
+  while (!ended)
+  {
+    if (!wait_readable(listen_sock, config.reconnect_timeout))
+    {
+      std::cerr << "[Ground Station] No transmitter for " << config.reconnect_timeout.count() << " ms, giving up\n";
+      break;
+    }
+    int client = accept(listen_sock, nullptr, nullptr);
+    if (client < 0)
+      continue;
+    if (++connections == 1)
+      start = std::chrono::steady_clock::now();
+    if (connections == 1)
+      std::cout << "[Ground Station] Connected to transmitter.\n";
+    else if (config.verbose)
+      std::cout << "[Ground Station] Transmitter reconnected, resuming at frame " << next << ".\n";
+
+    // Every connection starts a new compression stream
+    FrameDecoder decoder(config);
+    size_t unacked = 0;
+    bool alive = send_ack(client, next);
+    while (alive && recv_all(client, seq_buf.data(), kSeqSize))
+    {
+      uint64_t seq = get_u64(seq_buf.data());
+      if (seq == kEndOfStream)
+      {
+        ended = send_ack(client, kEndOfStream);
+        break;
+      }
+
+      try
+      {
+        if (!recv_all(client, header.data(), header.size()))
+          break;
+        FrameHeader h = decoder.parse_header(header.data());
+        payload.resize(h.payload_len);
+        if (!recv_all(client, payload.data(), payload.size()))
+          break;
+        // Duplicates are decoded too, to keep the stream's state in step
+        packets.clear();
+        decoder.decode(h, payload.data(), packets);
+      }
+      catch (const std::exception &e)
+      {
+        std::cerr << "[Ground Station] Dropping connection: " << e.what() << "\n";
+        break;
+      }
+      rx_frames.add();
+      rx_bytes.add(kSeqSize + header.size() + payload.size());
+
+      if (seq < next)
+      {
+        duplicates++;
+        reliable_metrics().duplicates.add();
+        continue;
+      }
+      if (seq > next)
+      {
+        std::cerr << "[Ground Station] Frame " << seq << " arrived while expecting " << next << ", dropping connection\n";
+        break;
+      }
+      sink.deliver(packets.data(), packets.size());
+      received += packets.size();
+      next++;
+
+      // Ack every few frames, and whenever the transmitter has nothing else in flight
+      int pending = 0;
+      if (++unacked >= ack_every || (ioctl(client, FIONREAD, &pending) == 0 && pending == 0))
+      {
+        alive = send_ack(client, next);
+        unacked = 0;
+      }
+    }
+    close(client);
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "[Ground Station] " << received << " packets in " << next << " frames over " << connections
+            << " connections, " << duplicates << " duplicate frames dropped, " << received / seconds << " packets/s\n";
+}
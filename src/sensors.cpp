@@ -5,14 +5,21 @@
 #include <ctime>
 #include <algorithm>
 #include <thread>
+#include <memory>
 
 #include "../include/buffer.h"
+#include "../include/sharded_buffer.h"
+#include "../include/priority_buffer.h"
+#include "../include/simulation.h"
 
-static std::mt19937 rng(std::random_device{}());
-
+// Every sensor draws its noise from the simulator's generator, so one seed fixes the whole stream
 class Sensor
 {
+protected:
+  std::mt19937 &rng;
+
 public:
+  explicit Sensor(std::mt19937 &rng) : rng(rng) {}
   virtual void update(double dt) = 0;
   virtual ~Sensor() = default;
 };
@@ -24,7 +31,8 @@ class TemperatureSensor : public Sensor
   float cooling_rate;
 
 public:
-  TemperatureSensor(float init = 25.0f, float c_rate = -0.005f) : temperature(init), noise(0.0f, 0.05f), cooling_rate(c_rate) {}
+  TemperatureSensor(std::mt19937 &rng, float init = 25.0f, float c_rate = -0.005f)
+      : Sensor(rng), temperature(init), noise(0.0f, 0.05f), cooling_rate(c_rate) {}
 
   void update(double dt) override
   {
@@ -41,8 +49,8 @@ class RadiationSensor : public Sensor
   std::normal_distribution<float> noise;
 
 public:
-  RadiationSensor(float init = 0.1f)
-      : radiation(init), noise(0.0f, 0.002f) {}
+  RadiationSensor(std::mt19937 &rng, float init = 0.1f)
+      : Sensor(rng), radiation(init), noise(0.0f, 0.002f) {}
 
   void update(double z) override
   {
@@ -60,8 +68,8 @@ class BatterySensor : public Sensor
   float discharge_rate;
 
 public:
-  BatterySensor(float init = 12.5f, float rate = 0.0001f)
-      : voltage(init), noise(0.0f, 0.002f), discharge_rate(rate) {}
+  BatterySensor(std::mt19937 &rng, float init = 12.5f, float rate = 0.0001f)
+      : Sensor(rng), voltage(init), noise(0.0f, 0.002f), discharge_rate(rate) {}
 
   void update(double dt) override
   {
@@ -80,7 +88,7 @@ class PositionSensor : public Sensor
   double elapsed_time = 0.0;
 
 public:
-  PositionSensor() : x(R), y(0.0f), z(0.0f) {}
+  explicit PositionSensor(std::mt19937 &rng) : Sensor(rng), x(R), y(0.0f), z(0.0f) {}
 
   void update(double dt) override
   {
@@ -106,8 +114,8 @@ class OrientationSensor : public Sensor
   }
 
 public:
-  OrientationSensor()
-      : pitch(0), roll(0), yaw(0),
+  explicit OrientationSensor(std::mt19937 &rng)
+      : Sensor(rng), pitch(0), roll(0), yaw(0),
         noise_pitch(0.0f, 0.01f),
         noise_roll(0.0f, 0.01f),
         noise_yaw(0.0f, 0.02f) {}
@@ -122,53 +130,121 @@ public:
   std::array<float, 3> value() const { return {pitch, roll, yaw}; }
 };
 
-class TelemetrySimulator
+struct TelemetrySimulator::Sensors
 {
+  std::mt19937 rng;
   TemperatureSensor temp_sensor;
   RadiationSensor radiation_sensor;
   BatterySensor battery_sensor;
   PositionSensor position_sensor;
   OrientationSensor orientation_sensor;
 
-  uint64_t tick = 0;
+  explicit Sensors(uint64_t seed)
+      : rng(static_cast<std::mt19937::result_type>(seed ^ (seed >> 32))),
+        temp_sensor(rng), radiation_sensor(rng), battery_sensor(rng),
+        position_sensor(rng), orientation_sensor(rng) {}
+};
 
-public:
-  TelemetryPacket generate_packet(double dt)
+TelemetrySimulator::TelemetrySimulator(uint64_t seed) : sensors_(std::make_unique<Sensors>(seed)) {}
+TelemetrySimulator::~TelemetrySimulator() = default;
+TelemetrySimulator::TelemetrySimulator(TelemetrySimulator &&) noexcept = default;
+
+TelemetryPacket TelemetrySimulator::generate_packet(double dt)
+{
+  Sensors &s = *sensors_;
+  tick_++;
+
+  s.temp_sensor.update(dt);
+  s.position_sensor.update(dt);
+  s.radiation_sensor.update(s.position_sensor.value()[2]);
+  s.orientation_sensor.update(dt);
+  s.battery_sensor.update(dt);
+
+  TelemetryPacket pkt;
+  pkt.timestamp = tick_;
+  pkt.temperature = s.temp_sensor.value();
+  pkt.radiation = s.radiation_sensor.value();
+  pkt.battery_voltage = s.battery_sensor.value();
+  pkt.position = s.position_sensor.value();
+  pkt.orientation = s.orientation_sensor.value();
+
+  return pkt;
+}
+
+VirtualClock::VirtualClock(const SimulationConfig &config)
+    : dt_(config.dt), speed_(config.speed), start_(std::chrono::steady_clock::now()) {}
+
+void VirtualClock::advance()
+{
+  ticks_++;
+  if (speed_ <= 0)
+    return;
+  std::this_thread::sleep_until(start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                             std::chrono::duration<double>(now() / speed_)));
+}
+
+uint64_t resolve_seed(uint64_t seed)
+{
+  if (seed != 0)
+    return seed;
+  std::random_device rd;
+  return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+// Shared by every buffer flavour: anything with push_n() and is_shutdown()
+template <typename Buffer>
+static void run_sensor_loop(Buffer &buffer, const SimulationConfig &config)
+{
+  TelemetrySimulator sim(resolve_seed(config.seed));
+  VirtualClock clock(config);
+
+  // Without sleeps there is no reason to hand packets over one at a time
+  constexpr size_t kFastBatch = 64;
+  TelemetryPacket batch[kFastBatch];
+  const size_t batch_size = clock.realtime() ? 1 : kFastBatch;
+  uint64_t produced = 0;
+
+  while (!buffer.is_shutdown() && (config.max_packets == 0 || produced < config.max_packets))
   {
-    tick++;
-
-    temp_sensor.update(dt);
-    position_sensor.update(dt);
-    radiation_sensor.update(position_sensor.value()[2]);
-    orientation_sensor.update(dt);
-    battery_sensor.update(dt);
-
-    TelemetryPacket pkt;
-    pkt.timestamp = tick;
-    pkt.temperature = temp_sensor.value();
-    pkt.radiation = radiation_sensor.value();
-    pkt.battery_voltage = battery_sensor.value();
-    pkt.position = position_sensor.value();
-    pkt.orientation = orientation_sensor.value();
-
-    return pkt;
+    size_t n = batch_size;
+    if (config.max_packets != 0)
+      n = std::min<uint64_t>(n, config.max_packets - produced);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      batch[i] = sim.generate_packet(clock.dt());
+      batch[i].source_id = config.source_id;
+    }
+    buffer.push_n(batch, n);
+    produced += n;
+    // Pace after the push: sleeping first would hold each packet back a tick
+    // and leave the last one to arrive after the run is over
+    for (size_t i = 0; i < n; ++i)
+      clock.advance();
   }
-};
+}
 
-void sensor_thread(TelemetryBuffer &buffer)
+void sensor_thread(TelemetryBuffer &buffer, const SimulationConfig &config)
 {
-  TelemetrySimulator sim;
-  auto last = std::chrono::steady_clock::now();
+  run_sensor_loop(buffer, config);
+}
 
-  while (!buffer.is_shutdown())
-  {
-    auto now = std::chrono::steady_clock::now();
-    double dt = std::chrono::duration<double>(now - last).count();
-    last = now;
+void sensor_thread(ShardedTelemetryBuffer::Producer producer, const SimulationConfig &config)
+{
+  run_sensor_loop(producer, config);
+}
 
-    TelemetryPacket pkt = sim.generate_packet(dt);
-    buffer.push(pkt);
+void sensor_thread(PriorityTelemetryBuffer &buffer, const SimulationConfig &config)
+{
+  run_sensor_loop(buffer, config);
+}
 
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-  }
+void sensor_thread(TelemetryBuffer &buffer)
+{
+  run_sensor_loop(buffer, SimulationConfig{});
+}
+
+void sensor_thread(ShardedTelemetryBuffer::Producer producer)
+{
+  run_sensor_loop(producer, SimulationConfig{});
 }
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <iostream>
+
+#include "../include/sharded_buffer.h"
+
+ShardedTelemetryBuffer::ShardedTelemetryBuffer(size_t producers, size_t capacity_per_shard)
+    : capacity_(std::max<size_t>(capacity_per_shard, 1))
+{
+  shards_.reserve(std::max<size_t>(producers, 1));
+  for (size_t i = 0; i < std::max<size_t>(producers, 1); ++i)
+  {
+    shards_.push_back(std::make_unique<Shard>());
+    shards_.back()->ring.resize(capacity_);
+  }
+}
+
+void ShardedTelemetryBuffer::push(size_t producer, const TelemetryPacket &pkt)
+{
+  push_n(producer, &pkt, 1);
+}
+
+size_t ShardedTelemetryBuffer::push_n(size_t producer, const TelemetryPacket *pkts, size_t count)
+{
+  Shard &s = *shards_[producer % shards_.size()];
+  size_t pushed = 0;
+
+  while (pushed < count)
+  {
+    {
+      std::unique_lock<std::mutex> lock(s.mtx);
+      s.cv_space.wait(lock, [&]
+                      { return stop_ || s.tail - s.head < capacity_; });
+      if (stop_)
+        break;
+
+      while (pushed < count && s.tail - s.head < capacity_)
+        s.ring[s.tail++ % capacity_] = pkts[pushed++];
+      s.count.store(s.tail - s.head, std::memory_order_release);
+    }
+    wake_consumers(count > 1);
+  }
+  return pushed;
+}
+
+// Consumers publish `parked_` before re-checking the shard counts, and producers
+// publish the count before checking `parked_`, so a wakeup cannot slip between them.
+void ShardedTelemetryBuffer::wake_consumers(bool all)
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (parked_.load(std::memory_order_relaxed) == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(wait_mtx_);
+  if (all)
+    cv_data_.notify_all();
+  else
+    cv_data_.notify_one();
+}
+
+size_t ShardedTelemetryBuffer::try_pop(size_t shard, TelemetryPacket *out, size_t max_count)
+{
+  Shard &s = *shards_[shard];
+  if (s.count.load(std::memory_order_acquire) == 0)
+    return 0;
+
+  size_t n = 0;
+  {
+    std::lock_guard<std::mutex> lock(s.mtx);
+    while (n < max_count && s.head != s.tail)
+      out[n++] = s.ring[s.head++ % capacity_];
+    s.count.store(s.tail - s.head, std::memory_order_release);
+  }
+
+  if (n > 0)
+    s.cv_space.notify_one();
+  return n;
+}
+
+bool ShardedTelemetryBuffer::any_pending() const
+{
+  for (const auto &s : shards_)
+    if (s->count.load(std::memory_order_acquire) != 0)
+      return true;
+  return false;
+}
+
+TelemetryPacket ShardedTelemetryBuffer::pop(size_t consumer)
+{
+  TelemetryPacket pkt{};
+  pop_n(consumer, &pkt, 1);
+  return pkt;
+}
+
+size_t ShardedTelemetryBuffer::pop_n(size_t consumer, TelemetryPacket *out, size_t max_count)
+{
+  return pop_n(consumer, out, max_count, std::chrono::steady_clock::time_point::max());
+}
+
+size_t ShardedTelemetryBuffer::pop_n(size_t consumer, TelemetryPacket *out, size_t max_count,
+                                     std::chrono::steady_clock::time_point deadline)
+{
+  const bool timed = deadline != std::chrono::steady_clock::time_point::max();
+  const size_t shards = shards_.size();
+  const size_t home = consumer % shards;
+
+  while (true)
+  {
+    // Home shard first, then steal round-robin from the rest
+    for (size_t i = 0; i < shards; ++i)
+      if (size_t n = try_pop((home + i) % shards, out, max_count))
+        return n;
+
+    std::unique_lock<std::mutex> lock(wait_mtx_);
+    parked_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!any_pending())
+    {
+      if (stop_ || (timed && std::chrono::steady_clock::now() >= deadline))
+      {
+        parked_.fetch_sub(1, std::memory_order_relaxed);
+        return 0;
+      }
+      if (timed)
+        cv_data_.wait_until(lock, deadline);
+      else
+        cv_data_.wait(lock);
+    }
+    parked_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+size_t ShardedTelemetryBuffer::size() const
+{
+  size_t total = 0;
+  for (const auto &s : shards_)
+    total += s->count.load(std::memory_order_acquire);
+  return total;
+}
+
+void ShardedTelemetryBuffer::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(wait_mtx_);
+    stop_ = true;
+  }
+  cv_data_.notify_all();
+
+  for (auto &s : shards_)
+  {
+    // Pass through each shard lock so blocked producers observe stop_
+    {
+      std::lock_guard<std::mutex> lock(s->mtx);
+    }
+    s->cv_space.notify_all();
+  }
+
+  std::cout << "Shutting Down" << std::endl;
+}
+
+bool ShardedTelemetryBuffer::is_shutdown() const
+{
+  return stop_.load();
+}
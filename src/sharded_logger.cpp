@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+#include "../include/sharded_logger.h"
+#include "../include/metrics.h"
+
+namespace
+{
+  uint64_t splitmix64(uint64_t x)
+  {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+  }
+
+  Counter &missing_counter()
+  {
+    static Counter &c = metrics().counter("telemetry_source_missing_total",
+                                          "Ticks a source skipped over, as seen by the sharded log");
+    return c;
+  }
+
+  Counter &dropped_counter()
+  {
+    static Counter &c = metrics().counter("telemetry_source_dropped_total",
+                                          "Packets the sharded log dropped because their source's queue was full");
+    return c;
+  }
+
+  Counter &late_counter()
+  {
+    static Counter &c = metrics().counter("telemetry_source_late_total",
+                                          "Packets at or before their source's newest timestamp");
+    return c;
+  }
+}
+
+ShardedTelemetryLogger::ShardedTelemetryLogger(const std::string &prefix, const ShardedLoggerOptions &options)
+    : prefix_(prefix), options_(options)
+{
+  options_.writers = std::max<size_t>(options_.writers, 1);
+  options_.queue_packets = std::max<size_t>(options_.queue_packets, 1);
+  options_.log.async = false;
+  options_.log.flush_every_records = 0; // each turn ends with a flush()
+
+  // Writer w's points depend only on w, so adding a writer leaves the others' in place
+  for (size_t w = 0; w < options_.writers; ++w)
+    for (size_t v = 0; v < kVirtualNodes; ++v)
+      ring_.push_back({splitmix64(w * kVirtualNodes + v), w});
+  std::sort(ring_.begin(), ring_.end());
+
+  for (size_t w = 0; w < options_.writers; ++w)
+    writers_.push_back(std::make_unique<Writer>());
+  for (auto &w : writers_)
+    w->thread = std::thread(&ShardedTelemetryLogger::write_loop, this, std::ref(*w));
+}
+
+ShardedTelemetryLogger::~ShardedTelemetryLogger()
+{
+  for (auto &w : writers_)
+  {
+    {
+      std::lock_guard<std::mutex> lock(w->mtx);
+      w->stop = true;
+    }
+    w->cv_work.notify_one();
+  }
+  for (auto &w : writers_)
+    w->thread.join();
+}
+
+size_t ShardedTelemetryLogger::writer_for(uint32_t source) const
+{
+  // Seeded apart from the writer points so sources and points do not line up
+  uint64_t h = splitmix64(source ^ 0x5A17ED5EEDull);
+  auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(h, size_t{0}));
+  return it == ring_.end() ? ring_.front().second : it->second;
+}
+
+std::string ShardedTelemetryLogger::filename(uint32_t source) const
+{
+  return prefix_ + "_src" + std::to_string(source) + (options_.log.format == LogFormat::Archive ? ".tlm" : ".csv");
+}
+
+void ShardedTelemetryLogger::log_packets(const TelemetryPacket *pkts, size_t count)
+{
+  for_each_source_run(pkts, count, [&](const TelemetryPacket *run, size_t n)
+                      { enqueue(*writers_[writer_for(run->source_id)], run, n); });
+}
+
+void ShardedTelemetryLogger::enqueue(Writer &w, const TelemetryPacket *pkts, size_t count)
+{
+  std::unique_lock<std::mutex> lock(w.mtx);
+  Shard *shard = nullptr;
+  size_t queued = 0, dropped = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint32_t source = pkts[i].source_id;
+    if (!shard || shard->source != source)
+    {
+      auto &slot = w.shards[source];
+      if (!slot)
+      {
+        slot = std::make_unique<Shard>();
+        slot->source = source;
+        slot->stats.source = source;
+      }
+      shard = slot.get();
+    }
+    // Full: this source's writer is behind, and waiting would stall every other source behind the caller
+    if (shard->pending.size() >= options_.queue_packets)
+    {
+      shard->dropped++;
+      dropped++;
+      continue;
+    }
+    shard->pending.push_back(pkts[i]);
+    queued++;
+    if (!shard->queued)
+    {
+      shard->queued = true;
+      w.ready.push_back(shard);
+    }
+  }
+  w.pending += queued;
+  lock.unlock();
+  if (dropped)
+    dropped_counter().add(dropped);
+  if (queued)
+    w.cv_work.notify_one();
+}
+
+void ShardedTelemetryLogger::write_loop(Writer &w)
+{
+  std::vector<TelemetryPacket> batch;
+  std::unique_lock<std::mutex> lock(w.mtx);
+  while (true)
+  {
+    w.cv_work.wait(lock, [&]
+                   { return w.stop || !w.ready.empty(); });
+    if (w.ready.empty())
+      break; // stopped and drained
+
+    // One turn for the source at the front; whatever it has left waits at the back
+    Shard &shard = *w.ready.front();
+    w.ready.pop_front();
+    size_t n = std::min(shard.pending.size(), kTurnPackets);
+    batch.assign(shard.pending.begin(), shard.pending.begin() + n);
+    shard.pending.erase(shard.pending.begin(), shard.pending.begin() + n);
+    if (shard.pending.empty())
+      shard.queued = false;
+    else
+      w.ready.push_back(&shard);
+    SourceStats stats = shard.stats;
+    w.busy = true;
+    lock.unlock();
+
+    write_turn(w, shard, batch, stats);
+
+    lock.lock();
+    shard.stats = stats;
+    w.pending -= n;
+    w.busy = false;
+    w.cv_drained.notify_all();
+  }
+}
+
+void ShardedTelemetryLogger::write_turn(Writer &w, Shard &shard, const std::vector<TelemetryPacket> &batch,
+                                        SourceStats &stats)
+{
+  uint64_t missing = 0, late = 0;
+  for (const TelemetryPacket &pkt : batch)
+  {
+    if (stats.packets > 0 && pkt.timestamp <= stats.last_timestamp)
+      ++late;
+    else
+    {
+      if (stats.packets > 0)
+        missing += pkt.timestamp - stats.last_timestamp - 1;
+      stats.last_timestamp = pkt.timestamp;
+    }
+    ++stats.packets;
+  }
+  stats.missing += missing;
+  stats.late += late;
+  if (missing)
+    missing_counter().add(missing);
+  if (late)
+    late_counter().add(late);
+
+  shard.last_turn = ++w.turns;
+  try
+  {
+    if (!shard.logger)
+    {
+      // Archives cannot be reopened without starting over, so only CSV shards are closed to make room
+      size_t limit = std::max<size_t>(options_.max_open_files / writers_.size(), 1);
+      if (w.open.size() >= limit && options_.log.format == LogFormat::Csv)
+      {
+        auto oldest = std::min_element(w.open.begin(), w.open.end(), [](const Shard *a, const Shard *b)
+                                       { return a->last_turn < b->last_turn; });
+        (*oldest)->logger.reset();
+        *oldest = w.open.back();
+        w.open.pop_back();
+      }
+      shard.logger = std::make_unique<TelemetryLogger>(filename(shard.source), options_.log);
+      w.open.push_back(&shard);
+    }
+    shard.logger->log_packets(batch.data(), batch.size());
+    shard.logger->flush();
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "[Logger] " << e.what() << " Dropped " << batch.size() << " rows from source " << shard.source
+              << ".\n";
+  }
+}
+
+void ShardedTelemetryLogger::flush()
+{
+  for (auto &w : writers_)
+  {
+    std::unique_lock<std::mutex> lock(w->mtx);
+    w->cv_drained.wait(lock, [&]
+                       { return w->pending == 0 && !w->busy; });
+  }
+}
+
+std::vector<SourceStats> ShardedTelemetryLogger::sources() const
+{
+  std::vector<SourceStats> out;
+  for (auto &w : writers_)
+  {
+    std::lock_guard<std::mutex> lock(w->mtx);
+    for (auto &[source, shard] : w->shards)
+    {
+      out.push_back(shard->stats);
+      out.back().dropped = shard->dropped;
+    }
+  }
+  std::sort(out.begin(), out.end(), [](const SourceStats &a, const SourceStats &b)
+            { return a.source < b.source; });
+  return out;
+}
@@ -0,0 +1,424 @@
+#include <iostream>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/shm.h"
+#include "../include/frame.h"
+#include "../include/decode_pipeline.h"
+#include "../include/ground_station.h"
+#include "../include/metrics.h"
+
+// Lives at the start of the mapping, followed by the ring itself. Both
+// processes touch these atomics, so they have to be lock-free.
+struct ShmRingHeader
+{
+  std::atomic<uint64_t> magic;
+  uint64_t capacity; // bytes, a power of two
+
+  alignas(64) std::atomic<uint64_t> head; // bytes ever written; transmitter only
+  std::atomic<uint32_t> data_seq;         // futex the ground station sleeps on
+  std::atomic<uint32_t> consumer_parked;
+
+  alignas(64) std::atomic<uint64_t> tail; // bytes ever released; ground station only
+  std::atomic<uint32_t> space_seq;        // futex the transmitter sleeps on
+  std::atomic<uint32_t> producer_parked;
+
+  alignas(64) std::atomic<uint32_t> attached; // futex: the transmitter has mapped the ring
+  std::atomic<uint32_t> closed;               // the transmitter is done; head is final
+  std::atomic<uint32_t> receiver_gone;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "shared ring needs lock-free atomics");
+
+namespace
+{
+  constexpr uint64_t kMagic = 0x544c4d53484d3031; // "TLMSHM01"
+  constexpr size_t kDataOffset = 4096;            // ring starts on its own page
+  constexpr uint32_t kSkip = 0xffffffff;          // rest of the ring up to the end is unused
+  constexpr unsigned kSpinLimit = 4096;
+  constexpr auto kParkTimeout = std::chrono::milliseconds(100);
+
+  inline void cpu_relax()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  size_t record_size(size_t len)
+  {
+    return (sizeof(uint32_t) + len + 7) & ~size_t(7);
+  }
+
+  // Shared futexes, not FUTEX_PRIVATE: the other side may be another process
+  void futex_wait(std::atomic<uint32_t> &word, uint32_t expected, std::chrono::milliseconds timeout)
+  {
+    timespec ts{static_cast<time_t>(timeout.count() / 1000), static_cast<long>(timeout.count() % 1000) * 1000000};
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+  }
+
+  void futex_wake(std::atomic<uint32_t> &word)
+  {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+  }
+
+  struct ShmMetrics
+  {
+    Counter &parks = metrics().counter("telemetry_shm_parks_total", "Times a shared-memory link side slept on its futex");
+  };
+
+  ShmMetrics &shm_metrics()
+  {
+    static ShmMetrics m;
+    return m;
+  }
+
+  // Spins on ready(), then parks on seq. Same handshake as the SPSC buffer:
+  // the waiter publishes `parked` and re-checks, the other side publishes its
+  // index and then checks `parked`, so one of them always sees the other.
+  // Returns ready() once abort() holds.
+  template <typename Ready, typename Abort>
+  bool wait_for(Ready ready, Abort abort, std::atomic<uint32_t> &seq, std::atomic<uint32_t> &parked)
+  {
+    for (unsigned spins = 0; spins < kSpinLimit; ++spins)
+    {
+      if (ready())
+        return true;
+      cpu_relax();
+    }
+
+    while (true)
+    {
+      uint32_t s = seq.load(std::memory_order_acquire);
+      parked.store(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready() || abort())
+      {
+        parked.store(0, std::memory_order_relaxed);
+        return ready();
+      }
+      shm_metrics().parks.add();
+      futex_wait(seq, s, kParkTimeout);
+    }
+  }
+
+  void notify(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &parked)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed))
+    {
+      seq.fetch_add(1, std::memory_order_release);
+      futex_wake(seq);
+    }
+  }
+
+  size_t ring_capacity(size_t requested)
+  {
+    size_t capacity = 64 * 1024;
+    while (capacity < requested)
+      capacity <<= 1;
+    return capacity;
+  }
+}
+
+std::string shm_object_name(const LinkConfig &config)
+{
+  if (!config.shm_name.empty())
+    return config.shm_name[0] == '/' ? config.shm_name : "/" + config.shm_name;
+  return "/telemetry-" + std::to_string(getpid()) + "-" + std::to_string(config.port);
+}
+
+ShmSender::ShmSender(const LinkConfig &config)
+{
+  std::string name = shm_object_name(config);
+  auto give_up = std::chrono::steady_clock::now() + config.reconnect_timeout;
+  while (true)
+  {
+    // The ground station sets magic last, once the ring is ready
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    struct stat st{};
+    if (fd >= 0 && fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > kDataOffset)
+    {
+      void *mem = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+      fd = -1;
+      if (mem != MAP_FAILED)
+      {
+        auto *ring = static_cast<ShmRingHeader *>(mem);
+        if (ring->magic.load(std::memory_order_acquire) == kMagic && !ring->attached.load())
+        {
+          ring_ = ring;
+          map_size_ = st.st_size;
+          capacity_ = ring->capacity;
+          data_ = static_cast<uint8_t *>(mem) + kDataOffset;
+          head_ = ring->head.load(std::memory_order_relaxed);
+          ring_->attached.store(1, std::memory_order_release);
+          futex_wake(ring_->attached);
+          return;
+        }
+        munmap(mem, st.st_size);
+      }
+    }
+    if (fd >= 0)
+      ::close(fd);
+    if (std::chrono::steady_clock::now() >= give_up)
+    {
+      std::cerr << "[Transmitter] No ground station at shared memory " << name << "\n";
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+ShmSender::~ShmSender()
+{
+  if (!ring_)
+    return;
+  close();
+  munmap(ring_, map_size_);
+}
+
+bool ShmSender::send(const uint8_t *data, size_t len)
+{
+  const size_t need = record_size(len);
+  if (!ring_ || closed_ || need > capacity_ / 2)
+    return false;
+
+  size_t offset = head_ & (capacity_ - 1);
+  size_t to_end = capacity_ - offset;
+  size_t total = need + (to_end < need ? to_end : 0);
+  bool room = wait_for([&]
+                       { return capacity_ - (head_ - ring_->tail.load(std::memory_order_acquire)) >= total; },
+                       [&]
+                       { return ring_->receiver_gone.load(std::memory_order_acquire) != 0; },
+                       ring_->space_seq, ring_->producer_parked);
+  if (!room || ring_->receiver_gone.load(std::memory_order_acquire))
+    return false;
+
+  if (to_end < need)
+  {
+    std::memcpy(data_ + offset, &kSkip, sizeof(kSkip));
+    head_ += to_end;
+    offset = 0;
+  }
+  uint32_t len32 = static_cast<uint32_t>(len);
+  std::memcpy(data_ + offset, &len32, sizeof(len32));
+  std::memcpy(data_ + offset + sizeof(len32), data, len);
+  head_ += need;
+  ring_->head.store(head_, std::memory_order_release);
+  notify(ring_->data_seq, ring_->consumer_parked);
+  return true;
+}
+
+void ShmSender::close()
+{
+  if (!ring_ || closed_)
+    return;
+  closed_ = true;
+  ring_->closed.store(1, std::memory_order_release);
+  // Always wake: the ground station may be about to park with nothing left to read
+  ring_->data_seq.fetch_add(1, std::memory_order_release);
+  futex_wake(ring_->data_seq);
+}
+
+ShmReceiver::ShmReceiver(const LinkConfig &config) : name_(shm_object_name(config))
+{
+  capacity_ = ring_capacity(config.shm_capacity);
+  map_size_ = kDataOffset + capacity_;
+
+  // A name left behind by a crashed run is replaced, never reused
+  shm_unlink(name_.c_str());
+  int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+  {
+    perror("shm_open");
+    return;
+  }
+  linked_ = true;
+  if (ftruncate(fd, static_cast<off_t>(map_size_)) < 0)
+  {
+    perror("ftruncate");
+    ::close(fd);
+    return;
+  }
+  void *mem = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED)
+  {
+    perror("mmap");
+    return;
+  }
+
+  // ftruncate zero-fills, so every index and flag already starts at 0
+  ring_ = static_cast<ShmRingHeader *>(mem);
+  data_ = static_cast<uint8_t *>(mem) + kDataOffset;
+  ring_->capacity = capacity_;
+  ring_->magic.store(kMagic, std::memory_order_release);
+}
+
+ShmReceiver::~ShmReceiver()
+{
+  if (ring_)
+  {
+    ring_->receiver_gone.store(1, std::memory_order_release);
+    ring_->space_seq.fetch_add(1, std::memory_order_release);
+    futex_wake(ring_->space_seq);
+    munmap(ring_, map_size_);
+  }
+  if (linked_)
+    shm_unlink(name_.c_str());
+}
+
+bool ShmReceiver::wait_for_sender(std::chrono::milliseconds timeout)
+{
+  auto give_up = std::chrono::steady_clock::now() + timeout;
+  while (!ring_->attached.load(std::memory_order_acquire))
+  {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(give_up - std::chrono::steady_clock::now());
+    if (left.count() <= 0)
+      return false;
+    futex_wait(ring_->attached, 0, std::min(left, std::chrono::milliseconds(kParkTimeout)));
+  }
+  shm_unlink(name_.c_str());
+  linked_ = false;
+  return true;
+}
+
+bool ShmReceiver::next(const uint8_t *&data, size_t &len)
+{
+  while (true)
+  {
+    bool ready = wait_for([&]
+                          { return ring_->head.load(std::memory_order_acquire) != tail_; },
+                          [&]
+                          { return ring_->closed.load(std::memory_order_acquire) != 0; },
+                          ring_->data_seq, ring_->consumer_parked);
+    if (!ready)
+      return false;
+
+    size_t offset = tail_ & (capacity_ - 1);
+    uint32_t len32;
+    std::memcpy(&len32, data_ + offset, sizeof(len32));
+    if (len32 == kSkip)
+    {
+      tail_ += capacity_ - offset; // handed back along with the next record
+      continue;
+    }
+    data = data_ + offset + sizeof(len32);
+    len = len32;
+    held_ = record_size(len32);
+    return true;
+  }
+}
+
+void ShmReceiver::release()
+{
+  tail_ += held_;
+  held_ = 0;
+  ring_->tail.store(tail_, std::memory_order_release);
+  notify(ring_->space_seq, ring_->producer_parked);
+}
+
+void run_shm_ground_station(const LinkConfig &config, GroundStationSink &sink)
+{
+  ShmReceiver receiver(config);
+  if (!receiver.ok())
+    return;
+
+  std::cout << "[Ground Station] Waiting for transmitter on shared memory " << shm_object_name(config) << "...\n";
+  if (!receiver.wait_for_sender(config.reconnect_timeout))
+  {
+    std::cerr << "[Ground Station] No transmitter for " << config.reconnect_timeout.count() << " ms, giving up\n";
+    return;
+  }
+  std::cout << "[Ground Station] Connected to transmitter.\n";
+
+  FrameDecoder decoder(config);
+  const size_t header_size = decoder.header_size();
+  std::vector<TelemetryPacket> packets;
+  uint64_t received = 0, frames = 0, wire_bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  Counter &rx_frames = metrics().counter("telemetry_rx_frames_total", "Frames received at the ground station");
+  Counter &rx_bytes = metrics().counter("telemetry_rx_bytes_total", "Bytes received at the ground station, framing included");
+
+  const bool ccsds = config.frame_mode == FrameMode::Ccsds;
+  FrameAssembler assembler(config);
+  std::unique_ptr<DecodePipeline> pipeline;
+  if (config.decode_workers > 0 && !ccsds)
+    pipeline = std::make_unique<DecodePipeline>(config, [&sink](const TelemetryPacket *pkts, size_t count)
+                                                { sink.deliver(pkts, count); });
+
+  const uint8_t *data;
+  size_t len;
+  while (receiver.next(data, len))
+  {
+    packets.clear();
+    try
+    {
+      if (ccsds)
+      {
+        // Transfer frames carry their own sync markers; the deframer takes them as a byte stream
+        std::memcpy(assembler.prepare(len), data, len);
+        size_t n = assembler.commit(len, packets);
+        frames += n;
+        rx_frames.add(n);
+      }
+      else
+      {
+        // Frames are decoded straight out of the ring (pipeline workers take a copy)
+        for (size_t at = 0; at < len; frames++)
+        {
+          if (len - at < header_size)
+            throw std::runtime_error("truncated frame header in shared memory record");
+          FrameHeader h = decoder.parse_header(data + at);
+          if (len - at - header_size < h.payload_len)
+            throw std::runtime_error("truncated frame in shared memory record");
+          if (pipeline)
+          {
+            if (!pipeline->submit(h, data + at + header_size))
+              throw std::runtime_error(pipeline->error());
+            received += h.packet_count;
+          }
+          else
+            decoder.decode(h, data + at + header_size, packets);
+          at += header_size + h.payload_len;
+          rx_frames.add();
+        }
+      }
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "[Ground Station] Dropping link: " << e.what() << "\n";
+      break;
+    }
+    receiver.release();
+
+    wire_bytes += len;
+    rx_bytes.add(len);
+    received += packets.size();
+    if (!packets.empty())
+      sink.deliver(packets.data(), packets.size());
+  }
+
+  if (pipeline && !pipeline->finish())
+    std::cerr << "[Ground Station] Dropping link: " << pipeline->error() << "\n";
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (received > 0)
+    std::cout << "[Ground Station] " << received << " packets in " << frames << " frames over shared memory: "
+              << static_cast<double>(wire_bytes) / received << " bytes/packet, " << received / seconds << " packets/s\n";
+}
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../include/spill_ring.h"
+
+SpillRing::SpillRing(const std::string &dir, size_t capacity) : capacity_(std::max<size_t>(capacity, 1))
+{
+  std::string path = dir + "/telemetry-spill-XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+  int fd = mkstemp(name.data());
+  if (fd < 0)
+    throw std::runtime_error("Failed to create spill file in " + dir);
+  unlink(name.data());
+
+  // Every block is reserved up front: stores into a hole the disk has no room
+  // for would raise SIGBUS in the producer instead of failing here
+  size_t bytes = capacity_ * sizeof(TelemetryPacket);
+  if (int err = posix_fallocate(fd, 0, static_cast<off_t>(bytes)))
+  {
+    ::close(fd);
+    throw std::runtime_error("Failed to reserve " + std::to_string(bytes) + " bytes for the spill file in " + dir + ": " +
+                             std::strerror(err));
+  }
+  void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    throw std::runtime_error("Failed to map spill file in " + dir);
+  map_ = static_cast<uint8_t *>(map);
+}
+
+SpillRing::~SpillRing()
+{
+  if (map_)
+    munmap(map_, capacity_ * sizeof(TelemetryPacket));
+}
+
+bool SpillRing::push(const TelemetryPacket &pkt)
+{
+  bool kept_all = count_ < capacity_;
+  if (!kept_all)
+  {
+    head_ = (head_ + 1) % capacity_;
+    count_--;
+  }
+  std::memcpy(slot(head_ + count_), &pkt, sizeof(pkt));
+  count_++;
+  return kept_all;
+}
+
+size_t SpillRing::pop_n(TelemetryPacket *out, size_t max_count)
+{
+  size_t n = std::min(max_count, count_);
+  for (size_t i = 0; i < n; ++i)
+    std::memcpy(&out[i], slot(head_ + i), sizeof(TelemetryPacket));
+  head_ = (head_ + n) % capacity_;
+  count_ -= n;
+  return n;
+}
@@ -14,11 +14,45 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <limits>
+#include <map>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <csignal>
 
 // Include project headers
 #include "../include/telemetry.h"
 #include "../include/buffer.h"
+#include "../include/sharded_buffer.h"
 #include "../include/compression.h"
+#include "../include/schema.h"
+#include "../include/frame.h"
+#include "../include/decode_pipeline.h"
+#include "../include/ccsds.h"
+#include "../include/columnar_codec.h"
+#include "../include/quantized.h"
+#include "../include/aggregator.h"
+#include "../include/anomaly.h"
+#include "../include/link.h"
+#include "../include/net.h"
+#include "../include/logger.h"
+#include "../include/sharded_logger.h"
+#include "../include/archive.h"
+#include "../include/metrics.h"
+#include "../include/simulation.h"
+#include "../include/fleet.h"
+#include "../include/udp.h"
+#include "../include/priority_buffer.h"
+#include "../include/uring.h"
+#include "../include/shm.h"
 
 // --- Helper Macros for Testing ---
 #define ASSERT_TRUE(condition, message)                                                             \
@@ -49,8 +83,12 @@
             << std::endl
 
 void sensor_thread(TelemetryBuffer &);
+void sensor_thread(TelemetryBuffer &buffer, const SimulationConfig &config);
 void transmitter_thread(TelemetryBuffer &);
+void transmitter_thread(TelemetryBuffer &buffer, const LinkConfig &config);
+void transmitter_thread(PriorityTelemetryBuffer &buffer, const LinkConfig &config);
 void ground_station_thread();
+void ground_station_thread(const LinkConfig &config);
 
 // --- Helper Functions ---
 bool float_eq(float a, float b, float epsilon = 0.001f)
@@ -60,7 +98,7 @@ bool float_eq(float a, float b, float epsilon = 0.001f)
 
 bool compare_packets(const TelemetryPacket &a, const TelemetryPacket &b)
 {
-  if (a.timestamp != b.timestamp)
+  if (a.timestamp != b.timestamp || a.source_id != b.source_id)
     return false;
   if (!float_eq(a.temperature, b.temperature))
     return false;
@@ -79,6 +117,60 @@ bool compare_packets(const TelemetryPacket &a, const TelemetryPacket &b)
   return true;
 }
 
+// Loopback TCP relay from listen_port to target_port that cuts the connection
+// every time cut_after more bytes have gone through from the client, until stop is set
+void flaky_relay(uint16_t listen_port, uint16_t target_port, size_t cut_after, const std::atomic<bool> &stop,
+                 std::atomic<size_t> &cuts)
+{
+  int listener = open_listen_socket(listen_port, 4, true);
+  std::vector<uint8_t> buf(16 * 1024);
+  while (!stop)
+  {
+    pollfd accept_fd{listener, POLLIN, 0};
+    if (poll(&accept_fd, 1, 20) <= 0)
+      continue;
+    int client = accept(listener, nullptr, nullptr);
+    int server = connect_loopback(target_port, true);
+    size_t forwarded = 0;
+    while (!stop && client >= 0 && server >= 0 && forwarded < cut_after)
+    {
+      pollfd fds[2] = {{client, POLLIN, 0}, {server, POLLIN, 0}};
+      if (poll(fds, 2, 20) <= 0)
+        continue;
+      int from = (fds[0].revents & (POLLIN | POLLHUP)) ? client : server;
+      int to = from == client ? server : client;
+      ssize_t n = recv(from, buf.data(), from == client ? std::min(buf.size(), cut_after - forwarded) : buf.size(), 0);
+      if (n <= 0 || !send_all(to, buf.data(), n))
+        break;
+      if (from == client)
+        forwarded += n;
+    }
+    if (forwarded >= cut_after)
+      cuts++;
+    close(client);
+    close(server);
+  }
+  close(listener);
+}
+
+// Slowly drifting packets shaped like TelemetrySimulator output
+std::vector<TelemetryPacket> make_telemetry_stream(size_t count)
+{
+  std::vector<TelemetryPacket> stream(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    TelemetryPacket &pkt = stream[i];
+    float t = static_cast<float>(i + 1);
+    pkt.timestamp = i + 1;
+    pkt.temperature = 25.0f - 0.005f * t + 0.05f * std::sin(t * 1.7f);
+    pkt.radiation = 0.05f + 0.002f * std::sin(t * 3.1f);
+    pkt.battery_voltage = 12.5f - 0.0001f * t + 0.002f * std::cos(t * 2.3f);
+    pkt.position = {7000.0f * std::cos(t * 0.00116f), 7000.0f * std::sin(t * 0.00116f), 0.0f};
+    pkt.orientation = {0.01f * std::sin(t), 0.01f * std::cos(t), 0.02f * std::sin(t * 0.5f)};
+  }
+  return stream;
+}
+
 // --- Test Cases ---
 
 void test_serialization()
@@ -92,10 +184,21 @@ void test_serialization()
   original.battery_voltage = 12.0f;
   original.position = {100.0f, 200.0f, 300.0f};
   original.orientation = {0.1f, 0.2f, 0.3f};
+  original.source_id = 0x01020304;
 
   std::vector<uint8_t> data = serialise(original);
 
-  ASSERT_EQUAL(data.size(), sizeof(TelemetryPacket), "Serialized size mismatch");
+  ASSERT_EQUAL(data.size(), size_t(48), "Serialized size mismatch");
+
+  // Packed and little-endian whatever the host: timestamp at 0, temperature at 8, source last
+  ASSERT_TRUE(data[0] == 0x15 && data[1] == 0xCD && data[2] == 0x5B && data[3] == 0x07 && data[7] == 0,
+              "Timestamp is not little-endian at offset 0");
+  uint32_t bits;
+  std::memcpy(&bits, &original.temperature, 4);
+  ASSERT_TRUE(data[8] == (bits & 0xFF) && data[11] == bits >> 24, "Temperature is not at offset 8");
+  std::memcpy(&bits, &original.battery_voltage, 4);
+  ASSERT_TRUE(data[40] == (bits & 0xFF) && data[43] == bits >> 24, "Battery voltage is not at offset 40");
+  ASSERT_TRUE(data[44] == 0x04 && data[47] == 0x01, "Source id is not the last field");
 
   TelemetryPacket deserialized = deserialise(data);
 
@@ -104,6 +207,62 @@ void test_serialization()
   PASS_TEST();
 }
 
+void test_packet_schema()
+{
+  LOG_TEST("Packet Schema (packed codec, CSV)");
+
+  ASSERT_EQUAL(std::string(kCsvHeader), std::string("timestamp,temperature,radiation,pos_x,pos_y,pos_z,pitch,roll,yaw,battery,source\n"),
+               "Generated CSV header changed");
+  static_assert(wire_size<PowerPacket>() == 8 + 7 * 4 + 4);
+  static_assert(wire_size<ThermalPacket>() == 8 + 12 * 4);
+
+  PowerPacket power{};
+  power.timestamp = 0x0102030405060708ull;
+  power.bus_voltage = 28.1f;
+  power.bus_current = -3.25f;
+  power.state_of_charge = 0.875f;
+  power.solar_current = {1.5f, 1.25f, 0.0f, -0.5f};
+  power.fault_flags = 0x80000001u;
+  uint8_t wire[wire_size<PowerPacket>()];
+  encode_packed(power, wire);
+  ASSERT_TRUE(wire[0] == 0x08 && wire[7] == 0x01, "PowerPacket timestamp is not little-endian");
+  ASSERT_TRUE(wire[sizeof(wire) - 4] == 0x01 && wire[sizeof(wire) - 1] == 0x80, "PowerPacket fault flags misplaced");
+  PowerPacket power2 = decode_packed<PowerPacket>(wire);
+  ASSERT_TRUE(power2.timestamp == power.timestamp && power2.bus_current == power.bus_current &&
+                  power2.solar_current == power.solar_current && power2.fault_flags == power.fault_flags,
+              "PowerPacket packed round trip mismatch");
+
+  // CSV round trip through the generated writer and parser
+  ThermalPacket thermal{};
+  thermal.timestamp = 99;
+  for (size_t i = 0; i < thermal.zone_temperature.size(); ++i)
+    thermal.zone_temperature[i] = -40.5f + 10.25f * i;
+  thermal.heater_duty = {0.0f, 0.25f, 0.5f, 1.0f};
+  std::string header = kCsvHeaderOf<ThermalPacket>.data();
+  ASSERT_TRUE(header.rfind("timestamp,zone_0,", 0) == 0 && header.find(",heater_3\n") != std::string::npos,
+              "ThermalPacket CSV header");
+  char row[max_csv_row_length<ThermalPacket>()];
+  char *end = format_csv(row, row + sizeof(row), thermal);
+  ASSERT_TRUE(end[-1] == '\n', "CSV row must end in a newline");
+  ThermalPacket parsed{};
+  ASSERT_TRUE(parse_csv(row, end - 1, parsed), "Generated CSV row did not parse");
+  ASSERT_TRUE(parsed.timestamp == 99 && parsed.zone_temperature == thermal.zone_temperature &&
+                  parsed.heater_duty == thermal.heater_duty,
+              "ThermalPacket CSV round trip mismatch");
+  ASSERT_TRUE(!parse_csv(row, row + 5, parsed), "Truncated CSV row should not parse");
+
+  // Widest possible row fits the generated bound
+  TelemetryPacket wide{};
+  wide.timestamp = ~0ull;
+  wide.temperature = wide.radiation = wide.battery_voltage = -1.23456e-38f;
+  wide.position = wide.orientation = {-3.4e38f, -3.4e38f, -3.4e38f};
+  wide.source_id = ~0u;
+  char text[kMaxCsvRowLength];
+  ASSERT_TRUE(format_csv_row(text, text + sizeof(text), wide) <= text + sizeof(text), "CSV row bound too small");
+
+  PASS_TEST();
+}
+
 void test_compression()
 {
   LOG_TEST("Compression Logic (zlib)");
@@ -123,6 +282,1019 @@ void test_compression()
   PASS_TEST();
 }
 
+void test_compression_codecs()
+{
+  LOG_TEST("Pluggable Payload Codecs (none, zlib levels, trained dictionary, adaptive)");
+
+  // Train on one stretch of a noisy stream, compress the next one packet at a time
+  const size_t TRAIN = 20000, NUM_PACKETS = 5000;
+  TelemetrySimulator sim(7);
+  std::vector<TelemetryPacket> stream(TRAIN + NUM_PACKETS);
+  for (TelemetryPacket &pkt : stream)
+    pkt = sim.generate_packet(1.0);
+  auto dictionary = std::make_shared<const CompressionDictionary>(train_dictionary(stream.data(), TRAIN));
+  ASSERT_TRUE(!dictionary->empty() && dictionary->size() <= 1024, "Dictionary should fill at most its size");
+  ASSERT_TRUE(train_dictionary(stream.data(), TRAIN) == *dictionary, "Training should be deterministic");
+
+  // compress_data() still sends plain zlib
+  std::vector<uint8_t> raw = serialise(stream[0]);
+  std::vector<uint8_t> packed = compress_data(raw);
+  std::vector<uint8_t> unpacked(raw.size());
+  uLongf unpacked_len = unpacked.size();
+  ASSERT_TRUE(uncompress(unpacked.data(), &unpacked_len, packed.data(), packed.size()) == Z_OK && unpacked == raw,
+              "compress_data() output should stay a zlib stream");
+
+  NoneCodec none;
+  ZlibCodec zlib, fast(1), best(9), primed(Z_DEFAULT_COMPRESSION, dictionary);
+  AdaptiveCodec adaptive(64 * 1024, Z_DEFAULT_COMPRESSION, dictionary);
+  ZlibCodec receiver(Z_DEFAULT_COMPRESSION, dictionary);
+  const std::pair<const char *, Codec *> codecs[] = {{"none", &none}, {"zlib", &zlib}, {"zlib level 1", &fast},
+                                                     {"zlib level 9", &best}, {"dict", &primed}, {"adaptive", &adaptive}};
+  std::map<std::string, double> per_packet;
+  std::vector<uint8_t> payload, back(kPacketWireSize);
+  for (auto [name, codec] : codecs)
+  {
+    size_t bytes = 0;
+    bool exact = true;
+    for (size_t i = TRAIN; i < stream.size(); ++i)
+    {
+      raw = serialise(stream[i]);
+      payload.clear();
+      codec->compress(raw.data(), raw.size(), payload);
+      bytes += payload.size();
+      // Whoever holds the dictionary decodes every codec's payloads
+      receiver.decompress(payload.data(), payload.size(), back.data(), back.size());
+      exact &= back == raw;
+    }
+    ASSERT_TRUE(exact, std::string(name) + " payloads did not round-trip");
+    per_packet[name] = static_cast<double>(bytes) / NUM_PACKETS;
+    std::cout << "  > " << name << ": " << per_packet[name] << " bytes/packet" << std::endl;
+  }
+  std::cout << "  > adaptive at 64 KB/s settled on " << adaptive.current() << std::endl;
+  ASSERT_TRUE(per_packet["dict"] < 0.95 * per_packet["zlib"], "A trained dictionary should beat zlib on single packets");
+  ASSERT_TRUE(per_packet["none"] == kPacketWireSize + 1, "None should cost one byte per payload");
+
+  // Larger payloads go through every codec too
+  raw.resize(32 * kPacketWireSize);
+  for (size_t i = 0; i < 32; ++i)
+    serialise_into(stream[TRAIN + i], raw.data() + i * kPacketWireSize);
+  for (auto [name, codec] : codecs)
+    ASSERT_TRUE(decompress_data(compress_data(raw, *codec), raw.size(), *codec) == raw,
+                std::string(name) + " batch did not round-trip");
+
+  // Primed payloads need the dictionary, and nothing decodes a truncated one
+  payload.clear();
+  primed.compress(raw.data(), raw.size(), payload);
+  for (size_t len : {payload.size(), payload.size() / 2})
+  {
+    bool threw = false;
+    try
+    {
+      std::vector<uint8_t> out(raw.size());
+      (len == payload.size() ? static_cast<Codec &>(zlib) : primed).decompress(payload.data(), len, out.data(), out.size());
+    }
+    catch (const std::runtime_error &)
+    {
+      threw = true;
+    }
+    ASSERT_TRUE(threw, "Undecodable payload accepted");
+  }
+
+  // A receiver trained on other captures refuses primed payloads rather than
+  // inflating them into different bytes
+  std::vector<TelemetryPacket> other(TRAIN);
+  TelemetrySimulator other_sim(8);
+  for (TelemetryPacket &pkt : other)
+    pkt = other_sim.generate_packet(1.0);
+  auto other_dictionary = std::make_shared<const CompressionDictionary>(train_dictionary(other.data(), TRAIN));
+  ASSERT_TRUE(*other_dictionary != *dictionary && dictionary_id(*other_dictionary) != dictionary_id(*dictionary),
+              "Different captures should give different dictionaries");
+  ZlibCodec mismatched(Z_DEFAULT_COMPRESSION, other_dictionary);
+  size_t refused = 0;
+  for (size_t i = TRAIN; i < TRAIN + 100; ++i)
+  {
+    raw = serialise(stream[i]);
+    payload.clear();
+    primed.compress(raw.data(), raw.size(), payload);
+    try
+    {
+      mismatched.decompress(payload.data(), payload.size(), back.data(), back.size());
+    }
+    catch (const std::runtime_error &)
+    {
+      refused++;
+    }
+  }
+  ASSERT_TRUE(refused == 100, "Payloads primed with another dictionary were decoded");
+
+  // Adaptive: CPU time decides on an unpaced link, bytes on a slow one
+  AdaptiveCodec unpaced(0, Z_DEFAULT_COMPRESSION, dictionary), slow(1000, Z_DEFAULT_COMPRESSION, dictionary);
+  for (size_t i = TRAIN; i < TRAIN + 1000; ++i)
+  {
+    raw = serialise(stream[i]);
+    payload.clear();
+    unpaced.compress(raw.data(), raw.size(), payload);
+    slow.compress(raw.data(), raw.size(), payload);
+  }
+  ASSERT_TRUE(std::string(unpaced.current()) == "none", "Adaptive should skip compression when the link is free");
+  ASSERT_TRUE(std::string(slow.current()) == "dict", "Adaptive should pick the smallest payloads on a slow link");
+
+  // PerPacket frames with the dictionary
+  LinkConfig link;
+  link.compression.mode = CompressionMode::Dictionary;
+  link.compression.dictionary = dictionary;
+  FrameEncoder encoder(link);
+  FrameDecoder decoder(link);
+  std::vector<uint8_t> wire;
+  encoder.encode(stream.data() + TRAIN, 100, wire);
+  std::vector<TelemetryPacket> framed;
+  for (size_t at = 0; at < wire.size();)
+  {
+    FrameHeader h = decoder.parse_header(wire.data() + at);
+    decoder.decode(h, wire.data() + at + decoder.header_size(), framed);
+    at += decoder.header_size() + h.payload_len;
+  }
+  ASSERT_EQUAL(framed.size(), 100u, "Dictionary frames lost packets");
+  ASSERT_TRUE(std::memcmp(framed.data(), stream.data() + TRAIN, 100 * sizeof(TelemetryPacket)) == 0,
+              "Dictionary frames changed packets");
+
+  // Dictionary files hold just the bytes
+  std::string path = "test_dict_" + std::to_string(getpid()) + ".dict";
+  save_dictionary(path, *dictionary);
+  ASSERT_TRUE(load_dictionary(path) == *dictionary, "Dictionary file did not round-trip");
+  std::remove(path.c_str());
+  bool threw = false;
+  try
+  {
+    load_dictionary(path);
+  }
+  catch (const std::runtime_error &)
+  {
+    threw = true;
+  }
+  ASSERT_TRUE(threw, "Missing dictionary file should be rejected");
+
+  PASS_TEST();
+}
+
+void test_batched_frames()
+{
+  LOG_TEST("Batched Frames on a Streaming Deflate Context");
+
+  const size_t NUM_PACKETS = 4096;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_PACKETS);
+
+  struct Case
+  {
+    size_t batch;
+    PayloadCodec codec;
+  };
+  const Case cases[] = {{1, PayloadCodec::Deflate}, {8, PayloadCodec::Deflate}, {32, PayloadCodec::Deflate},
+                        {128, PayloadCodec::Deflate}, {32, PayloadCodec::Columnar}, {128, PayloadCodec::Columnar}};
+
+  for (const Case &c : cases)
+  {
+    size_t batch = c.batch;
+    LinkConfig config;
+    config.frame_mode = batch == 1 ? FrameMode::PerPacket : FrameMode::Batched;
+    config.codec = c.codec;
+    config.batch_size = batch;
+
+    FrameEncoder encoder(config);
+    FrameDecoder decoder(config);
+    std::vector<uint8_t> wire;
+    std::vector<TelemetryPacket> decoded;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < NUM_PACKETS; i += batch)
+      encoder.encode(stream.data() + i, std::min(batch, NUM_PACKETS - i), wire);
+
+    size_t offset = 0;
+    while (offset < wire.size())
+    {
+      FrameHeader h = decoder.parse_header(wire.data() + offset);
+      offset += decoder.header_size();
+      decoder.decode(h, wire.data() + offset, decoded);
+      offset += h.payload_len;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ASSERT_EQUAL(decoded.size(), NUM_PACKETS, "Batched frames lost packets");
+    for (size_t i = 0; i < NUM_PACKETS; ++i)
+      ASSERT_TRUE(compare_packets(stream[i], decoded[i]), "Batched frame round trip mismatch");
+
+    std::cout << "  > batch " << batch << (c.codec == PayloadCodec::Columnar ? " columnar" : " deflate") << ": "
+              << static_cast<double>(wire.size()) / NUM_PACKETS << " bytes/packet on wire, "
+              << static_cast<uint64_t>(NUM_PACKETS / seconds) << " packets/s encode+decode" << std::endl;
+  }
+
+  // Incompressible chunks of every size, with the stream's window carried
+  // across them: each one must come back whole, however far deflate overruns
+  // a fresh stream's bound
+  std::mt19937 rng(11);
+  for (int level : {0, 1, 9})
+  {
+    DeflateStream deflater(level);
+    InflateStream inflater;
+    for (size_t len : {size_t(1), size_t(100), size_t(70000), size_t(5), size_t(300000), size_t(48)})
+    {
+      std::vector<uint8_t> chunk(len), out = {0xAA}, back(len);
+      for (uint8_t &b : chunk)
+        b = static_cast<uint8_t>(rng());
+      deflater.compress_chunk(chunk.data(), len, out);
+      ASSERT_TRUE(out[0] == 0xAA, "compress_chunk should append");
+      inflater.decompress_chunk(out.data() + 1, out.size() - 1, back.data(), len);
+      ASSERT_TRUE(back == chunk, "Deflate stream chunk did not round-trip");
+    }
+  }
+
+  PASS_TEST();
+}
+
+void test_columnar_codec()
+{
+  LOG_TEST("Columnar Delta/XOR Codec");
+
+  // Edge cases must round-trip bit for bit: single packet, timestamp jumps and
+  // wrap-around, identical values, sign flips and non-finite floats
+  std::vector<TelemetryPacket> edge = make_telemetry_stream(6);
+  edge[2].timestamp = 1ull << 40;
+  edge[3].timestamp = 5;
+  edge[4].timestamp = ~0ull;
+  edge[4].temperature = -edge[3].temperature;
+  edge[5].radiation = std::numeric_limits<float>::infinity();
+  edge[5].position = edge[4].position;
+  edge[1].source_id = 7;
+  edge[3].source_id = 7;
+  edge[5].source_id = ~0u;
+
+  for (size_t n = 1; n <= edge.size(); ++n)
+  {
+    std::vector<TelemetryPacket> batch(edge.begin(), edge.begin() + n);
+    std::vector<TelemetryPacket> decoded = decode_columnar(encode_columnar(batch), n);
+    ASSERT_TRUE(std::memcmp(batch.data(), decoded.data(), n * sizeof(TelemetryPacket)) == 0,
+                "Columnar codec is not lossless");
+  }
+
+  bool threw = false;
+  try
+  {
+    std::vector<uint8_t> encoded = encode_columnar(edge);
+    encoded.resize(encoded.size() / 2);
+    decode_columnar(encoded, edge.size());
+  }
+  catch (const std::runtime_error &)
+  {
+    threw = true;
+  }
+  ASSERT_TRUE(threw, "Truncated columnar input should be rejected");
+
+  // Ratio and speed against zlib over the same batches
+  const size_t NUM_PACKETS = 1 << 16, BATCH = 128;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_PACKETS);
+  size_t columnar_bytes = 0, zlib_bytes = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint8_t> encoded;
+  std::vector<TelemetryPacket> decoded(BATCH);
+  for (size_t i = 0; i < NUM_PACKETS; i += BATCH)
+  {
+    encoded.clear();
+    encode_columnar(stream.data() + i, BATCH, encoded);
+    decode_columnar(encoded.data(), encoded.size(), BATCH, decoded.data());
+    columnar_bytes += encoded.size();
+  }
+  double columnar_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < NUM_PACKETS; i += BATCH)
+  {
+    std::vector<uint8_t> raw(reinterpret_cast<const uint8_t *>(stream.data() + i),
+                             reinterpret_cast<const uint8_t *>(stream.data() + i + BATCH));
+    std::vector<uint8_t> compressed = compress_data(raw);
+    decompress_data(compressed, raw.size());
+    zlib_bytes += compressed.size();
+  }
+  double zlib_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "  > columnar: " << static_cast<double>(columnar_bytes) / NUM_PACKETS << " bytes/packet, "
+            << static_cast<uint64_t>(NUM_PACKETS / columnar_s) << " packets/s encode+decode" << std::endl;
+  std::cout << "  > zlib:     " << static_cast<double>(zlib_bytes) / NUM_PACKETS << " bytes/packet, "
+            << static_cast<uint64_t>(NUM_PACKETS / zlib_s) << " packets/s encode+decode" << std::endl;
+
+  ASSERT_TRUE(columnar_bytes < zlib_bytes, "Columnar codec should beat zlib on telemetry batches");
+
+  PASS_TEST();
+}
+
+void test_quantized_codec()
+{
+  LOG_TEST("Quantized Fixed-Point Codec");
+
+  QuantizedCodec codec;
+  ASSERT_EQUAL(codec.record_bits(), 152u, "Default ranges should take 152 bits per packet");
+
+  // Every in-range value comes back within its reported worst-case error
+  const size_t NUM_PACKETS = 4096, BATCH = 32;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_PACKETS);
+  for (size_t i = 0; i < NUM_PACKETS; ++i)
+    stream[i].orientation = {179.99f * std::sin(i * 0.37f), -45.0f + i * 0.01f, -179.995f};
+  std::vector<TelemetryPacket> decoded(NUM_PACKETS);
+  std::vector<uint8_t> encoded;
+  size_t bytes = 0;
+  for (size_t i = 0; i < NUM_PACKETS; i += BATCH)
+  {
+    encoded.clear();
+    codec.encode(stream.data() + i, BATCH, encoded);
+    codec.decode(encoded.data(), encoded.size(), BATCH, decoded.data() + i);
+    bytes += encoded.size();
+  }
+  std::array<float, kTelemetryFloatColumns> worst{};
+  bool timestamps_exact = true;
+  for (size_t i = 0; i < NUM_PACKETS; ++i)
+  {
+    timestamps_exact &= decoded[i].timestamp == stream[i].timestamp;
+    size_t c = 0;
+    for_each_column<TelemetryPacket>([&](auto col)
+                                     {
+                                       if constexpr (std::is_same_v<typename decltype(col)::Type, float>)
+                                       {
+                                         worst[c] = std::max(worst[c], std::fabs(col.get(decoded[i]) - col.get(stream[i])));
+                                         c++;
+                                       } });
+  }
+  ASSERT_TRUE(timestamps_exact, "Quantized timestamps must be exact");
+  for (size_t c = 0; c < kTelemetryFloatColumns; ++c)
+    ASSERT_TRUE(worst[c] <= codec.max_error(c), "Reconstruction error above the reported bound");
+  double per_packet = static_cast<double>(bytes) / NUM_PACKETS;
+  std::cout << "  > " << per_packet << " bytes/packet in batches of " << BATCH << " (packed: " << kPacketWireSize
+            << "), worst battery error " << worst[kTelemetryFloatColumns - 1] << " V" << std::endl;
+  ASSERT_TRUE(per_packet <= kPacketWireSize / 2.0, "Quantized packets should be at most half the packed size");
+
+  // Timestamp jumps of any size stay exact; out-of-range and NaN values clamp
+  std::vector<TelemetryPacket> edge = make_telemetry_stream(4);
+  edge[1].timestamp = 1ull << 40;
+  edge[2].timestamp = ~0ull;
+  edge[3].timestamp = 0;
+  edge[1].temperature = 500.0f;
+  edge[2].temperature = std::numeric_limits<float>::quiet_NaN();
+  edge[3].battery_voltage = -std::numeric_limits<float>::infinity();
+  edge[0].source_id = 40;
+  edge[2].source_id = 1u << 31;
+  Counter &clamped = metrics().counter("telemetry_quantized_clamped_total", "");
+  uint64_t clamped_before = clamped.value();
+  encoded.clear();
+  codec.encode(edge.data(), edge.size(), encoded);
+  std::vector<TelemetryPacket> back(edge.size());
+  codec.decode(encoded.data(), encoded.size(), edge.size(), back.data());
+  for (size_t i = 0; i < edge.size(); ++i)
+  {
+    ASSERT_EQUAL(back[i].timestamp, edge[i].timestamp, "Timestamp jump not exact");
+    ASSERT_EQUAL(back[i].source_id, edge[i].source_id, "Source id not exact");
+  }
+  ASSERT_TRUE(back[1].temperature == 80.0f && back[2].temperature == -50.0f && back[3].battery_voltage == 9.0f,
+              "Out-of-range values should clamp to the range");
+  ASSERT_EQUAL(clamped.value() - clamped_before, uint64_t(3), "Clamped values not counted");
+
+  bool threw = false;
+  try
+  {
+    codec.decode(encoded.data(), encoded.size() - 1, edge.size(), back.data());
+  }
+  catch (const std::runtime_error &)
+  {
+    threw = true;
+  }
+  ASSERT_TRUE(threw, "Truncated quantized input should be rejected");
+
+  // Ranges are configurable per column, and both ends of a link use them
+  QuantizationConfig coarse;
+  coarse.set("battery=9:12.6:0.01");
+  ASSERT_EQUAL(QuantizedCodec(coarse).bits(kTelemetryFloatColumns - 1), 9u, "Coarser battery step should need 9 bits");
+  for (const char *bad : {"volts=0:1:0.1", "battery=1:0:0.1", "battery=9:12.6", "battery=9:12.6:0"})
+  {
+    threw = false;
+    try
+    {
+      QuantizationConfig config;
+      config.set(bad);
+      QuantizedCodec check(config);
+    }
+    catch (const std::invalid_argument &)
+    {
+      threw = true;
+    }
+    ASSERT_TRUE(threw, std::string("Bad quantization accepted: ") + bad);
+  }
+
+  LinkConfig link;
+  link.frame_mode = FrameMode::Batched;
+  link.codec = PayloadCodec::Quantized;
+  link.quantization = coarse;
+  FrameEncoder encoder(link);
+  FrameDecoder decoder(link);
+  ASSERT_TRUE(decoder.independent_frames(), "Quantized frames should decode independently");
+  encoded.clear();
+  encoder.encode(stream.data(), BATCH, encoded);
+  std::vector<TelemetryPacket> framed;
+  decoder.decode(decoder.parse_header(encoded.data()), encoded.data() + decoder.header_size(), framed);
+  ASSERT_EQUAL(framed.size(), BATCH, "Quantized frame lost packets");
+  ASSERT_TRUE(std::fabs(framed[7].battery_voltage - stream[7].battery_voltage) <= 0.0051f,
+              "Quantized frame used the wrong ranges");
+
+  PASS_TEST();
+}
+
+void test_async_logger()
+{
+  LOG_TEST("Async Double-Buffered TelemetryLogger");
+
+  const size_t NUM_ROWS = 100000;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_ROWS);
+  std::string tag = std::to_string(getpid());
+
+  // Reference text from the original ostream formatting
+  std::ostringstream expected;
+  expected << "timestamp,temperature,radiation,pos_x,pos_y,pos_z,pitch,roll,yaw,battery,source\n";
+  for (const TelemetryPacket &pkt : stream)
+    expected << pkt.timestamp << "," << pkt.temperature << "," << pkt.radiation << ","
+             << pkt.position[0] << "," << pkt.position[1] << "," << pkt.position[2] << ","
+             << pkt.orientation[0] << "," << pkt.orientation[1] << "," << pkt.orientation[2] << ","
+             << pkt.battery_voltage << "," << pkt.source_id << "\n";
+
+  struct Case
+  {
+    const char *name;
+    LoggerOptions options;
+  };
+  const Case cases[] = {
+      {"sync, flush per row", LoggerOptions{}},
+      {"async, 4096 rows/block", LoggerOptions{true, 4096, std::chrono::milliseconds(0), false}},
+      {"async, 256 rows or 5 ms", LoggerOptions{true, 256, std::chrono::milliseconds(5), true}},
+  };
+
+  for (const Case &c : cases)
+  {
+    std::string filename = "test_logger_" + tag + ".csv";
+    auto start = std::chrono::steady_clock::now();
+    {
+      TelemetryLogger logger(filename, c.options);
+      for (const TelemetryPacket &pkt : stream)
+        logger.log_packet(pkt);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ifstream in("logs/" + filename);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::remove(("logs/" + filename).c_str());
+
+    ASSERT_TRUE(contents.str() == expected.str(), std::string("Log contents differ: ") + c.name);
+    std::cout << "  > " << c.name << ": " << static_cast<uint64_t>(NUM_ROWS / seconds) << " rows/s" << std::endl;
+  }
+
+  PASS_TEST();
+}
+
+void test_archive()
+{
+  LOG_TEST("Binary Columnar Archive (write, mmap range query, CSV conversion)");
+
+  const size_t NUM_ROWS = 1000000, BLOCK_ROWS = 4096;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_ROWS);
+  for (size_t i = 0; i < NUM_ROWS; ++i)
+    stream[i].source_id = static_cast<uint32_t>(i / 3000);
+  std::string tag = std::to_string(getpid());
+  std::string path = "test_archive_" + tag + ".tlm";
+
+  {
+    LoggerOptions options;
+    options.format = LogFormat::Archive;
+    options.archive_block_rows = BLOCK_ROWS;
+    TelemetryLogger logger(path, options);
+    logger.log_packets(stream.data(), stream.size());
+  }
+
+  ArchiveReader reader("logs/" + path);
+  ASSERT_EQUAL(reader.rows(), NUM_ROWS, "Archive row count mismatch");
+  ASSERT_EQUAL(reader.block_count(), (NUM_ROWS + BLOCK_ROWS - 1) / BLOCK_ROWS, "Archive block count mismatch");
+
+  // Ranges inside one block, across blocks, at the edges and outside the data
+  const std::pair<uint64_t, uint64_t> ranges[] = {{5000, 5010}, {4000, 13000}, {1, 1}, {NUM_ROWS - 3, NUM_ROWS + 50}, {NUM_ROWS + 1, NUM_ROWS + 9}};
+  for (auto [t0, t1] : ranges)
+  {
+    std::vector<TelemetryPacket> rows = reader.query(t0, t1);
+    uint64_t first = std::max<uint64_t>(t0, 1), last = std::min<uint64_t>(t1, NUM_ROWS);
+    size_t expected = last >= first ? last - first + 1 : 0;
+    ASSERT_EQUAL(rows.size(), expected, "Range query returned the wrong number of rows");
+    for (size_t i = 0; i < rows.size(); ++i)
+      ASSERT_TRUE(std::memcmp(&rows[i], &stream[first - 1 + i], sizeof(TelemetryPacket)) == 0, "Range query row mismatch");
+  }
+
+  // Full scan of one column straight from the mapping
+  auto start = std::chrono::steady_clock::now();
+  double sum = 0;
+  size_t scanned = 0;
+  reader.scan(0, ~0ull, [&](const ArchiveBlockView &view, size_t begin, size_t end)
+              {
+                for (size_t row = begin; row < end; ++row)
+                  sum += view.column[kColRadiation][row];
+                scanned += end - begin; });
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  ASSERT_EQUAL(scanned, NUM_ROWS, "Full scan did not visit every row");
+  ASSERT_TRUE(sum > 0, "Scan read no data");
+  std::cout << "  > column scan: " << static_cast<uint64_t>(NUM_ROWS / seconds) << " rows/s ("
+            << NUM_ROWS * sizeof(float) / seconds / 1e9 << " GB/s)" << std::endl;
+
+  // CSV -> archive -> CSV must reproduce the text exactly
+  std::string csv_in = "logs/test_archive_" + tag + "_in.csv", csv_out = "logs/test_archive_" + tag + "_out.csv";
+  std::string tlm = "logs/test_archive_" + tag + "_conv.tlm";
+  {
+    std::ofstream out(csv_in);
+    out << kCsvHeader;
+    std::vector<char> row(kMaxCsvRowLength);
+    for (size_t i = 0; i < 10000; ++i)
+      out.write(row.data(), format_csv_row(row.data(), row.data() + row.size(), stream[i]) - row.data());
+  }
+  ASSERT_EQUAL(csv_to_archive(csv_in, tlm, 512), 10000, "CSV conversion row count mismatch");
+  ASSERT_EQUAL(archive_to_csv(tlm, csv_out), 10000, "Archive conversion row count mismatch");
+
+  std::ifstream a(csv_in), b(csv_out);
+  std::stringstream sa, sb;
+  sa << a.rdbuf();
+  sb << b.rdbuf();
+  ASSERT_TRUE(sa.str() == sb.str(), "CSV -> archive -> CSV round trip changed the text");
+
+  // A log from before the source column was added converts with source 0
+  std::string csv_old = "logs/test_archive_" + tag + "_old.csv", tlm_old = "logs/test_archive_" + tag + "_old.tlm";
+  {
+    std::ofstream out(csv_old);
+    std::string header = kCsvHeader;
+    out << header.substr(0, header.rfind(',')) << '\n';
+    std::vector<char> row(kMaxCsvRowLength);
+    for (size_t i = 0; i < 100; ++i)
+    {
+      TelemetryPacket pkt = stream[i];
+      pkt.source_id = 7;
+      std::string text(row.data(), format_csv_row(row.data(), row.data() + row.size(), pkt));
+      out << text.substr(0, text.rfind(',')) << '\n';
+    }
+  }
+  ASSERT_EQUAL(csv_to_archive(csv_old, tlm_old), 100, "10-column CSV conversion row count mismatch");
+  {
+    std::vector<TelemetryPacket> rows = ArchiveReader(tlm_old).query(0, ~0ull);
+    ASSERT_EQUAL(rows.size(), 100, "10-column CSV archive row count mismatch");
+    ASSERT_EQUAL(rows[99].timestamp, stream[99].timestamp, "10-column CSV row read wrongly");
+    ASSERT_EQUAL(rows[99].source_id, 0u, "Missing source column did not read as 0");
+  }
+
+  // An index entry pointing past the blocks, between them, or at more rows
+  // than a block holds is refused when the file is opened
+  std::string bad = "logs/test_archive_" + tag + "_bad.tlm";
+  std::ifstream conv(tlm, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(conv)), std::istreambuf_iterator<char>());
+  uint64_t index_offset;
+  std::memcpy(&index_offset, bytes.data() + bytes.size() - 24, 8);
+  const size_t entry = index_offset + 3 * sizeof(ArchiveBlockIndex);
+  struct Corruption
+  {
+    size_t at; // byte offset into the file
+    uint64_t value;
+  };
+  const Corruption corruptions[] = {{entry, index_offset},
+                                    {entry, 1ull << 62},
+                                    {entry, 16 + 3 * 512 * 48 + 8},
+                                    {entry + 8, 513}};
+  for (const Corruption &c : corruptions)
+  {
+    std::vector<char> copy = bytes;
+    std::memcpy(copy.data() + c.at, &c.value, 8);
+    std::ofstream(bad, std::ios::binary | std::ios::trunc).write(copy.data(), copy.size());
+    bool threw = false;
+    try
+    {
+      ArchiveReader corrupt(bad);
+    }
+    catch (const std::runtime_error &)
+    {
+      threw = true;
+    }
+    ASSERT_TRUE(threw, "Archive with a bad index entry was opened");
+  }
+
+  for (const std::string &f : {"logs/" + path, csv_in, csv_out, tlm, bad, csv_old, tlm_old})
+    std::remove(f.c_str());
+
+  PASS_TEST();
+}
+
+void test_aggregator()
+{
+  LOG_TEST("Rolling-Window Aggregator");
+
+  AggregationConfig config;
+  config.resolutions = {{"a", 1, 8, 4}, {"b", 4, 8, 3}, {"c", 16, 4, 2}};
+  const size_t NUM_PACKETS = 600;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_PACKETS);
+  // Several packets per finest window, with a gap and late arrivals
+  for (size_t i = 0; i < NUM_PACKETS; ++i)
+    stream[i].timestamp = 1000 + i / 3 + (i >= 300 ? 40 : 0);
+
+  // Reference statistics over any subset of the stream
+  auto expect = [&](const WindowStats &s, auto in_window)
+  {
+    size_t n = 0;
+    std::array<double, kTelemetryFloatColumns> sum{}, sumsq{};
+    std::array<float, kTelemetryFloatColumns> lo, hi;
+    lo.fill(std::numeric_limits<float>::infinity());
+    hi.fill(-std::numeric_limits<float>::infinity());
+    for (size_t i = 0; i < NUM_PACKETS; ++i)
+    {
+      if (!in_window(i))
+        continue;
+      ++n;
+      size_t f = 0;
+      for_each_column<TelemetryPacket>([&](auto col)
+                                       {
+                                         if constexpr (std::is_same_v<typename decltype(col)::Type, float>)
+                                         {
+                                           float x = col.get(stream[i]);
+                                           sum[f] += x;
+                                           sumsq[f] += static_cast<double>(x) * x;
+                                           lo[f] = std::min(lo[f], x);
+                                           hi[f] = std::max(hi[f], x);
+                                           f++;
+                                         } });
+    }
+    ASSERT_EQUAL(s.count, n, "Window packet count");
+    for (size_t f = 0; f < kTelemetryFloatColumns && n > 0; ++f)
+    {
+      double mean = sum[f] / n;
+      double sd = std::sqrt(std::max(0.0, sumsq[f] / n - mean * mean));
+      ASSERT_TRUE(s.fields[f].min == lo[f] && s.fields[f].max == hi[f], "Window min/max");
+      ASSERT_TRUE(std::fabs(s.fields[f].mean - mean) <= 1e-6 * std::max(1.0, std::fabs(mean)), "Window mean");
+      ASSERT_TRUE(std::fabs(s.fields[f].stddev - sd) <= 1e-3 * std::max(1e-3, sd), "Window stddev");
+    }
+  };
+
+  // A reader polls snapshots while the writer runs; every snapshot must be
+  // internally consistent, which a torn read would break
+  std::vector<TelemetryPacket> probe = stream;
+  for (auto &pkt : probe)
+  {
+    float v = static_cast<float>(pkt.timestamp);
+    for_each_column<TelemetryPacket>([&](auto col)
+                                     {
+                                       if constexpr (std::is_same_v<typename decltype(col)::Type, float>)
+                                         col.get(pkt) = v; });
+  }
+  {
+    TelemetryAggregator agg(config);
+    std::atomic<bool> done{false};
+    std::atomic<size_t> torn{0}, reads{0};
+    std::thread reader([&]
+                       {
+                         while (!done.load())
+                           for (size_t level = 0; level < agg.resolutions(); ++level)
+                           {
+                             WindowStats s = agg.current(level);
+                             for (const FieldStats &fs : s.fields)
+                               torn += fs.mean != s.fields[0].mean || fs.min != s.fields[0].min;
+                             reads++;
+                           } });
+    for (int round = 0; round < 50; ++round)
+      for (size_t i = 0; i < NUM_PACKETS; ++i)
+      {
+        TelemetryPacket pkt = probe[i];
+        pkt.timestamp += round * 10000;
+        agg.add(&pkt, 1);
+      }
+    done = true;
+    reader.join();
+    std::cout << "  > " << reads.load() << " concurrent snapshot reads, " << torn.load() << " torn" << std::endl;
+    ASSERT_EQUAL(torn.load(), 0u, "Snapshot reads must never be torn");
+  }
+
+  TelemetryAggregator agg(config);
+  for (size_t i = 0; i < NUM_PACKETS; i += 7)
+    agg.add(stream.data() + i, std::min<size_t>(7, NUM_PACKETS - i));
+  const uint64_t last = stream.back().timestamp;
+
+  for (size_t level = 0; level < agg.resolutions(); ++level)
+  {
+    const uint64_t width = config.resolutions[level].width;
+    const uint64_t open = last / width;
+    WindowStats current = agg.current(level);
+    ASSERT_EQUAL(current.start, open * width, "Current window start");
+    expect(current, [&](size_t i)
+           { return stream[i].timestamp / width == open; });
+
+    std::vector<WindowStats> history = agg.history(level, config.resolutions[level].history);
+    ASSERT_TRUE(!history.empty(), "History should hold closed windows");
+    for (size_t h = 0; h < history.size(); ++h)
+    {
+      ASSERT_TRUE(history[h].start < open * width, "History only holds closed windows");
+      ASSERT_TRUE(h == 0 || history[h - 1].start < history[h].start, "History must be oldest first");
+      expect(history[h], [&](size_t i)
+             { return stream[i].timestamp / width == history[h].start / width; });
+    }
+
+    const uint64_t span = config.resolutions[level].sliding;
+    WindowStats sliding = agg.sliding(level);
+    ASSERT_EQUAL(sliding.start, (open - span) * width, "Sliding window start");
+    ASSERT_EQUAL(sliding.width, span * width, "Sliding window width");
+    expect(sliding, [&](size_t i)
+           { uint64_t w = stream[i].timestamp / width; return w + span >= open && w < open; });
+  }
+
+  // A late packet lands in the closed windows still covering its time
+  Counter &late = metrics().counter("telemetry_aggregate_late_total", "");
+  uint64_t late_before = late.value();
+  uint64_t coarse_before = agg.current(2).count;
+  TelemetryPacket straggler = stream[NUM_PACKETS - 20];
+  straggler.timestamp = last - 2;
+  straggler.temperature = -40.0f;
+  agg.add(&straggler, 1);
+  std::vector<WindowStats> recent = agg.history(0, 2);
+  ASSERT_TRUE(!recent.empty() && recent.front().start == last - 2, "Late packet should reopen its window");
+  ASSERT_EQUAL(recent.front().count, 4u, "Late packet should join its window");
+  ASSERT_TRUE(recent.front().fields[0].min == -40.0f, "Late packet should update its window's minimum");
+  ASSERT_EQUAL(agg.current(2).count, coarse_before + 1, "Late packet should join the open window of a coarser level");
+  ASSERT_EQUAL(late.value() - late_before, 1u, "Late packets should be counted");
+
+  // Nested widths, and the defaults scaled to the tick
+  bool threw = false;
+  try
+  {
+    AggregationConfig bad;
+    bad.resolutions = {{"a", 2, 8, 4}, {"b", 5, 8, 4}};
+    TelemetryAggregator nope(bad);
+  }
+  catch (const std::invalid_argument &)
+  {
+    threw = true;
+  }
+  ASSERT_TRUE(threw, "Widths that do not nest should be rejected");
+  AggregationConfig half = default_aggregation(0.5);
+  ASSERT_TRUE(half.resolutions[0].width == 2 && half.resolutions[1].width == 120 && half.resolutions[2].width == 7200,
+              "Default windows should scale to the tick");
+  std::cout << agg.summary();
+
+  PASS_TEST();
+}
+
+void test_anomaly_detector()
+{
+  LOG_TEST("Streaming Anomaly Detection");
+
+  AnomalyRule rule = AnomalyRule::parse("battery:rate<-0.01");
+  ASSERT_TRUE(rule.measure == AnomalyMeasure::Rate && !rule.above && rule.threshold == -0.01f,
+              "Rule should parse column, measure, direction and threshold");
+  ASSERT_TRUE(rule.describe() == "battery:rate<-0.01", "Rule text should round-trip");
+  ASSERT_TRUE(AnomalyRule::parse("radiation:z>8").describe() == "radiation:z>8", "z rule should round-trip");
+  for (const char *bad : {"battery", "volts<1", "battery:slope<1", "battery<", "battery<1x"})
+  {
+    bool threw = false;
+    try
+    {
+      AnomalyRule::parse(bad);
+    }
+    catch (const std::invalid_argument &)
+    {
+      threw = true;
+    }
+    ASSERT_TRUE(threw, "Malformed alert rule should be rejected");
+  }
+
+  // A quiet stream with a radiation spike, a battery sag and an attitude drift
+  const size_t NUM_PACKETS = 6000;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_PACKETS);
+  stream[2000].radiation = 0.2f;
+  for (size_t i = 3000; i < 3020; ++i)
+    stream[i].battery_voltage -= 0.05f * (i - 2999);
+  for (size_t i = 3020; i < NUM_PACKETS; ++i)
+    stream[i].battery_voltage -= 1.0f;
+  for (size_t i = 4000; i < NUM_PACKETS; ++i)
+    stream[i].orientation[0] += 0.1f * std::min<size_t>(i - 3999, 100);
+
+  stream[2500].radiation = 0.3f;
+
+  DetectorConfig config;
+  auto run = [&](size_t batch)
+  {
+    std::vector<std::pair<uint64_t, std::string>> events;
+    AnomalyDetector detector(config, [&](const AnomalyEvent &e)
+                             { events.push_back({e.timestamp, config.rules[e.rule].describe()}); });
+    for (size_t i = 0; i < NUM_PACKETS; i += batch)
+      detector.process(stream.data() + i, std::min(batch, NUM_PACKETS - i));
+    ASSERT_EQUAL(detector.alerts(), events.size(), "Every alert should reach the output");
+    return events;
+  };
+
+  Counter &spikes = metrics().counter("telemetry_alerts_total", "", "rule=\"radiation:z>8\"");
+  uint64_t spikes_before = spikes.value();
+  auto events = run(32);
+  for (const auto &[ts, text] : events)
+    std::cout << "  > t=" << ts << " " << text << std::endl;
+  ASSERT_EQUAL(events.size(), 4u, "Expected two spikes, one sag and one drift, and nothing else");
+  ASSERT_TRUE(events[0].first == 2001 && events[0].second == "radiation:z>8", "Radiation spike should alert on arrival");
+  ASSERT_TRUE(events[1].first == 2501 && events[1].second == "radiation:z>8", "A cleared rule should alert again");
+  ASSERT_TRUE(events[2].first > 3000 && events[2].first <= 3004 && events[2].second == "battery:rate<-0.01",
+              "Battery sag should alert within a few packets");
+  ASSERT_TRUE(events[3].first > 4000 && events[3].first <= 4005 && events[3].second == "pitch:rate>0.05",
+              "Attitude drift should alert within a few packets");
+  ASSERT_EQUAL(spikes.value() - spikes_before, 2u, "Alerts should be counted per rule");
+  ASSERT_TRUE(run(1) == events && run(7) == events, "Alerts must not depend on how packets are batched");
+
+  // The same stream interleaved with two quiet sources at other positions and
+  // voltages, as links sharing one detector deliver it: nothing may leak across
+  const size_t LINKS = 3, BATCH = 32;
+  std::vector<TelemetryPacket> quiet = make_telemetry_stream(NUM_PACKETS), fleet;
+  for (size_t i = 0; i < NUM_PACKETS; i += BATCH)
+    for (uint32_t s = 0; s < LINKS; ++s)
+      for (size_t j = i; j < std::min(i + BATCH, NUM_PACKETS); ++j)
+      {
+        TelemetryPacket pkt = s == 0 ? stream[j] : quiet[j];
+        if (s > 0)
+        {
+          pkt.position[2] = 500.0f * s;
+          pkt.battery_voltage -= 0.5f * s;
+          pkt.orientation[0] += 10.0f * s;
+        }
+        pkt.source_id = s;
+        fleet.push_back(pkt);
+      }
+  std::vector<std::pair<uint64_t, std::string>> mixed;
+  bool foreign = false;
+  AnomalyDetector shared(config, [&](const AnomalyEvent &e)
+                         {
+                           foreign |= e.source != 0;
+                           mixed.push_back({e.timestamp, config.rules[e.rule].describe()}); });
+  for (size_t i = 0; i < fleet.size(); i += BATCH * 2)
+    shared.process(fleet.data() + i, std::min(BATCH * 2, fleet.size() - i));
+  ASSERT_TRUE(!foreign, "Quiet sources should not alert");
+  ASSERT_TRUE(mixed == events, "Other sources changed one source's alerts");
+  ASSERT_TRUE(std::abs(shared.mean(4, 2) - 1000.0f) < 1.0f, "Per-source mean mixed with other sources"); // pos_z
+
+  PASS_TEST();
+}
+
+void test_sharded_logger()
+{
+  LOG_TEST("Per-Source Sharded Log Writers");
+
+  // Placement only depends on the source, and a fifth writer takes its share
+  // from the other four without shuffling sources between them
+  const uint32_t NUM_IDS = 10000;
+  ShardedLoggerOptions four;
+  four.writers = 4;
+  ShardedLoggerOptions five = four;
+  five.writers = 5;
+  ShardedTelemetryLogger ring4("test_ring4", four), ring5("test_ring5", five);
+  std::vector<size_t> share(5);
+  size_t moved = 0;
+  bool stray = false;
+  for (uint32_t id = 0; id < NUM_IDS; ++id)
+  {
+    size_t before = ring4.writer_for(id), after = ring5.writer_for(id);
+    ASSERT_EQUAL(ring4.writer_for(id), before, "Placement should be stable");
+    share[after]++;
+    if (before != after)
+    {
+      moved++;
+      stray |= after != 4;
+    }
+  }
+  double fraction = static_cast<double>(moved) / NUM_IDS;
+  std::cout << "  > 4 -> 5 writers moved " << fraction * 100 << "% of sources" << std::endl;
+  ASSERT_TRUE(!stray, "Only sources taken over by the new writer should move");
+  ASSERT_TRUE(fraction > 0.1 && fraction < 0.3, "A fifth writer should take about a fifth of the sources");
+  for (size_t n : share)
+    ASSERT_TRUE(n > NUM_IDS / 10, "Every writer should own a share of the sources");
+
+  // Eight sources interleaved in mixed batches: one skips five ticks, another
+  // repeats a packet after it has moved on
+  const size_t NUM_SOURCES = 8, PER_SOURCE = 3000, BATCH = 50;
+  std::string tag = std::to_string(getpid());
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(PER_SOURCE);
+  std::vector<TelemetryPacket> mixed;
+  for (size_t i = 0; i < PER_SOURCE; ++i)
+    for (uint32_t s = 0; s < NUM_SOURCES; ++s)
+    {
+      if (s == 2 && i >= 1000 && i < 1005)
+        continue;
+      TelemetryPacket pkt = stream[i];
+      pkt.source_id = 100 + s;
+      mixed.push_back(pkt);
+      if (s == 5 && i == 2000)
+        mixed.push_back(stream[1990]), mixed.back().source_id = 105;
+    }
+
+  ShardedLoggerOptions options;
+  options.writers = 3;
+  options.queue_packets = PER_SOURCE + 1; // room for everything, so none are dropped
+  {
+    ShardedTelemetryLogger logger("test_shards_" + tag, options);
+    for (size_t i = 0; i < mixed.size(); i += BATCH)
+      logger.log_packets(mixed.data() + i, std::min(BATCH, mixed.size() - i));
+    logger.flush();
+
+    std::vector<SourceStats> stats = logger.sources();
+    ASSERT_EQUAL(stats.size(), NUM_SOURCES, "Every source should be tracked");
+    for (const SourceStats &st : stats)
+    {
+      bool gap = st.source == 102, dup = st.source == 105;
+      ASSERT_EQUAL(st.packets, PER_SOURCE - (gap ? 5 : 0) + (dup ? 1 : 0), "Source packet count mismatch");
+      ASSERT_EQUAL(st.missing, gap ? 5u : 0u, "Skipped ticks should count as missing");
+      ASSERT_EQUAL(st.late, dup ? 1u : 0u, "A repeated packet should count as late");
+      ASSERT_EQUAL(st.last_timestamp, uint64_t(PER_SOURCE), "Newest timestamp mismatch");
+    }
+
+    // Each file holds its own source's rows, in the order they were logged
+    for (uint32_t s = 0; s < NUM_SOURCES; ++s)
+    {
+      std::string path = "logs/" + logger.filename(100 + s);
+      std::ifstream in(path);
+      std::string line;
+      std::getline(in, line);
+      ASSERT_TRUE(line + "\n" == kCsvHeader, "Shard should start with the CSV header");
+      std::vector<TelemetryPacket> expected;
+      for (const TelemetryPacket &pkt : mixed)
+        if (pkt.source_id == 100 + s)
+          expected.push_back(pkt);
+      size_t rows = 0;
+      bool ordered = true;
+      while (std::getline(in, line))
+      {
+        TelemetryPacket pkt;
+        ordered &= rows < expected.size() && parse_csv(line.data(), line.data() + line.size(), pkt) &&
+                   pkt.source_id == 100 + s && pkt.timestamp == expected[rows].timestamp;
+        rows++;
+      }
+      ASSERT_EQUAL(rows, expected.size(), "Shard row count mismatch");
+      ASSERT_TRUE(ordered, "Shard rows out of order or from another source");
+    }
+  }
+  for (uint32_t s = 0; s < NUM_SOURCES; ++s)
+    std::remove(("logs/test_shards_" + tag + "_src" + std::to_string(100 + s) + ".csv").c_str());
+
+  // One source floods a writer whose queue is full: its overflow is dropped
+  // and counted, log_packets() returns, and a quiet source on the same writer
+  // still gets every packet through
+  {
+    ShardedLoggerOptions small;
+    small.writers = 1;
+    small.queue_packets = 100;
+    std::string flood_prefix = "test_shards_flood_" + tag;
+    std::vector<TelemetryPacket> flood(stream.begin(), stream.end()), quiet(stream.begin(), stream.begin() + 50);
+    for (TelemetryPacket &pkt : flood)
+      pkt.source_id = 1;
+    for (TelemetryPacket &pkt : quiet)
+      pkt.source_id = 2;
+    ShardedTelemetryLogger logger(flood_prefix, small);
+    logger.log_packets(flood.data(), flood.size());
+    for (size_t i = 0; i < quiet.size(); i += 10)
+      logger.log_packets(quiet.data() + i, 10);
+    logger.flush();
+
+    std::vector<SourceStats> stats = logger.sources();
+    ASSERT_EQUAL(stats.size(), 2u, "Both sources should be tracked");
+    std::cout << "  > flooding source: " << stats[0].packets << " logged, " << stats[0].dropped << " dropped"
+              << std::endl;
+    ASSERT_TRUE(stats[0].dropped >= flood.size() - 100, "A full source queue should drop what does not fit");
+    ASSERT_EQUAL(stats[0].packets + stats[0].dropped, uint64_t(flood.size()), "Flood packets unaccounted for");
+    ASSERT_EQUAL(stats[1].packets, uint64_t(quiet.size()), "Quiet source lost packets to its neighbour's overflow");
+    ASSERT_EQUAL(stats[1].dropped, 0u, "Quiet source should drop nothing");
+    for (uint32_t s : {1u, 2u})
+      std::remove(("logs/" + logger.filename(s)).c_str());
+  }
+
+  // With more sources than open files, closed shards reopen and append
+  ShardedLoggerOptions tight;
+  tight.writers = 1;
+  tight.max_open_files = 2;
+  std::string prefix = "test_shards_lru_" + tag;
+  {
+    ShardedTelemetryLogger logger(prefix, tight);
+    for (size_t i = 0; i < mixed.size(); i += BATCH)
+      logger.log_packets(mixed.data() + i, std::min(BATCH, mixed.size() - i));
+  }
+  for (uint32_t s = 0; s < NUM_SOURCES; ++s)
+  {
+    std::string path = "logs/" + prefix + "_src" + std::to_string(100 + s) + ".csv";
+    std::ifstream in(path);
+    std::string line;
+    size_t headers = 0, rows = 0;
+    while (std::getline(in, line))
+      line + "\n" == kCsvHeader ? headers++ : rows++;
+    ASSERT_EQUAL(headers, 1u, "A reopened shard should not repeat its header");
+    ASSERT_EQUAL(rows, PER_SOURCE - (s == 2 ? 5 : 0) + (s == 5 ? 1 : 0), "Reopened shard lost rows");
+    std::remove(path.c_str());
+  }
+
+  PASS_TEST();
+}
+
 void test_buffer_behavior()
 {
   LOG_TEST("TelemetryBuffer Basic Behavior");
@@ -191,17 +1363,1463 @@ void test_buffer_concurrency()
   PASS_TEST();
 }
 
+void test_spsc_buffer_batches()
+{
+  LOG_TEST("TelemetryBuffer SpscRing Mode (push_n / pop_n)");
+
+  size_t capacity = 5;
+  TelemetryBuffer buffer(capacity, BufferMode::SpscRing);
+
+  ASSERT_EQUAL(buffer.size(), 0, "Buffer should be empty initially");
+
+  std::vector<TelemetryPacket> batch(capacity);
+  for (size_t i = 0; i < capacity; ++i)
+    batch[i].timestamp = i + 1;
+
+  ASSERT_EQUAL(buffer.push_n(batch.data(), batch.size()), capacity, "push_n should accept a full batch");
+  ASSERT_EQUAL(buffer.size(), capacity, "Buffer should be full");
+
+  TelemetryPacket pkt = buffer.pop();
+  ASSERT_EQUAL(pkt.timestamp, 1, "First popped item incorrect");
+
+  TelemetryPacket out[8];
+  size_t n = buffer.pop_n(out, 8);
+  ASSERT_EQUAL(n, capacity - 1, "pop_n should drain the remaining packets");
+  ASSERT_EQUAL(out[0].timestamp, 2, "pop_n returned packets out of order");
+  ASSERT_EQUAL(out[n - 1].timestamp, capacity, "pop_n returned packets out of order");
+
+  buffer.shutdown();
+  ASSERT_EQUAL(buffer.pop_n(out, 8), 0, "pop_n should return 0 once shut down and drained");
+  ASSERT_EQUAL(buffer.pop().timestamp, 0, "pop should return an empty packet once shut down");
+
+  PASS_TEST();
+}
+
+void test_spsc_buffer_concurrency()
+{
+  LOG_TEST("TelemetryBuffer SpscRing Thread Safety (all wait strategies)");
+
+  const WaitStrategy strategies[] = {WaitStrategy::Spin, WaitStrategy::SpinThenPark, WaitStrategy::Block};
+  const uint64_t NUM_ITEMS = 100000;
+
+  for (WaitStrategy wait : strategies)
+  {
+    TelemetryBuffer buffer(64, BufferMode::SpscRing, wait);
+    std::vector<uint64_t> received_timestamps;
+    received_timestamps.reserve(NUM_ITEMS);
+
+    std::thread consumer([&]()
+                         {
+          TelemetryPacket out[16];
+          while (received_timestamps.size() < NUM_ITEMS) {
+              size_t n = buffer.pop_n(out, 16);
+              for (size_t i = 0; i < n; ++i)
+                  received_timestamps.push_back(out[i].timestamp);
+          } });
+
+    std::thread producer([&]()
+                         {
+          TelemetryPacket batch[7]{};
+          uint64_t next = 0;
+          while (next < NUM_ITEMS) {
+              size_t n = std::min<uint64_t>(7, NUM_ITEMS - next);
+              for (size_t i = 0; i < n; ++i)
+                  batch[i].timestamp = next + i;
+              buffer.push_n(batch, n);
+              next += n;
+          } });
+
+    producer.join();
+    consumer.join();
+
+    ASSERT_EQUAL(received_timestamps.size(), NUM_ITEMS, "Lost packets during concurrent access");
+    for (uint64_t i = 0; i < NUM_ITEMS; ++i)
+      ASSERT_EQUAL(received_timestamps[i], i, "Packets received out of order");
+  }
+
+  PASS_TEST();
+}
+
+void test_sharded_buffer_concurrency()
+{
+  LOG_TEST("ShardedTelemetryBuffer Per-Producer FIFO (4 producers, 3 consumers)");
+
+  const size_t NUM_PRODUCERS = 4;
+  const size_t NUM_CONSUMERS = 3;
+  const uint64_t ITEMS_PER_PRODUCER = 20000;
+  const uint64_t STRIDE = 1000000; // timestamp = producer * STRIDE + sequence
+
+  ShardedTelemetryBuffer buffer(NUM_PRODUCERS, 32);
+  std::vector<std::vector<uint64_t>> received(NUM_CONSUMERS);
+  std::atomic<uint64_t> total{0};
+
+  std::vector<std::thread> consumers;
+  for (size_t c = 0; c < NUM_CONSUMERS; ++c)
+    consumers.emplace_back([&, c]()
+                           {
+          auto consumer = buffer.consumer(c);
+          TelemetryPacket out[8];
+          while (size_t n = consumer.pop_n(out, 8)) {
+              for (size_t i = 0; i < n; ++i)
+                  received[c].push_back(out[i].timestamp);
+              total += n;
+          } });
+
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < NUM_PRODUCERS; ++p)
+    producers.emplace_back([&, p]()
+                           {
+          auto producer = buffer.producer(p);
+          for (uint64_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+              TelemetryPacket pkt{};
+              pkt.timestamp = p * STRIDE + i;
+              producer.push(pkt);
+          } });
+
+  for (auto &t : producers)
+    t.join();
+  while (total < NUM_PRODUCERS * ITEMS_PER_PRODUCER)
+    std::this_thread::yield();
+  buffer.shutdown();
+  for (auto &t : consumers)
+    t.join();
+
+  ASSERT_EQUAL(total.load(), NUM_PRODUCERS * ITEMS_PER_PRODUCER, "Lost packets during concurrent access");
+
+  // Each consumer sees a subsequence of every producer's stream, so it must be increasing
+  for (const auto &seen : received)
+  {
+    std::vector<int64_t> last(NUM_PRODUCERS, -1);
+    for (uint64_t ts : seen)
+    {
+      size_t p = ts / STRIDE;
+      int64_t seq = static_cast<int64_t>(ts % STRIDE);
+      ASSERT_TRUE(seq > last[p], "Packets from one producer received out of order");
+      last[p] = seq;
+    }
+  }
+
+  PASS_TEST();
+}
+
+void test_epoll_ground_station()
+{
+  LOG_TEST("Epoll Ground Station (64 concurrent links, 2 reactors)");
+
+  const size_t NUM_LINKS = 64;
+  const uint64_t PACKETS_PER_LINK = 200;
+  const uint64_t STRIDE = 1000000; // timestamp = link * STRIDE + sequence
+
+  LinkConfig config;
+  config.port = 5101;
+  config.frame_mode = FrameMode::Batched;
+  config.batch_size = 16;
+  config.verbose = false;
+  config.receiver = ReceiverMode::Epoll;
+  config.reactor_threads = 2;
+  config.expected_links = NUM_LINKS;
+
+  std::map<uint64_t, uint64_t> next_seq; // per link
+  uint64_t received = 0;
+  bool in_order = true;
+  config.on_packet = [&](const TelemetryPacket &pkt)
+  {
+    uint64_t &expected = next_seq[pkt.timestamp / STRIDE];
+    in_order = in_order && pkt.timestamp % STRIDE == expected;
+    expected++;
+    received++;
+  };
+
+  std::thread ground_station([&]
+                             { ground_station_thread(config); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  // All links open at once, then take turns sending so frames interleave across them.
+  // Every other link dribbles its bytes in 7-byte pieces to exercise partial-frame reassembly.
+  std::vector<int> socks;
+  std::vector<std::unique_ptr<FrameEncoder>> encoders;
+  for (size_t link = 0; link < NUM_LINKS; ++link)
+  {
+    socks.push_back(connect_loopback(config.port));
+    ASSERT_TRUE(socks.back() >= 0, "Failed to connect link");
+    encoders.push_back(std::make_unique<FrameEncoder>(config));
+  }
+
+  std::vector<TelemetryPacket> batch(config.batch_size);
+  std::vector<uint8_t> wire;
+  for (uint64_t seq = 0; seq < PACKETS_PER_LINK; seq += config.batch_size)
+  {
+    for (size_t link = 0; link < NUM_LINKS; ++link)
+    {
+      for (size_t i = 0; i < batch.size(); ++i)
+        batch[i].timestamp = link * STRIDE + seq + i;
+      size_t n = std::min<uint64_t>(batch.size(), PACKETS_PER_LINK - seq);
+
+      wire.clear();
+      encoders[link]->encode(batch.data(), n, wire);
+      size_t piece = link % 2 ? 7 : wire.size();
+      for (size_t off = 0; off < wire.size(); off += piece)
+        ASSERT_TRUE(send_all(socks[link], wire.data() + off, std::min(piece, wire.size() - off)), "send failed");
+    }
+  }
+  for (int sock : socks)
+    close(sock);
+
+  ground_station.join();
+
+  ASSERT_EQUAL(received, NUM_LINKS * PACKETS_PER_LINK, "Lost packets across links");
+  ASSERT_EQUAL(next_seq.size(), NUM_LINKS, "Not every link delivered");
+  ASSERT_TRUE(in_order, "Packets within a link arrived out of order");
+
+  PASS_TEST();
+}
+
+void test_metrics()
+{
+  LOG_TEST("Metrics Registry (striped counters, log-linear histograms, Prometheus export)");
+
+  // Striped counters merge on read
+  Counter &events = metrics().counter("test_metrics_events_total", "Events counted by the metrics test");
+  const size_t THREADS = 4, PER_THREAD = 1000000;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < THREADS; ++t)
+    threads.emplace_back([&]
+                         {
+                           for (size_t i = 0; i < PER_THREAD; ++i)
+                             events.add(); });
+  for (auto &t : threads)
+    t.join();
+  ASSERT_EQUAL(events.value(), THREADS * PER_THREAD, "Counter lost increments");
+  ASSERT_TRUE(&events == &metrics().counter("test_metrics_events_total", ""), "Re-registering returned a different counter");
+
+  // Every value lands in a bucket whose bounds contain it, within 12.5%
+  std::mt19937_64 gen(42);
+  for (int i = 0; i < 100000; ++i)
+  {
+    uint64_t v = i < 1000 ? i : gen() >> (gen() % 64);
+    size_t b = Histogram::bucket_of(v);
+    ASSERT_TRUE(b < kHistogramBuckets, "Bucket index out of range");
+    ASSERT_TRUE(Histogram::bucket_lower(b) <= v && v <= Histogram::bucket_upper(b), "Value outside its bucket");
+    ASSERT_TRUE(Histogram::bucket_upper(b) - Histogram::bucket_lower(b) <= v / 8, "Bucket wider than 12.5%");
+  }
+  for (size_t b = 1; b < kHistogramBuckets; ++b)
+    ASSERT_EQUAL(Histogram::bucket_lower(b), Histogram::bucket_upper(b - 1) + 1, "Buckets are not contiguous");
+
+  Histogram &latency = metrics().histogram("test_metrics_latency_seconds", "Latency recorded by the metrics test");
+  for (uint64_t v = 1; v <= 10000; ++v)
+    latency.record(v);
+  HistogramSnapshot snap = latency.snapshot();
+  ASSERT_EQUAL(snap.count, 10000, "Histogram count mismatch");
+  ASSERT_EQUAL(snap.sum, 10000ull * 10001 / 2, "Histogram sum mismatch");
+  ASSERT_TRUE(snap.percentile(50) >= 5000 && snap.percentile(50) <= 5000 * 1.125, "p50 outside bucket error");
+  ASSERT_TRUE(snap.percentile(99) >= 9900 && snap.percentile(99) <= 9900 * 1.125, "p99 outside bucket error");
+
+  // One bound per power of two is rendered, empty or not, so the le bounds
+  // do not change between scrapes
+  auto lines_of = [](const std::string &text, const std::string &prefix)
+  {
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line);)
+      if (line.rfind(prefix, 0) == 0)
+        lines.push_back(line);
+    return lines;
+  };
+  auto bounds = [&]
+  {
+    std::vector<std::string> les;
+    for (const std::string &line : lines_of(metrics().render_prometheus(), "test_metrics_bounds_seconds_bucket{"))
+      les.push_back(line.substr(0, line.find('}')));
+    return les;
+  };
+  Histogram &sparse = metrics().histogram("test_metrics_bounds_seconds", "Histogram scraped by the metrics test");
+  sparse.record(100);
+  std::vector<std::string> before = bounds();
+  sparse.record(1ull << 40);
+  ASSERT_TRUE(lines_of(metrics().render_prometheus(), "test_metrics_latency_seconds_bucket{le=\"8.191e-06\"} 8191").size() == 1,
+              "Exported bucket does not sum the fine buckets below it");
+  ASSERT_EQUAL(before.size(), 65u + 1, "Histogram should export le=0 and 2^k-1 for k = 1..64, plus +Inf");
+  ASSERT_TRUE(bounds() == before, "Histogram bucket bounds changed between scrapes");
+
+  // Occupancy is per buffer, and a buffer's series goes away with it
+  const std::string occupancy = "telemetry_buffer_occupancy_packets{buffer=";
+  size_t buffers_before = lines_of(metrics().render_prometheus(), occupancy).size();
+  {
+    TelemetryBuffer three(8), five(8, BufferMode::SpscRing);
+    for (int i = 0; i < 3; ++i)
+      three.push(TelemetryPacket{});
+    for (int i = 0; i < 5; ++i)
+      five.push(TelemetryPacket{});
+    std::vector<std::string> series = lines_of(metrics().render_prometheus(), occupancy);
+    ASSERT_EQUAL(series.size(), buffers_before + 2, "Each buffer should have its own occupancy series");
+    size_t found = 0;
+    for (const std::string &line : series)
+      found += line.substr(line.size() - 2) == " 3" || line.substr(line.size() - 2) == " 5";
+    ASSERT_EQUAL(found, 2u, "Occupancy does not match each buffer's size");
+  }
+  ASSERT_EQUAL(lines_of(metrics().render_prometheus(), occupancy).size(), buffers_before,
+               "Occupancy series outlived its buffer");
+
+  // Hot path cost
+  Counter &bench_counter = metrics().counter("test_metrics_bench_total", "Hot path benchmark counter");
+  Histogram &bench_hist = metrics().histogram("test_metrics_bench_seconds", "Hot path benchmark histogram");
+  const size_t OPS = 10000000;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < OPS; ++i)
+    bench_counter.add();
+  double counter_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / OPS;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < OPS; ++i)
+    bench_hist.record(i);
+  double hist_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / OPS;
+  std::cout << "  > counter add: " << counter_ns << " ns, histogram record: " << hist_ns << " ns" << std::endl;
+
+  // Exposition text, over the local endpoint and in the dump file
+  std::string path = "test_metrics_" + std::to_string(getpid()) + ".prom";
+  std::string response;
+  {
+    MetricsExporter exporter(5102, path, std::chrono::milliseconds(20));
+    ASSERT_TRUE(exporter.listening(), "Metrics endpoint failed to bind");
+
+    int sock = connect_loopback(5102);
+    ASSERT_TRUE(sock >= 0, "Could not connect to the metrics endpoint");
+    const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    send_all(sock, reinterpret_cast<const uint8_t *>(request), sizeof(request) - 1);
+    char chunk[4096];
+    ssize_t n;
+    while ((n = recv(sock, chunk, sizeof(chunk), 0)) > 0)
+      response.append(chunk, n);
+    close(sock);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  }
+
+  ASSERT_TRUE(response.rfind("HTTP/1.0 200 OK", 0) == 0, "Metrics endpoint did not answer 200");
+  ASSERT_TRUE(response.find("# TYPE test_metrics_events_total counter\ntest_metrics_events_total 4000000\n") != std::string::npos,
+              "Counter missing from the exposition text");
+  ASSERT_TRUE(response.find("test_metrics_latency_seconds_bucket{le=\"+Inf\"} 10000\n") != std::string::npos,
+              "Histogram +Inf bucket missing");
+  ASSERT_TRUE(response.find("test_metrics_latency_seconds_count 10000\n") != std::string::npos, "Histogram count missing");
+  // Earlier tests pushed through buffers and ran the epoll receiver, so the pipeline metrics are populated
+  ASSERT_TRUE(response.find("telemetry_buffer_pushed_total ") != std::string::npos, "Buffer metrics missing");
+  ASSERT_TRUE(response.find("telemetry_stage_duration_seconds_count{stage=\"compress\"}") != std::string::npos, "Encoder metrics missing");
+  ASSERT_TRUE(response.find("telemetry_stage_duration_seconds_count{stage=\"recv\"}") != std::string::npos, "Receiver metrics missing");
+
+  std::ifstream dump(path);
+  std::stringstream text;
+  text << dump.rdbuf();
+  ASSERT_TRUE(text.str().find("test_metrics_events_total 4000000") != std::string::npos, "Metrics dump file missing or stale");
+  std::remove(path.c_str());
+
+  PASS_TEST();
+}
+
+// Runs one sensor thread to completion and returns everything it produced
+static std::vector<TelemetryPacket> run_sensor(const SimulationConfig &config, double *seconds = nullptr)
+{
+  TelemetryBuffer buffer(config.max_packets, BufferMode::SpscRing, WaitStrategy::Block);
+  auto start = std::chrono::steady_clock::now();
+  sensor_thread(buffer, config);
+  if (seconds)
+    *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<TelemetryPacket> out(config.max_packets);
+  size_t n = 0;
+  while (n < out.size() && buffer.size() > 0)
+    n += buffer.pop_n(out.data() + n, out.size() - n);
+  out.resize(n);
+  return out;
+}
+
+void test_virtual_clock()
+{
+  LOG_TEST("Virtual Clock (seeded, time-warped sensor loop)");
+
+  SimulationConfig config;
+  config.speed = 0;
+  config.seed = 1234;
+  config.max_packets = 20000;
+
+  // Same seed, same stream; a different seed diverges
+  double seconds = 0;
+  std::vector<TelemetryPacket> a = run_sensor(config, &seconds);
+  std::vector<TelemetryPacket> b = run_sensor(config);
+  config.seed = 4321;
+  std::vector<TelemetryPacket> c = run_sensor(config);
+
+  ASSERT_EQUAL(a.size(), config.max_packets, "Sensor did not stop at max_packets");
+  ASSERT_TRUE(std::memcmp(a.data(), b.data(), a.size() * sizeof(TelemetryPacket)) == 0, "Same seed produced different packets");
+  ASSERT_TRUE(std::memcmp(a.data(), c.data(), a.size() * sizeof(TelemetryPacket)) != 0, "Different seeds produced identical packets");
+  for (size_t i = 0; i < a.size(); ++i)
+    ASSERT_EQUAL(a[i].timestamp, i + 1, "Timestamps should count ticks");
+  std::cout << "  > as fast as possible: " << static_cast<uint64_t>(a.size() / seconds) << " packets/s" << std::endl;
+
+  // A full 5400 s orbit at dt = 1 finishes in well under a second and ends where it started
+  const TelemetryPacket &orbit = a[5399];
+  ASSERT_TRUE(std::fabs(orbit.position[0] - 7000.0f) < 1.0f && std::fabs(orbit.position[1]) < 5.0f, "Orbit did not close after 5400 s");
+
+  // Speed factor: 20 ticks of 0.5 s at 50x should take about 0.2 s of real time
+  SimulationConfig paced;
+  paced.dt = 0.5;
+  paced.speed = 50;
+  paced.seed = 1;
+  paced.max_packets = 20;
+  run_sensor(paced, &seconds);
+  ASSERT_TRUE(seconds >= 0.19 && seconds < 1.0, "Speed factor not honoured");
+
+  PASS_TEST();
+}
+
+void test_fleet_simulator()
+{
+  LOG_TEST("SoA Fleet Simulator (counter-based RNG, vectorized step)");
+
+  FleetConfig config;
+  config.vehicles = 10000;
+  config.seed = 99;
+  const uint64_t TICKS = 100;
+
+  // Output must not depend on how the fleet is split across workers
+  auto collect = [&](size_t threads)
+  {
+    FleetConfig c = config;
+    c.threads = threads;
+    FleetSimulator fleet(c);
+    std::vector<FleetPacket> last(c.vehicles);
+    std::mutex mtx;
+    fleet.run(TICKS, [&](size_t, const FleetPacket *pkts, size_t n)
+              {
+                std::lock_guard<std::mutex> lock(mtx);
+                for (size_t i = 0; i < n; ++i)
+                  last[pkts[i].vehicle_id] = pkts[i]; });
+    return last;
+  };
+  std::vector<FleetPacket> one = collect(1), three = collect(3);
+  for (size_t i = 0; i < config.vehicles; ++i)
+  {
+    ASSERT_EQUAL(one[i].vehicle_id, i, "Vehicle ids out of order");
+    ASSERT_EQUAL(one[i].packet.timestamp, TICKS, "Timestamp should be the tick");
+    ASSERT_TRUE(std::memcmp(&one[i].packet, &three[i].packet, sizeof(TelemetryPacket)) == 0, "Thread count changed the output");
+  }
+
+  // Noise has the scalar sensors' spread: temperature after 100 ticks ~ N(25 - 0.5, 0.05 * sqrt(100))
+  double mean = 0, var = 0;
+  for (const FleetPacket &fp : one)
+    mean += fp.packet.temperature;
+  mean /= one.size();
+  for (const FleetPacket &fp : one)
+    var += (fp.packet.temperature - mean) * (fp.packet.temperature - mean);
+  double stddev = std::sqrt(var / one.size());
+  ASSERT_TRUE(std::fabs(mean - 24.5) < 0.05, "Temperature drift is off");
+  ASSERT_TRUE(std::fabs(stddev - 0.5) < 0.05, "Temperature noise has the wrong spread");
+
+  // Rotation recurrence tracks the orbit, including across resyncs
+  FleetSimulator fleet(config);
+  std::vector<FleetPacket> start, now;
+  fleet.snapshot(start);
+  for (uint64_t t = 0; t < 3 * FleetSimulator::kResyncTicks + 7; ++t)
+    fleet.step();
+  fleet.snapshot(now);
+  for (size_t i = 0; i < config.vehicles; i += 97)
+  {
+    const auto &p0 = start[i].packet.position, &p1 = now[i].packet.position;
+    float r0 = std::hypot(p0[0], p0[1]), r1 = std::hypot(p1[0], p1[1]);
+    ASSERT_TRUE(r0 >= 6899.0f && r0 <= 7301.0f, "Orbit radius out of range");
+    ASSERT_TRUE(std::fabs(r1 - r0) < 0.5f, "Orbit radius drifted");
+  }
+
+  // Throughput against the scalar, virtual-dispatch path
+  const size_t SCALAR_VEHICLES = 10000, SCALAR_TICKS = 20;
+  std::vector<TelemetrySimulator> scalar;
+  for (size_t v = 0; v < SCALAR_VEHICLES; ++v)
+    scalar.emplace_back(v + 1);
+  TelemetryPacket sink{};
+  auto t0 = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < SCALAR_TICKS; ++t)
+    for (auto &sim : scalar)
+      sink = sim.generate_packet(1.0);
+  double scalar_rate = SCALAR_VEHICLES * SCALAR_TICKS / std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  (void)sink;
+
+  FleetConfig bench = config;
+  bench.vehicles = 100000;
+  FleetSimulator big(bench);
+  std::vector<FleetPacket> out;
+  t0 = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < SCALAR_TICKS; ++t)
+  {
+    big.step();
+    big.snapshot(out);
+  }
+  double fleet_rate = bench.vehicles * SCALAR_TICKS / std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  std::cout << "  > scalar TelemetrySimulator: " << static_cast<uint64_t>(scalar_rate) << " packets/s" << std::endl;
+  std::cout << "  > FleetSimulator (100k vehicles, 1 thread): " << static_cast<uint64_t>(fleet_rate) << " packets/s ("
+            << fleet_rate / scalar_rate << "x)" << std::endl;
+  ASSERT_TRUE(fleet_rate > scalar_rate, "SoA path should beat the scalar path");
+
+  PASS_TEST();
+}
+
+void test_udp_transport()
+{
+  LOG_TEST("UDP Transport (sendmmsg/recvmmsg, injected loss and reordering)");
+
+  // Datagram codec: every encoding round-trips, and garbage is rejected
+  std::vector<TelemetryPacket> pkts(kMaxDatagramPackets);
+  for (size_t i = 0; i < pkts.size(); ++i)
+    pkts[i] = TelemetryPacket{1000 + i, 20.0f + i * 0.1f, 0.05f, {7000.0f, 1.0f * i, 0.0f}, {0.1f, 0.2f, 0.3f}, 12.4f};
+  std::vector<uint8_t> wire(kMaxDatagramSize);
+  for (DatagramEncoding enc : {DatagramEncoding::Raw, DatagramEncoding::Zlib, DatagramEncoding::Columnar})
+  {
+    size_t len = encode_datagram(42, pkts.data(), pkts.size(), enc, wire.data());
+    ASSERT_TRUE(len <= kMaxDatagramSize, "Datagram exceeds the size limit");
+    std::vector<TelemetryPacket> out;
+    DatagramHeader h = decode_datagram(wire.data(), len, out);
+    ASSERT_EQUAL(h.seq, 42u, "Sequence number mismatch");
+    ASSERT_TRUE(!h.fin, "Data datagram flagged as FIN");
+    ASSERT_EQUAL(out.size(), pkts.size(), "Packet count mismatch");
+    for (size_t i = 0; i < out.size(); ++i)
+      ASSERT_TRUE(std::memcmp(&out[i], &pkts[i], sizeof(TelemetryPacket)) == 0, "Datagram round trip corrupted a packet");
+  }
+  std::vector<TelemetryPacket> out;
+  bool threw = false;
+  try
+  {
+    size_t len = encode_datagram(0, pkts.data(), 3, DatagramEncoding::Raw, wire.data());
+    decode_datagram(wire.data(), len - 1, out);
+  }
+  catch (const std::runtime_error &)
+  {
+    threw = true;
+  }
+  ASSERT_TRUE(threw, "Truncated datagram should throw");
+
+  // With nothing listening, the refusals come back as ECONNREFUSED: those
+  // datagrams count as dropped, not sent
+  {
+    Counter &tx_datagrams = metrics().counter("telemetry_udp_tx_datagrams_total", "Datagrams sent by UDP transmitters");
+    uint64_t tx_before = tx_datagrams.value();
+    LinkConfig refused_config;
+    refused_config.codec = PayloadCodec::Columnar;
+    UdpSender sender(5120, refused_config);
+    ASSERT_TRUE(sender.ok(), "UDP sender failed to open");
+    for (int i = 0; i < 20; ++i)
+    {
+      ASSERT_TRUE(sender.send(pkts.data(), 4) && sender.flush(), "A refused datagram should not end the link");
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::cout << "  > 20 datagrams with nothing listening: " << sender.dropped() << " refused" << std::endl;
+    ASSERT_TRUE(sender.dropped() > 0 && sender.dropped_packets() == 4 * sender.dropped(), "Refused datagrams were not counted");
+    ASSERT_EQUAL(tx_datagrams.value() - tx_before, 20 - sender.dropped(), "Refused datagrams counted as sent");
+  }
+
+  // End to end through a lossy, reordering channel. Loss accounting at the
+  // ground station must match exactly what the impairment proxy dropped.
+  const uint64_t NUM_PACKETS = 20000;
+  LinkConfig config;
+  config.port = 5103;
+  config.transport = Transport::Udp;
+  config.frame_mode = FrameMode::Batched;
+  config.batch_size = 64;
+  config.batch_deadline = std::chrono::milliseconds(5);
+  config.verbose = false;
+  config.impairment.loss = 0.1;
+  config.impairment.reorder = 0.05;
+  config.impairment.reorder_hold = std::chrono::microseconds(500);
+  config.impairment.seed = 7;
+
+  std::vector<bool> seen(NUM_PACKETS, false);
+  uint64_t received = 0, duplicates = 0;
+  config.on_packet = [&](const TelemetryPacket &pkt)
+  {
+    if (pkt.timestamp < NUM_PACKETS)
+    {
+      duplicates += seen[pkt.timestamp];
+      seen[pkt.timestamp] = true;
+    }
+    received++;
+  };
+
+  Counter &lost = metrics().counter("telemetry_udp_lost_datagrams_total", "");
+  Counter &dropped = metrics().counter("telemetry_udp_injected_drops_total", "");
+  Counter &reordered = metrics().counter("telemetry_udp_reordered_datagrams_total", "");
+  Counter &held = metrics().counter("telemetry_udp_injected_holds_total", "");
+  uint64_t lost0 = lost.value(), dropped0 = dropped.value(), reordered0 = reordered.value(), held0 = held.value();
+
+  std::thread ground_station([&]
+                             { ground_station_thread(config); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  TelemetryBuffer buffer(1024, BufferMode::SpscRing);
+  std::thread transmitter([&]
+                          { transmitter_thread(buffer, config); });
+  for (uint64_t ts = 0; ts < NUM_PACKETS; ++ts)
+  {
+    TelemetryPacket pkt{};
+    pkt.timestamp = ts;
+    buffer.push(pkt);
+    if (ts % 1000 == 999)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1)); // keep the receiver's socket buffer from overflowing
+  }
+  while (buffer.size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  buffer.shutdown();
+  transmitter.join();
+  ground_station.join();
+
+  uint64_t lost_n = lost.value() - lost0, dropped_n = dropped.value() - dropped0;
+  std::cout << "  > " << received << "/" << NUM_PACKETS << " packets delivered, " << dropped_n << " datagrams dropped, "
+            << lost_n << " counted lost, " << reordered.value() - reordered0 << " reordered" << std::endl;
+  ASSERT_TRUE(dropped_n > 0, "Impairment dropped nothing");
+  ASSERT_EQUAL(lost_n, dropped_n, "Loss accounting does not match injected drops");
+  ASSERT_TRUE(held.value() > held0 && reordered.value() > reordered0, "Reordering was not detected");
+  ASSERT_EQUAL(duplicates, 0u, "Packets delivered twice");
+  ASSERT_TRUE(received < NUM_PACKETS && received > NUM_PACKETS * 8 / 10, "Delivered count inconsistent with 10% loss");
+
+  PASS_TEST();
+}
+
+void test_ccsds_frames()
+{
+  LOG_TEST("CCSDS Transfer Frames (sync marker, virtual channels, resync)");
+
+  ASSERT_EQUAL(crc16_ccitt(reinterpret_cast<const uint8_t *>("123456789"), 9), 0x29B1, "CRC-16-CCITT check value");
+
+  // Three virtual channels interleaved on one stream; timestamp = vc * STRIDE + sequence
+  const uint64_t STRIDE = 1000000;
+  const uint8_t VCS[] = {0, 3, 5};
+  CcsdsFramer framer;
+  std::vector<uint8_t> wire;
+  std::map<uint8_t, uint64_t> sent;
+  std::mt19937 rng(11);
+  for (int round = 0; round < 200; ++round)
+  {
+    uint8_t vc = VCS[rng() % 3];
+    std::vector<TelemetryPacket> batch(1 + rng() % 40);
+    for (auto &pkt : batch)
+    {
+      pkt = TelemetryPacket{vc * STRIDE + sent[vc]++, 21.5f, 0.05f, {7000.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 12.4f};
+    }
+    if (round % 2)
+      framer.add_columnar(vc, batch.data(), batch.size(), wire);
+    else
+      framer.add_telemetry(vc, batch.data(), batch.size(), wire);
+    if (round % 5 == 0)
+      framer.flush(vc, wire);
+  }
+  for (uint8_t vc : VCS)
+    framer.flush(vc, wire);
+  ASSERT_EQUAL(wire.size() % kCaduSize, 0u, "Stream is not whole CADUs");
+
+  // Fed through a FrameAssembler in odd-sized reads, as a socket would
+  auto receive = [&](const std::vector<uint8_t> &bytes, std::map<uint8_t, std::vector<uint64_t>> &by_vc,
+                     const CcsdsDeframer *&deframer, FrameAssembler &assembler)
+  {
+    std::vector<TelemetryPacket> out;
+    for (size_t off = 0; off < bytes.size();)
+    {
+      size_t n = std::min<size_t>(1 + rng() % 3000, bytes.size() - off);
+      std::memcpy(assembler.prepare(n), bytes.data() + off, n);
+      assembler.commit(n, out);
+      off += n;
+    }
+    for (const auto &pkt : out)
+      by_vc[pkt.timestamp / STRIDE].push_back(pkt.timestamp % STRIDE);
+    deframer = assembler.deframer();
+  };
+
+  LinkConfig config;
+  config.frame_mode = FrameMode::Ccsds;
+  {
+    FrameAssembler assembler(config);
+    std::map<uint8_t, std::vector<uint64_t>> by_vc;
+    const CcsdsDeframer *deframer = nullptr;
+    receive(wire, by_vc, deframer, assembler);
+    ASSERT_EQUAL(deframer->bad_frames(), 0u, "Clean stream had bad frames");
+    for (uint8_t vc : VCS)
+    {
+      ASSERT_EQUAL(by_vc[vc].size(), sent[vc], "Packets missing on a virtual channel");
+      for (size_t i = 0; i < by_vc[vc].size(); ++i)
+        ASSERT_EQUAL(by_vc[vc][i], i, "Packets out of order on a virtual channel");
+      ASSERT_EQUAL(deframer->channel(vc).lost_frames, 0u, "Clean stream lost frames");
+    }
+  }
+
+  // Corrupt one frame and splice garbage between two others: the deframer
+  // drops that frame, resyncs on the next marker and loses nothing else
+  {
+    std::vector<uint8_t> damaged = wire;
+    const size_t BAD = 7;
+    damaged[BAD * kCaduSize + 300] ^= 0x5A;
+    uint8_t bad_vc = (damaged[BAD * kCaduSize + kAsmSize + 1] >> 1) & 0x7;
+    std::vector<uint8_t> garbage(777);
+    for (auto &b : garbage)
+      b = static_cast<uint8_t>(rng());
+    damaged.insert(damaged.begin() + 20 * kCaduSize, garbage.begin(), garbage.end());
+
+    FrameAssembler assembler(config);
+    std::map<uint8_t, std::vector<uint64_t>> by_vc;
+    const CcsdsDeframer *deframer = nullptr;
+    receive(damaged, by_vc, deframer, assembler);
+
+    ASSERT_EQUAL(deframer->good_frames(), wire.size() / kCaduSize - 1, "Only the corrupted frame should be lost");
+    ASSERT_TRUE(deframer->bad_frames() >= 1, "Corrupted frame not detected");
+    ASSERT_TRUE(deframer->skipped_bytes() >= garbage.size(), "Garbage not skipped");
+    ASSERT_EQUAL(deframer->channel(bad_vc).lost_frames, 1u, "Frame counter gap not detected");
+    uint64_t delivered = 0, total = 0;
+    for (uint8_t vc : VCS)
+    {
+      delivered += by_vc[vc].size();
+      total += sent[vc];
+      for (size_t i = 1; i < by_vc[vc].size(); ++i)
+        ASSERT_TRUE(by_vc[vc][i] > by_vc[vc][i - 1], "Resync delivered packets out of order");
+      if (vc != bad_vc)
+        ASSERT_EQUAL(by_vc[vc].size(), sent[vc], "Damage leaked into another virtual channel");
+    }
+    std::cout << "  > 1 corrupt frame + " << garbage.size() << " garbage bytes: " << total - delivered
+              << " of " << total << " packets lost" << std::endl;
+    ASSERT_TRUE(delivered < total && total - delivered <= 64, "Lost more than the packets in one frame");
+  }
+
+  // Through FrameEncoder: a batch from three sources goes out on three VCs
+  // from the base channel, and comes back apart, each source in order
+  {
+    LinkConfig fleet = config;
+    fleet.virtual_channel = 6;
+    FrameEncoder encoder(fleet);
+    std::vector<uint8_t> bytes;
+    std::map<uint32_t, uint64_t> per_source;
+    for (int round = 0; round < 50; ++round)
+    {
+      std::vector<TelemetryPacket> batch;
+      for (uint32_t source = 0; source < 3; ++source)
+        for (size_t i = 0, n = 1 + rng() % 20; i < n; ++i)
+        {
+          batch.push_back(TelemetryPacket{per_source[source]++, 21.5f, 0.05f, {7000.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 12.4f});
+          batch.back().source_id = source;
+        }
+      encoder.encode(batch.data(), batch.size(), bytes);
+    }
+
+    FrameAssembler assembler(fleet);
+    std::vector<TelemetryPacket> out;
+    std::memcpy(assembler.prepare(bytes.size()), bytes.data(), bytes.size());
+    assembler.commit(bytes.size(), out);
+    std::map<uint32_t, uint64_t> next;
+    bool ordered = true;
+    for (const TelemetryPacket &pkt : out)
+      ordered &= pkt.timestamp == next[pkt.source_id]++;
+    ASSERT_TRUE(ordered, "A source's packets came back out of order");
+    for (uint32_t source = 0; source < 3; ++source)
+    {
+      uint8_t vc = ccsds_channel(6, source);
+      ASSERT_EQUAL(next[source], per_source[source], "Packets missing for a source");
+      ASSERT_EQUAL(assembler.deframer()->channel(vc).packets, per_source[source], "Source not on its own virtual channel");
+    }
+    ASSERT_EQUAL(ccsds_channel(6, 2), 0u, "Virtual channel should wrap past 7");
+  }
+
+  // Demultiplexing rate on raw packets
+  {
+    std::vector<TelemetryPacket> batch(1024);
+    for (size_t i = 0; i < batch.size(); ++i)
+      batch[i].timestamp = i;
+    std::vector<uint8_t> bulk;
+    CcsdsFramer bulk_framer;
+    for (int round = 0; round < 256; ++round)
+      bulk_framer.add_telemetry(static_cast<uint8_t>(round % 4), batch.data(), batch.size(), bulk);
+
+    CcsdsDeframer deframer;
+    std::vector<TelemetryPacket> out;
+    out.reserve(256 * batch.size());
+    auto t0 = std::chrono::steady_clock::now();
+    size_t used = deframer.consume(bulk.data(), bulk.size(), out);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    ASSERT_EQUAL(used, bulk.size(), "Deframer left whole frames behind");
+    ASSERT_TRUE(out.size() >= 255 * batch.size(), "Bulk packets missing");
+    std::cout << "  > deframe + demux: " << bulk.size() / seconds / 1e6 << " MB/s, "
+              << static_cast<uint64_t>(out.size() / seconds) << " packets/s" << std::endl;
+  }
+
+  PASS_TEST();
+}
+
+void test_priority_scheduler()
+{
+  LOG_TEST("Priority Scheduler (strict alarms, weighted round-robin for the rest)");
+
+  ClassifierRule rule = ClassifierRule::parse("battery_voltage<11.2=warning");
+  ASSERT_TRUE(rule.field == ClassifierRule::Field::BatteryVoltage && !rule.above, "Rule field/operator misparsed");
+  ASSERT_TRUE(rule.threshold == 11.2f && rule.priority == PacketPriority::Warning, "Rule value/class misparsed");
+  for (const char *bad : {"battery_voltage<11.2", "voltage<11=alarm", "radiation>x=alarm", "radiation>1=urgent", "<1=alarm"})
+  {
+    bool threw = false;
+    try
+    {
+      ClassifierRule::parse(bad);
+    }
+    catch (const std::invalid_argument &)
+    {
+      threw = true;
+    }
+    ASSERT_TRUE(threw, std::string("Bad rule accepted: ") + bad);
+  }
+
+  auto make = [](uint64_t ts, float temp, float rad, float volt)
+  { return TelemetryPacket{ts, temp, rad, {7000.0f, 0.0f, 0.0f}, {0.0f, 7.5f, 0.0f}, volt}; };
+  PacketClassifier classifier;
+  ASSERT_TRUE(classifier.classify(make(0, 20.0f, 0.05f, 12.4f)) == PacketPriority::Routine, "Nominal packet not routine");
+  ASSERT_TRUE(classifier.classify(make(0, 20.0f, 0.05f, 10.0f)) == PacketPriority::Alarm, "Low battery not an alarm");
+  ASSERT_TRUE(classifier.classify(make(0, 20.0f, 0.9f, 12.4f)) == PacketPriority::Alarm, "Radiation spike not an alarm");
+  ASSERT_TRUE(classifier.classify(make(0, 75.0f, 0.05f, 12.4f)) == PacketPriority::Warning, "Overheat not a warning");
+  ASSERT_TRUE(classifier.classify(make(0, 75.0f, 0.05f, 10.0f)) == PacketPriority::Alarm, "First matching rule should win");
+
+  // Backlog all three classes, then drain in small batches: alarms come out
+  // first, then warnings and routine packets at 4:1, FIFO within each class
+  PriorityTelemetryBuffer buffer;
+  for (uint64_t i = 0; i < 400; ++i)
+    buffer.push(make(i, 20.0f, 0.05f, 12.4f));
+  for (uint64_t i = 0; i < 100; ++i)
+    buffer.push(make(1000 + i, 75.0f, 0.05f, 12.4f));
+  for (uint64_t i = 0; i < 20; ++i)
+    buffer.push(make(2000 + i, 20.0f, 0.05f, 10.0f));
+  ASSERT_EQUAL(buffer.size(PacketPriority::Alarm), 20u, "Alarm queue depth");
+  ASSERT_EQUAL(buffer.size(), 520u, "Total queue depth");
+
+  std::vector<TelemetryPacket> order;
+  TelemetryPacket batch[7];
+  while (size_t n = buffer.pop_n(batch, 7, std::chrono::steady_clock::now()))
+    order.insert(order.end(), batch, batch + n);
+  ASSERT_EQUAL(order.size(), 520u, "Packets lost in the scheduler");
+  for (size_t i = 0; i < 20; ++i)
+    ASSERT_EQUAL(order[i].timestamp, 2000 + i, "Alarms not sent first and in order");
+  size_t warnings = 0, routine = 0;
+  uint64_t next_warning = 1000, next_routine = 0;
+  for (size_t i = 20; i < 520; ++i)
+  {
+    bool warning = order[i].timestamp >= 1000;
+    uint64_t &next = warning ? next_warning : next_routine;
+    ASSERT_EQUAL(order[i].timestamp, next, "Reordered within a class");
+    next++;
+    if (i < 145)
+      (warning ? warnings : routine)++;
+  }
+  std::cout << "  > first 125 after the alarms: " << warnings << " warning, " << routine << " routine" << std::endl;
+  ASSERT_EQUAL(warnings, 100u, "Warnings should get four of every five slots");
+  ASSERT_EQUAL(routine, 25u, "Routine should get one of every five slots");
+
+  // A lone producer blocked on a full Routine class must already have queued
+  // the alarms from later in its batch
+  {
+    PriorityConfig small;
+    small.capacity = {8, 8, 4};
+    PriorityTelemetryBuffer saturated(small);
+    std::vector<TelemetryPacket> mixed;
+    for (uint64_t i = 0; i < 12; ++i)
+      mixed.push_back(make(i, 20.0f, 0.05f, 12.4f));
+    for (uint64_t i = 0; i < 3; ++i)
+      mixed.push_back(make(100 + i, 20.0f, 0.9f, 12.4f));
+    std::thread producer([&]
+                         { saturated.push_n(mixed.data(), mixed.size()); });
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (saturated.size(PacketPriority::Alarm) < 3 && std::chrono::steady_clock::now() < give_up)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ASSERT_EQUAL(saturated.size(PacketPriority::Alarm), 3u, "Alarms held back behind a full Routine class");
+    ASSERT_EQUAL(saturated.size(PacketPriority::Routine), 4u, "Routine class should be full");
+
+    std::vector<TelemetryPacket> drained;
+    while (drained.size() < mixed.size())
+    {
+      size_t n = saturated.pop_n(batch, 7, std::chrono::steady_clock::now() + std::chrono::seconds(1));
+      ASSERT_TRUE(n > 0, "Producer never finished its batch");
+      drained.insert(drained.end(), batch, batch + n);
+    }
+    producer.join();
+    for (size_t i = 0; i < 3; ++i)
+      ASSERT_EQUAL(drained[i].timestamp, 100 + i, "Alarms not sent first");
+    for (size_t i = 3; i < drained.size(); ++i)
+      ASSERT_EQUAL(drained[i].timestamp, i - 3, "Routine packets reordered");
+  }
+
+  // Through a real link: alarms queued behind a routine backlog go out in the first frame
+  const uint64_t BULK = 1000, ALARMS = 10;
+  LinkConfig config;
+  config.port = 5104;
+  config.frame_mode = FrameMode::Batched;
+  config.batch_size = 64;
+  config.verbose = false;
+  std::vector<uint64_t> arrival;
+  config.on_packet = [&](const TelemetryPacket &pkt)
+  { arrival.push_back(pkt.timestamp); };
+
+  std::thread ground_station([&]
+                             { ground_station_thread(config); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  PriorityTelemetryBuffer link_buffer;
+  for (uint64_t i = 0; i < BULK; ++i)
+    link_buffer.push(make(i, 20.0f, 0.05f, 12.4f));
+  for (uint64_t i = 0; i < ALARMS; ++i)
+    link_buffer.push(make(BULK + i, 20.0f, 0.9f, 12.4f));
+  std::thread transmitter([&]
+                          { transmitter_thread(link_buffer, config); });
+  while (link_buffer.size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  link_buffer.shutdown();
+  transmitter.join();
+  ground_station.join();
+
+  ASSERT_EQUAL(arrival.size(), BULK + ALARMS, "Packets lost on the link");
+  for (size_t i = 0; i < ALARMS; ++i)
+    ASSERT_EQUAL(arrival[i], BULK + i, "Alarm did not overtake the backlog");
+
+  PASS_TEST();
+}
+
+void test_decode_pipeline()
+{
+  LOG_TEST("Ground Station Decode Pipeline (worker pool, order-restoring reassembly)");
+
+  const size_t NUM_FRAMES = 2000, BATCH = 16;
+  struct Case
+  {
+    const char *name;
+    FrameMode mode;
+    PayloadCodec codec;
+  };
+  for (const Case &c : {Case{"per-packet", FrameMode::PerPacket, PayloadCodec::Deflate},
+                        Case{"batched deflate", FrameMode::Batched, PayloadCodec::Deflate},
+                        Case{"batched columnar", FrameMode::Batched, PayloadCodec::Columnar}})
+  {
+    LinkConfig config;
+    config.frame_mode = c.mode;
+    config.codec = c.codec;
+    config.decode_workers = 3;
+    config.decode_queue = 8; // small, so submit() has to wait for delivery
+
+    // Frames of varying size so the workers finish out of order
+    FrameEncoder encoder(config);
+    std::vector<uint8_t> wire;
+    std::vector<TelemetryPacket> batch;
+    uint64_t ts = 0;
+    for (size_t f = 0; f < NUM_FRAMES; ++f)
+    {
+      batch.clear();
+      size_t n = c.mode == FrameMode::PerPacket ? 1 : 1 + (f * 7) % BATCH;
+      for (size_t i = 0; i < n; ++i, ++ts)
+        batch.push_back(TelemetryPacket{ts, 20.0f + (ts % 13) * 0.5f, 0.05f, {7000.0f, 0.0f, 0.0f}, {0.1f, 0.2f, 0.3f}, 12.4f});
+      encoder.encode(batch.data(), batch.size(), wire);
+    }
+
+    std::vector<uint64_t> delivered;
+    {
+      DecodePipeline pipeline(config, [&](const TelemetryPacket *pkts, size_t count)
+                              {
+                                for (size_t i = 0; i < count; ++i)
+                                  delivered.push_back(pkts[i].timestamp); });
+      FrameDecoder decoder(config);
+      for (size_t at = 0; at < wire.size();)
+      {
+        FrameHeader h = decoder.parse_header(wire.data() + at);
+        at += decoder.header_size();
+        ASSERT_TRUE(pipeline.submit(h, wire.data() + at), "Pipeline rejected a valid frame");
+        at += h.payload_len;
+      }
+      ASSERT_TRUE(pipeline.finish(), "Pipeline reported an error");
+      std::cout << "  > " << c.name << ": " << delivered.size() << " packets, " << pipeline.steals() << " steals" << std::endl;
+    }
+    ASSERT_EQUAL(delivered.size(), ts, "Packets lost in the pipeline");
+    for (size_t i = 0; i < delivered.size(); ++i)
+      ASSERT_EQUAL(delivered[i], i, "Packets delivered out of order");
+  }
+
+  // A frame that fails to decode stops delivery right there
+  LinkConfig config;
+  config.frame_mode = FrameMode::Batched;
+  config.codec = PayloadCodec::Columnar;
+  config.decode_workers = 2;
+  FrameEncoder encoder(config);
+  std::vector<std::vector<uint8_t>> frames(10);
+  for (size_t f = 0; f < frames.size(); ++f)
+  {
+    std::vector<TelemetryPacket> batch(4);
+    for (size_t i = 0; i < batch.size(); ++i)
+      batch[i].timestamp = f * 4 + i;
+    encoder.encode(batch.data(), batch.size(), frames[f]);
+  }
+  std::fill(frames[5].begin() + 8, frames[5].end(), 0xFF);
+
+  Gauge &in_flight = metrics().gauge("telemetry_pipeline_frames_in_flight", "");
+  int64_t in_flight_before = in_flight.value();
+  size_t delivered = 0;
+  DecodePipeline pipeline(config, [&](const TelemetryPacket *, size_t count)
+                          { delivered += count; });
+  FrameDecoder decoder(config);
+  for (const std::vector<uint8_t> &frame : frames)
+    if (!pipeline.submit(decoder.parse_header(frame.data()), frame.data() + 8))
+      break;
+  ASSERT_TRUE(!pipeline.finish(), "Corrupt frame went unnoticed");
+  ASSERT_EQUAL(delivered, 20u, "Frames after the corrupt one were delivered");
+  ASSERT_EQUAL(in_flight.value(), in_flight_before, "Frames in flight left counted after the corrupt one");
+
+  // And over a real link, with the blocking receiver handing frames to workers
+  const uint64_t NUM_PACKETS = 20000;
+  LinkConfig link;
+  link.port = 5105;
+  link.frame_mode = FrameMode::Batched;
+  link.codec = PayloadCodec::Columnar;
+  link.batch_size = 32;
+  link.batch_deadline = std::chrono::milliseconds(1);
+  link.decode_workers = 2;
+  link.verbose = false;
+  std::vector<uint64_t> arrival;
+  link.on_packet = [&](const TelemetryPacket &pkt)
+  { arrival.push_back(pkt.timestamp); };
+
+  std::thread ground_station([&]
+                             { ground_station_thread(link); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  TelemetryBuffer buffer(1024, BufferMode::SpscRing);
+  std::thread transmitter([&]
+                          { transmitter_thread(buffer, link); });
+  for (uint64_t ts = 0; ts < NUM_PACKETS; ++ts)
+  {
+    TelemetryPacket pkt{};
+    pkt.timestamp = ts;
+    buffer.push(pkt);
+  }
+  while (buffer.size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  buffer.shutdown();
+  transmitter.join();
+  ground_station.join();
+
+  ASSERT_EQUAL(arrival.size(), NUM_PACKETS, "Packets lost on the link");
+  ASSERT_TRUE(std::is_sorted(arrival.begin(), arrival.end()), "Link delivered packets out of order");
+
+  PASS_TEST();
+}
+
+void test_overflow_policies()
+{
+  LOG_TEST("Buffer Overflow Policies (timeout, drop oldest/newest, spill to disk)");
+
+  auto fill = [](TelemetryBuffer &buffer, uint64_t count)
+  {
+    size_t accepted = 0;
+    for (uint64_t ts = 0; ts < count; ++ts)
+    {
+      TelemetryPacket pkt{};
+      pkt.timestamp = ts;
+      accepted += buffer.push_n(&pkt, 1);
+    }
+    return accepted;
+  };
+  auto drain = [](TelemetryBuffer &buffer)
+  {
+    std::vector<uint64_t> out;
+    TelemetryPacket batch[16];
+    while (size_t n = buffer.pop_n(batch, 16, std::chrono::steady_clock::now()))
+      for (size_t i = 0; i < n; ++i)
+        out.push_back(batch[i].timestamp);
+    return out;
+  };
+
+  // Nobody consumes, so every policy has to deal with 92 packets too many
+  OverflowConfig overflow;
+  for (BufferMode mode : {BufferMode::Locked, BufferMode::SpscRing})
+  {
+    overflow.policy = OverflowPolicy::DropNewest;
+    TelemetryBuffer newest(8, mode, WaitStrategy::Block, overflow);
+    ASSERT_EQUAL(fill(newest, 100), 8u, "DropNewest accepted too many");
+    ASSERT_EQUAL(newest.dropped(), 92u, "DropNewest drop count");
+    std::vector<uint64_t> kept = drain(newest);
+    ASSERT_TRUE(kept.size() == 8 && kept.front() == 0 && kept.back() == 7, "DropNewest kept the wrong packets");
+
+    overflow.policy = OverflowPolicy::BlockTimeout;
+    overflow.timeout = std::chrono::milliseconds(5);
+    TelemetryBuffer timeout(8, mode, WaitStrategy::Block, overflow);
+    std::vector<TelemetryPacket> pkts(10);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQUAL(timeout.push_n(pkts.data(), pkts.size()), 8u, "BlockTimeout accepted too many");
+    ASSERT_TRUE(std::chrono::steady_clock::now() - start >= overflow.timeout, "BlockTimeout gave up early");
+    ASSERT_EQUAL(timeout.dropped(), 2u, "BlockTimeout drop count");
+  }
+
+  overflow.policy = OverflowPolicy::DropOldest;
+  TelemetryBuffer oldest(8, BufferMode::Locked, WaitStrategy::Block, overflow);
+  ASSERT_EQUAL(fill(oldest, 100), 100u, "DropOldest should accept everything");
+  ASSERT_EQUAL(oldest.evicted(), 92u, "DropOldest eviction count");
+  std::vector<uint64_t> kept = drain(oldest);
+  ASSERT_TRUE(kept.size() == 8 && kept.front() == 92 && kept.back() == 99, "DropOldest kept the wrong packets");
+
+  bool threw = false;
+  try
+  {
+    TelemetryBuffer spsc(8, BufferMode::SpscRing, WaitStrategy::Block, overflow);
+  }
+  catch (const std::invalid_argument &)
+  {
+    threw = true;
+  }
+  ASSERT_TRUE(threw, "DropOldest should be rejected on an SpscRing buffer");
+
+  // Spill: 8 in memory, 50 on disk, the 42 oldest spilled packets evicted
+  overflow.policy = OverflowPolicy::Spill;
+  overflow.spill_capacity = 50;
+  TelemetryBuffer spill(8, BufferMode::Locked, WaitStrategy::Block, overflow);
+  ASSERT_EQUAL(fill(spill, 100), 100u, "Spill should accept everything");
+  ASSERT_EQUAL(spill.size(), 58u, "Spilled packets missing from size()");
+  ASSERT_EQUAL(spill.spilled(), 92u, "Spill count");
+  ASSERT_EQUAL(spill.evicted(), 42u, "Spill eviction count");
+  kept = drain(spill);
+  ASSERT_EQUAL(kept.size(), 58u, "Spilled packets lost");
+  for (size_t i = 0; i < kept.size(); ++i)
+    ASSERT_EQUAL(kept[i], i < 8 ? i : i + 42, "Spilled packets drained out of order");
+
+  // A spill file the disk cannot hold is refused up front, not discovered as
+  // SIGBUS mid-outage. A file size limit stands in for a full disk, in a child
+  // so the limit stays there.
+  pid_t child = fork();
+  if (child == 0)
+  {
+    signal(SIGXFSZ, SIG_IGN);
+    rlimit limit{1 << 20, 1 << 20};
+    setrlimit(RLIMIT_FSIZE, &limit);
+    overflow.spill_capacity = 1 << 20; // 48 MB
+    try
+    {
+      TelemetryBuffer full_disk(8, BufferMode::Locked, WaitStrategy::Block, overflow);
+    }
+    catch (const std::runtime_error &)
+    {
+      _exit(0);
+    }
+    _exit(1);
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0, "A spill file without room on disk should be refused");
+
+  // A producer that never stalls against a slow consumer: everything arrives, in order
+  const uint64_t NUM_PACKETS = 50000;
+  overflow.spill_capacity = NUM_PACKETS;
+  TelemetryBuffer live(64, BufferMode::Locked, WaitStrategy::Block, overflow);
+  std::vector<uint64_t> received;
+  std::thread consumer([&]
+                       {
+    TelemetryPacket batch[32];
+    while (size_t n = live.pop_n(batch, 32))
+    {
+      for (size_t i = 0; i < n; ++i)
+        received.push_back(batch[i].timestamp);
+      if (received.size() % 4096 < 32)
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    } });
+  for (uint64_t ts = 0; ts < NUM_PACKETS; ++ts)
+  {
+    TelemetryPacket pkt{};
+    pkt.timestamp = ts;
+    live.push(pkt);
+  }
+  while (live.size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  live.shutdown();
+  consumer.join();
+
+  std::cout << "  > " << live.spilled() << " of " << NUM_PACKETS << " packets went through the spill ring" << std::endl;
+  ASSERT_TRUE(live.spilled() > 0, "Slow consumer never caused a spill");
+  ASSERT_EQUAL(received.size(), NUM_PACKETS, "Packets lost through the spill ring");
+  for (size_t i = 0; i < received.size(); ++i)
+    ASSERT_EQUAL(received[i], i, "Packets reordered through the spill ring");
+
+  PASS_TEST();
+}
+
+void test_reliable_link()
+{
+  LOG_TEST("Reliable Link (sequence acks, reconnect with backoff, retransmit)");
+
+  // The transmitter talks to a relay that drops the connection every 20 KB;
+  // every packet must still arrive exactly once and in order
+  const uint64_t NUM_PACKETS = 30000;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_PACKETS);
+  for (PayloadCodec codec : {PayloadCodec::Deflate, PayloadCodec::Columnar})
+  {
+    LinkConfig config;
+    config.port = 5106;
+    config.reliable = true;
+    config.frame_mode = FrameMode::Batched;
+    config.codec = codec;
+    config.batch_size = 16;
+    config.batch_deadline = std::chrono::milliseconds(1);
+    config.retransmit_window = 64;
+    config.reconnect_backoff = std::chrono::milliseconds(5);
+    config.reconnect_timeout = std::chrono::milliseconds(3000);
+    config.verbose = false;
+    std::vector<TelemetryPacket> received;
+    config.on_packet = [&](const TelemetryPacket &pkt)
+    { received.push_back(pkt); };
+
+    LinkConfig tx_config = config;
+    tx_config.port = 5107;
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> cuts{0};
+    std::thread relay([&]
+                      { flaky_relay(tx_config.port, config.port, 20000, stop, cuts); });
+    std::thread ground_station([&]
+                               { ground_station_thread(config); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Counter &retransmitted = metrics().counter("telemetry_reliable_retransmitted_frames_total", "");
+    uint64_t retransmitted0 = retransmitted.value();
+
+    TelemetryBuffer buffer(1024, BufferMode::SpscRing);
+    std::thread transmitter([&]
+                            { transmitter_thread(buffer, tx_config); });
+    buffer.push_n(stream.data(), stream.size());
+    while (buffer.size() > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    buffer.shutdown();
+    transmitter.join();
+    ground_station.join();
+    stop = true;
+    relay.join();
+
+    std::cout << "  > " << (codec == PayloadCodec::Deflate ? "deflate" : "columnar") << ": " << received.size()
+              << " packets through " << cuts.load() << " dropped connections, "
+              << retransmitted.value() - retransmitted0 << " frames retransmitted" << std::endl;
+    ASSERT_TRUE(cuts.load() >= 2, "Relay never dropped the link");
+    ASSERT_EQUAL(received.size(), NUM_PACKETS, "Packets lost or duplicated across reconnects");
+    for (size_t i = 0; i < received.size(); ++i)
+      ASSERT_TRUE(compare_packets(received[i], stream[i]), "Packet corrupted or out of order across reconnects");
+  }
+
+  // With nobody listening the transmitter gives up after reconnect_timeout instead of hanging
+  LinkConfig config;
+  config.port = 5108;
+  config.reliable = true;
+  config.reconnect_backoff = std::chrono::milliseconds(5);
+  config.reconnect_timeout = std::chrono::milliseconds(100);
+  TelemetryBuffer buffer(16);
+  auto start = std::chrono::steady_clock::now();
+  transmitter_thread(buffer, config);
+  ASSERT_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(2), "Transmitter kept retrying");
+
+  PASS_TEST();
+}
+
+void test_uring_backend()
+{
+  LOG_TEST("io_uring Backend (batched linked writes, multishot recv)");
+
+  // Byte stream first: frames of every size, including ones bigger than a
+  // send slot, must come out the other end unchanged
+  int sv[2];
+  ASSERT_TRUE(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0, "socketpair failed");
+  LinkConfig config;
+  config.uring_depth = 8;
+  UringSender sender(sv[0], config);
+  UringReceiver receiver(sv[1]);
+  if (!sender.ok() || !receiver.ok())
+  {
+    std::cout << "  > io_uring unavailable here, skipped" << std::endl;
+    close(sv[0]);
+    close(sv[1]);
+    PASS_TEST();
+    return;
+  }
+
+  std::mt19937 rng(3);
+  std::vector<uint8_t> sent;
+  const size_t NUM_FRAMES = 5000;
+  std::vector<uint8_t> got;
+  std::thread reader([&]
+                     {
+    uint8_t chunk[3000];
+    ssize_t n;
+    while ((n = receiver.read(chunk, sizeof(chunk))) > 0)
+      got.insert(got.end(), chunk, chunk + n); });
+  for (size_t i = 0; i < NUM_FRAMES; ++i)
+  {
+    size_t len = i % 1000 == 999 ? UringSender::kSlotSize + 100 : 1 + rng() % 400;
+    std::vector<uint8_t> frame(len);
+    for (auto &b : frame)
+      b = static_cast<uint8_t>(rng());
+    sent.insert(sent.end(), frame.begin(), frame.end());
+    ASSERT_TRUE(sender.send(frame.data(), frame.size()), "UringSender::send failed");
+    if (i % 100 == 99)
+      ASSERT_TRUE(sender.submit(), "UringSender::submit failed");
+  }
+  ASSERT_TRUE(sender.flush(), "UringSender::flush failed");
+  shutdown(sv[0], SHUT_WR);
+  reader.join();
+  close(sv[0]);
+  close(sv[1]);
+
+  std::cout << "  > " << NUM_FRAMES << " frames (" << sent.size() << " bytes): " << sender.syscalls()
+            << " syscalls to send, " << receiver.syscalls() << " to receive" << std::endl;
+  ASSERT_EQUAL(got.size(), sent.size(), "Byte count differs");
+  ASSERT_TRUE(got == sent, "Stream corrupted or reordered");
+  ASSERT_TRUE(sender.syscalls() < NUM_FRAMES / 4, "Writes were not batched");
+
+  // End to end: both framings deliver the same packets in order as over plain sockets
+  const uint64_t NUM_PACKETS = 20000;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_PACKETS);
+  Counter &enters = metrics().counter("telemetry_io_syscalls_total", "", "call=\"io_uring_enter\"");
+  for (FrameMode mode : {FrameMode::PerPacket, FrameMode::Batched})
+  {
+    LinkConfig link;
+    link.port = 5109;
+    link.io_backend = IoBackend::Uring;
+    link.frame_mode = mode;
+    link.batch_deadline = std::chrono::milliseconds(1);
+    link.verbose = false;
+    std::vector<TelemetryPacket> received;
+    link.on_packet = [&](const TelemetryPacket &pkt)
+    { received.push_back(pkt); };
+    uint64_t enters0 = enters.value();
+
+    std::thread ground_station([&]
+                               { ground_station_thread(link); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    TelemetryBuffer buffer(1024, BufferMode::SpscRing);
+    std::thread transmitter([&]
+                            { transmitter_thread(buffer, link); });
+    buffer.push_n(stream.data(), stream.size());
+    while (buffer.size() > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    buffer.shutdown();
+    transmitter.join();
+    ground_station.join();
+
+    std::cout << "  > " << (mode == FrameMode::PerPacket ? "per-packet" : "batched") << ": " << received.size()
+              << " packets, " << enters.value() - enters0 << " io_uring_enter calls" << std::endl;
+    ASSERT_EQUAL(received.size(), NUM_PACKETS, "Packets lost over io_uring");
+    for (size_t i = 0; i < received.size(); ++i)
+      ASSERT_TRUE(compare_packets(received[i], stream[i]), "Packet corrupted or out of order over io_uring");
+    ASSERT_TRUE(enters.value() > enters0, "Link did not go through io_uring");
+  }
+
+  PASS_TEST();
+}
+
+void test_shm_transport()
+{
+  LOG_TEST("Shared-Memory Transport (SPSC ring, futex wakeups, separate processes)");
+
+  // Records of every size from a transmitter in another process. The ring is
+  // the smallest allowed, so it wraps and fills over and over.
+  LinkConfig config;
+  config.transport = Transport::Shm;
+  config.shm_name = "telemetry-test-" + std::to_string(getpid());
+  config.shm_capacity = 0;
+  config.reconnect_timeout = std::chrono::milliseconds(3000);
+  const size_t NUM_RECORDS = 20000;
+  auto record = [](size_t i, std::vector<uint8_t> &out)
+  {
+    out.resize(1 + (i * 7919) % 3000);
+    for (size_t b = 0; b < out.size(); ++b)
+      out[b] = static_cast<uint8_t>(i + b);
+  };
+
+  ShmReceiver receiver(config);
+  ASSERT_TRUE(receiver.ok(), "Could not create the shared ring");
+  pid_t child = fork();
+  if (child == 0)
+  {
+    ShmSender sender(config);
+    std::vector<uint8_t> bytes;
+    bool ok = sender.ok();
+    for (size_t i = 0; ok && i < NUM_RECORDS; ++i)
+    {
+      record(i, bytes);
+      ok = sender.send(bytes.data(), bytes.size());
+    }
+    sender.close();
+    _exit(ok ? 0 : 1);
+  }
+  ASSERT_TRUE(receiver.wait_for_sender(config.reconnect_timeout), "Transmitter process never attached");
+  ASSERT_TRUE(access(("/dev/shm/" + config.shm_name).c_str(), F_OK) != 0, "Ring name left behind after attach");
+
+  std::vector<uint8_t> expected;
+  const uint8_t *data;
+  size_t len, count = 0;
+  bool intact = true;
+  while (receiver.next(data, len))
+  {
+    record(count++, expected);
+    intact = intact && len == expected.size() && std::memcmp(data, expected.data(), len) == 0;
+    receiver.release();
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  std::cout << "  > " << count << " records across processes" << std::endl;
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0, "Transmitter process failed");
+  ASSERT_EQUAL(count, NUM_RECORDS, "Records lost or invented");
+  ASSERT_TRUE(intact, "Record corrupted or out of order");
+
+  // A transmitter whose ground station has gone gets an error, not a hang
+  {
+    LinkConfig lonely = config;
+    lonely.shm_name += "-gone";
+    auto gs = std::make_unique<ShmReceiver>(lonely);
+    ShmSender sender(lonely);
+    ASSERT_TRUE(sender.ok(), "Sender did not attach");
+    gs.reset();
+    std::vector<uint8_t> bytes(1000, 1);
+    ASSERT_TRUE(!sender.send(bytes.data(), bytes.size()), "Sender wrote to a ring nobody reads");
+  }
+
+  // End to end: the link delivers the same packets in order, with no port involved
+  const uint64_t NUM_PACKETS = 20000;
+  std::vector<TelemetryPacket> stream = make_telemetry_stream(NUM_PACKETS);
+  for (FrameMode mode : {FrameMode::PerPacket, FrameMode::Batched})
+  {
+    LinkConfig link;
+    link.transport = Transport::Shm;
+    link.frame_mode = mode;
+    link.codec = PayloadCodec::Columnar;
+    link.batch_deadline = std::chrono::milliseconds(1);
+    link.verbose = false;
+    std::vector<TelemetryPacket> received;
+    link.on_packet = [&](const TelemetryPacket &pkt)
+    { received.push_back(pkt); };
+
+    std::thread ground_station([&]
+                               { ground_station_thread(link); });
+    TelemetryBuffer buffer(1024, BufferMode::SpscRing);
+    std::thread transmitter([&]
+                            { transmitter_thread(buffer, link); });
+    buffer.push_n(stream.data(), stream.size());
+    while (buffer.size() > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    buffer.shutdown();
+    transmitter.join();
+    ground_station.join();
+
+    ASSERT_EQUAL(received.size(), NUM_PACKETS, "Packets lost over shared memory");
+    for (size_t i = 0; i < received.size(); ++i)
+      ASSERT_TRUE(compare_packets(received[i], stream[i]), "Packet corrupted or out of order over shared memory");
+  }
+
+  PASS_TEST();
+}
+
 void test_full_system_integration()
 {
   LOG_TEST("Full System Integration (Sensors -> TX -> RX)");
 
   TelemetryBuffer buffer(100);
 
-  std::thread ground_station(ground_station_thread);
+  std::thread ground_station([]
+                             { ground_station_thread(); });
   std::this_thread::sleep_for(std::chrono::seconds(1));
 
-  std::thread sensor(sensor_thread, std::ref(buffer));
-  std::thread transmitter(transmitter_thread, std::ref(buffer));
+  std::thread sensor([&buffer]
+                     { sensor_thread(buffer); });
+  std::thread transmitter([&buffer]
+                          { transmitter_thread(buffer); });
 
   std::cout << "  > Simulating for 5 seconds..." << std::endl;
   std::this_thread::sleep_for(std::chrono::seconds(5));
@@ -223,9 +2841,34 @@ int main()
   std::cout << "======================================\n\n";
 
   test_serialization();
+  test_packet_schema();
   test_compression();
+  test_compression_codecs();
+  test_batched_frames();
+  test_columnar_codec();
+  test_quantized_codec();
+  test_async_logger();
+  test_archive();
+  test_aggregator();
+  test_anomaly_detector();
+  test_sharded_logger();
   test_buffer_behavior();
   test_buffer_concurrency();
+  test_spsc_buffer_batches();
+  test_spsc_buffer_concurrency();
+  test_sharded_buffer_concurrency();
+  test_epoll_ground_station();
+  test_metrics();
+  test_virtual_clock();
+  test_fleet_simulator();
+  test_udp_transport();
+  test_ccsds_frames();
+  test_priority_scheduler();
+  test_decode_pipeline();
+  test_overflow_policies();
+  test_reliable_link();
+  test_uring_backend();
+  test_shm_transport();
   test_full_system_integration();
 
   std::cout << "All tests passed successfully!" << std::endl;
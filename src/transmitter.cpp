@@ -1,48 +1,381 @@
 #include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <thread>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 
 #include "../include/buffer.h"
+#include "../include/sharded_buffer.h"
 #include "../include/compression.h"
+#include "../include/frame.h"
+#include "../include/link.h"
+#include "../include/net.h"
+#include "../include/metrics.h"
+#include "../include/udp.h"
+#include "../include/reliable.h"
+#include "../include/priority_buffer.h"
+#include "../include/uring.h"
+#include "../include/shm.h"
 
-void transmitter_thread(TelemetryBuffer &buffer)
+// Emulates a downlink of LinkConfig::link_rate bytes/s: after each send the
+// transmitter sleeps until the link would have finished serialising it, so the
+// backlog builds up in the buffer in front of it rather than in the socket.
+class LinkPacer
 {
-  int sock = socket(AF_INET, SOCK_STREAM, 0);
-  if (sock < 0)
+  using Clock = std::chrono::steady_clock;
+  double rate_;
+  Clock::time_point free_at_{};
+
+public:
+  explicit LinkPacer(uint64_t rate) : rate_(static_cast<double>(rate)) {}
+
+  void sent(size_t bytes)
   {
-    perror("socket");
-    return;
+    if (rate_ <= 0)
+      return;
+    // An idle link does not bank credit for a later burst
+    free_at_ = std::max(free_at_, Clock::now()) +
+               std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(bytes / rate_));
+    std::this_thread::sleep_until(free_at_);
   }
+};
 
-  sockaddr_in server_addr{};
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_port = htons(5000);
-  inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
+// Blocks for the first packet, then keeps filling the batch until it is full
+// or the batch deadline passes. Returns 0 once the buffer is shut down and empty.
+template <typename Buffer>
+static size_t collect_batch(Buffer &buffer, std::vector<TelemetryPacket> &batch, const LinkConfig &config)
+{
+  size_t n = buffer.pop_n(batch.data(), batch.size());
+  if (n == 0 || config.frame_mode == FrameMode::PerPacket)
+    return n;
 
-  if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+  auto deadline = std::chrono::steady_clock::now() + config.batch_deadline;
+  while (n < batch.size())
   {
-    perror("connect");
-    close(sock);
-    return;
+    size_t got = buffer.pop_n(batch.data() + n, batch.size() - n, deadline);
+    if (got == 0)
+      break;
+    n += got;
   }
+  return n;
+}
+
+// Packets per frame; per-packet frames take them one at a time
+static size_t transmit_batch_size(const LinkConfig &config)
+{
+  return config.frame_mode != FrameMode::PerPacket ? std::max<size_t>(config.batch_size, 1) : 1;
+}
+
+// What one send() put on the wire
+struct SentBatch
+{
+  size_t bytes = 0;
+  size_t frames = 0;  // left out of telemetry_tx_frames_total when 0
+  size_t refused = 0; // packets the transport knows never left
+};
+
+struct TransmitTotals
+{
+  uint64_t packets = 0, frames = 0, wire_bytes = 0;
+  double seconds = 0;
+};
+
+// The loop every transport shares: collect(batch) fills a batch (0 ends the
+// run), send(pkts, n, sent) puts it on the wire and returns false to stop.
+// Pacing, the tx counters and the totals are kept here.
+template <typename Buffer, typename Collect, typename Send>
+static TransmitTotals transmit_loop(Buffer &buffer, const LinkConfig &config, Collect collect, Send send)
+{
+  std::vector<TelemetryPacket> batch(transmit_batch_size(config));
+  LinkPacer pacer(config.link_rate);
+  TransmitTotals totals;
+  auto start = std::chrono::steady_clock::now();
+
+  Counter &tx_packets = metrics().counter("telemetry_tx_packets_total", "Packets sent by transmitters");
+  Counter &tx_frames = metrics().counter("telemetry_tx_frames_total", "Frames sent by transmitters");
+  Counter &tx_bytes = metrics().counter("telemetry_tx_bytes_total", "Bytes sent by transmitters, framing included");
 
   while (!buffer.is_shutdown())
   {
-    TelemetryPacket pkt = buffer.pop();
+    size_t n = collect(batch);
+    if (n == 0)
+      break;
 
-    if (pkt.timestamp == 0)
+    SentBatch sent;
+    if (!send(batch.data(), n, sent))
       break;
+    pacer.sent(sent.bytes);
 
-    std::vector<uint8_t> bytes = serialise(pkt);
-    bytes = compress_data(bytes);
+    totals.packets += n;
+    totals.frames += sent.frames;
+    totals.wire_bytes += sent.bytes;
+    tx_packets.add(n - sent.refused);
+    if (sent.frames > 0)
+      tx_frames.add(sent.frames);
+    tx_bytes.add(sent.bytes);
+  }
+  totals.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return totals;
+}
 
-    uint32_t len = htonl(bytes.size());
-    send(sock, &len, sizeof(len), 0);
-    send(sock, bytes.data(), bytes.size(), 0);
+// transmit_loop with plain collect_batch
+template <typename Buffer, typename Send>
+static TransmitTotals transmit_loop(Buffer &buffer, const LinkConfig &config, Send send)
+{
+  return transmit_loop(buffer, config, [&](std::vector<TelemetryPacket> &batch)
+                       { return collect_batch(buffer, batch, config); },
+                       send);
+}
 
-    std::cout << "[Transmitter] Sent packet with timestamp " << pkt.timestamp
-              << " (" << bytes.size() << " bytes)\n";
+// Datagram flavour of run_transmitter. With an impairment configured the
+// datagrams take a detour through a local ImpairmentProxy.
+template <typename Buffer>
+static void run_udp_transmitter(Buffer &buffer, const LinkConfig &config)
+{
+  std::unique_ptr<ImpairmentProxy> proxy;
+  uint16_t port = config.port;
+  if (config.impairment.enabled())
+  {
+    proxy = std::make_unique<ImpairmentProxy>(config.port, config.impairment);
+    if (!proxy->ok())
+      return;
+    port = proxy->port();
+  }
+
+  UdpSender sender(port, config);
+  if (!sender.ok())
+    return;
+
+  auto send = [&](const TelemetryPacket *pkts, size_t n, SentBatch &sent)
+  {
+    uint64_t bytes_before = sender.bytes(), dropped_before = sender.dropped_packets();
+    if (!sender.send(pkts, n) || !sender.flush())
+      return false;
+    sent.bytes = sender.bytes() - bytes_before;
+    sent.refused = sender.dropped_packets() - dropped_before;
+    if (config.verbose)
+      std::cout << "[Transmitter] Sent datagrams up to #" << sender.datagrams() - 1 << " with timestamps "
+                << pkts[0].timestamp << ".." << pkts[n - 1].timestamp << " (" << n << " packets)\n";
+    return true;
+  };
+  TransmitTotals totals = transmit_loop(buffer, config, send);
+  sender.finish();
+
+  if (totals.packets > 0)
+    std::cout << "[Transmitter] " << totals.packets << " packets in " << sender.datagrams() << " datagrams over "
+              << sender.syscalls() << " sendmmsg calls: " << static_cast<double>(sender.bytes()) / totals.packets
+              << " bytes/packet on wire, " << totals.packets / totals.seconds << " packets/s\n";
+  if (sender.dropped() > 0)
+    std::cout << "[Transmitter] " << sender.dropped() << " datagrams (" << sender.dropped_packets()
+              << " packets) refused: no ground station listening\n";
+  if (proxy)
+  {
+    proxy->stop();
+    std::cout << "[Transmitter] Impairment: " << proxy->dropped() << " datagrams dropped, "
+              << proxy->reordered() << " held back, " << proxy->forwarded() << " forwarded\n";
   }
+}
+
+// Shared-memory flavour of run_transmitter: each encode() output becomes one
+// record in the ring the ground station created.
+template <typename Buffer>
+static void run_shm_transmitter(Buffer &buffer, const LinkConfig &config)
+{
+  ShmSender sender(config);
+  if (!sender.ok())
+    return;
+
+  FrameEncoder encoder(config);
+  std::vector<uint8_t> bytes;
+  uint64_t records = 0;
+  Histogram &send_time = stage_histogram("send");
+
+  auto send = [&](const TelemetryPacket *pkts, size_t n, SentBatch &sent)
+  {
+    bytes.clear();
+    encoder.encode(pkts, n, bytes);
+    uint64_t t0 = metrics_now_ns();
+    if (!sender.send(bytes.data(), bytes.size()))
+    {
+      std::cerr << "[Transmitter] Ground station went away\n";
+      return false;
+    }
+    send_time.record(metrics_now_ns() - t0);
+    records++;
+    sent.bytes = bytes.size();
+    return true;
+  };
+  TransmitTotals totals = transmit_loop(buffer, config, send);
+  sender.close();
+
+  if (totals.packets > 0)
+    std::cout << "[Transmitter] " << totals.packets << " packets in " << records << " records over shared memory: "
+              << static_cast<double>(totals.wire_bytes) / totals.packets << " bytes/packet, "
+              << totals.packets / totals.seconds << " packets/s\n";
+}
+
+// Sequence-numbered flavour of run_transmitter: a dropped connection is
+// retried with backoff and nothing popped from the buffer is lost.
+template <typename Buffer>
+static void run_reliable_transmitter(Buffer &buffer, const LinkConfig &config)
+{
+  ReliableSender sender(config);
+  if (!sender.ok())
+    return;
+
+  bool ok = true;
+  auto send = [&](const TelemetryPacket *pkts, size_t n, SentBatch &sent)
+  {
+    uint64_t bytes_before = sender.wire_bytes();
+    if (!(ok = sender.send(pkts, n)))
+      return false;
+    sent.bytes = sender.wire_bytes() - bytes_before;
+    sent.frames = 1;
+    return true;
+  };
+  TransmitTotals totals = transmit_loop(buffer, config, send);
+  if (ok)
+    ok = sender.finish();
+
+  if (totals.packets > 0)
+    std::cout << "[Transmitter] " << totals.packets << " packets in " << sender.frames() << " frames, "
+              << sender.reconnects() << " reconnects, " << sender.retransmitted() << " frames retransmitted, "
+              << totals.packets / totals.seconds << " packets/s" << (ok ? "" : " (link lost)") << "\n";
+}
+
+// Shared by every buffer flavour: anything with pop_n() and is_shutdown()
+template <typename Buffer>
+static void run_transmitter(Buffer &buffer, const LinkConfig &config)
+{
+  if (config.transport == Transport::Udp)
+  {
+    run_udp_transmitter(buffer, config);
+    return;
+  }
+  if (config.transport == Transport::Shm)
+  {
+    run_shm_transmitter(buffer, config);
+    return;
+  }
+  if (config.reliable)
+  {
+    run_reliable_transmitter(buffer, config);
+    return;
+  }
+
+  int sock = connect_loopback(config.port);
+  if (sock < 0)
+    return;
+
+  std::unique_ptr<UringSender> uring;
+  if (config.io_backend == IoBackend::Uring)
+  {
+    uring = std::make_unique<UringSender>(sock, config);
+    if (!uring->ok())
+    {
+      std::cerr << "[Transmitter] io_uring unavailable, using send()\n";
+      uring.reset();
+    }
+  }
+
+  FrameEncoder encoder(config);
+  std::vector<uint8_t> bytes;
+  Histogram &send_time = stage_histogram("send");
+
+  auto collect = [&](std::vector<TelemetryPacket> &batch) -> size_t
+  {
+    // io_uring keeps queuing frames while packets are waiting and hands them
+    // to the kernel before this thread could block on the buffer
+    size_t n = 0;
+    if (uring && uring->queued() > 0)
+    {
+      n = buffer.pop_n(batch.data(), batch.size(), std::chrono::steady_clock::now());
+      if (n < batch.size() && !uring->submit())
+      {
+        perror("io_uring write");
+        return 0;
+      }
+    }
+    return n > 0 ? n : collect_batch(buffer, batch, config);
+  };
+
+  auto send = [&](const TelemetryPacket *pkts, size_t n, SentBatch &sent)
+  {
+    bytes.clear();
+    encoder.encode(pkts, n, bytes);
+
+    // Header and payload go out in a single send(), or a single queued write
+    uint64_t t0 = metrics_now_ns();
+    if (uring ? !uring->send(bytes.data(), bytes.size()) : !send_all(sock, bytes.data(), bytes.size()))
+    {
+      perror("send");
+      return false;
+    }
+    send_time.record(metrics_now_ns() - t0);
+    sent.bytes = bytes.size();
+    // A CCSDS batch can span several fixed-size transfer frames
+    sent.frames = config.frame_mode == FrameMode::Ccsds ? bytes.size() / kCaduSize : 1;
+
+    if (!config.verbose)
+      return true;
+    if (n == 1)
+      std::cout << "[Transmitter] Sent packet with timestamp " << pkts[0].timestamp
+                << " (" << bytes.size() << " bytes)\n";
+    else
+      std::cout << "[Transmitter] Sent frame with timestamps " << pkts[0].timestamp
+                << ".." << pkts[n - 1].timestamp
+                << " (" << n << " packets, " << bytes.size() << " bytes)\n";
+    return true;
+  };
+  TransmitTotals totals = transmit_loop(buffer, config, collect, send);
+
+  if (uring)
+  {
+    if (!uring->flush())
+      perror("io_uring write");
+    metrics().counter("telemetry_io_syscalls_total", "Syscalls made to move link bytes", "call=\"io_uring_enter\"").add(uring->syscalls());
+  }
+
+  if (totals.packets > 0)
+    std::cout << "[Transmitter] " << totals.packets << " packets in " << totals.frames << " frames (batch "
+              << transmit_batch_size(config) << "): " << static_cast<double>(totals.wire_bytes) / totals.packets
+              << " bytes/packet on wire, " << totals.packets / totals.seconds << " packets/s"
+              << (uring ? ", " + std::to_string(uring->syscalls()) + " io_uring_enter calls" : "") << "\n";
+  uring.reset();
   close(sock);
 }
+
+void transmitter_thread(TelemetryBuffer &buffer, const LinkConfig &config)
+{
+  run_transmitter(buffer, config);
+  // Returning early means the link is gone; unblock the sensor rather than
+  // let it fill a buffer nobody drains
+  if (!buffer.is_shutdown())
+    buffer.shutdown();
+}
+
+void transmitter_thread(ShardedTelemetryBuffer::Consumer consumer, const LinkConfig &config)
+{
+  run_transmitter(consumer, config);
+}
+
+void transmitter_thread(PriorityTelemetryBuffer &buffer, const LinkConfig &config)
+{
+  run_transmitter(buffer, config);
+  if (!buffer.is_shutdown())
+    buffer.shutdown();
+}
+
+void transmitter_thread(TelemetryBuffer &buffer)
+{
+  run_transmitter(buffer, LinkConfig{});
+}
+
+void transmitter_thread(ShardedTelemetryBuffer::Consumer consumer)
+{
+  run_transmitter(consumer, LinkConfig{});
+}
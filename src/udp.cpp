@@ -0,0 +1,569 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "../include/udp.h"
+#include "../include/columnar_codec.h"
+#include "../include/ground_station.h"
+#include "../include/metrics.h"
+#include "../include/net.h"
+
+namespace
+{
+  constexpr uint8_t kFlagFin = 1;
+  constexpr int kFinCopies = 3;
+  constexpr int kReceiveBuffer = 8 << 20; // absorbs bursts while the receiver is busy logging
+
+  using Clock = std::chrono::steady_clock;
+
+  struct UdpMetrics
+  {
+    Histogram &compress = stage_histogram("compress");
+    Histogram &decompress = stage_histogram("decompress");
+    Histogram &send = stage_histogram("send");
+    Histogram &recv = stage_histogram("recv");
+    Counter &tx_datagrams = metrics().counter("telemetry_udp_tx_datagrams_total", "Datagrams sent by UDP transmitters");
+    Counter &tx_syscalls = metrics().counter("telemetry_udp_tx_syscalls_total", "sendmmsg calls made by UDP transmitters");
+    Counter &tx_dropped = metrics().counter("telemetry_udp_tx_dropped_datagrams_total", "Datagrams refused before they left a UDP transmitter");
+    Counter &rx_datagrams = metrics().counter("telemetry_udp_rx_datagrams_total", "Datagrams received at the UDP ground station");
+    Counter &rx_syscalls = metrics().counter("telemetry_udp_rx_syscalls_total", "recvmmsg calls that returned datagrams");
+    Counter &gaps = metrics().counter("telemetry_udp_gaps_total", "Jumps in a link's datagram sequence");
+    Counter &lost = metrics().counter("telemetry_udp_lost_datagrams_total", "Datagrams never received, counted when a link ends");
+    Counter &reordered = metrics().counter("telemetry_udp_reordered_datagrams_total", "Datagrams that arrived after a later one");
+    Counter &injected_drops = metrics().counter("telemetry_udp_injected_drops_total", "Datagrams dropped by impairment proxies");
+    Counter &injected_holds = metrics().counter("telemetry_udp_injected_holds_total", "Datagrams held back by impairment proxies");
+    Counter &malformed = metrics().counter("telemetry_udp_malformed_datagrams_total", "Datagrams that failed to decode");
+  };
+
+  UdpMetrics &udp_metrics()
+  {
+    static UdpMetrics m;
+    return m;
+  }
+
+  void put_u32(uint8_t *out, uint32_t value)
+  {
+    uint32_t be = htonl(value);
+    std::memcpy(out, &be, sizeof(be));
+  }
+
+  uint32_t get_u32(const uint8_t *in)
+  {
+    uint32_t be;
+    std::memcpy(&be, in, sizeof(be));
+    return ntohl(be);
+  }
+
+  void put_header(uint8_t *out, uint32_t seq, uint16_t count, DatagramEncoding encoding, uint8_t flags)
+  {
+    put_u32(out, seq);
+    uint16_t be = htons(count);
+    std::memcpy(out + 4, &be, sizeof(be));
+    out[6] = static_cast<uint8_t>(encoding);
+    out[7] = flags;
+  }
+
+  // Serial-number comparison, so sequences survive the wrap at 2^32
+  int32_t seq_diff(uint32_t a, uint32_t b)
+  {
+    return static_cast<int32_t>(a - b);
+  }
+}
+
+size_t encode_datagram(uint32_t seq, const TelemetryPacket *pkts, size_t count, DatagramEncoding preferred,
+                       uint8_t *out, Codec *codec)
+{
+  if (count > kMaxDatagramPackets)
+    throw std::invalid_argument("Too many packets for one datagram");
+
+  uint8_t *payload = out + kDatagramHeaderSize;
+  const size_t raw_size = count * kPacketWireSize;
+  for (size_t i = 0; i < count; ++i)
+    serialise_into(pkts[i], payload + i * kPacketWireSize);
+
+  DatagramEncoding used = DatagramEncoding::Raw;
+  size_t len = raw_size;
+  if (preferred != DatagramEncoding::Raw && count > 0)
+  {
+    ScopedTimer timer(udp_metrics().compress);
+    std::vector<uint8_t> packed;
+    if (preferred == DatagramEncoding::Columnar)
+      encode_columnar(pkts, count, packed);
+    else if (codec)
+      codec->compress(payload, raw_size, packed);
+    else
+      packed = compress_data(std::vector<uint8_t>(payload, payload + raw_size));
+
+    if (packed.size() < raw_size)
+    {
+      std::memcpy(payload, packed.data(), packed.size());
+      used = preferred;
+      len = packed.size();
+    }
+  }
+
+  put_header(out, seq, static_cast<uint16_t>(count), used, 0);
+  return kDatagramHeaderSize + len;
+}
+
+size_t encode_fin(uint32_t seq, uint8_t *out)
+{
+  put_header(out, seq, 0, DatagramEncoding::Raw, kFlagFin);
+  return kDatagramHeaderSize;
+}
+
+DatagramHeader decode_datagram(const uint8_t *data, size_t len, std::vector<TelemetryPacket> &out, Codec *codec)
+{
+  if (len < kDatagramHeaderSize)
+    throw std::runtime_error("Datagram shorter than its header");
+
+  DatagramHeader h;
+  h.seq = get_u32(data);
+  uint16_t be;
+  std::memcpy(&be, data + 4, sizeof(be));
+  h.count = ntohs(be);
+  h.encoding = static_cast<DatagramEncoding>(data[6]);
+  h.fin = data[7] & kFlagFin;
+  if (h.fin)
+    return h;
+  if (h.count > kMaxDatagramPackets)
+    throw std::runtime_error("Datagram packet count out of range");
+
+  const uint8_t *payload = data + kDatagramHeaderSize;
+  size_t payload_len = len - kDatagramHeaderSize;
+  size_t at = out.size();
+  out.resize(at + h.count);
+
+  switch (h.encoding)
+  {
+  case DatagramEncoding::Raw:
+    if (payload_len != h.count * kPacketWireSize)
+      throw std::runtime_error("Raw datagram has the wrong length");
+    for (size_t i = 0; i < h.count; ++i)
+      deserialise_into(payload + i * kPacketWireSize, out[at + i]);
+    break;
+  case DatagramEncoding::Zlib:
+  {
+    ScopedTimer timer(udp_metrics().decompress);
+    std::vector<uint8_t> bytes(payload, payload + payload_len);
+    std::vector<uint8_t> raw = codec ? decompress_data(bytes, h.count * kPacketWireSize, *codec)
+                                     : decompress_data(bytes, h.count * kPacketWireSize);
+    for (size_t i = 0; i < h.count; ++i)
+      deserialise_into(raw.data() + i * kPacketWireSize, out[at + i]);
+    break;
+  }
+  case DatagramEncoding::Columnar:
+  {
+    ScopedTimer timer(udp_metrics().decompress);
+    decode_columnar(payload, payload_len, h.count, out.data() + at);
+    break;
+  }
+  default:
+    out.resize(at);
+    throw std::runtime_error("Unknown datagram encoding");
+  }
+  return h;
+}
+
+UdpSender::UdpSender(uint16_t port, const LinkConfig &config)
+    : fd_(connect_udp_loopback(port)),
+      batch_(std::max<size_t>(config.datagram_batch, 1)),
+      encoding_(config.codec == PayloadCodec::Columnar ? DatagramEncoding::Columnar : DatagramEncoding::Zlib),
+      compressor_(make_codec(config.compression, config.link_rate)),
+      slots_(batch_ * kMaxDatagramSize)
+{
+  lengths_.reserve(batch_);
+  counts_.reserve(batch_);
+}
+
+UdpSender::~UdpSender()
+{
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool UdpSender::send(const TelemetryPacket *pkts, size_t count)
+{
+  while (count > 0)
+  {
+    size_t n = std::min(count, kMaxDatagramPackets);
+    lengths_.push_back(encode_datagram(seq_++, pkts, n, encoding_, slot(lengths_.size()), compressor_.get()));
+    counts_.push_back(n);
+    pkts += n;
+    count -= n;
+    if (lengths_.size() == batch_ && !flush())
+      return false;
+  }
+  return true;
+}
+
+bool UdpSender::flush()
+{
+  std::vector<mmsghdr> msgs(lengths_.size());
+  std::vector<iovec> iov(lengths_.size());
+  for (size_t i = 0; i < lengths_.size(); ++i)
+  {
+    iov[i] = {slot(i), lengths_[i]};
+    msgs[i] = {};
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  ScopedTimer timer(udp_metrics().send);
+  size_t sent = 0;
+  while (sent < msgs.size())
+  {
+    int n = sendmmsg(fd_, msgs.data() + sent, msgs.size() - sent, 0);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == ECONNREFUSED) // nobody listening yet: like any datagram, it is simply lost
+      {
+        dropped_++;
+        dropped_packets_ += counts_[sent];
+        udp_metrics().tx_dropped.add();
+        sent++;
+        continue;
+      }
+      perror("sendmmsg");
+      lengths_.clear();
+      counts_.clear();
+      return false;
+    }
+    syscalls_++;
+    udp_metrics().tx_syscalls.add();
+    udp_metrics().tx_datagrams.add(n);
+    for (int i = 0; i < n; ++i)
+      bytes_ += lengths_[sent + i];
+    sent += n;
+  }
+  lengths_.clear();
+  counts_.clear();
+  return true;
+}
+
+void UdpSender::finish()
+{
+  flush();
+  // FIN is not retransmitted, so a few copies guard against losing it; the
+  // ground station ignores the extras
+  uint8_t fin[kDatagramHeaderSize];
+  size_t len = encode_fin(seq_, fin);
+  for (int i = 0; i < kFinCopies; ++i)
+    (void)!::send(fd_, fin, len, 0);
+}
+
+ImpairmentProxy::ImpairmentProxy(uint16_t forward_port, const ChannelImpairment &impairment)
+    : impairment_(impairment),
+      in_fd_(open_udp_socket(0, true)),
+      out_fd_(connect_udp_loopback(forward_port)),
+      stop_fd_(eventfd(0, EFD_NONBLOCK))
+{
+  if (in_fd_ < 0 || out_fd_ < 0)
+    return;
+  port_ = local_port(in_fd_);
+  int size = kReceiveBuffer;
+  setsockopt(in_fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  thread_ = std::thread(&ImpairmentProxy::run, this);
+}
+
+void ImpairmentProxy::stop()
+{
+  if (thread_.joinable())
+  {
+    uint64_t one = 1;
+    (void)!write(stop_fd_, &one, sizeof(one));
+    thread_.join();
+  }
+}
+
+ImpairmentProxy::~ImpairmentProxy()
+{
+  stop();
+  for (int fd : {in_fd_, out_fd_, stop_fd_})
+    if (fd >= 0)
+      close(fd);
+}
+
+void ImpairmentProxy::run()
+{
+  struct Held
+  {
+    Clock::time_point due;
+    uint64_t order; // ties go out in arrival order
+    std::vector<uint8_t> bytes;
+    bool operator>(const Held &o) const { return due != o.due ? due > o.due : order > o.order; }
+  };
+  std::priority_queue<Held, std::vector<Held>, std::greater<Held>> held;
+  Clock::time_point latest_due{};
+  uint64_t order = 0;
+
+  std::mt19937_64 rng(impairment_.seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  constexpr size_t kBatch = 64;
+  std::vector<uint8_t> storage(kBatch * kMaxDatagramSize);
+  std::vector<mmsghdr> msgs(kBatch);
+  std::vector<iovec> iov(kBatch);
+  bool stopping = false;
+
+  while (true)
+  {
+    int timeout = -1;
+    if (!held.empty())
+    {
+      auto left = std::chrono::duration_cast<std::chrono::microseconds>(held.top().due - Clock::now());
+      timeout = static_cast<int>(std::max<int64_t>((left.count() + 999) / 1000, 0));
+    }
+    else if (stopping)
+      timeout = 0;
+
+    // Once stopping, the eventfd stays readable, so it is no longer polled
+    pollfd fds[2] = {{in_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+    int ready = poll(fds, stopping ? 1 : 2, timeout);
+    if (ready < 0 && errno != EINTR)
+      return;
+    if (!stopping && (fds[1].revents & POLLIN))
+      stopping = true;
+
+    // Everything the sender handed over so far, through the impairment model
+    int n;
+    do
+    {
+      for (size_t i = 0; i < kBatch; ++i)
+      {
+        iov[i] = {storage.data() + i * kMaxDatagramSize, kMaxDatagramSize};
+        msgs[i] = {};
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      n = recvmmsg(in_fd_, msgs.data(), kBatch, MSG_DONTWAIT, nullptr);
+      Clock::time_point now = Clock::now();
+      for (int i = 0; i < n; ++i)
+      {
+        const uint8_t *data = storage.data() + i * kMaxDatagramSize;
+        size_t len = msgs[i].msg_len;
+        bool fin = len >= kDatagramHeaderSize && (data[7] & kFlagFin);
+
+        Clock::time_point due = now + impairment_.delay;
+        if (fin)
+          due = std::max(due, latest_due);
+        else
+        {
+          if (uniform(rng) < impairment_.loss)
+          {
+            dropped_++;
+            udp_metrics().injected_drops.add();
+            continue;
+          }
+          due += std::chrono::microseconds(static_cast<int64_t>(uniform(rng) * impairment_.jitter.count()));
+          if (uniform(rng) < impairment_.reorder)
+          {
+            due += impairment_.reorder_hold;
+            reordered_++;
+            udp_metrics().injected_holds.add();
+          }
+        }
+        latest_due = std::max(latest_due, due);
+        held.push(Held{due, order++, std::vector<uint8_t>(data, data + len)});
+      }
+    } while (n == static_cast<int>(kBatch));
+
+    // Forward everything that is due, many datagrams per call
+    Clock::time_point now = Clock::now();
+    std::vector<Held> due;
+    while (!held.empty() && held.top().due <= now)
+    {
+      due.push_back(std::move(const_cast<Held &>(held.top())));
+      held.pop();
+    }
+    for (size_t sent = 0; sent < due.size();)
+    {
+      size_t count = std::min(kBatch, due.size() - sent);
+      for (size_t i = 0; i < count; ++i)
+      {
+        iov[i] = {due[sent + i].bytes.data(), due[sent + i].bytes.size()};
+        msgs[i] = {};
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      int m = sendmmsg(out_fd_, msgs.data(), count, 0);
+      if (m < 0 && errno == EINTR)
+        continue;
+      // Refused or failed datagrams are lost, as they would be on a real link
+      size_t moved = m > 0 ? static_cast<size_t>(m) : 1;
+      if (m > 0)
+        forwarded_ += m;
+      sent += moved;
+    }
+
+    if (stopping && held.empty() && n <= 0)
+      return;
+  }
+}
+
+namespace
+{
+  struct UdpFlow
+  {
+    std::string name;
+    uint32_t next_seq = 0; // one past the highest sequence seen
+    uint64_t datagrams = 0, packets = 0, bytes = 0, gaps = 0, reordered = 0;
+    bool finished = false;
+    uint32_t sent = 0; // from the FIN
+    Clock::time_point opened = Clock::now();
+
+    // Every sequence number below next_seq that never arrived
+    uint64_t lost() const
+    {
+      uint64_t expected = finished ? sent : next_seq;
+      return expected > datagrams ? expected - datagrams : 0;
+    }
+  };
+
+  std::string endpoint_name(const sockaddr_in &addr)
+  {
+    char ip[INET_ADDRSTRLEN] = "?";
+    inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+    return std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+  }
+}
+
+void run_udp_ground_station(const LinkConfig &config, GroundStationSink &sink, int sock)
+{
+  int size = kReceiveBuffer;
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  std::cout << "[Ground Station] Listening for UDP datagrams...\n";
+
+  const size_t batch = std::max<size_t>(config.datagram_batch, 1);
+  std::vector<uint8_t> storage(batch * kMaxDatagramSize);
+  std::vector<mmsghdr> msgs(batch);
+  std::vector<iovec> iov(batch);
+  std::vector<sockaddr_in> from(batch);
+  std::vector<TelemetryPacket> packets;
+  std::unique_ptr<Codec> compressor = make_codec(config.compression);
+
+  std::unordered_map<uint64_t, UdpFlow> flows;
+  size_t finished = 0;
+  Clock::time_point last_rx = Clock::now();
+
+  UdpMetrics &m = udp_metrics();
+  Counter &rx_frames = metrics().counter("telemetry_rx_frames_total", "Frames received at the ground station");
+  Counter &rx_bytes = metrics().counter("telemetry_rx_bytes_total", "Bytes received at the ground station, framing included");
+
+  while (finished < config.expected_links)
+  {
+    pollfd pfd{sock, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0)
+    {
+      // UDP has no close, so a link that lost every FIN copy is ended by silence
+      if (!flows.empty() && Clock::now() - last_rx > config.udp_idle_timeout)
+      {
+        std::cout << "[Ground Station] No datagrams for " << config.udp_idle_timeout.count() << " ms, giving up.\n";
+        break;
+      }
+      continue;
+    }
+
+    for (size_t i = 0; i < batch; ++i)
+    {
+      iov[i] = {storage.data() + i * kMaxDatagramSize, kMaxDatagramSize};
+      msgs[i] = {};
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = &from[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+    }
+    uint64_t t0 = metrics_now_ns();
+    int n = recvmmsg(sock, msgs.data(), batch, MSG_DONTWAIT, nullptr);
+    if (n <= 0)
+      continue;
+    m.recv.record(metrics_now_ns() - t0);
+    m.rx_syscalls.add();
+    m.rx_datagrams.add(n);
+    last_rx = Clock::now();
+
+    packets.clear();
+    for (int i = 0; i < n; ++i)
+    {
+      uint64_t key = (uint64_t{from[i].sin_addr.s_addr} << 16) | from[i].sin_port;
+      auto it = flows.find(key);
+      if (it == flows.end())
+      {
+        it = flows.emplace(key, UdpFlow{}).first;
+        it->second.name = endpoint_name(from[i]);
+        std::cout << "[Ground Station] New UDP link from " << it->second.name << "\n";
+      }
+      UdpFlow &flow = it->second;
+
+      DatagramHeader h;
+      size_t before = packets.size();
+      try
+      {
+        h = decode_datagram(storage.data() + i * kMaxDatagramSize, msgs[i].msg_len, packets, compressor.get());
+      }
+      catch (const std::exception &)
+      {
+        packets.resize(before);
+        m.malformed.add();
+        continue;
+      }
+
+      if (h.fin)
+      {
+        if (!flow.finished)
+        {
+          flow.finished = true;
+          flow.sent = h.seq;
+          finished++;
+        }
+        continue;
+      }
+
+      int32_t ahead = seq_diff(h.seq, flow.next_seq);
+      if (ahead > 0)
+      {
+        flow.gaps++;
+        m.gaps.add();
+      }
+      if (ahead >= 0)
+        flow.next_seq = h.seq + 1;
+      else
+      {
+        flow.reordered++;
+        m.reordered.add();
+      }
+      flow.datagrams++;
+      flow.packets += h.count;
+      flow.bytes += msgs[i].msg_len;
+      rx_frames.add();
+      rx_bytes.add(msgs[i].msg_len);
+    }
+    sink.deliver(packets.data(), packets.size());
+  }
+
+  for (auto &[key, flow] : flows)
+  {
+    (void)key;
+    uint64_t lost = flow.lost();
+    m.lost.add(lost);
+    double seconds = std::chrono::duration<double>(Clock::now() - flow.opened).count();
+    uint64_t expected = flow.datagrams + lost;
+    std::cout << "[Ground Station] UDP link " << flow.name << ": " << flow.packets << " packets in "
+              << flow.datagrams << " datagrams, lost " << lost << " ("
+              << (expected ? 100.0 * lost / expected : 0.0) << "%) in " << flow.gaps << " gaps, "
+              << flow.reordered << " reordered, " << flow.packets / seconds << " packets/s"
+              << (flow.finished ? "" : ", no FIN") << "\n";
+  }
+}
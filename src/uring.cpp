@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/uring.h"
+#include "../include/net.h"
+
+namespace
+{
+  // user_data of the receiver's two kinds of request
+  constexpr uint64_t kRecvTag = 1;
+  constexpr uint64_t kProvideTag = 2;
+}
+
+IoUring::IoUring(unsigned entries)
+{
+  io_uring_params p{};
+  fd_ = static_cast<int>(syscall(__NR_io_uring_setup, std::max(entries, 1u), &p));
+  if (fd_ < 0)
+    return;
+
+  sq_ring_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap)
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+  cq_ring_ = single_mmap || sq_ring_ == MAP_FAILED
+                 ? sq_ring_
+                 : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+  void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+  if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes == MAP_FAILED)
+  {
+    if (sqes != MAP_FAILED)
+      munmap(sqes, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+      munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED)
+      munmap(sq_ring_, sq_ring_size_);
+    sq_ring_ = cq_ring_ = nullptr;
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+  auto *sq = static_cast<uint8_t *>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+  sq_entries_ = p.sq_entries;
+
+  auto *cq = static_cast<uint8_t *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+}
+
+IoUring::~IoUring()
+{
+  if (fd_ < 0)
+    return;
+  munmap(sqes_, sqes_size_);
+  if (cq_ring_ != sq_ring_)
+    munmap(cq_ring_, cq_ring_size_);
+  munmap(sq_ring_, sq_ring_size_);
+  close(fd_);
+}
+
+io_uring_sqe *IoUring::get_sqe()
+{
+  // The kernel only reads the tail inside io_uring_enter, so new SQEs are
+  // published in one go by submit()
+  unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  unsigned tail = *sq_tail_ + queued_;
+  if (tail - head >= sq_entries_)
+    return nullptr;
+
+  unsigned index = tail & *sq_mask_;
+  sq_array_[index] = index;
+  queued_++;
+  io_uring_sqe *sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+bool IoUring::submit(unsigned wait_nr)
+{
+  unsigned to_submit = queued_;
+  __atomic_store_n(sq_tail_, *sq_tail_ + queued_, __ATOMIC_RELEASE);
+  queued_ = 0;
+
+  // Retrying with the same count is safe: the kernel never takes more than is left in the ring
+  while (true)
+  {
+    enters_++;
+    long ret = syscall(__NR_io_uring_enter, fd_, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    if (ret >= 0)
+      return true;
+    if (errno != EINTR)
+      return false;
+  }
+}
+
+bool IoUring::peek(io_uring_cqe &out)
+{
+  unsigned head = *cq_head_;
+  if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+    return false;
+  out = cqes_[head & *cq_mask_];
+  __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool IoUring::register_files(const int *fds, unsigned count)
+{
+  return syscall(__NR_io_uring_register, fd_, IORING_REGISTER_FILES, fds, count) == 0;
+}
+
+bool IoUring::register_buffers(const iovec *iov, unsigned count)
+{
+  return syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, iov, count) == 0;
+}
+
+UringSender::UringSender(int sock, const LinkConfig &config)
+    : ring_(static_cast<unsigned>(std::max<size_t>(config.uring_depth, 1))), sock_(sock),
+      depth_(std::max<size_t>(config.uring_depth, 1)), memory_(depth_ * 2 * kSlotSize), slots_(depth_ * 2)
+{
+  if (!ring_.ok())
+    return;
+
+  std::vector<iovec> iov(slots_.size());
+  for (unsigned i = 0; i < slots_.size(); ++i)
+  {
+    iov[i] = {slot_data(i), kSlotSize};
+    free_.push_back(i);
+  }
+  ok_ = ring_.register_files(&sock_, 1) && ring_.register_buffers(iov.data(), static_cast<unsigned>(iov.size()));
+}
+
+bool UringSender::submit_chain()
+{
+  io_uring_sqe *last = nullptr;
+  while (!pending_.empty() && chain_.size() < depth_)
+  {
+    io_uring_sqe *sqe = ring_.get_sqe();
+    if (!sqe)
+      break;
+    unsigned s = pending_.front();
+    pending_.pop_front();
+
+    // Fixed file 0 is the socket; offset 0 because sockets have no position
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+    sqe->fd = 0;
+    sqe->addr = reinterpret_cast<uintptr_t>(slot_data(s) + slots_[s].done);
+    sqe->len = static_cast<uint32_t>(slots_[s].len - slots_[s].done);
+    sqe->buf_index = static_cast<uint16_t>(s);
+    sqe->user_data = s;
+    chain_.push_back(s);
+    last = sqe;
+  }
+  if (!last)
+    return true;
+  last->flags &= ~IOSQE_IO_LINK;
+  outstanding_ = chain_.size();
+  if (!ring_.submit())
+    ok_ = false;
+  return ok_;
+}
+
+bool UringSender::reap(bool wait)
+{
+  io_uring_cqe cqe;
+  while (outstanding_ > 0)
+  {
+    if (!ring_.peek(cqe))
+    {
+      if (!wait)
+        return true;
+      if (!ring_.submit(1))
+        return ok_ = false;
+      continue;
+    }
+    outstanding_--;
+    if (cqe.res > 0)
+      slots_[cqe.user_data].done += cqe.res;
+    else if (cqe.res != -ECANCELED)
+    {
+      errno = cqe.res < 0 ? -cqe.res : EPIPE;
+      return ok_ = false;
+    }
+  }
+
+  // A short write fails the links behind it; those go out again, in order, first
+  for (auto it = chain_.rbegin(); it != chain_.rend(); ++it)
+  {
+    if (slots_[*it].done < slots_[*it].len)
+      pending_.push_front(*it);
+    else
+      free_.push_back(*it);
+  }
+  chain_.clear();
+  return true;
+}
+
+// Waits out the chain in flight, or starts the next one if there is none
+bool UringSender::step()
+{
+  return outstanding_ > 0 ? reap(true) : submit_chain();
+}
+
+bool UringSender::send(const uint8_t *data, size_t len)
+{
+  if (!ok_)
+    return false;
+  if (len > kSlotSize)
+  {
+    if (!flush())
+      return false;
+    fallback_sends_++;
+    return send_all(sock_, data, len);
+  }
+
+  if (!reap(false))
+    return false;
+  while (free_.empty())
+    if (!step())
+      return false;
+
+  unsigned s = free_.front();
+  free_.pop_front();
+  std::memcpy(slot_data(s), data, len);
+  slots_[s] = {len, 0};
+  pending_.push_back(s);
+  return pending_.size() < depth_ || outstanding_ > 0 || submit_chain();
+}
+
+bool UringSender::submit()
+{
+  while (ok_ && !pending_.empty())
+    if (!step())
+      return false;
+  return ok_;
+}
+
+bool UringSender::flush()
+{
+  while (ok_ && (outstanding_ > 0 || !pending_.empty()))
+    if (!step())
+      return false;
+  return ok_;
+}
+
+UringReceiver::UringReceiver(int sock) : ring_(kBuffers * 2), memory_(kBuffers * kBufferSize)
+{
+  // Room for every buffer coming back one at a time plus the recv itself
+  ok_ = ring_.ok() && ring_.register_files(&sock, 1) && provide(0, kBuffers) && arm() && ring_.submit();
+}
+
+bool UringReceiver::provide(unsigned first, unsigned count)
+{
+  io_uring_sqe *sqe = ring_.get_sqe();
+  if (!sqe)
+    return false;
+  // Only failures post a completion, so a wait for data is never woken by one of these
+  sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+  sqe->fd = static_cast<int>(count);
+  sqe->addr = reinterpret_cast<uintptr_t>(memory_.data() + first * kBufferSize);
+  sqe->len = kBufferSize;
+  sqe->off = first;
+  sqe->buf_group = 0;
+  sqe->user_data = kProvideTag;
+  return true;
+}
+
+bool UringReceiver::arm()
+{
+  io_uring_sqe *sqe = ring_.get_sqe();
+  if (!sqe)
+    return false;
+  sqe->opcode = IORING_OP_RECV;
+  sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+  sqe->fd = 0;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->buf_group = 0;
+  sqe->user_data = kRecvTag;
+  armed_ = true;
+  return true;
+}
+
+ssize_t UringReceiver::read(uint8_t *out, size_t len)
+{
+  if (!ok_)
+    return -1;
+
+  while (ready_len_ == 0)
+  {
+    if (current_ >= 0)
+    {
+      // Queued only; it reaches the kernel with the next submit, ahead of any re-arm
+      if (!provide(current_, 1))
+        return -1;
+      current_ = -1;
+    }
+    if (eof_)
+      return 0;
+
+    io_uring_cqe cqe;
+    if (!ring_.peek(cqe))
+    {
+      // Nothing buffered: this is the only place the receive path enters the kernel
+      if ((!armed_ && !arm()) || !ring_.submit(1))
+        return -1;
+      continue;
+    }
+    if (cqe.user_data == kProvideTag)
+    {
+      if (cqe.res < 0)
+      {
+        errno = -cqe.res;
+        return -1;
+      }
+      continue;
+    }
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+      armed_ = false;
+    if (cqe.res == -ENOBUFS)
+      continue; // the reader fell behind and every buffer was full; re-armed once they drain
+    if (cqe.res < 0)
+    {
+      errno = -cqe.res;
+      return -1;
+    }
+    if (cqe.res == 0)
+    {
+      eof_ = true;
+      return 0;
+    }
+    current_ = static_cast<int>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    ready_ = memory_.data() + current_ * kBufferSize;
+    ready_len_ = cqe.res;
+  }
+
+  size_t n = std::min(len, ready_len_);
+  std::memcpy(out, ready_, n);
+  ready_ += n;
+  ready_len_ -= n;
+  return static_cast<ssize_t>(n);
+}
+
+bool UringReceiver::read_all(uint8_t *out, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t n = read(out, len);
+    if (n <= 0)
+      return false;
+    out += n;
+    len -= n;
+  }
+  return true;
+}